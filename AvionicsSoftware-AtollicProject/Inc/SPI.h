@@ -17,48 +17,83 @@
 #define SPI_H
 
 #include <inttypes.h>
+#include "stm32f4xx_hal.h"
+
+typedef void* SPI;	//One device on one of the buses, from spi_register_device.
+
+typedef enum
+{
+	SPI_BUS_1 = 0,	//Flash.
+	SPI_BUS_2,		//BMP388.
+	SPI_BUS_3,		//BMI088 accelerometer and gyroscope.
+	SPI_NUM_BUSES
+} spi_bus_id;
+
+//How a device wants to be talked to. Each driver keeps its own, so the pins and ratings stay next to the code for
+//the part.
+typedef struct
+{
+	spi_bus_id bus;
+	GPIO_TypeDef *cs_port;
+	uint16_t cs_pin;
+	uint32_t max_clock_hz;	//Fastest SCK the part is rated for. The bus runs at the fastest prescaler at or below it.
+	uint8_t mode;			//SPI mode 0 to 3: bit 1 is CPOL, bit 0 is CPHA.
+} spi_device_config;
 
-typedef void* SPI;
 // Description:
-//  This function initializes the SPI1 interface.
-SPI spi1_init();
-
-
-// Description:
-//  This function initializes the SPI2 interface.
-SPI spi2_init();
-
+//  Adds a device to its bus, setting up the bus the first time one of its devices is added, and drives the chip
+//  select high. Call from main or a driver init, before the scheduler starts.
+//  A transaction with the device locks the bus, sets the clock and mode if the last device on the bus used
+//  different ones, and asserts the device's own chip select.
+//
+// Returns:
+//  The device, or NULL if there is no room for another one.
+SPI spi_register_device(const spi_device_config *config);
 
 // Description:
-//  This function initializes the SPI3 interface.
-SPI spi3_init();
+//  The SCK frequency a device is talked to at.
+//
+// Returns:
+//  The clock in Hz.
+uint32_t spi_get_clock_hz(SPI device);
 
 // Description:
 //  This function reads one or more bytes over the SPI bus, by sending multiple address bytes
-//  and then reading multiple bytes.
+//  and then reading multiple bytes. The chip select stays asserted for the whole read, so
+//  any number of bytes can be streamed in one transaction.
+//  Once the scheduler is running, longer reads go through DMA: the calling task blocks until
+//  the transfer completes and other tasks keep running in the meantime.
 //
 // Parameters:
-//     hspi             A reference used to refer to the SPI interface.
+//     hspi             The device.
 //     addr_buffer      A pointer to the buffer holding address to read from.
 //	   addr_buffer_size The number of bytes in the address/command.
 //     rx_buffer        A pointer to where the received bytes should be stored
 //     rx_buffer_size   The number of bytes being  received.
 //     timeout          The timeout value in milliseconds.
-void spi_receive(SPI hspi,uint8_t *addr_buffer,uint8_t addr_buffer_size,uint8_t *rx_buffer,uint16_t rx_buffer_size, uint32_t timeout);
+//
+// Returns:
+//  HAL_OK, or the status of the first part of the transaction that failed, e.g. HAL_TIMEOUT for a DMA transfer
+//  that did not complete in time. The contents of rx_buffer are undefined unless it is HAL_OK.
+HAL_StatusTypeDef spi_receive(SPI hspi,uint8_t *addr_buffer,uint8_t addr_buffer_size,uint8_t *rx_buffer,uint32_t rx_buffer_size, uint32_t timeout);
 
 
 // Description:
 //  This function transfers one or more bytes over the SPI bus.
 //  It firstly sends multiple register address bytes.
+//  Like spi_receive, longer payloads are sent by DMA while the calling task blocks.
 //
 // Parameters:
-//     hspi            	A reference used to refer to the SPI interface.
+//     hspi            	The device.
 //     addr_buffer     	A pointer to the buffer holding the address to write to.
 //	   addr_buffer_size	Number of bytes in the address/command.
 //     tx_buffer       	A pointer to the bytes to send.
 //     size            	The number of bytes being sent.
 //     timeout         	The timeout value in milliseconds.
-void spi_send(SPI hspi, uint8_t *reg_addr,uint8_t reg_addr_size, uint8_t *tx_buffer, uint16_t tx_buffer_size, uint32_t timeout);
+//
+// Returns:
+//  HAL_OK, or the status of the first part of the transaction that failed.
+HAL_StatusTypeDef spi_send(SPI hspi, uint8_t *reg_addr,uint8_t reg_addr_size, uint8_t *tx_buffer, uint32_t tx_buffer_size, uint32_t timeout);
 
 
 // Description: DO NOT USE. Will be deleted in future versions of the code!
@@ -66,13 +101,15 @@ void spi_send(SPI hspi, uint8_t *reg_addr,uint8_t reg_addr_size, uint8_t *tx_buf
 //  and then reading
 //
 // Parameters:
-//     hspi            A reference used to refer to the SPI interface.
+//     hspi            The device.
 //     addr_buffer     A pointer to the address to read from.
 //     rx_buffer       A pointer to where the received bytes should be stored
 //     total_size      The number of bytes being sent and received. (# of bytes read + 1)
 //     timeout         The timeout value in milliseconds.
-
-void spi_read(SPI hspi,uint8_t *addr_buffer,uint8_t *rx_buffer,uint16_t total_size, uint32_t timeout);
+//
+// Returns:
+//  As spi_receive.
+HAL_StatusTypeDef spi_read(SPI hspi,uint8_t *addr_buffer,uint8_t *rx_buffer,uint16_t total_size, uint32_t timeout);
 
 
 // Description:  DO NOT USE! Will be deleted in future versions of the code!
@@ -80,12 +117,15 @@ void spi_read(SPI hspi,uint8_t *addr_buffer,uint8_t *rx_buffer,uint16_t total_si
 //  It firstly sends the register address (hard coded to be a 1 byte address).
 //
 // Parameters:
-//     hspi            A reference used to refer to the SPI interface.
+//     hspi            The device.
 //     addr_buffer     A pointer to the address to write to.
 //     tx_buffer       A pointer to the bytes to send.
 //     size            The number of bytes being sent.
 //     timeout         The timeout value in milliseconds.
-void spi_transmit(SPI hspi, uint8_t *reg_addr, uint8_t *tx_buffer,uint16_t total_size, uint32_t timeout);
+//
+// Returns:
+//  As spi_send.
+HAL_StatusTypeDef spi_transmit(SPI hspi, uint8_t *reg_addr, uint8_t *tx_buffer,uint16_t total_size, uint32_t timeout);
 
 #endif /* SPI_H_ */
 
@@ -18,5 +18,14 @@ void stm32_error_handler(void);
 void stm32_delay(uint32_t ms);
 void stm32_led_blink();
 
+// Description:
+//  Starts TIM5 as a free running 32 bit counter at 1 MHz. Called by stm32_init.
+STM32Status stm32_timestamp_init(void);
+
+// Description:
+//  Microseconds since stm32_timestamp_init. Wraps after about 71 minutes, so only use differences.
+//  Safe to call from interrupts.
+uint32_t stm32_get_time_us(void);
+
 
 #endif //AVIONICS_STM32_H
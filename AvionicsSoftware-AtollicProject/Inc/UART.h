@@ -14,9 +14,11 @@
 // - Created.
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #define TIMEOUT_MAX 0xFFFF
 #define BUFFER_SIZE 2048
+#define UART_RX_RING_SIZE 256	//Bytes the receive DMA can hold before uart_receive_available must be called.
 
 typedef void* UART;
 
@@ -92,6 +94,66 @@ void uart_transmit_line(UART uart, const char * message);
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 void uart_transmit_bytes(UART uart, uint8_t * bytes, uint16_t numBytes);
 
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts sending bytes by DMA and returns straight away. The bytes must stay untouched until uart_wait_transmit_done
+//	returns true. Only UART port 6 has DMA, other ports send the bytes blocking before this returns.
+//
+// Parameters:
+//  UART uart - UART port to uart_transmit to
+//  uint8_t* bytes - A pointer to the bytes you want to send.
+//
+// Returns:
+//  true if the transfer started.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool uart_transmit_bytes_dma(UART uart, uint8_t * bytes, uint16_t numBytes);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Blocks the calling task until the DMA transfer started by uart_transmit_bytes_dma is done, or timeout milliseconds.
+//
+// Returns:
+//  true if nothing is being sent any more.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool uart_wait_transmit_done(UART uart, uint32_t timeout);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Changes the baud rate. Anything still being sent is cut off, so wait for it first.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void uart_set_baud_rate(UART uart, uint32_t baud_rate);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts receiving into a ring buffer by circular DMA, so nothing is lost while the task is busy. UART port 6 only.
+//	uart_receive_command must not be used until uart_receive_stop is called.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void uart_receive_start(UART uart);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies up to max bytes that arrived since the last call. Never blocks.
+//
+// Returns:
+//  The number of bytes copied.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t uart_receive_available(UART uart, uint8_t * bytes, uint16_t max);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Stops the receive DMA started by uart_receive_start.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void uart_receive_stop(UART uart);
+
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
 //	BLOCKING FUNCTION
@@ -320,6 +320,69 @@ int8_t bmi08a_get_sensor_time(const struct bmi08x_dev *dev, uint32_t *sensor_tim
  */
 int8_t bmi08a_perform_selftest(struct bmi08x_dev *dev);
 
+/*!
+ *  @brief This API sets the FIFO mode and the frame contents of the accel FIFO,
+ *  and flushes whatever the FIFO held before.
+ *
+ *  @param[in] config : Structure instance of bmi08x_accel_fifo_config.
+ *  @param[in] dev    : Structure instance of bmi08x_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08a_set_fifo_config(const struct bmi08x_accel_fifo_config *config, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API sets the accel FIFO watermark level in bytes.
+ *
+ *  @param[in] wm_level : Watermark level (bytes).
+ *  @param[in] dev      : Structure instance of bmi08x_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08a_set_fifo_wm(uint16_t wm_level, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API reads the number of bytes in the accel FIFO.
+ *
+ *  @param[out] fifo_length : Number of bytes in the FIFO.
+ *  @param[in]  dev         : Structure instance of bmi08x_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08a_get_fifo_length(uint16_t *fifo_length, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API reads fifo->length bytes from the accel FIFO in one burst
+ *  and resets the parser state of fifo.
+ *
+ *  @param[in,out] fifo : Structure instance of bmi08x_fifo_frame.
+ *  @param[in]     dev  : Structure instance of bmi08x_dev.
+ *  @note : fifo->data must hold fifo->length + 1 bytes, the SPI dummy byte is read into it as well.
+ *  On return fifo->length counts the dummy byte and fifo->byte_start_idx points past it.
+ *  Asking for 4 bytes more than bmi08a_get_fifo_length reports makes the sensor append a sensor time frame.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08a_read_fifo_data(struct bmi08x_fifo_frame *fifo, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API parses the accel frames out of the data read by
+ *  bmi08a_read_fifo_data. Sensor time and skip frames update fifo.
+ *
+ *  @param[out]    accel_data   : Array the accel frames are written to.
+ *  @param[in,out] accel_length : In: size of accel_data. Out: number of frames parsed.
+ *  @param[in,out] fifo         : Structure instance of bmi08x_fifo_frame.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08a_extract_accel(struct bmi08x_sensor_data *accel_data, uint16_t *accel_length,
+							struct bmi08x_fifo_frame *fifo);
+
 /*********************** BMI088 Gyroscope function prototypes ****************************/
 /*!
  *  @brief This API is the entry point for gyro sensor.
@@ -467,6 +530,55 @@ int8_t bmi08g_set_int_config(const struct bmi08x_gyro_int_channel_cfg *int_confi
  */
 int8_t bmi08g_perform_selftest(const struct bmi08x_dev *dev);
 
+/*!
+ *  @brief This API sets the gyro FIFO mode and watermark, and flushes the FIFO.
+ *
+ *  @param[in] config : Structure instance of bmi08x_gyro_fifo_config.
+ *  @param[in] dev    : Structure instance of bmi08x_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08g_set_fifo_config(const struct bmi08x_gyro_fifo_config *config, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API reads the number of frames in the gyro FIFO.
+ *
+ *  @param[out] frame_count : Number of frames in the FIFO.
+ *  @param[out] overrun     : Set if frames were lost because the FIFO was full. May be NULL.
+ *  @param[in]  dev         : Structure instance of bmi08x_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08g_get_fifo_frame_count(uint8_t *frame_count, uint8_t *overrun, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API reads fifo->length bytes from the gyro FIFO in one burst
+ *  and resets the parser state of fifo.
+ *
+ *  @param[in,out] fifo : Structure instance of bmi08x_fifo_frame.
+ *  @param[in]     dev  : Structure instance of bmi08x_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08g_read_fifo_data(struct bmi08x_fifo_frame *fifo, const struct bmi08x_dev *dev);
+
+/*!
+ *  @brief This API parses the gyro frames out of the data read by
+ *  bmi08g_read_fifo_data.
+ *
+ *  @param[out]    gyro_data   : Array the gyro frames are written to.
+ *  @param[in,out] gyro_length : In: size of gyro_data. Out: number of frames parsed.
+ *  @param[in,out] fifo        : Structure instance of bmi08x_fifo_frame.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi08g_extract_gyro(struct bmi08x_sensor_data *gyro_data, uint16_t *gyro_length,
+						   struct bmi08x_fifo_frame *fifo);
+
 #ifdef __cplusplus
 }
 #endif
@@ -230,6 +230,24 @@
 /**\name    Accel Soft reset register */
 #define BMI08X_ACCEL_SOFTRESET_REG                  UINT8_C(0x7E)
 
+/**\name    Accel FIFO length registers */
+#define BMI08X_ACCEL_FIFO_LENGTH_0_REG              UINT8_C(0x24)
+#define BMI08X_ACCEL_FIFO_LENGTH_1_REG              UINT8_C(0x25)
+
+/**\name    Accel FIFO data register */
+#define BMI08X_ACCEL_FIFO_DATA_REG                  UINT8_C(0x26)
+
+/**\name    Accel FIFO downsampling register */
+#define BMI08X_ACCEL_FIFO_DOWNS_REG                 UINT8_C(0x45)
+
+/**\name    Accel FIFO watermark registers */
+#define BMI08X_ACCEL_FIFO_WTM_0_REG                 UINT8_C(0x46)
+#define BMI08X_ACCEL_FIFO_WTM_1_REG                 UINT8_C(0x47)
+
+/**\name    Accel FIFO configuration registers */
+#define BMI08X_ACCEL_FIFO_CONFIG_0_REG              UINT8_C(0x48)
+#define BMI08X_ACCEL_FIFO_CONFIG_1_REG              UINT8_C(0x49)
+
 #if BMI08X_FEATURE_BMI085 == 1
 /**\name    BMI085 Accel unique chip identifier */
 #define BMI08X_ACCEL_CHIP_ID                        UINT8_C(0x1F)
@@ -290,6 +308,40 @@
 #define BMI08X_ACCEL_PM_ACTIVE                      UINT8_C(0x00)
 #define BMI08X_ACCEL_PM_SUSPEND                     UINT8_C(0x03)
 
+/**\name    Accel FIFO configuration */
+#define BMI08X_ACCEL_FIFO_MODE_STREAM               UINT8_C(0x00)
+#define BMI08X_ACCEL_FIFO_MODE_FIFO                 UINT8_C(0x01)
+#define BMI08X_ACCEL_FIFO_CONFIG_0_RESERVED         UINT8_C(0x02)
+#define BMI08X_ACCEL_FIFO_CONFIG_1_RESERVED         UINT8_C(0x10)
+#define BMI08X_ACCEL_FIFO_ACC_EN                    UINT8_C(0x40)
+#define BMI08X_ACCEL_FIFO_INT1_EN                   UINT8_C(0x08)
+#define BMI08X_ACCEL_FIFO_INT2_EN                   UINT8_C(0x04)
+#define BMI08X_ACCEL_FIFO_FLUSH_CMD                 UINT8_C(0xB0)
+
+/**\name    Accel FIFO sizes (in bytes) */
+#define BMI08X_ACCEL_FIFO_SIZE                      UINT16_C(1024)
+#define BMI08X_ACCEL_FIFO_LENGTH_MASK               UINT16_C(0x3FFF)
+
+/**\name    Accel FIFO frame headers. The two lowest bits carry the interrupt tags. */
+#define BMI08X_ACCEL_FIFO_HEADER_MASK               UINT8_C(0xFC)
+#define BMI08X_ACCEL_FIFO_HEADER_ACCEL              UINT8_C(0x84)
+#define BMI08X_ACCEL_FIFO_HEADER_SKIP               UINT8_C(0x40)
+#define BMI08X_ACCEL_FIFO_HEADER_SENSOR_TIME        UINT8_C(0x44)
+#define BMI08X_ACCEL_FIFO_HEADER_CONFIG_CHANGE      UINT8_C(0x48)
+#define BMI08X_ACCEL_FIFO_HEADER_DROP               UINT8_C(0x50)
+#define BMI08X_ACCEL_FIFO_HEADER_EMPTY              UINT8_C(0x80)
+
+/**\name    Accel FIFO frame lengths, header included */
+#define BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH        UINT8_C(7)
+#define BMI08X_ACCEL_FIFO_SENSOR_TIME_FRAME_LENGTH  UINT8_C(4)
+#define BMI08X_ACCEL_FIFO_SHORT_FRAME_LENGTH        UINT8_C(2)
+
+/**\name    Accel sensor time: 24 bit counter, 1 LSB = 39.0625 us (25.6 kHz) */
+#define BMI08X_ACCEL_SENSORTIME_MASK                UINT32_C(0x00FFFFFF)
+#define BMI08X_ACCEL_SENSORTIME_HZ                  UINT32_C(25600)
+/**\name    fifo->sensor_time when no sensor time frame was parsed */
+#define BMI08X_ACCEL_FIFO_NO_SENSOR_TIME            UINT32_C(0xFFFFFFFF)
+
 /**\name    Accel Power control settings */
 #define BMI08X_ACCEL_POWER_DISABLE                  UINT8_C(0x00)
 #define BMI08X_ACCEL_POWER_ENABLE                   UINT8_C(0x04)
@@ -348,10 +400,14 @@
 /**\name    Mask definitions for INT1_INT2_MAP_DATA register */
 #define BMI08X_ACCEL_INT1_DRDY_MASK                 UINT8_C(0x04)
 #define BMI08X_ACCEL_INT2_DRDY_MASK                 UINT8_C(0x40)
+#define BMI08X_ACCEL_INT1_FWM_MASK                  UINT8_C(0x02)
+#define BMI08X_ACCEL_INT2_FWM_MASK                  UINT8_C(0x20)
 
 /**\name    Position definitions for INT1_INT2_MAP_DATA register */
 #define BMI08X_ACCEL_INT1_DRDY_POS                  UINT8_C(2)
 #define BMI08X_ACCEL_INT2_DRDY_POS                  UINT8_C(6)
+#define BMI08X_ACCEL_INT1_FWM_POS                   UINT8_C(1)
+#define BMI08X_ACCEL_INT2_FWM_POS                   UINT8_C(5)
 
 /**\name    Asic Initialization value */
 #define BMI08X_ASIC_INITIALIZED                     UINT8_C(0x01)
@@ -408,6 +464,35 @@
 /**\name    Gyro Self test register */
 #define BMI08X_GYRO_SELF_TEST_REG                   UINT8_C(0x3C)
 
+/**\name    Gyro FIFO status register */
+#define BMI08X_GYRO_FIFO_STATUS_REG                 UINT8_C(0x0E)
+
+/**\name    Gyro FIFO watermark enable register */
+#define BMI08X_GYRO_FIFO_WM_ENABLE_REG              UINT8_C(0x1E)
+
+/**\name    Gyro FIFO configuration registers */
+#define BMI08X_GYRO_FIFO_CONFIG_0_REG               UINT8_C(0x3D)
+#define BMI08X_GYRO_FIFO_CONFIG_1_REG               UINT8_C(0x3E)
+
+/**\name    Gyro FIFO data register */
+#define BMI08X_GYRO_FIFO_DATA_REG                   UINT8_C(0x3F)
+
+/**\name    Gyro FIFO configuration */
+#define BMI08X_GYRO_FIFO_MODE_BYPASS                UINT8_C(0x00)
+#define BMI08X_GYRO_FIFO_MODE_FIFO                  UINT8_C(0x40)
+#define BMI08X_GYRO_FIFO_MODE_STREAM                UINT8_C(0x80)
+#define BMI08X_GYRO_FIFO_WM_ENABLE                  UINT8_C(0x88)
+#define BMI08X_GYRO_FIFO_WM_DISABLE                 UINT8_C(0x08)
+#define BMI08X_GYRO_FIFO_WM_LEVEL_MASK              UINT8_C(0x7F)
+
+/**\name    Gyro FIFO status */
+#define BMI08X_GYRO_FIFO_FRAME_COUNT_MASK           UINT8_C(0x7F)
+#define BMI08X_GYRO_FIFO_OVERRUN_MASK               UINT8_C(0x80)
+
+/**\name    Gyro FIFO sizes. Gyro frames carry no header, only x, y and z. */
+#define BMI08X_GYRO_FIFO_FRAME_LENGTH               UINT8_C(6)
+#define BMI08X_GYRO_FIFO_MAX_FRAMES                 UINT8_C(100)
+
 /**\name    Gyro unique chip identifier */
 #define BMI08X_GYRO_CHIP_ID                         UINT8_C(0x0F)
 
@@ -750,7 +835,8 @@ enum bmi08x_accel_int_types {
 BMI08X_ACCEL_DATA_RDY_INT,      /* Accel data ready interrupt */
 BMI08X_ACCEL_SYNC_DATA_RDY_INT, /* Accel synchronized data ready interrupt */
 BMI08X_ACCEL_SYNC_INPUT,        /* Accel synchronized data ready input*/
-BMI08X_ACCEL_ANYMOTION_INT      /* Accel anymotion interrupt for BMI085 */
+BMI08X_ACCEL_ANYMOTION_INT,     /* Accel anymotion interrupt for BMI085 */
+BMI08X_ACCEL_FIFO_WM_INT        /* Accel FIFO watermark interrupt */
 };
 
 /*!
@@ -809,6 +895,46 @@ enum bmi08x_gyro_int_types int_type;
 struct bmi08x_int_pin_cfg int_pin_cfg;
 };
 
+/*!
+ *  @brief Accel FIFO configuration structure
+ */
+struct bmi08x_accel_fifo_config {
+/*! BMI08X_ACCEL_FIFO_MODE_STREAM or BMI08X_ACCEL_FIFO_MODE_FIFO */
+uint8_t mode;
+/*! Store accel frames in the FIFO */
+uint8_t accel_en;
+/*! Store INT1 / INT2 input tags in the frame headers */
+uint8_t int1_en;
+uint8_t int2_en;
+};
+
+/*!
+ *  @brief Gyro FIFO configuration structure
+ */
+struct bmi08x_gyro_fifo_config {
+/*! BMI08X_GYRO_FIFO_MODE_BYPASS, BMI08X_GYRO_FIFO_MODE_FIFO or BMI08X_GYRO_FIFO_MODE_STREAM */
+uint8_t mode;
+/*! Watermark level in frames, 0 disables the watermark interrupt */
+uint8_t wm_level;
+};
+
+/*!
+ *  @brief FIFO frame structure. Holds one burst read of a FIFO and the parser state.
+ */
+struct bmi08x_fifo_frame {
+/*! Buffer the FIFO is read into. Must hold length bytes plus one SPI dummy byte */
+uint8_t *data;
+/*! Number of bytes to read / bytes read */
+uint16_t length;
+/*! Index of the next byte the parser looks at */
+uint16_t byte_start_idx;
+/*! Last sensor time frame found in the data (accel only).
+ *  BMI08X_ACCEL_FIFO_NO_SENSOR_TIME if the burst did not end with one */
+uint32_t sensor_time;
+/*! Frames the sensor skipped because the FIFO was full (accel only) */
+uint8_t skipped_frame_count;
+};
+
 /*!
  *  @brief Interrupt Configuration structure
  */
@@ -30,8 +30,14 @@
 #define DATA_RATE 				50
 #define INITIAL_WAIT_TIME 		10000			//in milliseconds
 #define FLAGS 					0x00			//default not in flight, not recording.
-#define DATA_START_ADDRESS		0x00001000		//Start writing to second page of memory.
-#define DATA_END_ADDRESS		0x00001000		//Assume no saved data.
+#define DATA_START_ADDRESS		FLASH_START_ADDRESS		//Data starts right after the configuration journal.
+#define DATA_END_ADDRESS		FLASH_START_ADDRESS		//Assume no saved data.
+
+//The configuration is saved as a journal of records in the first parameter sectors. Each save programs the next
+//empty slot, so no erase is needed until the journal wraps around.
+#define CONFIG_JOURNAL_ADDRESS	0x00000000
+#define CONFIG_JOURNAL_SECTORS	2				//Must match the space reserved in front of FLASH_START_ADDRESS.
+#define CONFIG_RECORD_SIZE		128				//Slot size in bytes. Divides FLASH_PAGE_SIZE, so a record never crosses a page.
 
 #define ACC_BANDWIDTH			BMI08X_ACCEL_BW_NORMAL
 #define ACC_ODR					BMI08X_ACCEL_ODR_100_HZ
@@ -51,12 +57,42 @@
 #define GND_ALT					0
 #define GND_PRES				101325
 
+//The log policy of each log_phase in utilities/log_rate.h: pad, ascent, drogue, main and landed.
+//Log rates in Hz. 0 leaves the sensor out of the log, LOG_RATE_ALL logs every sample.
+#define CONFIG_LOG_PHASES		5
+#define LOG_RATE_ALL			255
+#define IMU_LOG_RATES			{10, LOG_RATE_ALL, 100, 10, 1}
+#define BARO_LOG_RATES			{5, LOG_RATE_ALL, 50, 5, 1}
+
+//Channels logged in each phase. A sensor with none of its channels on is not logged at all.
+#define LOG_CHANNEL_ACC			0x01
+#define LOG_CHANNEL_GYRO		0x02
+#define LOG_CHANNEL_PRESSURE	0x04
+#define LOG_CHANNEL_TEMPERATURE	0x08
+#define LOG_CHANNEL_ALTITUDE	0x10
+#define LOG_CHANNELS_IMU		(LOG_CHANNEL_ACC | LOG_CHANNEL_GYRO)
+#define LOG_CHANNELS_BARO		(LOG_CHANNEL_PRESSURE | LOG_CHANNEL_TEMPERATURE | LOG_CHANNEL_ALTITUDE)
+#define LOG_CHANNELS_ALL		(LOG_CHANNELS_IMU | LOG_CHANNELS_BARO)
+#define LOG_CHANNELS			{LOG_CHANNEL_ACC | LOG_CHANNELS_BARO, LOG_CHANNELS_ALL, LOG_CHANNELS_ALL, \
+								 LOG_CHANNEL_ACC | LOG_CHANNELS_BARO, LOG_CHANNELS_BARO}
+
+//Precision of each phase, as the number of low bits dropped from the IMU values (low nibble) and from the pressure
+//sensor values (high nibble). The values are rounded to the nearest multiple of 1 << bits.
+#define LOG_PRECISION(imu_bits, baro_bits)	((uint8_t) (((baro_bits) << 4) | (imu_bits)))
+#define LOG_PRECISION_IMU(x)	((x) & 0x0F)
+#define LOG_PRECISION_BARO(x)	(((x) >> 4) & 0x0F)
+#define LOG_PRECISION_MAX_BITS	12
+#define LOG_PRECISIONS			{LOG_PRECISION(0, 0), LOG_PRECISION(0, 0), LOG_PRECISION(0, 0), \
+								 LOG_PRECISION(3, 4), LOG_PRECISION(0, 4)}
+
 //Macros to get flags.
 #define IS_IN_FLIGHT(x)		((x>>0)&0x01)
 #define	IS_RECORDING(x)		((x>>1)&0x01)
 #define CONFIGURATION_IS_PRE_DROGUE(x)	((x>>2)&0x01)
 #define CONFIGURATION_IS_POST_DROGUE(x)	((x>>3)&0x01)
 #define CONFIGURATION_IS_POST_MAIN(x)		((x>>4)&0x01)
+#define IS_PROFILING(x)		((x>>5)&0x01)	//Timings go in the flight log, see utilities/profiler.h.
+#define IS_LOG_DECIMATING(x)	((x>>6)&0x01)	//Log the newest sample at the log rate instead of the average since the last one.
 
 
 typedef enum
@@ -102,6 +138,11 @@ typedef struct {
 	float	 	 ref_alt;
 	float 	 	 ref_pres;
 
+	uint8_t		 imu_log_rate[CONFIG_LOG_PHASES];
+	uint8_t		 baro_log_rate[CONFIG_LOG_PHASES];
+	uint8_t		 log_channels[CONFIG_LOG_PHASES];
+	uint8_t		 log_precision[CONFIG_LOG_PHASES];
+
 	Flash flash;
 	uint8_t state;
 
@@ -126,17 +167,20 @@ ConfigStatus init_config(configuration_data_t* configuration);
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
-//  Reads the configuration values from flash memory..
+//  Reads the configuration values from flash memory.
+//	Scans the journal and loads the newest record with a valid CRC. The flash handle and state are left alone.
 //
 // Returns:
-//  Returns a ConfigStatus with OK or ERROR.
+//  Returns a ConfigStatus with OK, or ERROR if there is no valid record in the journal.
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 ConfigStatus read_config(configuration_data_t* configuration);
 
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
-//  Writes the configuration values to flash memory..
+//  Writes the configuration values to flash memory.
+//	Appends one record to the journal, which is a single page program. When the write fills a sector, the erase of
+//	the next sector is started but not waited for. The next flash operation waits for it instead.
 //
 // Returns:
 //  Returns a ConfigStatus with OK or ERROR.
@@ -15,6 +15,7 @@
 
 #include <stdio.h>
 #include <inttypes.h>
+#include <stdbool.h>
 
 /**
  * So far flash.h must depend on SPI.h because it initializes SPI_HandleTypeDef
@@ -28,10 +29,13 @@
 #define 	FLASH_ENABLE_WRITE_COMMAND		0x06		//Write Enable
 #define		FLASH_PP_COMMAND				0x02		//Page Program Command (write)
 #define		FLASH_READ_COMMAND				0x03
+#define		FLASH_FAST_READ_COMMAND			0x0B		//Read with one dummy byte, valid at the full SPI clock.
 #define 	FLASH_ERASE_SEC_COMMAND			0xD8
 #define 	FLASH_ERASE_PARAM_SEC_COMMAND	0x20
 #define		FLASH_GET_STATUS_REG_COMMAND	0x05
 #define		FLASH_BULK_ERASE_COMMAND		0x60		//Command to erase the whole device.
+#define		FLASH_ERASE_SUSPEND_COMMAND		0x75		//Pauses a sector erase so other sectors can be read or programmed.
+#define		FLASH_ERASE_RESUME_COMMAND		0x7A
 
 /**
  *  @brief Macros for constants
@@ -46,9 +50,9 @@
 #define 	FLASH_LOW_BYTE_MASK_24B			0x000000FF
 #define 	FLASH_PAGE_SIZE					256
 #define 	FLASH_PARAM_SECTOR_SIZE			(FLASH_PAGE_SIZE*16)
-#define		FLASH_SECTOR_SIZE				(FLASH_PAGE_SIZE*64)
-#define 	FLASH_START_ADDRESS				(0x00000000+FLASH_PARAM_SECTOR_SIZE)
-#define		FLASH_SIZE_BYTES				(8000000-FLASH_PARAM_SECTOR_SIZE)
+#define		FLASH_SECTOR_SIZE				(FLASH_PAGE_SIZE*256)		//What FLASH_ERASE_SEC_COMMAND clears: 64 kB on the S25FL064P.
+#define 	FLASH_START_ADDRESS				(0x00000000+2*FLASH_PARAM_SECTOR_SIZE)	//The first two parameter sectors hold the configuration journal.
+#define		FLASH_SIZE_BYTES				(8000000-2*FLASH_PARAM_SECTOR_SIZE)
 #define 	FLASH_PARAM_END_ADDRESS			(0x0001FFFF)
 #define 	FLASH_END_ADDRESS				(0x7FFFFF)
 
@@ -72,7 +76,8 @@ typedef enum flash_status_t
 {
 	FLASH_ERROR, /**< If the lat operation failed. */
 	FLASH_OK,    /**< If the last operation was successful. */
-	FLASH_BUSY   /**< If the last operation couldn't start because the device was busy. */
+	FLASH_BUSY,  /**< If the last operation couldn't start because the device was busy. */
+	FLASH_CORRUPT /**< If the data on the flash is not laid out the way the operation expects. */
 } FlashStatus;
 
 /**
@@ -116,10 +121,24 @@ FlashStatus flash_check_id(Flash p_flash);
  */
 FlashStatus flash_program_page(Flash p_flash, uint32_t address, uint8_t *data_buffer, uint16_t num_bytes);
 
+/**
+ * @brief
+ * This streams any number of bytes starting at a specified location in the flash memory.
+ * The whole transfer is a single FAST_READ command: the chip select stays asserted and the
+ * device auto-increments the address across page and sector boundaries.
+ * @param p_flash Pointer to @c Flash structure
+ * @param address Address of the first byte (0x000000 to 0x7FFFFF).
+ * @param data_buffer Destination, must hold at least @c num_bytes bytes.
+ * @param num_bytes Number of bytes to read.
+ * @return @c FlashStatus. Will be FLASH_BUSY if there is another operation in progress, FLASH_OK otherwise.
+ * @see https://github.com/UMSATS/Avionics-2019/
+ */
+FlashStatus flash_read(Flash p_flash, uint32_t address, uint8_t *data_buffer, uint32_t num_bytes);
+
 /**
  * @brief
  * This reads from a specified location in the flash memory.
- * The whole memory array may be read using a single read command.
+ * The whole memory array may be read using a single read command, see @c flash_read.
 
  * @param p_flash Pointer to @c Flash structure
  * @return @c FlashStatus. Will be FLASH_BUSY if there is another operation in progress, FLASH_OK otherwise.
@@ -154,6 +173,17 @@ FlashStatus flash_erase_sector(Flash p_flash, uint32_t address);
  */
 FlashStatus flash_erase_param_sector(Flash p_flash, uint32_t address);
 
+/**
+ * @brief
+ * This tells whether a page program is still running.
+ * Unlike the WIP bit in the status register, a sector erase does not count: while one runs, reads and programs
+ * outside that sector suspend it, go ahead and resume it before they return.
+ * @param p_flash Pointer to @c Flash structure
+ * @return @c true while the device is busy with something other than a sector erase.
+ * @see https://github.com/UMSATS/Avionics-2019/
+ */
+bool flash_is_programming(Flash p_flash);
+
 /**
  * @brief
  * This erases the whole flash memory. Will take up to 128 seconds.
@@ -177,13 +207,21 @@ uint8_t flash_get_status_register(Flash p_flash);
 
 /**
  * @brief
- * This returns the address of the first empty page in memory.
- * Assumes continuous block of memory used.
+ * This finds the address of the first empty page after the log.
+ * The search starts at @c hint: if it is still the end of the data this takes two page reads. If more
+ * data was written after it, the search looks twice as far past the hint each time until it finds a sector
+ * that is not full, then bisects the sectors and the pages of the last one, so it takes a few tens of reads
+ * at most. It relies on the written pages coming first in every sector, and on the eraser's run of erased
+ * sectors past the log being longer than the data written since the hint, so old data the eraser has not
+ * cleared yet is never taken for part of the log.
  * @param p_flash Pointer to @c Flash structure
- * @return @c uint32_t
- * The address value (32 bits)
+ * @param hint Last known end of the data, e.g. the saved end_data_address. Pass 0 if there is none.
+ * @param end_address Set to the address found. FLASH_SIZE_BYTES if the flash is full, and on any error, so
+ * nothing is programmed over data that could not be checked.
+ * @return @c FlashStatus. FLASH_ERROR if a page could not be read, FLASH_BUSY if the device stayed busy for
+ * seconds, FLASH_CORRUPT if a sector has a written page after an empty one, FLASH_OK otherwise.
  * @see https://github.com/UMSATS/Avionics-2019/
  */
-size_t flash_scan(Flash p_flash);
+FlashStatus flash_scan(Flash p_flash, uint32_t hint, uint32_t *end_address);
 
 #endif // FLASH_H
@@ -99,6 +99,10 @@
 #define IMU_GYRO_INT_PIN  		GPIO_PIN_8
 #define IMU_GYRO_INT_PORT 		GPIOB
 
+//PRES_INT and the IMU INT pins all land on EXTI lines 5 to 9.
+#define SENSOR_INT_IRQn			EXTI9_5_IRQn
+#define SENSOR_INT_PRIORITY		5	//Highest priority allowed to call FreeRTOS, so the timestamp is taken as early as possible.
+
 //Recovery Circuit (driver1 -> drogue | driver2 -> main)
 #define RECOV_DROGUE_ACTIVATE_PIN		GPIO_PIN_2	//Output
 #define RECOV_DROGUE_ACTIVATE_PORT		GPIOA
@@ -23,7 +23,8 @@ typedef enum{
 	CONFIG_MENU,
 	EMATCH_MENU,
 	MEM_MENU,
-	SAVE_MENU
+	SAVE_MENU,
+	PROF_MENU
 } menuState_t;
 
 typedef struct
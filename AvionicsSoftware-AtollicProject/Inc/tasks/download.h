@@ -0,0 +1,74 @@
+#ifndef DOWNLOAD_H
+#define DOWNLOAD_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Framed download of the log over the CLI UART, see Documentation/DownloadProtocol.md.
+//
+//  Every frame carries a sequence number, the log offset of its data and a CRC-32. The receiver acknowledges what it
+//  has, and the sender keeps a window of frames in flight and goes back to the first unacknowledged one on a NAK or a
+//  timeout (go back N). The receiver picks the starting offset, so an interrupted download can be resumed, and asks
+//  for a faster baud rate, which both sides switch to after the handshake.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include "flash.h"
+#include "UART.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define DOWNLOAD_SYNC_0				0x55
+#define DOWNLOAD_SYNC_1				0xAA
+#define DOWNLOAD_HEADER_SIZE		14		//Sync (2), type, flags, payload length (2), sequence (4), offset (4). Big endian.
+#define DOWNLOAD_CRC_SIZE			4		//CRC-32 of the header and payload, big endian.
+
+#define DOWNLOAD_CHUNK_MAX			1024	//Largest data payload.
+#define DOWNLOAD_WINDOW_MAX			16		//Most data frames in flight before an acknowledgement.
+#define DOWNLOAD_CONTROL_MAX		16		//Largest payload of a frame sent to the flight computer.
+#define DOWNLOAD_FRAME_MAX			(DOWNLOAD_HEADER_SIZE + DOWNLOAD_CHUNK_MAX + DOWNLOAD_CRC_SIZE)
+
+#define DOWNLOAD_DEFAULT_BAUD		115200	//The CLI rate, where every download starts and ends.
+#define DOWNLOAD_MAX_BAUD			921600
+
+#define DOWNLOAD_START_TIMEOUT		30000	//ms to wait for the receiver to send START.
+#define DOWNLOAD_SYNC_TIMEOUT		2000	//ms to wait for the first ACK after switching baud rate.
+#define DOWNLOAD_ACK_TIMEOUT		500		//ms without progress before going back to the last acknowledged offset.
+#define DOWNLOAD_MAX_RETRIES		10		//Timeouts in a row before giving up.
+
+typedef enum
+{
+	DOWNLOAD_START = 1,		//Receiver: offset to resume from. Payload: baud rate (4), window (2), chunk size (2).
+	DOWNLOAD_INFO = 2,		//Flight computer: offset it will start from. Payload: log size (4), baud rate (4), window (2), chunk size (2).
+	DOWNLOAD_DATA = 3,		//Flight computer: offset of the payload in the log.
+	DOWNLOAD_ACK = 4,		//Receiver: everything before offset arrived.
+	DOWNLOAD_NAK = 5,		//Receiver: frame at offset missing or bad, send again from there.
+	DOWNLOAD_END = 6,		//Flight computer: offset is the log size, nothing more to send.
+	DOWNLOAD_ABORT = 7		//Either side: stop now.
+} download_frame_type;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sends the log from FLASH_START_ADDRESS up to end_address to a receiver on uart. Blocks the calling task until the
+//	download is done, cancelled or has failed, and prints the outcome as a CLI line at the default baud rate.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void download_run(UART uart, Flash flash, uint32_t end_address);
+
+#endif // DOWNLOAD_H
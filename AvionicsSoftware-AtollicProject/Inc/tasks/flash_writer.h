@@ -0,0 +1,106 @@
+#ifndef FLASH_WRITER_H
+#define FLASH_WRITER_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Header file for the flash writer task. The flight state controller hands it full data pages and this task programs
+//  them, so the sample loop never waits for a page program to finish.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdbool.h>
+#include "flash.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define FLASH_WRITER_QUEUE_PAGES	16	//Number of page slots between the controller and the writer. Must be a power of 2.
+#define FLASH_WRITER_ERASE_AHEAD	FLASH_SECTOR_SIZE	//How far past the write address the eraser keeps the flash erased.
+
+typedef struct
+{
+	Flash flash;
+	uint32_t start_address;		//Address of the first page to program.
+} flash_writer_thread_parameters;
+
+typedef struct
+{
+	uint32_t pages_written;		//Pages programmed into the flash.
+	uint32_t pages_dropped;		//Pages thrown away because the queue was full. Only updated by the producer.
+	uint32_t pages_lost;		//Pages the writer could not program (flash full or program error).
+	uint32_t queue_high_water;	//Largest number of pages that were waiting in the queue at once.
+	uint32_t next_address;		//Where the next page will be programmed.
+	uint32_t erased_address;	//Everything from next_address up to here is erased.
+	uint32_t erase_errors;		//Sectors the eraser could not erase.
+	uint32_t erase_stall_max;	//Longest time in milliseconds the writer waited for the eraser.
+} flash_writer_statistics;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  This task owns the data area of the flash. It sleeps until pages are queued and then programs them in order.
+//
+//	Should be passed a populated flash_writer_thread_parameters as the parameter.
+//	The flash should be initialized before this task is started.
+//
+// Returns:
+//
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void thread_flash_writer_start(void const *params);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  This low priority task erases the data area one sector at a time, just ahead of where the writer programs.
+//	It does nothing until flash_writer_start_eraser is called. While a sector is being erased, the writer and the
+//	configuration journal suspend the erase to get their pages in, so they never wait for it.
+//
+//	Should be passed the same flash_writer_thread_parameters as the writer.
+//
+// Returns:
+//
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void thread_flash_eraser_start(void const *params);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Lets the eraser run. It keeps FLASH_WRITER_ERASE_AHEAD bytes erased past the write address, and also clears the
+//	old data up to old_data_end so that the log stays one continuous block. Pass the start address to keep old data.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void flash_writer_start_eraser(uint32_t old_data_end);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies one DATA_BUFFER_SIZE page into the queue and wakes the writer. There must only be one task calling this.
+//	If the queue is full, waits up to timeout milliseconds for a slot to free up. Pass 0 to never wait.
+//
+// Returns:
+//  true if the page was queued, false if it was dropped.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool flash_writer_submit_page(const uint8_t *page, uint32_t timeout);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the writer's counters into statistics.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void flash_writer_get_statistics(flash_writer_statistics *statistics);
+
+#endif // FLASH_WRITER_H
@@ -41,14 +41,6 @@
 #define POWER_FAIL			0x002000
 #define	OVERCURRENT_EVENT	0x001000
 
-
-typedef enum{
-
-	BUFFER_A = 0,
-	BUFFER_B = 1
-
-} BufferSelection_t;
-
 typedef struct{
 	Flash flash_ptr;
 	UART uart;
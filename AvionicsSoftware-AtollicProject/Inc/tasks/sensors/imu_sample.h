@@ -0,0 +1,40 @@
+#ifndef AVIONICS_IMU_SAMPLE_H
+#define AVIONICS_IMU_SAMPLE_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Reads one BMI088 sample for the IMU task when it runs without the FIFOs. Kept apart from the task so it builds on
+//  its own, without the RTOS.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdbool.h>
+#include "SPI.h"
+#include "tasks/sensors/imu_sensor.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Reads the accelerometer and gyroscope data registers straight into sample, without going through the driver. The
+//	two halves of the BMI088 have their own chip selects, so it is one burst on each: the 6 accelerometer data
+//	registers behind the dummy byte every accelerometer read starts with, then the 6 gyroscope data registers. The
+//	readings are the same as bmi08a_get_data and bmi08g_get_data give. The time stamps are left to the caller.
+//
+// Returns:
+//  False, leaving sample as it was, if either read failed.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool imu_sample_read(SPI accel, SPI gyro, imu_sensor_data *sample);
+
+#endif // AVIONICS_IMU_SAMPLE_H
@@ -17,9 +17,12 @@
 #include <stdbool.h>
 #include "configuration.h"
 #include "UART.h"
+#include "utilities/sample_ring.h"
 
-#define	ACC_LENGTH	6		// Length of a accelerometer measurement in bytes.
-#define	GYRO_LENGTH	6		// Length of a gyroscope measurement in bytes.
+#define IMU_SENSOR_FIFO_MODE	1	// 1: drain the BMI088 hardware FIFOs in bursts. 0: read one sample per wakeup.
+#define IMU_FIFO_BATCH_FRAMES	8	// Accelerometer frames to let the FIFO collect between two wakeups.
+#define IMU_FIFO_MAX_FRAMES		32	// Most frames taken out of each FIFO in one wakeup.
+#define IMU_SENSOR_INTERRUPT_MODE	1	// 1: wake on the accelerometer INT1 pin (FIFO watermark, or data ready without the FIFO). 0: wake on a timer.
 
 
 //Groups both sensor readings and a time stamp.
@@ -34,6 +37,7 @@ typedef struct imu_sensor_data
 	int16_t	gyro_z;
 	
 	uint32_t time_ticks;	//time of sensor reading in ticks.
+	uint32_t time_us;		//time of sensor reading on the stm32_get_time_us clock.
 	
 }imu_sensor_data;
 
@@ -56,8 +60,53 @@ typedef struct{
 bool imu_sensor_test();
 bool imu_sensor_init(configuration_data_t * parameters);
 void imu_thread_start(void const *param);
-bool imu_read(imu_sensor_data * buffer, uint8_t data_rate);
-void imu_sensor_data_to_bytes(imu_sensor_data reading, uint8_t* bytes, uint32_t timestamp);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts a reader of the IMU samples at the next one to come. Each task that wants every sample keeps its own reader.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void imu_reader_init(sample_ring_reader * reader);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the reader's next IMU sample into buffer, waiting up to timeout ms for one. Samples the reader fell too far
+//	behind for are skipped and counted in reader->overruns.
+//
+// Returns:
+//  true if buffer was filled.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool imu_read(sample_ring_reader * reader, imu_sensor_data * buffer, uint8_t timeout);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the newest IMU sample into buffer, for readers that only care about the current value.
+//
+// Returns:
+//  true if there has been a sample yet.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool imu_read_latest(imu_sensor_data * buffer);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Called from the EXTI interrupt when the accelerometer INT1 pin rises. Records when it happened and wakes the IMU task.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void imu_sensor_interrupt(uint32_t time_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  How many samples a second the IMU task publishes with this configuration: one per accelerometer frame, or one per
+//	data_rate period when it polls.
+//
+// Returns:
+//  Samples per second.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t imu_sensor_rate_hz(const configuration_data_t * parameters);
 
 
 #endif // SENSOR_AG_H
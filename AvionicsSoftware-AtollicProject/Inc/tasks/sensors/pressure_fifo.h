@@ -0,0 +1,46 @@
+#ifndef AVIONICS_PRESSURE_FIFO_H
+#define AVIONICS_PRESSURE_FIFO_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Turns one BMP388 FIFO burst, as bmp3_get_fifo_data read it, into compensated samples for the pressure task.
+//  Kept apart from the task so it builds on its own, without the RTOS.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include "bmp3.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define PRESSURE_FIFO_NO_SENSOR_TIME	0xFFFFFFFF	//The burst did not reach the sensor time frame at the end of the FIFO.
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Compensates up to max_frames pressure and temperature frames of the burst in dev->fifo into frames, oldest first,
+//	with the same arithmetic as a single-shot bmp3_get_sensor_data. A frame cut short by the end of the burst is left
+//	out rather than compensated from the bytes after it: the BMP388 only lets go of a frame that was read to the end,
+//	so it comes again whole in the next burst. Config change, error and empty frames are skipped.
+//
+// Returns:
+//  BMP3_OK, or the driver's error. count is the number of frames compensated, and sensor_time the sensor time frame's
+//	value, or PRESSURE_FIFO_NO_SENSOR_TIME if the burst was cut short or max_frames came first.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int8_t pressure_fifo_parse(struct bmp3_dev *dev, struct bmp3_data *frames, uint8_t max_frames, uint8_t *count,
+						   uint32_t *sensor_time);
+
+#endif // AVIONICS_PRESSURE_FIFO_H
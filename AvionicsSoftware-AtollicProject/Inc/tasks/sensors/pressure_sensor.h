@@ -19,21 +19,27 @@
 #include <stdbool.h>
 #include "configuration.h"
 #include "UART.h"
+#include "utilities/sample_ring.h"
 
 
-#define	PRES_LENGTH	3		//Length of a pressure measurement in bytes.
-#define	TEMP_LENGTH	3		//Length of a temperature measurement in bytes.
-#define ALT_LENGTH  4
 #define TIMEOUT 100 // milliseconds
 
+#define PRESSURE_SENSOR_FIFO_MODE		1	// 1: drain the BMP388 FIFO in bursts. 0: read one sample per wakeup.
+#define PRESSURE_FIFO_BATCH_FRAMES		8	// Frames to let the FIFO collect between two wakeups (also the watermark).
+#define PRESSURE_FIFO_MAX_FRAMES		32	// Most frames taken out of the FIFO in one wakeup.
+#define PRESSURE_SENSOR_INTERRUPT_MODE	1	// 1: wake on the BMP388 INT pin (FIFO watermark, or data ready without the FIFO). 0: wake on a timer.
+
 //Groups a time stamp with the reading.
 typedef struct pressure_sensor_data
 {
 	uint32_t time_ticks; //time of sensor reading in ticks.
+	uint32_t time_us; //time of sensor reading on the stm32_get_time_us clock.
 	/*! Compensated temperature */
 	int64_t temperature;
 	/*! Compensated pressure */
 	uint64_t pressure;
+	float altitude; //Worked out once by the pressure task, see pressure_sensor_calculate_altitude.
+	uint32_t sensor_time; //Sensor time at the end of the FIFO burst this reading came from. 0 when polled, 0xFFFFFFFF if the burst did not reach the end.
 } pressure_sensor_data;
 
 
@@ -59,9 +65,55 @@ void pressure_sensor_calibrate(configuration_data_t * configParams);
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 void thread_pressure_sensor_start(void const *pvParameters);
 bool pressure_sensor_test(void);
-bool pressure_sensor_read(pressure_sensor_data * buffer, uint8_t data_rate);
-void pressure_sensor_data_to_bytes(pressure_sensor_data reading, uint8_t * bytes);
 float pressure_sensor_calculate_altitude(pressure_sensor_data * reading);
 
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts a reader of the pressure samples at the next one to come. Each task that wants every sample keeps its own
+//	reader.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void pressure_sensor_reader_init(sample_ring_reader * reader);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the reader's next pressure sample into buffer, waiting up to timeout ms for one. Samples the reader fell too
+//	far behind for are skipped and counted in reader->overruns.
+//
+// Returns:
+//  true if buffer was filled.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool pressure_sensor_read(sample_ring_reader * reader, pressure_sensor_data * buffer, uint8_t timeout);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the newest pressure sample into buffer, for readers that only care about the current value.
+//
+// Returns:
+//  true if there has been a sample yet.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool pressure_sensor_read_latest(pressure_sensor_data * buffer);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Called from the EXTI interrupt when the BMP388 INT pin rises. Records when it happened and wakes the pressure task.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void pressure_sensor_interrupt(uint32_t time_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  How many samples a second the pressure task publishes with this configuration: the BMP388 ODR, or one per
+//	data_rate period when it polls.
+//
+// Returns:
+//  Samples per second, at least 1.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t pressure_sensor_rate_hz(const configuration_data_t * parameters);
+
 
 #endif // PRESSURE_SENSOR_BMP3_H
@@ -52,7 +52,7 @@ typedef struct{
 //  This function will be the first task to run when the flight computer is powered on.
 //
 //As of right now, if S2 is not pressed the task will wait for an amount of time specified in the configuration
-//	header file, and will then erase the flash memory and start the IMU, BMP and data logging
+//	header file, and will then let the flash eraser clear the old data and start the IMU, BMP and data logging
 //	tasks.
 //
 //	If S2 is pressed then the xtract task will be started.
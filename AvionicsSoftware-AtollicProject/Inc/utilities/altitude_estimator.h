@@ -0,0 +1,94 @@
+#ifndef AVIONICS_ALTITUDE_ESTIMATOR_H
+#define AVIONICS_ALTITUDE_ESTIMATOR_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Kalman filter for the vertical state of the rocket: altitude, vertical velocity and vertical acceleration.
+//  It is predicted forward and corrected with the accelerometer at the IMU rate, and corrected with the barometric
+//  altitude whenever a pressure sample comes in.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdbool.h>
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define ALTITUDE_ESTIMATOR_STATES			3
+
+#define ALTITUDE_ESTIMATOR_JERK_NOISE		10.0f	//Process noise: spectral density of the jerk the model does not know about [m^2/s^5].
+#define ALTITUDE_ESTIMATOR_ALTITUDE_NOISE	1.0f	//Variance of one barometric altitude [m^2].
+#define ALTITUDE_ESTIMATOR_ACC_NOISE		1.0f	//Variance of one vertical acceleration, vibration and tilt included [m^2/s^4].
+#define ALTITUDE_ESTIMATOR_MAX_DT			0.5f	//Longer gaps are clamped so one late sample cannot blow up the covariance [s].
+
+typedef enum
+{
+	ALTITUDE_ESTIMATOR_ALTITUDE = 0,
+	ALTITUDE_ESTIMATOR_VELOCITY,
+	ALTITUDE_ESTIMATOR_ACCELERATION
+} altitude_estimator_state;
+
+typedef struct
+{
+	float x[ALTITUDE_ESTIMATOR_STATES];								//Altitude [m], velocity [m/s], acceleration [m/s^2]. Up is positive.
+	float P[ALTITUDE_ESTIMATOR_STATES][ALTITUDE_ESTIMATOR_STATES];	//Covariance of x.
+	uint32_t last_time_us;											//Time x was last predicted to, on the stm32_get_time_us clock.
+	bool initialized;
+} altitude_estimator;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts the filter at rest at the given altitude, with time_us as its current time.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void altitude_estimator_init(altitude_estimator *estimator, float altitude, uint32_t time_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Moves the state forward to time_us assuming constant acceleration. Earlier times are ignored.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void altitude_estimator_predict(altitude_estimator *estimator, uint32_t time_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Corrects the state with a vertical acceleration [m/s^2], gravity already removed.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void altitude_estimator_update_acceleration(altitude_estimator *estimator, float acceleration);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Corrects the state with a barometric altitude [m].
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void altitude_estimator_update_altitude(altitude_estimator *estimator, float altitude);
+
+static inline float altitude_estimator_get(const altitude_estimator *estimator, altitude_estimator_state state)
+{
+	return estimator->x[state];
+}
+
+#endif //AVIONICS_ALTITUDE_ESTIMATOR_H
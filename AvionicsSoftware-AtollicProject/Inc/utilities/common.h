@@ -16,9 +16,9 @@ static inline void write_32(uint32_t src, uint8_t * dest)
 
 static inline void write_24(uint32_t src, uint8_t * dest)
 {
-	dest[1] = (uint8_t) ((src >> 16) & 0xFF);
-	dest[2] = (uint8_t) ((src >> 8) & 0xFF);
-	dest[3] = (uint8_t) ((src >> 0) & 0xFF);
+	dest[0] = (uint8_t) ((src >> 16) & 0xFF);
+	dest[1] = (uint8_t) ((src >> 8) & 0xFF);
+	dest[2] = (uint8_t) ((src >> 0) & 0xFF);
 }
 
 static inline void write_16(uint16_t src, uint8_t * dest)
@@ -27,25 +27,25 @@ static inline void write_16(uint16_t src, uint8_t * dest)
 	dest[1] = (uint8_t) ((src >> 0) & 0xFF);
 }
 
-inline uint32_t read_32(const uint8_t * src)
+static inline uint32_t read_32(const uint8_t * src)
 {
-	return ((((uint8_t) src[0]) << 24) & 0xFF) |
-		   ((((uint8_t) src[1]) << 16) & 0xFF) |
-		   ((((uint8_t) src[2]) << 8) & 0xFF)  |
-		   ((((uint8_t) src[3]) << 0) & 0xFF);
+	return (((uint32_t) src[0]) << 24) |
+		   (((uint32_t) src[1]) << 16) |
+		   (((uint32_t) src[2]) << 8)  |
+		   (((uint32_t) src[3]) << 0);
 }
 
 static inline uint32_t read_24(const uint8_t * src)
 {
-	return ((((uint8_t) src[1]) << 16) & 0xFF) |
-		   ((((uint8_t) src[2]) << 8) & 0xFF) |
-		   ((((uint8_t) src[3]) << 0) & 0xFF);
+	return (((uint32_t) src[0]) << 16) |
+		   (((uint32_t) src[1]) << 8)  |
+		   (((uint32_t) src[2]) << 0);
 }
 
 static inline uint16_t read_16(const uint8_t * src)
 {
-	return ((((uint8_t) src[0]) << 8) & 0xFF) |
-		   ((((uint8_t) src[1]) << 0) & 0xFF);
+	return (uint16_t) ((((uint16_t) src[0]) << 8) |
+					   (((uint16_t) src[1]) << 0));
 }
 
 static inline bool is_buffer_empty(uint8_t * buffer, size_t size)
@@ -73,4 +73,35 @@ static inline void float2bytes(float float_variable, uint8_t bytes_temp[4])
 	memcpy(bytes_temp, thing.bytes, 4);
 }
 
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+static inline uint16_t crc16_ccitt(const uint8_t * data, size_t size)
+{
+	uint16_t crc = 0xFFFF;
+	for(size_t i = 0; i < size; i++)
+	{
+		crc ^= (uint16_t) (data[i] << 8);
+		for(int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+	}
+	return crc;
+}
+
+// CRC-32 as used by zlib and Python's binascii.crc32 (reflected polynomial 0xEDB88320), one nibble at a time.
+static inline uint32_t crc32(const uint8_t * data, size_t size)
+{
+	static const uint32_t table[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+
+	uint32_t crc = 0xFFFFFFFF;
+	for(size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+	}
+	return ~crc;
+}
+
 #endif //AVIONICS_COMMON_H
@@ -0,0 +1,166 @@
+#ifndef AVIONICS_LOG_ENCODER_H
+#define AVIONICS_LOG_ENCODER_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Encoder for the version 2 log format, see Documentation/DataFormatDescription.md.
+//
+//  The log starts with a superblock page that describes the format version and the sensor configuration. Every data
+//  page after it starts over from a keyframe: the first record in a page is stored against zero, the following ones
+//  as zig-zag varint deltas against the previous record. Records never cross a page, and each page carries its own
+//  sequence number and CRC, so any page can be checked and decoded on its own.
+//
+//  What a record holds is set by the log policy of the flight phase: the channels that are logged and how many low
+//  bits are dropped from them. The policy is in the header of every page, and only changes at a page boundary.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdbool.h>
+#include "configuration.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define LOG_FORMAT_VERSION		2
+#define LOG_PAGE_SIZE			FLASH_PAGE_SIZE
+
+#define LOG_SUPERBLOCK_MAGIC	0x554D534CUL	//"UMSL", first four bytes of the superblock page.
+
+#define LOG_PAGE_MARKER			0xA5			//First byte of every data page.
+#define LOG_PAGE_HEADER_SIZE	10				//Marker, record count, sequence number, first record offset and policy.
+#define LOG_PAGE_COUNT			1				//Offset of the record count.
+#define LOG_PAGE_SEQUENCE		2				//Offset of the sequence number, uint32 big endian. Data pages count from 1, after the superblock.
+#define LOG_PAGE_FIRST_RECORD	6				//Offset of the byte that holds where the first record starts.
+#define LOG_PAGE_PHASE			7				//Offset of the log_phase the page was written in...
+#define LOG_PAGE_CHANNELS		8				//...the LOG_CHANNEL_* bits its records hold...
+#define LOG_PAGE_PRECISION		9				//...and the low bits dropped from them, as in the configuration.
+#define LOG_PAGE_CRC			(LOG_PAGE_SIZE - 4)	//CRC-32 of everything before it, uint32 big endian. Also in the superblock.
+
+//Bits of the record type byte.
+#define LOG_RECORD_IMU			0x80			//Accelerometer and gyroscope, 6 x int16, as far as the page's channels have them.
+#define LOG_RECORD_BARO			0x40			//Pressure, temperature and altitude in cm, same.
+#define LOG_RECORD_EVENTS		0x20			//An event byte follows the type byte.
+#define LOG_RECORD_PROFILE		0x10			//Timings from utilities/profiler.h. Never together with IMU or BARO.
+
+//Ids of the profile records. A span has count, min, mean, p99 and max in CPU cycles, a gauge its high water mark.
+#define LOG_PROFILE_SPAN		0x00			//Plus the profiler_span.
+#define LOG_PROFILE_GAUGE		0x40			//Plus the profiler_gauge.
+#define LOG_PROFILE_SPAN_VALUES	5
+
+//Type byte, event byte, time delta and the largest deltas of every field. A profile record, with its id byte and
+//five values, is smaller.
+#define LOG_RECORD_MAX_SIZE		(1 + 1 + 5 + 6 * 3 + 3 * 5)
+
+typedef struct
+{
+	uint32_t time_us;			//On the stm32_get_time_us clock.
+	uint8_t types;				//LOG_RECORD_IMU and/or LOG_RECORD_BARO, or LOG_RECORD_PROFILE on its own.
+	uint8_t events;				//Event bits, see flight_state_controller.h. 0 if nothing happened.
+
+	int16_t acc[3];
+	int16_t gyro[3];
+
+	uint32_t pressure;			//Compensated pressure, same units as pressure_sensor_data.
+	int32_t temperature;		//Compensated temperature, same units as pressure_sensor_data.
+	int32_t altitude_cm;
+
+	uint8_t profile_id;			//LOG_PROFILE_SPAN or LOG_PROFILE_GAUGE plus the index.
+	uint32_t profile[LOG_PROFILE_SPAN_VALUES];	//Stored as they are, not as deltas.
+} log_record;
+
+typedef struct
+{
+	uint8_t phase;					//log_phase the policy is for.
+	uint8_t channels;				//LOG_CHANNEL_* bits that are logged.
+	uint8_t precision;				//Low bits dropped, see LOG_PRECISION in configuration.h.
+} log_policy;
+
+typedef struct
+{
+	uint8_t page[LOG_PAGE_SIZE];	//Page being filled.
+	uint16_t length;				//Bytes used in page.
+	log_record previous;			//What the next record is delta coded against, in the units of the page's precision.
+	log_policy policy;				//Policy of the page being filled.
+} log_encoder;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts an empty page under the given policy.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void log_encoder_init(log_encoder *encoder, const log_policy *policy);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Switches to another policy. The page being filled is finished first, if it holds any records, so every record after
+//	this is written under the new policy and every record before it under the old one.
+//
+// Returns:
+//  true if full_page holds a finished page.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool log_encoder_set_policy(log_encoder *encoder, const log_policy *policy, uint8_t *full_page);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Finishes the page being filled, if it holds any records, e.g. when logging stops.
+//
+// Returns:
+//  true if full_page holds a finished page.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool log_encoder_flush(log_encoder *encoder, uint8_t *full_page);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Adds one record to the current page. If it does not fit, the finished page is copied to full_page and the record
+//	becomes the keyframe of the next one. Encodes the record at most twice, so the time taken is bounded.
+//
+// Returns:
+//  true if full_page holds a finished page.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool log_encoder_append(log_encoder *encoder, const log_record *record, uint8_t *full_page);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Stamps a finished page with its sequence number and CRC. Done when the page leaves the controller, so the numbers
+//	follow the order the pages are stored in.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void log_encoder_seal(uint8_t *page, uint32_t sequence);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Checks the CRC of a sealed data page or of a superblock.
+//
+// Returns:
+//  true if the page is intact.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool log_encoder_verify(const uint8_t *page);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Fills page with the superblock for the given configuration. It goes in front of the first data page of a log.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void log_encoder_superblock(const configuration_data_t *configuration, uint8_t *page);
+
+#endif // AVIONICS_LOG_ENCODER_H
@@ -0,0 +1,150 @@
+#ifndef AVIONICS_LOG_RATE_H
+#define AVIONICS_LOG_RATE_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Log rates that are set apart from the sensor rates.
+//
+//  Each sensor is read at its own ODR, and the altitude estimator and the state machine see every sample. What goes
+//  in the log is brought down to the rate set for the current flight phase, per sensor, by a log_decimator. It either
+//  averages the samples since the last logged one (a boxcar, which keeps the noise out that picking would alias in)
+//  or just picks the newest. The rates are in the configuration, so they can be set from the CLI, and a phase can log
+//  fast during the climb and around apogee and slowly on the pad and under the main.
+//
+//  Together with the channels and the precision of each phase, also in the configuration, the rates make up the log
+//  policy of the phase.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdbool.h>
+#include "configuration.h"
+#include "utilities/log_encoder.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define LOG_DECIMATOR_MAX_VALUES	6		//Accelerometer and gyroscope.
+
+//Typical record size for the flash budget, from SITL flights: the type byte and the time delta, which a record that
+//holds both sensors has only once. The deltas of the channels are estimated in log_rate.c. The delta coding makes
+//them depend on the noise, so they are only estimates.
+#define LOG_RATE_RECORD_BYTES		3
+
+typedef enum
+{
+	LOG_PHASE_PAD = 0,		//On the pad, into the launchpad ring only.
+	LOG_PHASE_ASCENT,		//Launch to apogee.
+	LOG_PHASE_DROGUE,		//Apogee to the main.
+	LOG_PHASE_MAIN,			//Under the main.
+	LOG_PHASE_LANDED,
+	LOG_NUM_PHASES
+} log_phase;
+
+//configuration.h keeps a log rate for each phase. A negative array size stops the build if the two disagree.
+typedef char log_rate_phases_match_configuration[(LOG_NUM_PHASES == CONFIG_LOG_PHASES) ? 1 : -1];
+
+typedef struct
+{
+	uint32_t period_us;							//0 logs every sample.
+	uint32_t due_us;							//Time of the next sample that is logged.
+	bool enabled;
+	bool average;
+	bool started;								//due_us is set.
+	uint8_t values;
+	uint16_t count;								//Samples summed since the last one logged.
+	int64_t sum[LOG_DECIMATOR_MAX_VALUES];
+} log_decimator;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Short name of a phase, for the CLI.
+//
+// Returns:
+//  The name.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+const char *log_rate_phase_name(log_phase phase);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  The rate a sensor that runs at sensor_hz is logged at when its rate in the configuration is rate_hz. LOG_RATE_ALL,
+//	or any rate the sensor does not reach, logs every sample.
+//
+// Returns:
+//  Records per second. 0 if the sensor is not logged.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t log_rate_effective_hz(uint8_t rate_hz, uint32_t sensor_hz);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  The log policy of a phase: its channels and precision.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void log_rate_policy(const configuration_data_t *configuration, log_phase phase, log_policy *policy);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  The IMU and pressure sensor log rates of a phase, as in the configuration, but 0 for a sensor that has none of its
+//	channels logged in the phase.
+//
+// Returns:
+//  The rate, as in the configuration.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t log_rate_imu(const configuration_data_t *configuration, log_phase phase);
+uint8_t log_rate_baro(const configuration_data_t *configuration, log_phase phase);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Estimate of the log bytes written per second under policy for the given record rates. The page headers and CRCs
+//	are included, combined records are assumed as long as the slower sensor keeps up with the faster.
+//
+// Returns:
+//  Bytes per second.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t log_rate_bytes_per_second(const log_policy *policy, uint32_t imu_hz, uint32_t baro_hz);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sets up a decimator for samples of values fields, at rate_hz as in the configuration. A decimator that is already
+//	running keeps its samples and its schedule, so a phase change does not lose or repeat a record.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void log_decimator_set_rate(log_decimator *decimator, uint8_t values, uint8_t rate_hz, bool average);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Adds one sample taken at time_us.
+//
+// Returns:
+//  true when the sample is due to be logged. Take the record with log_decimator_take.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool log_decimator_add(log_decimator *decimator, uint32_t time_us, const int32_t *sample);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  The value to log: the average of the samples added since the last call, or the newest of them when the decimator
+//	does not average. Also takes a record early, e.g. when an event has to be logged now.
+//
+// Returns:
+//  false if no sample was added since the last call.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool log_decimator_take(log_decimator *decimator, int32_t *value);
+
+#endif // AVIONICS_LOG_RATE_H
@@ -2,6 +2,7 @@
 #define AVIONICS_MATH_H
 
 #include <math.h>
+#include <inttypes.h>
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
 //  Calculate altitude from pressure reading
@@ -19,5 +20,32 @@ static inline uint32_t math_approximate_altitude(float pressure, float temperatu
 	return (uint32_t)(p_term*t_term)/0.0065F+ref_alt;
 }
 
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  pressure^(-1/5.257) from a table, without calling powf between 20 kPa and 120 kPa.
+//
+// Parameters:
+//  pressure - [Pa]
+//
+// Returns:
+//  float - pressure^(-1/5.257), relative error below 3e-7 inside the table.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+float math_pressure_power(float pressure);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Same barometric formula as math_approximate_altitude, using math_pressure_power instead of powf and without
+//  truncating the result to whole metres.
+//
+// Parameters:
+//  pressure    - [Pa]
+//  temperature - [C]
+//  ref_pres    - [Pa] pressure at ref_alt.
+//  ref_alt     - [m]
+//
+// Returns:
+//  float - altitude in metres. Within 2 cm of the exact formula between 20 kPa and 120 kPa.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+float math_fast_altitude(float pressure, float temperature, float ref_pres, float ref_alt);
 
 #endif //AVIONICS_MATH_H
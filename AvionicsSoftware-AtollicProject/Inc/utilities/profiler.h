@@ -0,0 +1,206 @@
+#ifndef AVIONICS_PROFILER_H
+#define AVIONICS_PROFILER_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Timing of the hot paths, for the CLI [prof] menu and the flight log.
+//
+//  A span is a named piece of code that is timed with the DWT cycle counter every time it runs. Each span keeps its
+//  count, total, min and max, and a histogram of its durations that the percentiles come from. A gauge keeps the
+//  highest value it was ever given, e.g. how far a reader fell behind a sample ring. The share of the CPU each task
+//  gets is measured by FreeRTOS itself (configGENERATE_RUN_TIME_STATS, on the TIM5 microsecond clock).
+//
+//  With PROFILER_MODE 0 every call compiles to nothing. With timing turned off at run time, a span costs one load
+//  and one branch at each end.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdbool.h>
+#include "stm32f4xx_hal.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define PROFILER_MODE				1		//0 compiles all the timing out.
+
+//The histogram has 4 buckets per power of two, so a percentile is within 19% of the true value. Durations of
+//2^PROFILER_HISTOGRAM_OCTAVES cycles (50 ms at 84 MHz) and up all go in the last bucket.
+#define PROFILER_HISTOGRAM_OCTAVES	22
+#define PROFILER_HISTOGRAM_BUCKETS	(4 * (PROFILER_HISTOGRAM_OCTAVES - 1))
+
+typedef enum
+{
+	PROFILER_SPAN_SPI_TRANSACTION = 0,	//One spi_send/spi_receive on any bus, the wait for the bus included.
+	PROFILER_SPAN_IMU_READ,				//One pass of the IMU task: reading the BMI088 and publishing the samples.
+	PROFILER_SPAN_PRESSURE_READ,		//One pass of the pressure sensor task.
+	PROFILER_SPAN_ALTITUDE,				//Pressure and temperature to altitude.
+	PROFILER_SPAN_ESTIMATOR,			//Altitude estimator predict and update.
+	PROFILER_SPAN_STATE_MACHINE_TICK,	//One step of the flight state machine.
+	PROFILER_SPAN_PAGE_HAND_OFF,		//A finished log page, from the encoder to the flash writer queue.
+	PROFILER_SPAN_FLASH_PROGRAM_PAGE,	//flash_program_page, up to the start of the program cycle.
+	PROFILER_NUM_SPANS
+} profiler_span;
+
+typedef enum
+{
+	PROFILER_GAUGE_IMU_BACKLOG = 0,		//IMU samples waiting for the flight state controller.
+	PROFILER_GAUGE_PRESSURE_BACKLOG,	//Pressure samples waiting for the flight state controller.
+	PROFILER_GAUGE_FLASH_QUEUE,			//Pages waiting for the flash writer.
+	PROFILER_NUM_GAUGES
+} profiler_gauge;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;				//In CPU cycles, like the rest.
+	uint32_t mean;
+	uint32_t p99;				//Upper edge of the histogram bucket that holds the 99th percentile, at most max.
+	uint32_t max;
+} profiler_span_summary;
+
+extern volatile bool profiler_running;	//Set by profiler_set_running. Only read here so the check can be inlined.
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts the DWT cycle counter and turns timing on. Call once from main, before the scheduler starts.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profiler_init(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Turns timing on or off. What was recorded so far is kept.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profiler_set_running(bool running);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Clears every span and gauge.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profiler_reset(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Adds one duration to a span. Safe from any task or interrupt, and before the scheduler starts.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profiler_record(profiler_span span, uint32_t cycles);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Raises a gauge's high water mark to value if it is higher.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profiler_record_gauge(profiler_gauge gauge, uint32_t value);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sums up a span as it is now into summary, which is the caller's own. Safe from several tasks at once.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profiler_get_span(profiler_span span, profiler_span_summary *summary);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  The highest value a gauge has been given since the last reset.
+//
+// Returns:
+//  The high water mark.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t profiler_get_gauge(profiler_gauge gauge);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Short names for the CLI report.
+//
+// Returns:
+//  The name.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+const char *profiler_span_name(profiler_span span);
+const char *profiler_gauge_name(profiler_gauge gauge);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Marks the start of a span. Pass what it returns to profiler_end.
+//
+// Returns:
+//  The cycle counter, or 0 while timing is off.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static inline uint32_t profiler_start(void)
+{
+#if PROFILER_MODE
+	return profiler_running ? DWT->CYCCNT : 0;
+#else
+	return 0;
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Marks the end of a span that profiler_start began. A span that started while timing was off is not counted.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static inline void profiler_end(profiler_span span, uint32_t start)
+{
+#if PROFILER_MODE
+	if(profiler_running && start != 0)
+	{
+		profiler_record(span, DWT->CYCCNT - start);
+	}
+#else
+	(void) span;
+	(void) start;
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Gives a gauge its current value.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static inline void profiler_gauge_update(profiler_gauge gauge, uint32_t value)
+{
+#if PROFILER_MODE
+	if(profiler_running)
+	{
+		profiler_record_gauge(gauge, value);
+	}
+#else
+	(void) gauge;
+	(void) value;
+#endif
+}
+
+#endif // AVIONICS_PROFILER_H
@@ -0,0 +1,114 @@
+#ifndef AVIONICS_SAMPLE_RING_H
+#define AVIONICS_SAMPLE_RING_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Single writer, many reader ring of fixed size samples, for sharing sensor data between tasks.
+//
+//  The writer never waits: it overwrites the oldest sample. Each reader keeps its own position, so any number of
+//  them can follow the same stream at their own pace, and a reader that falls more than the ring behind finds out
+//  how many samples it lost. Reading is lock free (a per slot sequence number, seqlock style): no critical section,
+//  no kernel call, and the writer is never held up by a reader.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//A ring called name of capacity samples of type, with its storage, ready to use without sample_ring_init.
+//capacity must be a power of two.
+#define SAMPLE_RING_DEFINE(name, type, capacity)	static type name##_samples[capacity]; \
+													static uint32_t name##_sequences[capacity]; \
+													static sample_ring name = {(uint8_t *) name##_samples, name##_sequences, \
+																			   sizeof(type), (capacity) - 1, 0}
+
+typedef struct
+{
+	uint8_t *samples;
+	uint32_t *sequences;	//Per slot: number of the sample in it plus one, or 0 while it is being written.
+	size_t sample_size;
+	uint32_t mask;			//Capacity - 1.
+	uint32_t written;		//Samples published so far. The newest one is number written - 1.
+} sample_ring;
+
+typedef struct
+{
+	uint32_t next;			//Number of the next sample this reader wants.
+	uint32_t overruns;		//Samples this reader lost because the writer got a whole ring ahead of it.
+} sample_ring_reader;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sets up an empty ring over the given storage, for rings not made with SAMPLE_RING_DEFINE. Must happen before any
+//	reader or the writer touches it. capacity must be a power of two.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sample_ring_init(sample_ring *ring, void *samples, uint32_t *sequences, size_t sample_size, uint32_t capacity);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Publishes a sample, overwriting the oldest one if the ring is full. Only one task (or ISR) may write a ring.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sample_ring_write(sample_ring *ring, const void *sample);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts a reader at the next sample to be written, so it only sees samples from now on.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sample_ring_reader_init(const sample_ring *ring, sample_ring_reader *reader);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the reader's next sample into sample and moves the reader past it. If the writer has overwritten it, the
+//	reader skips to the oldest sample still in the ring and the lost ones are added to reader->overruns.
+//
+// Returns:
+//  true if a sample was copied, false if the reader has already seen everything written.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool sample_ring_read(const sample_ring *ring, sample_ring_reader *reader, void *sample);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Copies the newest sample into sample, without any reader state. If number is not NULL it gets the sample's
+//	number, which increases by one per sample written.
+//
+// Returns:
+//  true if a sample was copied, false if nothing has been written yet.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool sample_ring_read_latest(const sample_ring *ring, void *sample, uint32_t *number);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Samples written but not read yet by reader, at most the capacity of the ring.
+//
+// Returns:
+//  Number of samples.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t sample_ring_available(const sample_ring *ring, const sample_ring_reader *reader);
+
+#endif // AVIONICS_SAMPLE_RING_H
@@ -92,11 +92,12 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
     #include <stdint.h>
     extern uint32_t SystemCoreClock;
+    uint32_t stm32_get_time_us(void);
 #endif
 
 #define configUSE_PREEMPTION                     1
-#define configSUPPORT_STATIC_ALLOCATION          0
-#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configSUPPORT_STATIC_ALLOCATION          1
+#define configSUPPORT_DYNAMIC_ALLOCATION         0 // 0: every task, queue and semaphore is placed at link time and there is no RTOS heap.
 #define configUSE_IDLE_HOOK                      0
 #define configUSE_TICK_HOOK                      0
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
@@ -109,10 +110,13 @@
 #define configQUEUE_REGISTRY_SIZE                8
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION  1
 
+// With dynamic allocation off, heap_4.c compiles to nothing, so any leftover pvPortMalloc fails to link.
+#if configSUPPORT_DYNAMIC_ALLOCATION == 1
 #define configAPPLICATION_ALLOCATED_HEAP         1 // address in memory to start the heap
 #define configTOTAL_HEAP_SIZE                    ((size_t)70360)
 
 uint8_t ucHeap[ configTOTAL_HEAP_SIZE ];
+#endif
 
 
 /* Co-routine definitions. */
@@ -129,6 +133,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil             1
 #define INCLUDE_vTaskDelay                  1
 #define INCLUDE_xTaskGetSchedulerState      1
+#define INCLUDE_xTaskGetCurrentTaskHandle   1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -173,8 +178,23 @@ standard names. */
 /* USER CODE BEGIN Defines */   	      
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
 #define configUSE_TRACE_FACILITY                   1
-//#define configGENERATE_RUN_TIME_STATS              1
-
+#define configGENERATE_RUN_TIME_STATS              1
+
+/* Run time stats count microseconds on TIM5, which stm32_init has already started.
+The total wraps 71 minutes after power on, and the CPU shares are wrong from then on. */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()           stm32_get_time_us()
+
+/* The host build in sitl/ reports a failed assert and stops instead of hanging, and
+uses the idle hook to move its simulated clock on to the next event. */
+#ifdef SITL
+void vPortAssert( const char *pcFile, int xLine );
+#undef configASSERT
+#define configASSERT( x ) if ((x) == 0) vPortAssert( __FILE__, __LINE__ )
+#undef configUSE_IDLE_HOOK
+#define configUSE_IDLE_HOOK 1
+#undef xPortSysTickHandler
+#endif
 
 /* USER CODE END Defines */ 
 
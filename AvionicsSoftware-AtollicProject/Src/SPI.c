@@ -14,103 +14,135 @@
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 #include "SPI.h"
+#include <stdbool.h>
 #include "hardware_definitions.h"
 #include "FreeRTOS.h"
 #include "portable.h"
+#include "task.h"
+#include "semphr.h"
+#include "utilities/profiler.h"
 
 
-#define SPI1_CS_PIN        FLASH_SPI_CS_PIN
-#define SPI1_CS_PORT    FLASH_SPI_CS_PORT
+#define SPI_MAX_TRANSFER_SIZE	0xFFFF	//Largest transfer the HAL accepts in one call.
 
-#define SPI2_CS_PIN        PRES_SPI_CS_PIN
-#define SPI2_CS_PORT    PRES_SPI_CS_PORT
+//Transfers shorter than this are polled: for command and register bytes, setting up the DMA costs more than it saves.
+#define SPI_DMA_MIN_TRANSFER_SIZE	16
 
-//Right now the timeout value is used to select between chip selects.
-//We should really find a better way to do this!
-//Currently only works with the send and receive functions.
-//timeout=10 for acc
-//timeout=other for gyro
+//Must be numerically >= configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, since the completion ISRs use the FreeRTOS API.
+#define SPI_DMA_IRQ_PRIORITY		6
 
-#define SPI3_CS1_PIN    IMU_SPI_ACC_CS_PIN
-#define SPI3_CS1_PORT   IMU_SPI_ACC_CS_PORT
+#define SPI_MAX_DEVICES				4		//Flash, BMP388, BMI088 accelerometer and gyroscope.
+#define SPI_CR1_CLOCK_BITS			(SPI_CR1_BR | SPI_CR1_CPOL | SPI_CR1_CPHA)
 
-#define SPI3_CS2_PIN    IMU_SPI_GYRO_CS_PIN
-#define SPI3_CS2_PORT   IMU_SPI_GYRO_CS_PORT
+//DMA streams, as CubeMX would name them. The IRQ handlers in stm32f4xx_it.c refer to these.
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
+DMA_HandleTypeDef hdma_spi2_rx;
+DMA_HandleTypeDef hdma_spi2_tx;
+DMA_HandleTypeDef hdma_spi3_rx;
+DMA_HandleTypeDef hdma_spi3_tx;
 
+typedef struct
+{
+	SPI_HandleTypeDef handle;			//First, so the HAL callbacks can get back to the bus from it.
+	bool initialised;
+	uint32_t clock_settings;			//Prescaler, CPOL and CPHA the bus is set to now, as CR1 bits.
+	SemaphoreHandle_t lock;				//Held for a whole transaction, chip select to chip select.
+	StaticSemaphore_t lock_buffer;
+
+	//Book keeping for the DMA transfer in flight.
+	TaskHandle_t waiting_task;			//Task blocked until the transfer completes.
+	volatile HAL_StatusTypeDef result;	//Set by the completion callback.
+} spi_bus;
 
-SPI spi1_init(void)
+typedef struct
 {
-	__HAL_RCC_SPI1_CLK_ENABLE();
-	SPI_HandleTypeDef *hspi = (SPI_HandleTypeDef *) pvPortMalloc(sizeof(SPI_HandleTypeDef));
-	if(hspi == NULL)
+	spi_bus *bus;
+	GPIO_TypeDef *cs_port;
+	uint16_t cs_pin;
+	uint32_t clock_settings;			//What the bus must be set to for this device.
+	uint32_t clock_hz;
+} spi_device;
+
+static spi_bus s_buses[SPI_NUM_BUSES];
+static spi_device s_devices[SPI_MAX_DEVICES];
+static uint8_t s_device_count;
+
+static spi_bus *get_bus(SPI_HandleTypeDef *hspi)
+{
+	return (spi_bus *) hspi;
+}
+
+static void dma_init(SPI_HandleTypeDef *hspi, DMA_HandleTypeDef *hdma_rx, DMA_Stream_TypeDef *rx_stream, IRQn_Type rx_irq,
+					 DMA_HandleTypeDef *hdma_tx, DMA_Stream_TypeDef *tx_stream, IRQn_Type tx_irq, uint32_t channel)
+{
+	hdma_rx->Instance = rx_stream;
+	hdma_rx->Init.Channel = channel;
+	hdma_rx->Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_rx->Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_rx->Init.MemInc = DMA_MINC_ENABLE;
+	hdma_rx->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_rx->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_rx->Init.Mode = DMA_NORMAL;
+	hdma_rx->Init.Priority = DMA_PRIORITY_HIGH;
+	hdma_rx->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if(HAL_DMA_Init(hdma_rx) != HAL_OK)
 	{
-		return NULL;
+		while(1)
+		{} //DMA setup failed!
 	}
-	
-	hspi->Instance = SPI1;
-	hspi->Init.Mode = SPI_MODE_MASTER;
-	hspi->Init.Direction = SPI_DIRECTION_2LINES;
-	hspi->Init.DataSize = SPI_DATASIZE_8BIT;
-	hspi->Init.CLKPolarity = SPI_POLARITY_LOW;
-	hspi->Init.CLKPhase = SPI_PHASE_1EDGE;
-	hspi->Init.NSS = SPI_NSS_SOFT;
-	hspi->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_256;
-	hspi->Init.FirstBit = SPI_FIRSTBIT_MSB;
-	hspi->Init.TIMode = SPI_TIMODE_DISABLE;
-	hspi->Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
-	hspi->Init.CRCPolynomial = 10;
-	
-	if(HAL_SPI_Init(hspi) != HAL_OK)
+	__HAL_LINKDMA(hspi, hdmarx, *hdma_rx);
+
+	hdma_tx->Instance = tx_stream;
+	hdma_tx->Init.Channel = channel;
+	hdma_tx->Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_tx->Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_tx->Init.MemInc = DMA_MINC_ENABLE;
+	hdma_tx->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_tx->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_tx->Init.Mode = DMA_NORMAL;
+	hdma_tx->Init.Priority = DMA_PRIORITY_MEDIUM;
+	hdma_tx->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if(HAL_DMA_Init(hdma_tx) != HAL_OK)
 	{
 		while(1)
-		{} //SPI setup failed!
+		{} //DMA setup failed!
 	}
-	
-	
-	/*SPI1 GPIO Configuration
-	PA5     ------> SPI1_SCK
-	PA6     ------> SPI1_MISO
-	PA7     ------> SPI1_MOSI
-	PA9     ------> SPI1_CS
-	*/
-	GPIO_InitTypeDef GPIO_InitStruct = {0};
-	
-	__HAL_RCC_GPIOA_CLK_ENABLE();
-	__HAL_RCC_GPIOC_CLK_ENABLE();
-	
-	//Setup the SPI MOSI,MISO and SCK. These pins are fixed.
-	GPIO_InitStruct.Pin = FLASH_SPI_SCK_PIN | FLASH_SPI_MOSI_PIN | FLASH_SPI_MISO_PIN;
-	GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-	GPIO_InitStruct.Pull = GPIO_NOPULL;
-	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	GPIO_InitStruct.Alternate = GPIO_AF5_SPI1;
-	HAL_GPIO_Init(FLASH_SPI_PORT, &GPIO_InitStruct);
-	
-	//Setup the SPI CS. This can be any pin.
-	GPIO_InitStruct.Pin = SPI1_CS_PIN;
-	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	GPIO_InitStruct.Pull = GPIO_NOPULL;
-	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	GPIO_InitStruct.Alternate = 0;
-	
-	HAL_GPIO_Init(SPI1_CS_PORT, &GPIO_InitStruct);
-	HAL_GPIO_WritePin(SPI1_CS_PORT, SPI1_CS_PIN, GPIO_PIN_SET);
+	__HAL_LINKDMA(hspi, hdmatx, *hdma_tx);
 
-	return hspi;
+	HAL_NVIC_SetPriority(rx_irq, SPI_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(rx_irq);
+	HAL_NVIC_SetPriority(tx_irq, SPI_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(tx_irq);
 }
 
-SPI spi2_init(void)
+
+/**
+ * @brief Sets up the peripheral, its pins and its DMA streams. The chip selects belong to the devices.
+ */
+static void bus_init(spi_bus_id id)
 {
-	__HAL_RCC_SPI2_CLK_ENABLE();
-	__HAL_RCC_GPIOB_CLK_ENABLE();
-	
-	SPI_HandleTypeDef *hspi = (SPI_HandleTypeDef *) pvPortMalloc(sizeof(SPI_HandleTypeDef));
-	if(hspi == NULL)
+	spi_bus *bus = &s_buses[id];
+	SPI_HandleTypeDef *hspi = &bus->handle;
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	switch(id)
 	{
-		return NULL;
+		case SPI_BUS_1:
+			__HAL_RCC_SPI1_CLK_ENABLE();
+			hspi->Instance = SPI1;
+			break;
+		case SPI_BUS_2:
+			__HAL_RCC_SPI2_CLK_ENABLE();
+			hspi->Instance = SPI2;
+			break;
+		default:
+			__HAL_RCC_SPI3_CLK_ENABLE();
+			hspi->Instance = SPI3;
+			break;
 	}
-	
-	hspi->Instance = SPI2;
+
+	//Starts at the slowest clock. The first transaction sets what its device wants.
 	hspi->Init.Mode = SPI_MODE_MASTER;
 	hspi->Init.Direction = SPI_DIRECTION_2LINES;
 	hspi->Init.DataSize = SPI_DATASIZE_8BIT;
@@ -122,324 +154,310 @@ SPI spi2_init(void)
 	hspi->Init.TIMode = SPI_TIMODE_DISABLE;
 	hspi->Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
 	hspi->Init.CRCPolynomial = 10;
+
 	if(HAL_SPI_Init(hspi) != HAL_OK)
 	{
 		while(1)
 		{} //SPI setup failed!
 	}
-	
-	
-	/*SPI2 GPIO Configuration
-	PB13     ------> SPI1_SCK
-	PB14     ------> SPI1_MISO
-	PB15     ------> SPI1_MOSI
-	PC7     ------> SPI1_CS
-	*/
-	GPIO_InitTypeDef GPIO_InitStruct = {0};
-	
-	__HAL_RCC_GPIOC_CLK_ENABLE();
-	
-	//Setup the SPI MOSI,MISO and SCK. These pins are fixed.
-	GPIO_InitStruct.Pin = PRES_SPI_SCK_PIN | PRES_SPI_MOSI_PIN | PRES_SPI_MISO_PIN;
+	bus->clock_settings = SPI_BAUDRATEPRESCALER_256 | SPI_POLARITY_LOW | SPI_PHASE_1EDGE;
+
 	GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
 	GPIO_InitStruct.Pull = GPIO_NOPULL;
 	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	GPIO_InitStruct.Alternate = GPIO_AF5_SPI2;
-	HAL_GPIO_Init(PRES_SPI_PORT, &GPIO_InitStruct);
-	
-	//Setup the SPI CS. This can be any pin.
-	GPIO_InitStruct.Pin = SPI2_CS_PIN;
-	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	GPIO_InitStruct.Pull = GPIO_NOPULL;
-	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	GPIO_InitStruct.Alternate = 0;
-	
-	HAL_GPIO_Init(SPI2_CS_PORT, &GPIO_InitStruct);
 
-	return hspi;
+	switch(id)
+	{
+		case SPI_BUS_1:
+			//SPI1_RX -> DMA2 Stream 0, SPI1_TX -> DMA2 Stream 3 (both channel 3).
+			__HAL_RCC_DMA2_CLK_ENABLE();
+			dma_init(hspi, &hdma_spi1_rx, DMA2_Stream0, DMA2_Stream0_IRQn, &hdma_spi1_tx, DMA2_Stream3, DMA2_Stream3_IRQn,
+					 DMA_CHANNEL_3);
+
+			//PA5 SCK, PA6 MISO, PA7 MOSI.
+			__HAL_RCC_GPIOA_CLK_ENABLE();
+			GPIO_InitStruct.Pin = FLASH_SPI_SCK_PIN | FLASH_SPI_MOSI_PIN | FLASH_SPI_MISO_PIN;
+			GPIO_InitStruct.Alternate = GPIO_AF5_SPI1;
+			HAL_GPIO_Init(FLASH_SPI_PORT, &GPIO_InitStruct);
+			break;
+		case SPI_BUS_2:
+			//SPI2_RX -> DMA1 Stream 3, SPI2_TX -> DMA1 Stream 4 (both channel 0).
+			__HAL_RCC_DMA1_CLK_ENABLE();
+			dma_init(hspi, &hdma_spi2_rx, DMA1_Stream3, DMA1_Stream3_IRQn, &hdma_spi2_tx, DMA1_Stream4, DMA1_Stream4_IRQn,
+					 DMA_CHANNEL_0);
+
+			//PB13 SCK, PB14 MISO, PB15 MOSI.
+			__HAL_RCC_GPIOB_CLK_ENABLE();
+			GPIO_InitStruct.Pin = PRES_SPI_SCK_PIN | PRES_SPI_MOSI_PIN | PRES_SPI_MISO_PIN;
+			GPIO_InitStruct.Alternate = GPIO_AF5_SPI2;
+			HAL_GPIO_Init(PRES_SPI_PORT, &GPIO_InitStruct);
+			break;
+		default:
+			//SPI3_RX -> DMA1 Stream 0, SPI3_TX -> DMA1 Stream 5 (both channel 0).
+			__HAL_RCC_DMA1_CLK_ENABLE();
+			dma_init(hspi, &hdma_spi3_rx, DMA1_Stream0, DMA1_Stream0_IRQn, &hdma_spi3_tx, DMA1_Stream5, DMA1_Stream5_IRQn,
+					 DMA_CHANNEL_0);
+
+			//PC10 SCK, PC11 MISO, PC12 MOSI.
+			__HAL_RCC_GPIOC_CLK_ENABLE();
+			GPIO_InitStruct.Pin = IMU_SPI_SCK_PIN | IMU_SPI_MOSI_PIN | IMU_SPI_MISO_PIN;
+			GPIO_InitStruct.Alternate = GPIO_AF6_SPI3;
+			HAL_GPIO_Init(IMU_SPI_PORT, &GPIO_InitStruct);
+			break;
+	}
+
+	bus->lock = xSemaphoreCreateMutexStatic(&bus->lock_buffer);
+	bus->initialised = true;
 }
 
-SPI spi3_init(void)
+SPI spi_register_device(const spi_device_config *config)
 {
-	__HAL_RCC_SPI3_CLK_ENABLE();
-	__HAL_RCC_GPIOC_CLK_ENABLE();
-	
-	SPI_HandleTypeDef *hspi = (SPI_HandleTypeDef *) pvPortMalloc(sizeof(SPI_HandleTypeDef));
-	if(hspi == NULL)
+	if(s_device_count == SPI_MAX_DEVICES)
 	{
 		return NULL;
 	}
-	
-	hspi->Instance = SPI3;
-	hspi->Init.Mode = SPI_MODE_MASTER;
-	hspi->Init.Direction = SPI_DIRECTION_2LINES;
-	hspi->Init.DataSize = SPI_DATASIZE_8BIT;
-	hspi->Init.CLKPolarity = SPI_POLARITY_LOW;
-	hspi->Init.CLKPhase = SPI_PHASE_1EDGE;
-	hspi->Init.NSS = SPI_NSS_SOFT;
-	hspi->Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_256;
-	hspi->Init.FirstBit = SPI_FIRSTBIT_MSB;
-	hspi->Init.TIMode = SPI_TIMODE_DISABLE;
-	hspi->Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
-	hspi->Init.CRCPolynomial = 10;
-	if(HAL_SPI_Init(hspi) != HAL_OK)
+
+	spi_bus *bus = &s_buses[config->bus];
+	if(!bus->initialised)
 	{
-		while(1)
-		{} //SPI setup failed!
+		bus_init(config->bus);
+	}
+
+	//SPI1 is on APB2, the other two on APB1. The prescalers are the powers of two from 2 to 256.
+	uint32_t pclk = (config->bus == SPI_BUS_1) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+	uint32_t prescaler = 0;
+	while(prescaler < 7 && (pclk >> (prescaler + 1)) > config->max_clock_hz)
+	{
+		prescaler++;
 	}
-	
-	
-	
-	/*SPI3 GPIO Configuration
-	PC10     ------> SPI1_SCK
-	PC11     ------> SPI1_MISO
-	PC12     ------> SPI1_MOSI
-	
-	
-	*/
+
+	spi_device *device = &s_devices[s_device_count++];
+	device->bus = bus;
+	device->cs_port = config->cs_port;
+	device->cs_pin = config->cs_pin;
+	device->clock_hz = pclk >> (prescaler + 1);
+	device->clock_settings = (prescaler << SPI_CR1_BR_Pos) | ((config->mode & 0x02) ? SPI_POLARITY_HIGH : SPI_POLARITY_LOW) |
+							 ((config->mode & 0x01) ? SPI_PHASE_2EDGE : SPI_PHASE_1EDGE);
+
 	GPIO_InitTypeDef GPIO_InitStruct = {0};
-	
-	__HAL_RCC_GPIOC_CLK_ENABLE();
-	__HAL_RCC_GPIOB_CLK_ENABLE();
-	
-	//Setup the SPI MOSI,MISO and SCK. These pins are fixed.
-	
-	GPIO_InitStruct.Pin = IMU_SPI_SCK_PIN | IMU_SPI_MOSI_PIN | IMU_SPI_MISO_PIN;
-	
-	GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+	GPIO_InitStruct.Pin = config->cs_pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
 	GPIO_InitStruct.Pull = GPIO_NOPULL;
 	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	GPIO_InitStruct.Alternate = GPIO_AF6_SPI3;
-	
-	HAL_GPIO_Init(IMU_SPI_PORT, &GPIO_InitStruct);
-	
-	GPIO_InitTypeDef GPIO_InitStruct2 = {0};
-	//Setup the SPI CS. This can be any pin.
-	GPIO_InitStruct2.Pin = SPI3_CS1_PIN | SPI3_CS2_PIN;
-	
-	GPIO_InitStruct2.Mode = GPIO_MODE_OUTPUT_PP;
-	GPIO_InitStruct2.Pull = GPIO_NOPULL;
-	GPIO_InitStruct2.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-	GPIO_InitStruct2.Alternate = 0;
-	
-	HAL_GPIO_Init(SPI3_CS1_PORT, &GPIO_InitStruct2);
-	
-	//Make sure both CS are high. Undefined behavior if these are not high be for communication begins.
-	HAL_GPIO_WritePin(SPI3_CS1_PORT, SPI3_CS1_PIN, GPIO_PIN_SET);
-	HAL_GPIO_WritePin(SPI3_CS2_PORT, SPI3_CS2_PIN, GPIO_PIN_SET);
-
-	return hspi;
+	GPIO_InitStruct.Alternate = 0;
+	HAL_GPIO_Init(config->cs_port, &GPIO_InitStruct);
+
+	//Undefined behaviour if a chip select is not high before communication begins.
+	HAL_GPIO_WritePin(config->cs_port, config->cs_pin, GPIO_PIN_SET);
+
+	return device;
 }
 
-static void
-transmit(SPI_HandleTypeDef *hspi, uint8_t *reg_addr, uint8_t *tx_buffer, uint16_t size, uint32_t timeout)
+uint32_t spi_get_clock_hz(SPI device)
 {
-	HAL_StatusTypeDef stat;
-	GPIO_TypeDef *port = SPI1_CS_PORT;
-	uint16_t pin = 0;
-	
-	if(hspi->Instance == SPI1)
-	{
-		port = SPI1_CS_PORT;
-		pin = SPI1_CS_PIN;
-	}else if(hspi->Instance == SPI2)
-	{
-		port = SPI2_CS_PORT;
-		pin = SPI2_CS_PIN;
-	}else if(hspi->Instance == SPI3)
-	{
-		port = SPI3_CS1_PORT;
-		pin = SPI3_CS1_PIN;
-	}
-	//Write the CS low (lock)
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_RESET);
-	
-	/* Select the slave register (**1 byte address**) first via a uart_transmit */
-	stat = HAL_SPI_Transmit(hspi, reg_addr, 1, timeout);
-	while(stat != HAL_OK)
-	{ stat = HAL_SPI_GetState(hspi); }
-	/* Send the tx_buffer to slave */
-	
-	if(size > 1)
-	{
-		stat = HAL_SPI_Transmit(hspi, tx_buffer, size, timeout);
-		while(stat != HAL_OK)
-		{ stat = HAL_SPI_GetState(hspi); }
-	}
-	
-	//Write the CS hi (release)
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_SET);
+	return ((spi_device *) device)->clock_hz;
 }
 
-static void
-read(SPI_HandleTypeDef *hspi, uint8_t *addr_buffer, uint8_t *rx_buffer, uint16_t total_size, uint32_t timeout)
+//Starts a DMA transfer and blocks the calling task on a notification until the completion interrupt fires.
+//Other tasks run while the bytes are on the wire.
+static HAL_StatusTypeDef transfer_dma(SPI_HandleTypeDef *hspi, uint8_t *tx_buffer, uint8_t *rx_buffer, uint16_t size,
+									  uint32_t timeout)
 {
-	GPIO_TypeDef *port = SPI1_CS_PORT;
-	uint16_t pin = 0;
+	spi_bus *bus = get_bus(hspi);
 	HAL_StatusTypeDef stat;
-	
-	if(hspi->Instance == SPI1)
-	{
-		port = SPI1_CS_PORT;
-		pin = SPI1_CS_PIN;
-	}else if(hspi->Instance == SPI2)
+
+	bus->waiting_task = xTaskGetCurrentTaskHandle();
+	bus->result = HAL_BUSY;
+	ulTaskNotifyTake(pdTRUE, 0); //Drop any stale notification.
+
+	if(rx_buffer != NULL)
 	{
-		port = SPI2_CS_PORT;
-		pin = SPI2_CS_PIN;
-	}else if(hspi->Instance == SPI3)
+		stat = HAL_SPI_Receive_DMA(hspi, rx_buffer, size);
+	}else
 	{
-		port = SPI3_CS1_PORT;
-		pin = SPI3_CS1_PIN;
+		stat = HAL_SPI_Transmit_DMA(hspi, tx_buffer, size);
 	}
-	//Write the CS low
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_RESET);
-	
-	//Could also use HAL_TransmittReceive.
-	
-	//Send the address to read from.
-	stat = HAL_SPI_Transmit(hspi, addr_buffer, 1, timeout);
-	while(stat != HAL_OK)
+
+	if(stat != HAL_OK)
 	{
-		stat = HAL_SPI_GetState(hspi);
+		bus->waiting_task = NULL;
+		return stat;
 	}
-	
-	//Read in the specified number of bytes.
-	stat = HAL_SPI_Receive(hspi, rx_buffer, total_size - 1, timeout);
-	while(stat != HAL_OK)
+
+	if(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout)) == 0)
 	{
-		stat = HAL_SPI_GetState(hspi);
+		HAL_SPI_Abort(hspi);
+		bus->waiting_task = NULL;
+		return HAL_TIMEOUT;
 	}
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_SET);
-	
+
+	return bus->result;
 }
-static void receive(SPI_HandleTypeDef *hspi, uint8_t *addr_buffer, uint8_t addr_buffer_size, uint8_t *rx_buffer,
-					uint16_t rx_buffer_size, uint32_t timeout)
+
+//Moves the data phase of a transaction. The caller owns the chip select.
+//Either tx_buffer or rx_buffer is used, never both.
+static HAL_StatusTypeDef transfer(SPI_HandleTypeDef *hspi, uint8_t *tx_buffer, uint8_t *rx_buffer, uint32_t size,
+								  uint32_t timeout)
 {
-	GPIO_TypeDef *port = SPI1_CS_PORT;
-	uint16_t pin = 0;
-	HAL_StatusTypeDef stat;
-	
-	if(hspi->Instance == SPI1)
-	{
-		port = SPI1_CS_PORT;
-		pin = SPI1_CS_PIN;
-	}else if(hspi->Instance == SPI2)
-	{
-		port = SPI2_CS_PORT;
-		pin = SPI2_CS_PIN;
-	}else if(hspi->Instance == SPI3)
+	HAL_StatusTypeDef stat = HAL_OK;
+	uint8_t use_dma = (hspi->hdmarx != NULL) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+
+	//A single HAL transfer is limited to 16 bits, so longer transfers are split while CS stays low.
+	while(size > 0 && stat == HAL_OK)
 	{
-		
-		if(timeout == 10)
+		uint16_t chunk = (size > SPI_MAX_TRANSFER_SIZE) ? SPI_MAX_TRANSFER_SIZE : size;
+
+		if(use_dma && chunk >= SPI_DMA_MIN_TRANSFER_SIZE)
 		{
-			port = SPI3_CS1_PORT;
-			pin = SPI3_CS1_PIN;
+			stat = transfer_dma(hspi, tx_buffer, rx_buffer, chunk, timeout);
+		}else if(rx_buffer != NULL)
+		{
+			stat = HAL_SPI_Receive(hspi, rx_buffer, chunk, timeout);
 		}else
 		{
-			port = SPI3_CS2_PORT;
-			pin = SPI3_CS2_PIN;
+			stat = HAL_SPI_Transmit(hspi, tx_buffer, chunk, timeout);
 		}
-		
-	}
-	//Write the CS low
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_RESET);
-	
-	//Could also use HAL_TransmittReceive.
-	
-	//Send the address to read from.
-	if(addr_buffer_size > 0)
-	{
-		stat = HAL_SPI_Transmit(hspi, addr_buffer, addr_buffer_size, timeout);
-		while(stat != HAL_OK)
+
+		if(rx_buffer != NULL)
 		{
-			stat = HAL_SPI_GetState(hspi);
-		}
-	}
-	//Read in the specified number of bytes.
-	if(rx_buffer_size > 0)
-	{
-		stat = HAL_SPI_Receive(hspi, rx_buffer, rx_buffer_size, timeout);
-		while(stat != HAL_OK)
+			rx_buffer += chunk;
+		}else
 		{
-			stat = HAL_SPI_GetState(hspi);
+			tx_buffer += chunk;
 		}
+		size -= chunk;
 	}
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_SET);
-	
+
+	return stat;
 }
-static void
-send(SPI_HandleTypeDef *hspi, uint8_t *reg_addr, uint8_t reg_addr_size, uint8_t *tx_buffer, uint16_t tx_buffer_size,
-	 uint32_t timeout)
+
+/**
+ * @brief Takes the bus, switches it to the device's clock and mode if the last device used others, and asserts the
+ * device's chip select. Before the scheduler starts there is only one context, and nothing to lock against.
+ * @return The bus, or NULL if it could not be locked.
+ */
+static SPI_HandleTypeDef *select(spi_device *device)
 {
-	
-	
-	HAL_StatusTypeDef stat;
-	GPIO_TypeDef *port = SPI1_CS_PORT;
-	uint16_t pin = 0;
-	
-	if(hspi->Instance == SPI1)
+	spi_bus *bus = device->bus;
+
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && xSemaphoreTake(bus->lock, portMAX_DELAY) != pdTRUE)
 	{
-		port = SPI1_CS_PORT;
-		pin = SPI1_CS_PIN;
-	}else if(hspi->Instance == SPI2)
+		return NULL;
+	}
+
+	//BR, CPOL and CPHA may only change while the peripheral is off. The HAL turns it back on with the next transfer.
+	if(bus->clock_settings != device->clock_settings)
 	{
-		port = SPI2_CS_PORT;
-		pin = SPI2_CS_PIN;
-	}else if(hspi->Instance == SPI3)
+		__HAL_SPI_DISABLE(&bus->handle);
+		MODIFY_REG(bus->handle.Instance->CR1, SPI_CR1_CLOCK_BITS, device->clock_settings);
+		bus->handle.Init.BaudRatePrescaler = device->clock_settings & SPI_CR1_BR;
+		bus->handle.Init.CLKPolarity = device->clock_settings & SPI_CR1_CPOL;
+		bus->handle.Init.CLKPhase = device->clock_settings & SPI_CR1_CPHA;
+		bus->clock_settings = device->clock_settings;
+	}
+
+	HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_RESET);
+	return &bus->handle;
+}
+
+static void deselect(spi_device *device)
+{
+	HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_SET);
+
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
 	{
-		
-		if(timeout == 10)
-		{
-			port = SPI3_CS1_PORT;
-			pin = SPI3_CS1_PIN;
-		}else
-		{
-			port = SPI3_CS2_PORT;
-			pin = SPI3_CS2_PIN;
-		}
+		xSemaphoreGive(device->bus->lock);
 	}
-	//Write the CS low (lock)
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_RESET);
-	
-	/* Select the slave register (**1 byte address**) first via a uart_transmit */
-	if(reg_addr_size > 0)
+}
+
+/**
+ * @brief One transaction: the command or address bytes, then the data phase, with the chip select held low. The data
+ * phase is skipped if the command did not go out.
+ * @return The status of the first transfer that failed, HAL_BUSY if the bus could not be locked, or HAL_OK.
+ */
+static HAL_StatusTypeDef transaction(spi_device *device, uint8_t *command, uint32_t command_size, uint8_t *tx_buffer,
+									 uint8_t *rx_buffer, uint32_t size, uint32_t timeout)
+{
+	SPI_HandleTypeDef *hspi = select(device);
+	if(hspi == NULL)
 	{
-		stat = HAL_SPI_Transmit(hspi, reg_addr, reg_addr_size, timeout);
-		while(stat != HAL_OK)
-		{
-			stat = HAL_SPI_GetState(hspi);
-		}
+		return HAL_BUSY;
 	}
-	/* Send the tx_buffer to slave */
-	if(tx_buffer_size > 0)
+
+	HAL_StatusTypeDef stat = transfer(hspi, command, NULL, command_size, timeout);
+	if(stat == HAL_OK && size > 0)
 	{
-		stat = HAL_SPI_Transmit(hspi, tx_buffer, tx_buffer_size, timeout);
-		while(stat != HAL_OK)
-		{
-			stat = HAL_SPI_GetState(hspi);
-		}
+		stat = transfer(hspi, tx_buffer, rx_buffer, size, timeout);
 	}
-	//Write the CS hi (release)
-	HAL_GPIO_WritePin(port, pin, GPIO_PIN_SET);
-	
+
+	deselect(device);
+	return stat;
 }
-void spi_transmit(SPI hspi, uint8_t *addr_buffer, uint8_t *tx_buffer, uint16_t total_size, uint32_t timeout)
+
+//Completion callbacks, called by the HAL from the DMA interrupts. They wake the task waiting in transfer_dma.
+static void notify_transfer_done(SPI_HandleTypeDef *hspi, HAL_StatusTypeDef result)
 {
-	transmit(hspi, addr_buffer, tx_buffer, total_size, timeout);
+	spi_bus *bus = get_bus(hspi);
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	bus->result = result;
+	if(bus->waiting_task != NULL)
+	{
+		vTaskNotifyGiveFromISR(bus->waiting_task, &higher_priority_task_woken);
+		bus->waiting_task = NULL;
+	}
+	portYIELD_FROM_ISR(higher_priority_task_woken);
 }
-void spi_read(SPI hspi, uint8_t *addr_buffer, uint8_t *rx_buffer, uint16_t total_size, uint32_t timeout)
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-	read(hspi, addr_buffer, rx_buffer, total_size, timeout);
+	notify_transfer_done(hspi, HAL_OK);
 }
-void spi_send(SPI hspi, uint8_t *reg_addr, uint8_t reg_addr_size, uint8_t *tx_buffer, uint16_t tx_buffer_size,
-			  uint32_t timeout)
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-	send(hspi, reg_addr, reg_addr_size, tx_buffer, tx_buffer_size, timeout);
+	notify_transfer_done(hspi, HAL_OK);
 }
-void spi_receive(SPI hspi, uint8_t *addr_buffer, uint8_t addr_buffer_size, uint8_t *rx_buffer, uint16_t rx_buffer_size,
-				 uint32_t timeout)
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-	receive(hspi, addr_buffer, addr_buffer_size, rx_buffer, rx_buffer_size, timeout);
+	notify_transfer_done(hspi, HAL_OK);
 }
 
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	notify_transfer_done(hspi, HAL_ERROR);
+}
 
+HAL_StatusTypeDef spi_transmit(SPI hspi, uint8_t *addr_buffer, uint8_t *tx_buffer, uint16_t total_size, uint32_t timeout)
+{
+	uint32_t start = profiler_start();
+	//The register address is always 1 byte, and the payload is only sent if there is more than it.
+	HAL_StatusTypeDef stat = transaction(hspi, addr_buffer, 1, tx_buffer, NULL, (total_size > 1) ? total_size : 0, timeout);
+	profiler_end(PROFILER_SPAN_SPI_TRANSACTION, start);
+	return stat;
+}
+HAL_StatusTypeDef spi_read(SPI hspi, uint8_t *addr_buffer, uint8_t *rx_buffer, uint16_t total_size, uint32_t timeout)
+{
+	uint32_t start = profiler_start();
+	HAL_StatusTypeDef stat = transaction(hspi, addr_buffer, 1, NULL, rx_buffer, (total_size > 0) ? total_size - 1u : 0,
+										 timeout);
+	profiler_end(PROFILER_SPAN_SPI_TRANSACTION, start);
+	return stat;
+}
+HAL_StatusTypeDef spi_send(SPI hspi, uint8_t *reg_addr, uint8_t reg_addr_size, uint8_t *tx_buffer,
+						   uint32_t tx_buffer_size, uint32_t timeout)
+{
+	uint32_t start = profiler_start();
+	HAL_StatusTypeDef stat = transaction(hspi, reg_addr, reg_addr_size, tx_buffer, NULL, tx_buffer_size, timeout);
+	profiler_end(PROFILER_SPAN_SPI_TRANSACTION, start);
+	return stat;
+}
+HAL_StatusTypeDef spi_receive(SPI hspi, uint8_t *addr_buffer, uint8_t addr_buffer_size, uint8_t *rx_buffer,
+							  uint32_t rx_buffer_size, uint32_t timeout)
+{
+	uint32_t start = profiler_start();
+	HAL_StatusTypeDef stat = transaction(hspi, addr_buffer, addr_buffer_size, NULL, rx_buffer, rx_buffer_size, timeout);
+	profiler_end(PROFILER_SPAN_SPI_TRANSACTION, start);
+	return stat;
+}
@@ -5,6 +5,8 @@
 static STM32Status system_clock_config(void);
 static void GPIO_init(void);
 
+static TIM_HandleTypeDef s_timestamp_timer;
+
 STM32Status stm32_init(void)
 {
 	/* Reset of all peripherals, Initializes the Flash interface and the Systick. */
@@ -23,7 +25,36 @@ STM32Status stm32_init(void)
 	/* Initialize all configured peripherals */
 	GPIO_init();
 	
-	return STM32_OK;
+	return stm32_timestamp_init();
+}
+
+STM32Status stm32_timestamp_init(void)
+{
+	/* TIM5 sits on APB1. Its clock is twice PCLK1 whenever the APB1 prescaler is not 1. */
+	uint32_t timer_clock = HAL_RCC_GetPCLK1Freq();
+	if((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1)
+	{
+		timer_clock *= 2;
+	}
+	
+	__HAL_RCC_TIM5_CLK_ENABLE();
+	
+	s_timestamp_timer.Instance = TIM5;
+	s_timestamp_timer.Init.Prescaler = (timer_clock / 1000000) - 1;
+	s_timestamp_timer.Init.CounterMode = TIM_COUNTERMODE_UP;
+	s_timestamp_timer.Init.Period = 0xFFFFFFFF;
+	s_timestamp_timer.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	if(HAL_TIM_Base_Init(&s_timestamp_timer) != HAL_OK)
+	{
+		return STM32_ERROR;
+	}
+	
+	return (HAL_TIM_Base_Start(&s_timestamp_timer) == HAL_OK) ? STM32_OK : STM32_ERROR;
+}
+
+uint32_t stm32_get_time_us(void)
+{
+	return TIM5->CNT;
 }
 
 void stm32_delay(__uint32_t ms)
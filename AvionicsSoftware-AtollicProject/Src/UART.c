@@ -23,6 +23,7 @@
 
 #include "FreeRTOS.h"
 #include "portable.h"
+#include "semphr.h"
 #include "hardware_definitions.h"
 
 
@@ -32,6 +33,24 @@
 uint8_t bufftx[BUFFER_SIZE] = ""; //uart_transmit buffer
 uint8_t buffrx[BUFFER_SIZE] = ""; //receive buffer
 
+//Must be numerically >= configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, since the completion ISR uses the FreeRTOS API.
+#define UART_DMA_IRQ_PRIORITY	6
+
+//DMA streams, as CubeMX would name them. The IRQ handlers in stm32f4xx_it.c refer to these.
+DMA_HandleTypeDef hdma_usart6_rx;
+DMA_HandleTypeDef hdma_usart6_tx;
+UART_HandleTypeDef *huart6_dma;	//The port the USART6 IRQ handler passes to the HAL.
+
+static UART_HandleTypeDef s_uart2;
+static UART_HandleTypeDef s_uart6;
+
+static SemaphoreHandle_t s_tx_done;		//Given by the transmit complete callback.
+static StaticSemaphore_t s_tx_done_buffer;
+static volatile bool s_tx_busy;
+static uint8_t s_rx_ring[UART_RX_RING_SIZE];
+static uint16_t s_rx_tail;				//Next byte of s_rx_ring to hand out.
+static volatile bool s_rx_active;		//Between uart_receive_start and uart_receive_stop.
+
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ENUMS AND ENUM TYPEDEFS
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -59,6 +78,15 @@ uint8_t buffrx[BUFFER_SIZE] = ""; //receive buffer
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 static void Error_Handler_UART(void);
 
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sets up the USART6 transmit (DMA2 stream 6) and circular receive (DMA2 stream 1) streams, both on channel 5.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void uart6_dma_init(UART_HandleTypeDef *uart);
+
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // FUNCTIONS
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -86,12 +114,7 @@ UART UART_Port2_Init(void)
 	GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
 	HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
-	/* Create UART struct */
-	UART_HandleTypeDef* uart = (UART_HandleTypeDef*)pvPortMalloc(sizeof(UART_HandleTypeDef));
-	if(uart == NULL)
-	{
-		return NULL;
-	}
+	UART_HandleTypeDef* uart = &s_uart2;
 
 	uart->Instance = USART2;
 	uart->Init.BaudRate = 9600;
@@ -131,13 +154,7 @@ __HAL_RCC_GPIOA_CLK_ENABLE();
 	GPIO_InitStruct.Alternate = GPIO_AF8_USART6;
 	HAL_GPIO_Init(UART_RX_PORT, &GPIO_InitStruct);
 
-	/* Create UART struct */
-
-	UART_HandleTypeDef* uart = (UART_HandleTypeDef*)pvPortMalloc(sizeof(UART_HandleTypeDef));
-	if(uart == NULL)
-	{
-	return NULL;
-	}
+	UART_HandleTypeDef* uart = &s_uart6;
 
 	uart->Instance = USART6;
 	uart->Init.BaudRate = 115200;
@@ -152,6 +169,8 @@ __HAL_RCC_GPIOA_CLK_ENABLE();
 		Error_Handler_UART();
 	}
 
+	uart6_dma_init(uart);
+
 	return uart;
 }
 
@@ -191,6 +210,89 @@ void uart_transmit_bytes(UART uart, uint8_t * bytes, uint16_t numBytes){
 	}
 }
 
+bool uart_transmit_bytes_dma(UART uart, uint8_t * bytes, uint16_t numBytes){
+
+	UART_HandleTypeDef *huart = (UART_HandleTypeDef *) uart;
+	if(huart->hdmatx == NULL){
+		uart_transmit_bytes(uart, bytes, numBytes);
+		return true;
+	}
+
+	xSemaphoreTake(s_tx_done, 0); //Drop a stale completion.
+	s_tx_busy = true;
+	if(HAL_UART_Transmit_DMA(huart, bytes, numBytes) != HAL_OK){
+		s_tx_busy = false;
+		return false;
+	}
+	return true;
+}
+
+bool uart_wait_transmit_done(UART uart, uint32_t timeout){
+
+	if(!s_tx_busy){
+		return true;
+	}
+	xSemaphoreTake(s_tx_done, pdMS_TO_TICKS(timeout));
+	return !s_tx_busy;
+}
+
+void uart_set_baud_rate(UART uart, uint32_t baud_rate){
+
+	UART_HandleTypeDef *huart = (UART_HandleTypeDef *) uart;
+	bool receiving = huart->RxState == HAL_UART_STATE_BUSY_RX;
+
+	if(receiving){
+		HAL_UART_AbortReceive(huart);
+	}
+	HAL_UART_AbortTransmit(huart);
+	s_tx_busy = false;
+
+	huart->Init.BaudRate = baud_rate;
+	if (HAL_UART_Init(huart) != HAL_OK)
+	{
+		Error_Handler_UART();
+	}
+
+	if(receiving){
+		uart_receive_start(uart);
+	}
+}
+
+void uart_receive_start(UART uart){
+
+	UART_HandleTypeDef *huart = (UART_HandleTypeDef *) uart;
+	s_rx_tail = 0;
+	s_rx_active = true;
+	HAL_UART_Receive_DMA(huart, s_rx_ring, UART_RX_RING_SIZE);
+}
+
+uint16_t uart_receive_available(UART uart, uint8_t * bytes, uint16_t max){
+
+	UART_HandleTypeDef *huart = (UART_HandleTypeDef *) uart;
+	if(huart->hdmarx == NULL || huart->RxState != HAL_UART_STATE_BUSY_RX){
+		return 0;
+	}
+
+	//The DMA counts down the bytes left before it wraps to the start of the ring.
+	uint16_t head = UART_RX_RING_SIZE - __HAL_DMA_GET_COUNTER(huart->hdmarx);
+	if(head == UART_RX_RING_SIZE){
+		head = 0;
+	}
+
+	uint16_t count = 0;
+	while(s_rx_tail != head && count < max){
+		bytes[count++] = s_rx_ring[s_rx_tail];
+		s_rx_tail = (s_rx_tail + 1) % UART_RX_RING_SIZE;
+	}
+	return count;
+}
+
+void uart_receive_stop(UART uart){
+
+	s_rx_active = false;
+	HAL_UART_AbortReceive((UART_HandleTypeDef *) uart);
+}
+
 char* uart_receive_command(UART uart){
 	uint8_t c; //key pressed character
 	size_t i;
@@ -237,6 +339,83 @@ char* uart_receive_command(UART uart){
 	return (char*)buffrx;
 }
 
+static void uart6_dma_init(UART_HandleTypeDef *uart)
+{
+	__HAL_RCC_DMA2_CLK_ENABLE();
+
+	hdma_usart6_tx.Instance = DMA2_Stream6;
+	hdma_usart6_tx.Init.Channel = DMA_CHANNEL_5;
+	hdma_usart6_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_usart6_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_usart6_tx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_usart6_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart6_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_usart6_tx.Init.Mode = DMA_NORMAL;
+	hdma_usart6_tx.Init.Priority = DMA_PRIORITY_LOW;
+	hdma_usart6_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if(HAL_DMA_Init(&hdma_usart6_tx) != HAL_OK)
+	{
+		Error_Handler_UART();
+	}
+	__HAL_LINKDMA(uart, hdmatx, hdma_usart6_tx);
+
+	//Circular, so the receive ring keeps filling without the task restarting it.
+	hdma_usart6_rx.Instance = DMA2_Stream1;
+	hdma_usart6_rx.Init.Channel = DMA_CHANNEL_5;
+	hdma_usart6_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_usart6_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_usart6_rx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_usart6_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart6_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_usart6_rx.Init.Mode = DMA_CIRCULAR;
+	hdma_usart6_rx.Init.Priority = DMA_PRIORITY_LOW;
+	hdma_usart6_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if(HAL_DMA_Init(&hdma_usart6_rx) != HAL_OK)
+	{
+		Error_Handler_UART();
+	}
+	__HAL_LINKDMA(uart, hdmarx, hdma_usart6_rx);
+
+	s_tx_done = xSemaphoreCreateBinaryStatic(&s_tx_done_buffer);
+	huart6_dma = uart;
+
+	HAL_NVIC_SetPriority(DMA2_Stream6_IRQn, UART_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Stream6_IRQn);
+	HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, UART_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
+	HAL_NVIC_SetPriority(USART6_IRQn, UART_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(USART6_IRQn);
+}
+
+//Called by the HAL from the USART6 interrupt once the last byte of a DMA transfer is out.
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	s_tx_busy = false;
+	xSemaphoreGiveFromISR(s_tx_done, &higher_priority_task_woken);
+	portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+//An overrun or framing error stops the receive DMA. Start it again so the ring keeps filling, the protocol on top
+//notices the lost bytes by their CRC.
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	if(s_rx_active && huart->RxState == HAL_UART_STATE_READY && huart->hdmarx != NULL)
+	{
+		s_rx_tail = 0;
+		HAL_UART_Receive_DMA(huart, s_rx_ring, UART_RX_RING_SIZE);
+	}
+	if(s_tx_busy && huart->gState == HAL_UART_STATE_READY)
+	{
+		s_tx_busy = false;
+		xSemaphoreGiveFromISR(s_tx_done, &higher_priority_task_woken);
+	}
+	portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
 static void Error_Handler_UART(void)
 {
   /* User can add his own implementation to report the HAL error return state */
@@ -703,6 +703,18 @@ static int8_t set_int_pin_config(const struct bmi08x_accel_int_channel_cfg *int_
 static int8_t set_accel_data_ready_int(const struct bmi08x_accel_int_channel_cfg *int_config,
 	const struct bmi08x_dev *dev);
 
+/*!
+ * @brief This API sets the FIFO watermark interrupt for accel sensor
+ *
+ * @param[in] int_config  : Structure instance of bmi08x_accel_int_channel_cfg.
+ * @param[in] dev         : Structure instance of bmi08x_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / -ve value -> Error
+ */
+static int8_t set_accel_fifo_wm_int(const struct bmi08x_accel_int_channel_cfg *int_config,
+	const struct bmi08x_dev *dev);
+
 /*!
  * @brief This API sets the synchronized data ready interrupt for accel sensor
  *
@@ -1354,6 +1366,10 @@ int8_t bmi08a_set_int_config(const struct bmi08x_accel_int_channel_cfg *int_conf
 			/* Anymotion interrupt */
 			rslt = set_accel_anymotion_int(int_config, dev);
 			break;
+		case BMI08X_ACCEL_FIFO_WM_INT:
+			/* FIFO watermark interrupt */
+			rslt = set_accel_fifo_wm_int(int_config, dev);
+			break;
 		default:
 			rslt = BMI08X_E_INVALID_CONFIG;
 			break;
@@ -1486,6 +1502,208 @@ int8_t bmi08a_perform_selftest(struct bmi08x_dev *dev)
 	return rslt;
 }
 
+/*!
+ *  @brief This API sets the FIFO mode and the frame contents of the accel FIFO,
+ *  and flushes whatever the FIFO held before.
+ */
+int8_t bmi08a_set_fifo_config(const struct bmi08x_accel_fifo_config *config, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t data;
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if ((rslt == BMI08X_OK) && (config != NULL)) {
+		/* Bit 1 of FIFO_CONFIG_0 must always be written as 1 */
+		data = BMI08X_ACCEL_FIFO_CONFIG_0_RESERVED | (config->mode & BMI08X_ACCEL_FIFO_MODE_FIFO);
+		rslt = set_regs(BMI08X_ACCEL_FIFO_CONFIG_0_REG, &data, 1, dev);
+
+		if (rslt == BMI08X_OK) {
+			/* Bit 4 of FIFO_CONFIG_1 must always be written as 1 */
+			data = BMI08X_ACCEL_FIFO_CONFIG_1_RESERVED;
+			if (config->accel_en) {
+				data |= BMI08X_ACCEL_FIFO_ACC_EN;
+			}
+			if (config->int1_en) {
+				data |= BMI08X_ACCEL_FIFO_INT1_EN;
+			}
+			if (config->int2_en) {
+				data |= BMI08X_ACCEL_FIFO_INT2_EN;
+			}
+			rslt = set_regs(BMI08X_ACCEL_FIFO_CONFIG_1_REG, &data, 1, dev);
+		}
+
+		if (rslt == BMI08X_OK) {
+			/* Start from an empty FIFO */
+			data = BMI08X_ACCEL_FIFO_FLUSH_CMD;
+			rslt = set_regs(BMI08X_ACCEL_SOFTRESET_REG, &data, 1, dev);
+			dev->delay_ms(BMI08X_DELAY_BETWEEN_WRITES_MS);
+		}
+	} else {
+		rslt = BMI08X_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API sets the accel FIFO watermark level in bytes.
+ */
+int8_t bmi08a_set_fifo_wm(uint16_t wm_level, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t data[2];
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if (rslt == BMI08X_OK) {
+		if (wm_level < BMI08X_ACCEL_FIFO_SIZE) {
+			data[0] = BMI08X_GET_LSB(wm_level);
+			data[1] = BMI08X_GET_MSB(wm_level);
+			rslt = set_regs(BMI08X_ACCEL_FIFO_WTM_0_REG, data, 2, dev);
+		} else {
+			rslt = BMI08X_E_OUT_OF_RANGE;
+		}
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API reads the number of bytes in the accel FIFO.
+ */
+int8_t bmi08a_get_fifo_length(uint16_t *fifo_length, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t data[2] = { 0 };
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if ((rslt == BMI08X_OK) && (fifo_length != NULL)) {
+		rslt = get_regs(BMI08X_ACCEL_FIFO_LENGTH_0_REG, data, 2, dev);
+
+		if (rslt == BMI08X_OK) {
+			*fifo_length = ((uint16_t) data[1] << 8 | data[0]) & BMI08X_ACCEL_FIFO_LENGTH_MASK;
+		}
+	} else {
+		rslt = BMI08X_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API reads fifo->length bytes from the accel FIFO in one burst.
+ *  The dummy byte is read straight into fifo->data (no bounce buffer), so the
+ *  parser starts after it and fifo->length counts it on return.
+ */
+int8_t bmi08a_read_fifo_data(struct bmi08x_fifo_frame *fifo, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t reg_addr = BMI08X_ACCEL_FIFO_DATA_REG;
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if ((rslt == BMI08X_OK) && (fifo != NULL) && (fifo->data != NULL)) {
+		if (dev->intf == BMI08X_SPI_INTF) {
+			/* Configuring reg_addr for SPI Interface */
+			reg_addr = reg_addr | BMI08X_SPI_RD_MASK;
+		}
+
+		fifo->length += dev->dummy_byte;
+		fifo->byte_start_idx = dev->dummy_byte;
+		fifo->sensor_time = BMI08X_ACCEL_FIFO_NO_SENSOR_TIME;
+		fifo->skipped_frame_count = 0;
+
+		rslt = dev->read(dev->accel_id, reg_addr, fifo->data, fifo->length);
+		if (rslt != BMI08X_OK) {
+			fifo->length = 0;
+			rslt = BMI08X_E_COM_FAIL;
+		}
+	} else {
+		rslt = BMI08X_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API parses the accel frames out of the data read by
+ *  bmi08a_read_fifo_data.
+ */
+int8_t bmi08a_extract_accel(struct bmi08x_sensor_data *accel_data, uint16_t *accel_length,
+							struct bmi08x_fifo_frame *fifo)
+{
+	uint16_t count = 0;
+	uint16_t idx;
+	uint8_t header;
+	uint8_t stop = 0;
+
+	if ((accel_data == NULL) || (accel_length == NULL) || (fifo == NULL) || (fifo->data == NULL)) {
+		return BMI08X_E_NULL_PTR;
+	}
+
+	idx = fifo->byte_start_idx;
+	while ((idx < fifo->length) && (count < *accel_length) && !stop) {
+		header = fifo->data[idx] & BMI08X_ACCEL_FIFO_HEADER_MASK;
+
+		switch (header) {
+		case BMI08X_ACCEL_FIFO_HEADER_ACCEL:
+			if ((idx + BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH) > fifo->length) {
+				/* Partial frame, the rest was not read */
+				stop = 1;
+				break;
+			}
+			accel_data[count].x = (int16_t) ((uint16_t) fifo->data[idx + 2] << 8 | fifo->data[idx + 1]);
+			accel_data[count].y = (int16_t) ((uint16_t) fifo->data[idx + 4] << 8 | fifo->data[idx + 3]);
+			accel_data[count].z = (int16_t) ((uint16_t) fifo->data[idx + 6] << 8 | fifo->data[idx + 5]);
+			count++;
+			idx += BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH;
+			break;
+
+		case BMI08X_ACCEL_FIFO_HEADER_SENSOR_TIME:
+			if ((idx + BMI08X_ACCEL_FIFO_SENSOR_TIME_FRAME_LENGTH) > fifo->length) {
+				stop = 1;
+				break;
+			}
+			fifo->sensor_time = (uint32_t) fifo->data[idx + 3] << 16 |
+								(uint32_t) fifo->data[idx + 2] << 8 | fifo->data[idx + 1];
+			idx += BMI08X_ACCEL_FIFO_SENSOR_TIME_FRAME_LENGTH;
+			break;
+
+		case BMI08X_ACCEL_FIFO_HEADER_SKIP:
+			if ((idx + 1) < fifo->length) {
+				fifo->skipped_frame_count = fifo->data[idx + 1];
+			}
+			idx += BMI08X_ACCEL_FIFO_SHORT_FRAME_LENGTH;
+			break;
+
+		case BMI08X_ACCEL_FIFO_HEADER_CONFIG_CHANGE:
+		case BMI08X_ACCEL_FIFO_HEADER_DROP:
+			idx += BMI08X_ACCEL_FIFO_SHORT_FRAME_LENGTH;
+			break;
+
+		default:
+			/* BMI08X_ACCEL_FIFO_HEADER_EMPTY or garbage: nothing more to parse */
+			stop = 1;
+			break;
+		}
+	}
+
+	fifo->byte_start_idx = idx;
+	*accel_length = count;
+
+	return BMI08X_OK;
+}
+
 /*****************************************************************************/
 /* Static function definition */
 /*!
@@ -1660,6 +1878,51 @@ static int8_t set_accel_data_ready_int(const struct bmi08x_accel_int_channel_cfg
 	return rslt;
 }
 
+/*!
+ * @brief This API sets the FIFO watermark interrupt for accel sensor.
+ */
+static int8_t set_accel_fifo_wm_int(const struct bmi08x_accel_int_channel_cfg *int_config,
+	const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t data = 0, conf;
+
+	/* Read interrupt map register */
+	rslt = get_regs(BMI08X_ACCEL_INT1_INT2_MAP_DATA_REG, &data, 1, dev);
+
+	if (rslt == BMI08X_OK) {
+		conf = int_config->int_pin_cfg.enable_int_pin;
+
+		switch (int_config->int_channel) {
+		case BMI08X_INT_CHANNEL_1:
+			/* Updating the data */
+			data = BMI08X_SET_BITS(data, BMI08X_ACCEL_INT1_FWM, conf);
+			break;
+
+		case BMI08X_INT_CHANNEL_2:
+			/* Updating the data */
+			data = BMI08X_SET_BITS(data, BMI08X_ACCEL_INT2_FWM, conf);
+			break;
+
+		default:
+			rslt = BMI08X_E_INVALID_INPUT;
+			break;
+		}
+
+		if (rslt == BMI08X_OK) {
+			/* Configure interrupt pins */
+			rslt = set_int_pin_config(int_config, dev);
+
+			if (rslt == BMI08X_OK) {
+				/* Write to interrupt map register */
+				rslt = set_regs(BMI08X_ACCEL_INT1_INT2_MAP_DATA_REG, &data, 1, dev);
+			}
+		}
+	}
+
+	return rslt;
+}
+
 /*!
  * @brief This API sets the synchronized data ready interrupt for accel sensor
  */
@@ -555,6 +555,120 @@ int8_t bmi08g_perform_selftest(const struct bmi08x_dev *dev)
 	return rslt;
 }
 
+/*!
+ *  @brief This API sets the gyro FIFO mode and watermark, and flushes the FIFO.
+ */
+int8_t bmi08g_set_fifo_config(const struct bmi08x_gyro_fifo_config *config, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t data;
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if ((rslt == BMI08X_OK) && (config != NULL)) {
+		data = config->wm_level & BMI08X_GYRO_FIFO_WM_LEVEL_MASK;
+		rslt = set_regs(BMI08X_GYRO_FIFO_CONFIG_0_REG, &data, 1, dev);
+
+		if (rslt == BMI08X_OK) {
+			data = (config->wm_level != 0) ? BMI08X_GYRO_FIFO_WM_ENABLE : BMI08X_GYRO_FIFO_WM_DISABLE;
+			rslt = set_regs(BMI08X_GYRO_FIFO_WM_ENABLE_REG, &data, 1, dev);
+		}
+
+		if (rslt == BMI08X_OK) {
+			/* Writing FIFO_CONFIG_1 also clears the FIFO */
+			data = config->mode;
+			rslt = set_regs(BMI08X_GYRO_FIFO_CONFIG_1_REG, &data, 1, dev);
+		}
+	} else {
+		rslt = BMI08X_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API reads the number of frames in the gyro FIFO.
+ */
+int8_t bmi08g_get_fifo_frame_count(uint8_t *frame_count, uint8_t *overrun, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+	uint8_t data = 0;
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if ((rslt == BMI08X_OK) && (frame_count != NULL)) {
+		rslt = get_regs(BMI08X_GYRO_FIFO_STATUS_REG, &data, 1, dev);
+
+		if (rslt == BMI08X_OK) {
+			*frame_count = data & BMI08X_GYRO_FIFO_FRAME_COUNT_MASK;
+			if (overrun != NULL) {
+				*overrun = (data & BMI08X_GYRO_FIFO_OVERRUN_MASK) ? BMI08X_ENABLE : BMI08X_DISABLE;
+			}
+		}
+	} else {
+		rslt = BMI08X_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API reads fifo->length bytes from the gyro FIFO in one burst.
+ */
+int8_t bmi08g_read_fifo_data(struct bmi08x_fifo_frame *fifo, const struct bmi08x_dev *dev)
+{
+	int8_t rslt;
+
+	/* Check for null pointer in the device structure*/
+	rslt = null_ptr_check(dev);
+
+	/* Proceed if null check is fine */
+	if ((rslt == BMI08X_OK) && (fifo != NULL) && (fifo->data != NULL)) {
+		fifo->byte_start_idx = 0;
+		rslt = get_regs(BMI08X_GYRO_FIFO_DATA_REG, fifo->data, fifo->length, dev);
+		if (rslt != BMI08X_OK) {
+			fifo->length = 0;
+		}
+	} else {
+		rslt = BMI08X_E_NULL_PTR;
+	}
+
+	return rslt;
+}
+
+/*!
+ *  @brief This API parses the gyro frames out of the data read by
+ *  bmi08g_read_fifo_data.
+ */
+int8_t bmi08g_extract_gyro(struct bmi08x_sensor_data *gyro_data, uint16_t *gyro_length,
+						   struct bmi08x_fifo_frame *fifo)
+{
+	uint16_t count = 0;
+	uint16_t idx;
+
+	if ((gyro_data == NULL) || (gyro_length == NULL) || (fifo == NULL) || (fifo->data == NULL)) {
+		return BMI08X_E_NULL_PTR;
+	}
+
+	idx = fifo->byte_start_idx;
+	while (((idx + BMI08X_GYRO_FIFO_FRAME_LENGTH) <= fifo->length) && (count < *gyro_length)) {
+		gyro_data[count].x = (int16_t) ((uint16_t) fifo->data[idx + 1] << 8 | fifo->data[idx]);
+		gyro_data[count].y = (int16_t) ((uint16_t) fifo->data[idx + 3] << 8 | fifo->data[idx + 2]);
+		gyro_data[count].z = (int16_t) ((uint16_t) fifo->data[idx + 5] << 8 | fifo->data[idx + 4]);
+		count++;
+		idx += BMI08X_GYRO_FIFO_FRAME_LENGTH;
+	}
+
+	fifo->byte_start_idx = idx;
+	*gyro_length = count;
+
+	return BMI08X_OK;
+}
+
 /*****************************************************************************/
 /* Static function definition */
 /*!
@@ -2177,7 +2177,8 @@ static int64_t compensate_temperature(const struct bmp3_uncomp_data *uncomp_data
 	int64_t partial_data6;
 	int64_t comp_temp;
 
-	partial_data1 = uncomp_data->temperature - (256 * calib_data->reg_calib_data.par_t1);
+	/* In 64 bits: below 0 degC the raw value is the smaller one, and a 32 bit difference wraps to a huge temperature */
+	partial_data1 = (uint64_t)uncomp_data->temperature - (256 * (uint64_t)calib_data->reg_calib_data.par_t1);
 	partial_data2 = calib_data->reg_calib_data.par_t2 * partial_data1;
 	partial_data3 = partial_data1 * partial_data1;
 	partial_data4 = (int64_t)partial_data3 * calib_data->reg_calib_data.par_t3;
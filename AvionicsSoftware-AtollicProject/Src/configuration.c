@@ -19,16 +19,131 @@
 
 
 #include "configuration.h"
+#include <stddef.h>
+#include <stdbool.h>
 #include "bmi08x_defs.h"
 #include "bmp3_defs.h"
+#include "utilities/common.h"
+#include "cmsis_os.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Journal record layout. Only CONFIG_RECORD_USED_SIZE bytes of each slot are programmed, the rest stays erased.
+#define CONFIG_RECORD_MAGIC			0xC7										//Changes with the payload layout, so older records are not misread.
+#define CONFIG_PAYLOAD_SIZE			offsetof(configuration_data_values, flash)	//Everything in front of the flash handle is saved.
+#define CONFIG_RECORD_MAGIC_OFFSET	0
+#define CONFIG_RECORD_SEQUENCE		1											//uint32, big endian. Increments on every write.
+#define CONFIG_RECORD_PAYLOAD		5
+#define CONFIG_RECORD_CRC			(CONFIG_RECORD_PAYLOAD + CONFIG_PAYLOAD_SIZE)	//CRC-16 over all the bytes before it.
+#define CONFIG_RECORD_USED_SIZE		(CONFIG_RECORD_CRC + 2)
+
+#define CONFIG_SLOTS_PER_SECTOR		(FLASH_PARAM_SECTOR_SIZE / CONFIG_RECORD_SIZE)
+#define CONFIG_SLOT_COUNT			(CONFIG_SLOTS_PER_SECTOR * CONFIG_JOURNAL_SECTORS)
+
+#if CONFIG_JOURNAL_ADDRESS + CONFIG_JOURNAL_SECTORS * FLASH_PARAM_SECTOR_SIZE > FLASH_START_ADDRESS
+#error "The configuration journal overlaps the data area."
+#endif
+
+//A negative array size stops the build if a record does not fit its slot.
+typedef char config_record_fits_slot[(CONFIG_RECORD_USED_SIZE <= CONFIG_RECORD_SIZE) ? 1 : -1];
+
+typedef struct
+{
+	uint32_t next_slot;		//Slot the next record goes into.
+	uint32_t sequence;		//Sequence number of the newest record, 0 if there is none.
+	bool scanned;
+} config_journal;
+
+static config_journal s_journal;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// STATIC FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t slot_address(uint32_t slot)
+{
+	return CONFIG_JOURNAL_ADDRESS + slot * CONFIG_RECORD_SIZE;
+}
+
+//Lets the other tasks run while the flash is busy. Before the scheduler starts nothing else can run, so just spin.
+static void wait_for_flash(void)
+{
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING){
+		vTaskDelay(1);
+	}
+}
+
+static FlashStatus read_slot(Flash flash, uint32_t slot, uint8_t *record)
+{
+	FlashStatus result;
+
+	//Waits out a program or a background erase that is still running.
+	while((result = flash_read(flash, slot_address(slot), record, CONFIG_RECORD_USED_SIZE)) == FLASH_BUSY){
+		wait_for_flash();
+	}
+
+	return result;
+}
+
+static bool record_is_blank(const uint8_t *record)
+{
+	for(size_t i = 0; i < CONFIG_RECORD_USED_SIZE; i++)
+	{
+		if(record[i] != 0xFF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool record_is_valid(const uint8_t *record)
+{
+	return record[CONFIG_RECORD_MAGIC_OFFSET] == CONFIG_RECORD_MAGIC
+		&& read_16(&record[CONFIG_RECORD_CRC]) == crc16_ccitt(record, CONFIG_RECORD_CRC);
+}
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
-//  Enter description for static function here.
+//  Reads every slot of the journal and finds the newest valid record. Sets up where the next record will be written.
+//	If newest is not NULL, the newest record is copied into it.
 //
 // Returns:
-//  Enter description of return values (if any).
+//  true if a valid record was found.
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static bool scan_journal(Flash flash, uint8_t *newest)
+{
+	uint8_t record[CONFIG_RECORD_USED_SIZE];
+	bool found = false;
+
+	s_journal.next_slot = 0;
+	s_journal.sequence = 0;
+
+	for(uint32_t slot = 0; slot < CONFIG_SLOT_COUNT; slot++)
+	{
+		if(read_slot(flash, slot, record) != FLASH_OK || !record_is_valid(record))
+		{
+			continue;
+		}
+
+		uint32_t sequence = read_32(&record[CONFIG_RECORD_SEQUENCE]);
+		if(!found || sequence > s_journal.sequence)
+		{
+			found = true;
+			s_journal.sequence = sequence;
+			s_journal.next_slot = (slot + 1) % CONFIG_SLOT_COUNT;
+
+			if(newest != NULL)
+			{
+				memcpy(newest, record, CONFIG_RECORD_USED_SIZE);
+			}
+		}
+	}
+
+	s_journal.scanned = true;
+
+	return found;
+}
 
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -58,6 +173,16 @@ ConfigStatus init_config(configuration_data_t* configuration){
 	configuration->values.temp_os = TEMP_OS;
 	configuration->values.pres_os = PRES_OS;
 	configuration->values.iir_coef = BMP_IIR;
+
+	const uint8_t imu_log_rates[CONFIG_LOG_PHASES] = IMU_LOG_RATES;
+	const uint8_t baro_log_rates[CONFIG_LOG_PHASES] = BARO_LOG_RATES;
+	memcpy(configuration->values.imu_log_rate, imu_log_rates, CONFIG_LOG_PHASES);
+	memcpy(configuration->values.baro_log_rate, baro_log_rates, CONFIG_LOG_PHASES);
+
+	const uint8_t log_channels[CONFIG_LOG_PHASES] = LOG_CHANNELS;
+	const uint8_t log_precision[CONFIG_LOG_PHASES] = LOG_PRECISIONS;
+	memcpy(configuration->values.log_channels, log_channels, CONFIG_LOG_PHASES);
+	memcpy(configuration->values.log_precision, log_precision, CONFIG_LOG_PHASES);
 	
 	configuration->values.state = STATE_LAUNCHPAD;
 
@@ -69,38 +194,86 @@ ConfigStatus init_config(configuration_data_t* configuration){
 
 ConfigStatus read_config(configuration_data_t* configuration){
 
-	ConfigStatus stat = CONFIG_ERROR;
-
-	FlashStatus result = flash_read_page(configuration->values.flash,
-											0x00000000,configuration->bytes,
-										 sizeof(configuration_data_t) - (sizeof(Flash*) + 4)); //The state variable is padded to 4 bytes!
+	uint8_t newest[CONFIG_RECORD_USED_SIZE];
 
-	if(result == FLASH_OK){
-		stat = CONFIG_OK;
+	if(!scan_journal(configuration->values.flash, newest)){
+		return CONFIG_ERROR;
 	}
 
-	return stat;
+	memcpy(configuration->bytes, &newest[CONFIG_RECORD_PAYLOAD], CONFIG_PAYLOAD_SIZE);
+
+	return CONFIG_OK;
 }
 
 ConfigStatus write_config(configuration_data_t* configuration){
 
-
+	Flash flash = configuration->values.flash;
+	uint8_t record[CONFIG_RECORD_USED_SIZE];
 	FlashStatus result;
 
-	ConfigStatus stat = CONFIG_ERROR;
+	if(!s_journal.scanned){
+		scan_journal(flash, NULL);
+	}
 
-	result = flash_erase_param_sector(configuration->values.flash,0x00000000);
-	while(FLASH_IS_DEVICE_BUSY(flash_get_status_register(configuration->values.flash))){}
+	//Normally the next slot is empty. After a reset in the middle of a program or an erase it may not be, so skip
+	//torn slots and erase a sector here if its background erase never finished.
+	uint32_t slot = s_journal.next_slot;
+	for(uint32_t i = 0; i < CONFIG_SLOT_COUNT; i++){
+		read_slot(flash, slot, record);
+		if(record_is_blank(record)){
+			break;
+		}
+
+		if((slot % CONFIG_SLOTS_PER_SECTOR) == 0){
+			while(flash_erase_param_sector(flash, slot_address(slot)) == FLASH_BUSY){
+				wait_for_flash();
+			}
+			while(FLASH_IS_DEVICE_BUSY(flash_get_status_register(flash))){
+				wait_for_flash();
+			}
+			break;
+		}
+
+		slot = (slot + 1) % CONFIG_SLOT_COUNT;
+	}
+
+	uint32_t sequence = s_journal.sequence + 1;
+
+	memset(record, 0xFF, sizeof(record));
+	record[CONFIG_RECORD_MAGIC_OFFSET] = CONFIG_RECORD_MAGIC;
+	write_32(sequence, &record[CONFIG_RECORD_SEQUENCE]);
+	memcpy(&record[CONFIG_RECORD_PAYLOAD], configuration->bytes, CONFIG_PAYLOAD_SIZE);
+	write_16(crc16_ccitt(record, CONFIG_RECORD_CRC), &record[CONFIG_RECORD_CRC]);
+
+	//The flash writer task may be programming a data page, so retry until the flash accepts the command.
+	while((result = flash_program_page(flash, slot_address(slot), record, CONFIG_RECORD_USED_SIZE)) == FLASH_BUSY){
+		wait_for_flash();
+	}
+
+	//A data sector may be erasing in the background, only wait for the program itself.
+	while(flash_is_programming(flash)){
+		wait_for_flash();
+	}
+	uint8_t status_reg = flash_get_status_register(flash);
+
+	//Even a failed program may have touched the slot, so never reuse it.
+	s_journal.next_slot = (slot + 1) % CONFIG_SLOT_COUNT;
+
+	if(result != FLASH_OK || FLASH_WAS_PROGRAMING_ERROR(status_reg)){
+		return CONFIG_ERROR;
+	}
 
-	if(result == FLASH_OK){
-	 result = flash_program_page(configuration->values.flash,0x00000000,configuration->bytes, sizeof(configuration_data_t) - (sizeof(Flash*) + 4));
+	s_journal.sequence = sequence;
 
-		while(FLASH_IS_DEVICE_BUSY(flash_get_status_register(configuration->values.flash))){
-			stat = CONFIG_OK;
+	//The record just written was the last one in its sector. The next sector only holds older records, so start
+	//erasing it now and let the next flash operation wait for it.
+	if((s_journal.next_slot % CONFIG_SLOTS_PER_SECTOR) == 0){
+		while(flash_erase_param_sector(flash, slot_address(s_journal.next_slot)) == FLASH_BUSY){
+			wait_for_flash();
 		}
 	}
 
-	return stat;
+	return CONFIG_OK;
 }
 
 #endif
@@ -11,40 +11,202 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "FreeRTOS.h"
 #include "portable.h"
+#include "semphr.h"
+#include "task.h"
 
 #include "flash.h"
 #include "hardware_definitions.h"
 #include "SPI.h"
+#include "STM32.h"
+#include "utilities/profiler.h"
 
 
 struct flash_t
 {
     SPI spi_handle; /**< SPI handle. */
+    SemaphoreHandle_t lock; /**< Serializes SPI transactions between the tasks sharing the flash. */
+    bool erasing; /**< A sector erase was started and has not been seen to finish yet. */
+    uint32_t erase_address; /**< First address of the sector being erased. */
+    uint32_t erase_size; /**< Size of the sector being erased. */
 };
 
 typedef struct flash_t* Flash;
 
+/** There is one flash chip, so its state is placed at link time rather than allocated. */
+static struct flash_t s_flash;
+static StaticSemaphore_t s_flash_lock_buffer;
+
+/**
+ * @brief
+ * The S25FL064P is rated 104 MHz for FAST_READ but only 40 MHz for the plain READ, which execute_command also sends.
+ * From the 84 MHz APB2 this gives 21 MHz.
+ */
+static const spi_device_config s_flash_spi =
+{
+	.bus = SPI_BUS_1,
+	.cs_port = FLASH_SPI_CS_PORT,
+	.cs_pin = FLASH_SPI_CS_PIN,
+	.max_clock_hz = 40000000,
+	.mode = 0,
+};
+
+/**
+ * @brief
+ * Timeout for one SPI transaction with the flash. A page takes well under a millisecond on the wire; the margin is
+ * for the wait on the bus and for the slowest clock SPI.c could fall back to.
+ */
+#define FLASH_SPI_TIMEOUT_MS(num_bytes)	(10 + ((num_bytes) >> 5))
+
+/**
+ * @brief
+ * Longest wait for the device to become ready inside a command: a suspend takes 45 us and a page program 3 ms at most.
+ * Before the scheduler starts there is no tick, so the wait counts status reads instead. Each takes over a
+ * microsecond on the wire.
+ */
+#define FLASH_READY_TIMEOUT_MS			10
+#define FLASH_READY_MAX_POLLS			(FLASH_READY_TIMEOUT_MS * 1000)
+
+/**
+ * @brief
+ * How long flash_scan waits for a page it can not read yet. An erase left running by a reset takes 2 s at most.
+ */
+#define FLASH_SCAN_BUSY_TIMEOUT_MS		3000
+
+/**
+ * @brief
+ * Takes the bus lock. Several tasks talk to the flash, and a command is only atomic if no other task
+ * can put its own transaction on the bus in the middle of it. Before the scheduler starts there is only one context.
+ */
+static void lock(Flash flash)
+{
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+	{
+		xSemaphoreTake(flash->lock, portMAX_DELAY);
+	}
+}
+
+static void unlock(Flash flash)
+{
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+	{
+		xSemaphoreGive(flash->lock);
+	}
+}
+
+/**
+ * @brief
+ * Reads the status register. One that could not be read reads as busy, with both error bits set, so no caller takes
+ * a failed transfer for a finished, successful operation.
+ */
+static uint8_t read_status_register(Flash flash)
+{
+	uint8_t command = FLASH_GET_STATUS_REG_COMMAND;
+	uint8_t status_reg;
+	if(spi_receive(flash->spi_handle, &command, 1, &status_reg, 1, 10) != HAL_OK)
+	{
+		return 0xFF;
+	}
+	return status_reg;
+}
+
+/**
+ * @brief
+ * Updates the erase tracking from a status register value. Once WIP is clear, no erase can still be running.
+ */
+static uint8_t track_erase(Flash flash, uint8_t status_reg)
+{
+	if(!FLASH_IS_DEVICE_BUSY(status_reg))
+	{
+		flash->erasing = false;
+	}
+	return status_reg;
+}
+
+/**
+ * @brief
+ * Tells whether a command may pause the running sector erase to get on the bus. Only reads and programs can, and
+ * only outside the sector being erased, since that sector reads back undefined data while suspended.
+ */
+static bool can_suspend_erase(Flash flash, uint32_t address, uint8_t command)
+{
+	if(!flash->erasing)
+	{
+		return false;
+	}
+
+	if(command != FLASH_READ_COMMAND && command != FLASH_FAST_READ_COMMAND && command != FLASH_PP_COMMAND)
+	{
+		return false;
+	}
+
+	return (address - flash->erase_address) >= flash->erase_size;
+}
+
+/**
+ * @brief
+ * Waits until WIP clears, sleeping between polls once the scheduler runs so the tasks waiting for the lock are not
+ * starved. A status register that can not be read looks busy, so the wait has to give up at some point.
+ * @return false if the device still looked busy after FLASH_READY_TIMEOUT_MS.
+ */
+static bool wait_until_ready(Flash flash)
+{
+	bool scheduler_running = (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+	TickType_t start = xTaskGetTickCount();
+	uint32_t polls = 0;
+
+	while(FLASH_IS_DEVICE_BUSY(read_status_register(flash)))
+	{
+		if(scheduler_running)
+		{
+			if((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(FLASH_READY_TIMEOUT_MS))
+			{
+				return false;
+			}
+			vTaskDelay(1);
+		}else if(++polls >= FLASH_READY_MAX_POLLS)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief
+ * Sends a one byte command and waits until the device is ready.
+ * @return FLASH_BUSY if the command did not go out, FLASH_ERROR if the device did not become ready, FLASH_OK otherwise.
+ */
+static FlashStatus send_and_wait(Flash flash, uint8_t command)
+{
+	if(spi_send(flash->spi_handle, &command, 1, NULL, 0, 10) != HAL_OK)
+	{
+		return FLASH_BUSY;
+	}
+	return wait_until_ready(flash) ? FLASH_OK : FLASH_ERROR;
+}
+
 /**
  * @brief
  * This function sets the write enable. This is needed before a
  * write status register, program or erase command.
  * @param p_flash Pointer to @c Flash structure
- * @return Will be FLASH_BUSY if there is another operation in progress, FLASH_OK otherwise.
+ * @return Will be FLASH_BUSY if there is another operation in progress, FLASH_ERROR if the command could not be
+ * sent, FLASH_OK otherwise.
  * @see https://github.com/UMSATS/Avionics-2019/
  */
 FlashStatus enable_write(Flash flash)
 {
-	uint8_t status_reg = flash_get_status_register(flash);
+	uint8_t status_reg = read_status_register(flash);
 	if(FLASH_IS_DEVICE_BUSY(status_reg)){
 		return FLASH_BUSY;
 	}
 	else{
 		uint8_t command = FLASH_ENABLE_WRITE_COMMAND;
-		spi_transmit(flash->spi_handle, &command, NULL, 1, 10);
-		return FLASH_OK;
+		return (spi_send(flash->spi_handle, &command, 1, NULL, 0, 10) == HAL_OK) ? FLASH_OK : FLASH_ERROR;
 	}
 }
 
@@ -53,77 +215,163 @@ FlashStatus enable_write(Flash flash)
  * This function is responsible to work like a generic interface to send any command to the flash driver
  * @param p_flash Pointer to @c Flash structure
  * @param address pointer to where in the flash memory you want to apply the operation to
- * @return Will be FLASH_BUSY if there is another operation in progress, FLASH_OK otherwise.
+ * @param data_buffer Data phase of the command. Sent for program commands, filled for read commands. May be NULL.
+ * @param num_bytes Number of bytes in the data phase.
+ * @return Will be FLASH_BUSY if there is another operation in progress, FLASH_ERROR if a transfer failed or the
+ * device did not become ready around an erase suspend (the data_buffer of a read is then undefined), FLASH_OK
+ * otherwise.
  * @note Any additional commands should always call this function. If this function does not satisfy the
  * needs later on when the interface is extended to potentially support more operations
  * a developer should modify this function to his needs to keep this function as a generic interface forever
+ * @note The command, address and data phase always go out in a single transaction (CS is held low throughout),
+ * so a read of any length costs exactly one command.
  * @see https://github.com/UMSATS/Avionics-2019/
  */
-FlashStatus execute_command(Flash flash, uint32_t address, uint8_t command)
+FlashStatus execute_command(Flash flash, uint32_t address, uint8_t command, uint8_t *data_buffer, uint32_t num_bytes)
 {
-	uint8_t status_reg = flash_get_status_register(flash);
+	lock(flash);
+
+	bool suspended = false;
+	uint8_t status_reg = track_erase(flash, read_status_register(flash));
 	if(FLASH_IS_DEVICE_BUSY(status_reg)){
-		return FLASH_BUSY;
+		if(!can_suspend_erase(flash, address, command)){
+			unlock(flash);
+			return FLASH_BUSY;
+		}
+		FlashStatus suspend = send_and_wait(flash, FLASH_ERASE_SUSPEND_COMMAND);
+		if(suspend == FLASH_ERROR){
+			//The suspend may still take effect, and nothing else would resume the erase.
+			uint8_t resume = FLASH_ERASE_RESUME_COMMAND;
+			spi_send(flash->spi_handle, &resume, 1, NULL, 0, 10);
+		}
+		if(suspend != FLASH_OK){
+			//If the suspend did not go out the erase is still running, so as far as the caller can tell the device is busy.
+			unlock(flash);
+			return suspend;
+		}
+		suspended = true;
 	}
-	else{
-		enable_write(flash);
-		if(command == FLASH_BULK_ERASE_COMMAND)
-		{
-			enable_write(flash);
-			uint8_t _command = FLASH_BULK_ERASE_COMMAND;
-			spi_send(flash->spi_handle, &_command, 1, NULL, 0, 10);
-			return FLASH_OK;
-		}
-		else
-		{
-			uint8_t command_address[] =
-				{
-					(command),
-					(address & (FLASH_HIGH_BYTE_MASK_24B)) >> 16,
-					(address & (FLASH_MID_BYTE_MASK_24B)) >> 8 ,
-					(address & (FLASH_LOW_BYTE_MASK_24B))
-				};
-
-			spi_send(flash->spi_handle, command_address, 4, NULL, 0, 10);
-			return FLASH_OK;
+
+	uint8_t command_address[] =
+		{
+			(command),
+			(address & (FLASH_HIGH_BYTE_MASK_24B)) >> 16,
+			(address & (FLASH_MID_BYTE_MASK_24B)) >> 8 ,
+			(address & (FLASH_LOW_BYTE_MASK_24B)),
+			0x00 // Dummy byte, only clocked out for FAST_READ.
 		};
+
+	HAL_StatusTypeDef stat = HAL_ERROR;
+	switch(command)
+	{
+		case FLASH_READ_COMMAND:
+		{
+			stat = spi_receive(flash->spi_handle, command_address, 4, data_buffer, num_bytes,
+							   FLASH_SPI_TIMEOUT_MS(num_bytes));
+			break;
+		}
+		case FLASH_FAST_READ_COMMAND:
+		{
+			stat = spi_receive(flash->spi_handle, command_address, 5, data_buffer, num_bytes,
+							   FLASH_SPI_TIMEOUT_MS(num_bytes));
+			break;
+		}
+		case FLASH_BULK_ERASE_COMMAND:
+		{
+			if(enable_write(flash) == FLASH_OK){
+				stat = spi_send(flash->spi_handle, &command, 1, NULL, 0, 10);
+			}
+			break;
+		}
+		default:
+		{
+			if(enable_write(flash) == FLASH_OK){
+				stat = spi_send(flash->spi_handle, command_address, 4, data_buffer, num_bytes,
+								FLASH_SPI_TIMEOUT_MS(num_bytes));
+			}
+			break;
+		}
+	}
+
+	if(stat == HAL_OK && (command == FLASH_ERASE_SEC_COMMAND || command == FLASH_ERASE_PARAM_SEC_COMMAND))
+	{
+		flash->erase_size = (command == FLASH_ERASE_SEC_COMMAND) ? FLASH_SECTOR_SIZE : FLASH_PARAM_SECTOR_SIZE;
+		flash->erase_address = address & ~(flash->erase_size - 1);
+		flash->erasing = true;
+	}
+
+	if(suspended)
+	{
+		//A program has to finish before the erase can be resumed. Resume anyway if it does not seem to.
+		if(!wait_until_ready(flash)){
+			stat = HAL_ERROR;
+		}
+		uint8_t resume = FLASH_ERASE_RESUME_COMMAND;
+		if(spi_send(flash->spi_handle, &resume, 1, NULL, 0, 10) != HAL_OK){
+			stat = HAL_ERROR;
+		}
 	}
+
+	unlock(flash);
+	return (stat == HAL_OK) ? FLASH_OK : FLASH_ERROR;
 }
 
 
 
 uint8_t flash_get_status_register(Flash p_flash)
 {
-	uint8_t command = FLASH_GET_STATUS_REG_COMMAND;
-	uint8_t status_reg;
-	spi_receive(p_flash->spi_handle, &command, 1, &status_reg, 1, 10);
+	lock(p_flash);
+	uint8_t status_reg = track_erase(p_flash, read_status_register(p_flash));
+	unlock(p_flash);
 	return status_reg;
 }
 
+bool flash_is_programming(Flash p_flash)
+{
+	lock(p_flash);
+	uint8_t status_reg = track_erase(p_flash, read_status_register(p_flash));
+	bool programming = FLASH_IS_DEVICE_BUSY(status_reg) && !p_flash->erasing;
+	unlock(p_flash);
+	return programming;
+}
+
 
 FlashStatus flash_erase_sector(Flash p_flash, uint32_t address)
 {
-	return execute_command(p_flash, address, FLASH_ERASE_SEC_COMMAND);
+	return execute_command(p_flash, address, FLASH_ERASE_SEC_COMMAND, NULL, 0);
 }
 
 FlashStatus flash_erase_param_sector(Flash p_flash, uint32_t address)
 {
-	return execute_command(p_flash, address, FLASH_ERASE_PARAM_SEC_COMMAND);
+	return execute_command(p_flash, address, FLASH_ERASE_PARAM_SEC_COMMAND, NULL, 0);
 }
 
 FlashStatus flash_program_page(Flash p_flash, uint32_t address, uint8_t *data_buffer, uint16_t num_bytes)
 {
-	return execute_command(p_flash, address, FLASH_PP_COMMAND);
+	if(num_bytes > FLASH_PAGE_SIZE)
+	{
+		return FLASH_ERROR;
+	}
+
+	uint32_t start = profiler_start();
+	FlashStatus status = execute_command(p_flash, address, FLASH_PP_COMMAND, data_buffer, num_bytes);
+	profiler_end(PROFILER_SPAN_FLASH_PROGRAM_PAGE, start);
+	return status;
+}
+
+FlashStatus flash_read(Flash p_flash, uint32_t address, uint8_t *data_buffer, uint32_t num_bytes)
+{
+	return execute_command(p_flash, address, FLASH_FAST_READ_COMMAND, data_buffer, num_bytes);
 }
 
 FlashStatus flash_read_page(Flash p_flash, uint32_t address, uint8_t *data_buffer, uint16_t num_bytes)
 {
-	return execute_command(p_flash, address, FLASH_READ_COMMAND);
+	return flash_read(p_flash, address, data_buffer, num_bytes);
 }
 
 FlashStatus flash_erase_device(Flash flash)
 {
-	return execute_command(flash, 0, FLASH_BULK_ERASE_COMMAND);
+	return execute_command(flash, 0, FLASH_BULK_ERASE_COMMAND, NULL, 0);
 }
 
 FlashStatus flash_check_id(Flash p_flash)
@@ -131,8 +379,10 @@ FlashStatus flash_check_id(Flash p_flash)
 	uint8_t command = FLASH_READ_ID_COMMAND;
 	uint8_t id[3] = {0, 0, 0};
 
-	spi_receive(p_flash->spi_handle, (uint8_t *) &command, 1, id, 3, 10);
-	if((id[0] == FLASH_MANUFACTURER_ID) && (id[1] == FLASH_DEVICE_ID_MSB) && (id[2] == FLASH_DEVICE_ID_LSB)){
+	lock(p_flash);
+	HAL_StatusTypeDef stat = spi_receive(p_flash->spi_handle, (uint8_t *) &command, 1, id, 3, 10);
+	unlock(p_flash);
+	if(stat == HAL_OK && (id[0] == FLASH_MANUFACTURER_ID) && (id[1] == FLASH_DEVICE_ID_MSB) && (id[2] == FLASH_DEVICE_ID_LSB)){
 		return FLASH_OK;
 	}
 
@@ -142,11 +392,14 @@ FlashStatus flash_check_id(Flash p_flash)
 
 Flash flash_initialize()
 {
-    Flash flash = (Flash)pvPortMalloc(sizeof(struct flash_t));
-    if(flash == NULL)
-    {
-        return NULL;
-    }
+	Flash flash = &s_flash;
+
+	flash->erasing = false;
+	flash->lock = xSemaphoreCreateMutexStatic(&s_flash_lock_buffer);
+	if(flash->lock == NULL)
+	{
+		return NULL;
+	}
 
 	__HAL_RCC_GPIOB_CLK_ENABLE();
 	__HAL_RCC_GPIOC_CLK_ENABLE();
@@ -173,9 +426,11 @@ Flash flash_initialize()
 	HAL_GPIO_WritePin(FLASH_WP_PORT, FLASH_WP_PIN, GPIO_PIN_SET);
 	HAL_GPIO_WritePin(FLASH_HOLD_PORT, FLASH_HOLD_PIN, GPIO_PIN_SET);
 	//Set up the SPI interface
-	spi1_init(&flash->spi_handle);
-
-	HAL_GPIO_WritePin(FLASH_SPI_CS_PORT, FLASH_SPI_CS_PIN, GPIO_PIN_SET);
+	flash->spi_handle = spi_register_device(&s_flash_spi);
+	if(flash->spi_handle == NULL)
+	{
+		return NULL;
+	}
 	
 	if(FLASH_ERROR == flash_check_id(flash))
 	{
@@ -185,38 +440,203 @@ Flash flash_initialize()
 	return flash;
 }
 
-size_t flash_scan(Flash p_flash)
+/**
+ * @brief
+ * Tells whether a page reads back erased. While an erase keeps the flash busy this sleeps and tries again, for
+ * FLASH_SCAN_BUSY_TIMEOUT_MS at most.
+ * @return The result of the last read. @c empty is only set if it is FLASH_OK.
+ */
+static FlashStatus is_page_empty(Flash p_flash, uint32_t address, bool *empty)
+{
+	uint8_t dataRX[FLASH_PAGE_SIZE];
+
+	FlashStatus stat = flash_read(p_flash, address, dataRX, FLASH_PAGE_SIZE);
+	for(uint32_t waited = 0; stat == FLASH_BUSY && waited < FLASH_SCAN_BUSY_TIMEOUT_MS; waited++)
+	{
+		if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+		{
+			vTaskDelay(pdMS_TO_TICKS(1));
+		}else
+		{
+			stm32_delay(1);
+		}
+		stat = flash_read(p_flash, address, dataRX, FLASH_PAGE_SIZE);
+	}
+
+	if(stat != FLASH_OK)
+	{
+		return stat;
+	}
+
+	*empty = true;
+	for(int j = 0; j < FLASH_PAGE_SIZE; j++)
+	{
+		if(dataRX[j] != 0xFF)
+		{
+			*empty = false;
+			break;
+		}
+	}
+
+	return FLASH_OK;
+}
+
+static uint32_t scan_sector_size(uint32_t address)
+{
+	return (address > FLASH_PARAM_END_ADDRESS) ? FLASH_SECTOR_SIZE : FLASH_PARAM_SECTOR_SIZE;
+}
+
+static uint32_t scan_sector_start(uint32_t address)
+{
+	return address & ~(scan_sector_size(address) - 1);
+}
+
+/** @brief End of the sector starting at sector. The last sector of the data area is cut short by FLASH_SIZE_BYTES. */
+static uint32_t scan_sector_end(uint32_t sector)
+{
+	uint32_t end = sector + scan_sector_size(sector);
+	return (end > FLASH_SIZE_BYTES) ? FLASH_SIZE_BYTES : end;
+}
+
+/**
+ * @brief
+ * Tells whether every page of a sector is written. Written pages come first in a sector, so this is the last page.
+ * The first page is read too when the last one is written, to check that they really do.
+ * @return FLASH_CORRUPT if the last page is written but the first is empty.
+ */
+static FlashStatus is_sector_full(Flash p_flash, uint32_t sector, bool *full)
 {
-	size_t result = 0;
-	uint8_t dataRX[256];
-	size_t i;
-	int j;
-	i = FLASH_START_ADDRESS;
-	while(i < FLASH_SIZE_BYTES)
+	bool empty;
+	FlashStatus stat = is_page_empty(p_flash, scan_sector_end(sector) - FLASH_PAGE_SIZE, &empty);
+	if(stat != FLASH_OK || empty)
 	{
-		FlashStatus status;
-		for(j = 0; j < 256; j++){
-			dataRX[j] = 0;
+		*full = false;
+		return stat;
+	}
+
+	stat = is_page_empty(p_flash, sector, &empty);
+	if(stat == FLASH_OK && empty)
+	{
+		return FLASH_CORRUPT;
+	}
+	*full = true;
+	return stat;
+}
+
+FlashStatus flash_scan(Flash p_flash, uint32_t hint, uint32_t *end_address)
+{
+	uint32_t low = FLASH_START_ADDRESS;		//A sector start. Every sector below low is full.
+	uint32_t high = FLASH_SIZE_BYTES;		//The sector at high is not full, or high is the end of the data area.
+	bool high_known = false;
+	bool empty;
+	bool full;
+	FlashStatus stat;
+
+	//Anything that goes wrong leaves the flash looking full, so nothing is programmed over data that was not read.
+	*end_address = FLASH_SIZE_BYTES;
+
+	if(hint >= FLASH_START_ADDRESS && hint < FLASH_SIZE_BYTES)
+	{
+		hint &= ~(uint32_t) (FLASH_PAGE_SIZE - 1);
+
+		if((stat = is_page_empty(p_flash, hint, &empty)) != FLASH_OK)
+		{
+			return stat;
 		}
 
-		status = flash_read_page(p_flash, i, dataRX, 256);
-		uint16_t empty = 0xFFFF;
-		for(j = 0; j < 256; j++)
+		if(empty)
 		{
-			if(dataRX[j] != 0xFF){
-				empty--;
+			//Usually the hint is exact and this costs two reads.
+			if(hint == FLASH_START_ADDRESS)
+			{
+				*end_address = hint;
+				return FLASH_OK;
+			}
+			if((stat = is_page_empty(p_flash, hint - FLASH_PAGE_SIZE, &empty)) != FLASH_OK)
+			{
+				return stat;
+			}
+			if(!empty)
+			{
+				*end_address = hint;
+				return FLASH_OK;
 			}
+
+			//Otherwise the data ends before the hint, in its sector or an earlier one.
+			high = scan_sector_start(hint);
+			high_known = true;
+		}else
+		{
+			low = scan_sector_start(hint);
+		}
+	}
+
+	//The log is written in order from FLASH_START_ADDRESS, and the eraser clears the old flight a whole sector at a
+	//time from the same end. So past the new data there is a run of erased sectors and then maybe old data that was
+	//not erased yet, and a bisection of the whole area could land in the old data. The search looks past low instead,
+	//twice as far each time, and bisects between the last two sectors it looked at. That gap is never longer than the
+	//data found past the hint. The eraser clears 128 kB/s, many times what the log fills, so the erased run is longer
+	//than the data written since the hint was saved and the search can not jump over it.
+	for(uint32_t step = 0; !high_known && low + step < FLASH_SIZE_BYTES; step = (step == 0) ? scan_sector_size(low) : 2 * step)
+	{
+		uint32_t sector = scan_sector_start(low + step);
+		if((stat = is_sector_full(p_flash, sector, &full)) != FLASH_OK)
+		{
+			return stat;
 		}
 
-		if(empty == 0xFFFF)
+		if(full)
 		{
-			result = i;
-			break;
+			low = scan_sector_end(sector);
+		}else
+		{
+			high = sector;
+			high_known = true;
+		}
+	}
+
+	while(low < high)
+	{
+		uint32_t sector = scan_sector_start(low + (high - low) / 2);
+		if((stat = is_sector_full(p_flash, sector, &full)) != FLASH_OK)
+		{
+			return stat;
 		}
 
-		i = i + 256;
+		if(full)
+		{
+			low = scan_sector_end(sector);
+		}else
+		{
+			high = sector;
+		}
+	}
+
+	if(low >= FLASH_SIZE_BYTES)
+	{
+		*end_address = FLASH_SIZE_BYTES;
+		return FLASH_OK;
+	}
+
+	//The log ends in the sector at low, and the pages written in it come first.
+	uint32_t last = scan_sector_end(low) - FLASH_PAGE_SIZE;
+	while(low < last)
+	{
+		uint32_t mid = low + ((last - low) / FLASH_PAGE_SIZE / 2) * FLASH_PAGE_SIZE;
+		if((stat = is_page_empty(p_flash, mid, &empty)) != FLASH_OK)
+		{
+			return stat;
+		}
+
+		if(empty)
+		{
+			last = mid;
+		}else
+		{
+			low = mid + FLASH_PAGE_SIZE;
+		}
 	}
 
-	if(result == 0) result = FLASH_SIZE_BYTES;
-	return result;
+	*end_address = low;
+	return FLASH_OK;
 }
@@ -29,19 +29,43 @@
 #include "tasks/sensors/pressure_sensor.h"
 #include "tasks/command_line_interface.h"
 #include "tasks/flight_state_controller.h"
+#include "tasks/flash_writer.h"
 #include "tasks/timer.h"
+#include "utilities/profiler.h"
 #include "cmsis_os.h"
 
+//Stack of each task, in words. uxTaskGetSystemState reports how much of it each task has never touched.
+#define TASK_STACK_SIZE		1000
+
+//Stack and control block of one task, placed at link time.
+#define TASK_MEMORY(name)	static uint32_t s_##name##_stack[TASK_STACK_SIZE]; \
+							static osStaticThreadDef_t s_##name##_control
+
+TASK_MEMORY(timer);
+TASK_MEMORY(imu);
+TASK_MEMORY(flight_state_controller);
+TASK_MEMORY(flash_writer);
+TASK_MEMORY(flash_eraser);
+TASK_MEMORY(cli);
+TASK_MEMORY(pressure_sensor);
+TASK_MEMORY(startup);
+
+static StaticTask_t s_idle_control;
+static StackType_t s_idle_stack[configMINIMAL_STACK_SIZE];
+
 
 int main(void)
 {
-	configuration_data_t app_configuration_data;
+	//Static, like everything the tasks are handed: the scheduler reuses main's stack for interrupts once it starts.
+	static configuration_data_t app_configuration_data;
 	STM32Status board_status = stm32_init();
 	if(board_status != STM32_OK)
 	{
 		stm32_error_handler();
 	}
 	
+	profiler_init();
+	
 	UART huart6 = UART_Port6_Init();
 	if(huart6 == NULL)
 	{
@@ -85,8 +109,12 @@ int main(void)
 		app_configuration_data.values.state = STATE_IN_FLIGHT_PRE_APOGEE;
 	}
 	
-	size_t end_Address = flash_scan(flash);
-	sprintf(lines, "end address :%zu", end_Address);
+	uint32_t end_Address;
+	if(flash_scan(flash, app_configuration_data.values.end_data_address, &end_Address) != FLASH_OK)
+	{
+		uart_transmit_line(huart6, "Could not find the end of the data, using the end of the flash.");
+	}
+	sprintf(lines, "end address :%" PRIu32, end_Address);
 	uart_transmit_line(huart6, lines);
 	app_configuration_data.values.end_data_address = end_Address;
 	
@@ -97,16 +125,22 @@ int main(void)
 	uart_transmit_line(huart6, "Recovery GPIO pins have been set up.");
 	
 	//Initialize and get the flight computer parameters.
-	imu_sensor_thread_parameters thread_imu_params;
-	pressure_sensor_thread_parameters thread_pressure_sensor_params;
-	flight_state_controller_thread_parameters thread_flight_state_controller_params;
-	cli_thread_parameters thread_cli_params;
-	startup_thread_parameters thread_startup_parameters;
+	static imu_sensor_thread_parameters thread_imu_params;
+	static pressure_sensor_thread_parameters thread_pressure_sensor_params;
+	static flight_state_controller_thread_parameters thread_flight_state_controller_params;
+	static flash_writer_thread_parameters thread_flash_writer_params;
+	static cli_thread_parameters thread_cli_params;
+	static startup_thread_parameters thread_startup_parameters;
 	
 	thread_flight_state_controller_params.flash_ptr = flash;
 	thread_flight_state_controller_params.uart = huart6;
 	thread_flight_state_controller_params.configuration_data = &app_configuration_data;
 	
+	//After a reset in flight, continue logging after the data that is already there.
+	thread_flash_writer_params.flash = flash;
+	thread_flash_writer_params.start_address = IS_IN_FLIGHT(app_configuration_data.values.flags)
+											   ? app_configuration_data.values.end_data_address : FLASH_START_ADDRESS;
+	
 	thread_pressure_sensor_params.huart = huart6;
 	thread_pressure_sensor_params.flightCompConfig = &app_configuration_data;
 	
@@ -123,6 +157,12 @@ int main(void)
 	thread_startup_parameters.cli_thread_params						= NULL;
 	thread_startup_parameters.timer_thread_handle					= NULL;
 	thread_cli_params.startupTaskHandle								= NULL;
+	thread_startup_parameters.flash_ptr								= flash;
+	thread_startup_parameters.huart_ptr								= huart6;
+	thread_startup_parameters.configuration_data					= &app_configuration_data;
+
+	//Filled in when the timer task is created below, the controller only looks at it at launch.
+	thread_flight_state_controller_params.timer_thread_handle = &thread_startup_parameters.timer_thread_handle;
 	
 	if(!IS_IN_FLIGHT(app_configuration_data.values.flags))
 	{
@@ -153,33 +193,45 @@ int main(void)
 		}
 	}
 	
-	osThreadDef(timer, thread_timer_start, osPriorityAboveNormal, 1, 1000);
+	osThreadStaticDef(timer, thread_timer_start, osPriorityAboveNormal, 1, TASK_STACK_SIZE, s_timer_stack, &s_timer_control);
 	if(NULL == (thread_startup_parameters.timer_thread_handle = osThreadCreate(osThread(timer), &app_configuration_data))){
 		stm32_error_handler();
 	}
 	
-	osThreadDef(imu, imu_thread_start, osPriorityHigh, 1, 1000);
-	if(NULL == (thread_startup_parameters.imu_thread_handle = osThreadCreate(osThread(imu), &app_configuration_data))){
+	osThreadStaticDef(imu, imu_thread_start, osPriorityHigh, 1, TASK_STACK_SIZE, s_imu_stack, &s_imu_control);
+	if(NULL == (thread_startup_parameters.imu_thread_handle = osThreadCreate(osThread(imu), &thread_imu_params))){
 		stm32_error_handler();
 	}
 	
-	osThreadDef(flight_state_controller, thread_flight_state_controller_start, osPriorityHigh, 1, 1000);
+	osThreadStaticDef(flight_state_controller, thread_flight_state_controller_start, osPriorityHigh, 1, TASK_STACK_SIZE, s_flight_state_controller_stack, &s_flight_state_controller_control);
 	if(NULL == (thread_startup_parameters.flight_state_controller_thread_handle = osThreadCreate(osThread(flight_state_controller), &thread_flight_state_controller_params))){
 		stm32_error_handler();
 	}
 	
-	osThreadDef(cli, thread_command_line_interface_start, osPriorityAboveNormal, 1, 1000);
+	//Not suspended: it sleeps until the controller queues a page.
+	osThreadStaticDef(flash_writer, thread_flash_writer_start, osPriorityAboveNormal, 1, TASK_STACK_SIZE, s_flash_writer_stack, &s_flash_writer_control);
+	if(NULL == osThreadCreate(osThread(flash_writer), &thread_flash_writer_params)){
+		stm32_error_handler();
+	}
+	
+	//Not suspended either: it does nothing until the startup task lets it erase.
+	osThreadStaticDef(flash_eraser, thread_flash_eraser_start, osPriorityLow, 1, TASK_STACK_SIZE, s_flash_eraser_stack, &s_flash_eraser_control);
+	if(NULL == osThreadCreate(osThread(flash_eraser), &thread_flash_writer_params)){
+		stm32_error_handler();
+	}
+	
+	osThreadStaticDef(cli, thread_command_line_interface_start, osPriorityAboveNormal, 1, TASK_STACK_SIZE, s_cli_stack, &s_cli_control);
 	if(NULL == (thread_startup_parameters.cli_thread_params = osThreadCreate(osThread(cli), &thread_cli_params))){
 		stm32_error_handler();
 	}
 
-	osThreadDef(pressure_sensor, thread_pressure_sensor_start, osPriorityAboveNormal, 1, 1000);
-	if(NULL == (thread_startup_parameters.pressure_sensor_thread_handle = osThreadCreate(osThread(pressure_sensor), &app_configuration_data))){
+	osThreadStaticDef(pressure_sensor, thread_pressure_sensor_start, osPriorityAboveNormal, 1, TASK_STACK_SIZE, s_pressure_sensor_stack, &s_pressure_sensor_control);
+	if(NULL == (thread_startup_parameters.pressure_sensor_thread_handle = osThreadCreate(osThread(pressure_sensor), &thread_pressure_sensor_params))){
 		stm32_error_handler();
 	}
 	
-	osThreadDef(startup, thread_startup_start, osPriorityAboveNormal, 1, 1000);
-	if(NULL == (thread_cli_params.startupTaskHandle = osThreadCreate(osThread(startup), &app_configuration_data))){
+	osThreadStaticDef(startup, thread_startup_start, osPriorityAboveNormal, 1, TASK_STACK_SIZE, s_startup_stack, &s_startup_control);
+	if(NULL == (thread_cli_params.startupTaskHandle = osThreadCreate(osThread(startup), &thread_startup_parameters))){
 		stm32_error_handler();
 	}
 	
@@ -196,6 +248,17 @@ int main(void)
 	
 	/* We should never get here as control is now taken by the scheduler */
 	stm32_error_handler();
+	return 0;
+}
+
+/**
+  * @brief  Hands the scheduler the memory of the idle task, since there is no heap to create it from.
+  */
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize)
+{
+	*ppxIdleTaskTCBBuffer = &s_idle_control;
+	*ppxIdleTaskStackBuffer = s_idle_stack;
+	*pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
 }
 
 /**
@@ -27,12 +27,30 @@
 #include "bmi08x_defs.h"
 #include "recovery.h"
 #include "UART.h"
+#include "utilities/common.h"
+#include "utilities/log_encoder.h"
+#include "utilities/log_rate.h"
+#include "utilities/altitude_estimator.h"
+#include "tasks/download.h"
+#include "tasks/flash_writer.h"
+#include "tasks/sensors/imu_sensor.h"
+#include "tasks/sensors/pressure_sensor.h"
+#include "utilities/profiler.h"
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // DEFINITIONS AND MACROS
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 //static UART_HandleTypeDef* uart;
 //static Flash * flash;
+#define RAM_REPORT_MAX_TASKS	12		//Room for every task, the idle task included.
+#define BUDGET_TIMING_RUNS		64		//Made up samples the log budget times the estimator and the encoder on.
+
+static TaskStatus_t s_tasks[RAM_REPORT_MAX_TASKS];	//For ram_report and the task table of the [prof] menu.
+
+//Linker script symbols.
+extern uint8_t _sdata;		//Start of RAM.
+extern uint8_t _ebss;		//End of the statically placed data.
+extern uint8_t _estack;		//End of RAM.
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // ENUMS AND ENUM TYPEDEFS
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -82,6 +100,14 @@ void ematch(char* command, cli_thread_parameters * params);
 void memory_menu(char* command, cli_thread_parameters * params);
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Description:
+//  menu for the hot path timings, the CPU share of each task and the queue high water marks.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void profile_menu(char* command, cli_thread_parameters * params);
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
 //  display introduction about xtract program
 //
 // Returns:
@@ -106,6 +132,24 @@ void help(UART  uart); //display help menu
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 void cli_read(cli_thread_parameters * params);
 
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  prints how much RAM is placed at link time, and the stack each task has never used.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void ram_report(UART  uart);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  prints the log policy, the flash use and an estimate of the CPU load of each flight phase.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void log_budget_report(UART  uart, configuration_data_t * config);
+
 
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -117,7 +161,7 @@ void thread_command_line_interface_start(void const *pvParameters)
 	UART uart = params->huart;
 	menuState_t state = MAIN_MENU;
 	intro(uart); //display help on start up
-	char * cmd_buf = (char*) malloc(sizeof(char) * BUFFER_SIZE); //command buffer
+	char * cmd_buf; //command buffer, owned by the UART driver
 	state = MAIN_MENU;
 	/* As per most FreeRTOS tasks, this task is implemented in an infinite loop. */
 	while(1){
@@ -127,6 +171,19 @@ void thread_command_line_interface_start(void const *pvParameters)
 	}
 }
 
+/**
+ * @brief Finds the end of the log. If the scan went wrong it says so, and the end is the end of the flash.
+ */
+static uint32_t scan_end_address(UART uart, Flash flash, uint32_t hint)
+{
+	uint32_t end_address;
+	if(flash_scan(flash, hint, &end_address) != FLASH_OK)
+	{
+		uart_transmit_line(uart, "Could not find the end of the data, using the end of the flash.");
+	}
+	return end_address;
+}
+
 void task_cli_execute_command(char* command, cli_thread_parameters * params, menuState_t * state){
 
 
@@ -143,6 +200,12 @@ void task_cli_execute_command(char* command, cli_thread_parameters * params, men
 	else if((strcmp(command, "read") == 0 && *state == MAIN_MENU )|| *state == READ_MENU){
 		cli_read(params);
 	}
+	else if(strcmp(command, "download") == 0 && *state == MAIN_MENU){
+		download_run(uart, params->flash, scan_end_address(uart, params->flash, config->values.end_data_address));
+	}
+	else if(strcmp(command, "ram") == 0 && *state == MAIN_MENU){
+		ram_report(uart);
+	}
 	else if((strcmp(command, "config") == 0 && *state == MAIN_MENU )|| *state == CONFIG_MENU){
 
 		if(strcmp(command,"return")==0){
@@ -173,12 +236,23 @@ void task_cli_execute_command(char* command, cli_thread_parameters * params, men
 		}
 		memory_menu(command,params);
 	}
+	else if((strcmp(command, "prof") == 0 && *state == MAIN_MENU )|| *state == PROF_MENU){
+		if(strcmp(command,"return")==0){
+			uart_transmit_line(uart,"Returning to main menu");
+			*state = MAIN_MENU;
+		}else{
+			*state = PROF_MENU;
+		}
+		profile_menu(command,params);
+	}
 	else if((strcmp(command, "save") == 0 && *state == MAIN_MENU )|| *state == SAVE_MENU){
 		write_config(config);
 
 	}
 	else if((strcmp(command, "start") == 0 && *state == MAIN_MENU )){
 
+		log_budget_report(uart, config);
+
 		config->values.state = STATE_LAUNCHPAD_ARMED;
 		vTaskResume(startupTaskHandle);
 
@@ -204,15 +278,272 @@ void help(UART  uart){
 	uart_transmit_line(uart, "Commands:\r\n"
 					"\t[help] - displays the help menu and more commands\r\n"
 					"\t[read] - Downloads flight data\r\n"
+					"\t[download] - Fast framed download, for serialReader.py download\r\n"
 					"\t[config] - Setup flight computer\r\n"
 					"\t[ematch] - check and fire ematches\r\n"
 					"\t[mem] - Check on and erase the flash memory\r\n"
 					"\t[save] - Save all setting to the flight computer\r\n"
+					"\t[ram] - RAM use and stack headroom of each task\r\n"
+					"\t[prof] - Timings, CPU share of each task and queue high water marks\r\n"
 					"\t[start] - Start the flight computer\r\n"
 					);
 }
 
 
+void ram_report(UART  uart){
+
+	char output[BUFFER_SIZE];
+	UBaseType_t count = uxTaskGetSystemState(s_tasks, RAM_REPORT_MAX_TASKS, NULL);
+	UBaseType_t i;
+
+	//Everything is placed at link time, so this is the same as the linker map. What is left is shared by the newlib
+	//heap and the interrupt stack.
+	sprintf(output, "RAM: %" PRIu32 " bytes, %" PRIu32 " placed at link time, %" PRIu32
+			" left for the newlib heap and the interrupt stack.",
+			(uint32_t) (&_estack - &_sdata), (uint32_t) (&_ebss - &_sdata), (uint32_t) (&_estack - &_ebss));
+	uart_transmit_line(uart, output);
+
+	uart_transmit_line(uart, "Task\t\t\tPriority\tStack never used (words)");
+	for(i = 0; i < count; i++){
+		sprintf(output, "%-16s\t%" PRIu32 "\t\t%d", s_tasks[i].pcTaskName, (uint32_t) s_tasks[i].uxCurrentPriority,
+				s_tasks[i].usStackHighWaterMark);
+		uart_transmit_line(uart, output);
+	}
+}
+
+/**
+ * @brief CPU cycles one IMU sample takes in the altitude estimator, and one record in the log encoder. Timed here, on
+ * made up samples, so the estimate does not depend on the sensors having run.
+ */
+static void time_log_path(uint32_t *estimator_cycles, uint32_t *record_cycles)
+{
+	//Too big for the CLI stack.
+	static altitude_estimator estimator;
+	static log_encoder encoder;
+	static uint8_t full_page[LOG_PAGE_SIZE];
+	log_record record;
+	uint32_t start;
+	int i;
+
+	altitude_estimator_init(&estimator, 0.0f, 0);
+	start = DWT->CYCCNT;
+	for(i = 1; i <= BUDGET_TIMING_RUNS; i++){
+		altitude_estimator_predict(&estimator, i * 10000);
+		altitude_estimator_update_acceleration(&estimator, (float) (i % 7));
+	}
+	*estimator_cycles = (DWT->CYCCNT - start) / BUDGET_TIMING_RUNS;
+
+	log_policy policy = {LOG_PHASE_ASCENT, LOG_CHANNELS_ALL, 0};
+	log_encoder_init(&encoder, &policy);
+	memset(&record, 0, sizeof(log_record));
+	record.types = LOG_RECORD_IMU | LOG_RECORD_BARO;
+	start = DWT->CYCCNT;
+	for(i = 1; i <= BUDGET_TIMING_RUNS; i++){
+		record.time_us = i * 10000;
+		record.acc[0] = 2048 + (i * 37) % 61;
+		record.acc[1] = (i * 53) % 41;
+		record.acc[2] = (i * 29) % 47;
+		record.gyro[0] = (i * 17) % 23;
+		record.gyro[1] = (i * 13) % 19;
+		record.gyro[2] = (i * 11) % 29;
+		record.pressure = 10132500 + (i * 7) % 97;
+		record.temperature = 2100 + i % 3;
+		record.altitude_cm = (i * 31) % 89;
+		log_encoder_append(&encoder, &record, full_page);
+	}
+	*record_cycles = (DWT->CYCCNT - start) / BUDGET_TIMING_RUNS;
+}
+
+/**
+ * @brief Mean of a span in CPU cycles, 0 if it has not run since power on.
+ */
+static uint32_t span_mean(profiler_span span)
+{
+	profiler_span_summary summary;
+	profiler_get_span(span, &summary);
+	return summary.mean;
+}
+
+void log_budget_report(UART  uart, configuration_data_t * config){
+
+	char output[128];
+	uint32_t imu_hz = imu_sensor_rate_hz(config);
+	uint32_t baro_hz = pressure_sensor_rate_hz(config);
+	uint32_t flash_bytes = FLASH_END_ADDRESS + 1 - FLASH_START_ADDRESS;
+	uint32_t estimator_cycles;
+	uint32_t record_cycles;
+
+	time_log_path(&estimator_cycles, &record_cycles);
+
+	//The sensor reads and the page writes can only be timed on the real thing, so they count once they have run.
+#if IMU_SENSOR_FIFO_MODE
+	uint32_t imu_reads = imu_hz / IMU_FIFO_BATCH_FRAMES;
+#else
+	uint32_t imu_reads = imu_hz;
+#endif
+#if PRESSURE_SENSOR_FIFO_MODE
+	uint32_t baro_reads = baro_hz / PRESSURE_FIFO_BATCH_FRAMES;
+#else
+	uint32_t baro_reads = baro_hz;
+#endif
+	uint64_t fixed_cycles = (uint64_t) imu_reads * span_mean(PROFILER_SPAN_IMU_READ)
+						  + (uint64_t) baro_reads * span_mean(PROFILER_SPAN_PRESSURE_READ)
+						  + (uint64_t) imu_hz * (estimator_cycles + span_mean(PROFILER_SPAN_STATE_MACHINE_TICK));
+	uint32_t page_cycles = span_mean(PROFILER_SPAN_PAGE_HAND_OFF) + span_mean(PROFILER_SPAN_FLASH_PROGRAM_PAGE);
+
+	sprintf(output, "Log budget: IMU %" PRIu32 " Hz, pressure %" PRIu32 " Hz, logging %s. %" PRIu32 " kB of flash for the log.",
+			imu_hz, baro_hz, IS_LOG_DECIMATING(config->values.flags) ? "the newest sample" : "averages", flash_bytes / 1000);
+	uart_transmit_line(uart, output);
+	if(span_mean(PROFILER_SPAN_IMU_READ) == 0 || span_mean(PROFILER_SPAN_FLASH_PROGRAM_PAGE) == 0){
+		uart_transmit_line(uart, "The sensor reads and flash writes have not been timed since power on, the CPU load leaves them out.");
+	}
+	uart_transmit_line(uart, "Phase\tIMU Hz\tBaro Hz\tChannels\tBits dropped\tBytes/s\tFlash lasts (min)\tCPU (%)");
+
+	for(int phase = 0; phase < LOG_NUM_PHASES; phase++){
+
+		log_policy policy;
+		log_rate_policy(config, phase, &policy);
+		uint32_t imu_log_hz = log_rate_effective_hz(log_rate_imu(config, phase), imu_hz);
+		uint32_t baro_log_hz = log_rate_effective_hz(log_rate_baro(config, phase), baro_hz);
+		uint32_t bytes = log_rate_bytes_per_second(&policy, imu_log_hz, baro_log_hz);
+		uint32_t records = (imu_log_hz > baro_log_hz) ? imu_log_hz : baro_log_hz;
+
+		uint64_t cycles = fixed_cycles + (uint64_t) records * record_cycles;
+		if(phase != LOG_PHASE_PAD){
+			cycles += (uint64_t) bytes * page_cycles / LOG_PAGE_SIZE;
+		}
+		uint32_t permille = (uint32_t) (cycles * 1000 / SystemCoreClock);
+
+		//On the pad the pages only go round the launchpad ring.
+		char minutes[16] = "-";
+		if(phase != LOG_PHASE_PAD && bytes > 0){
+			sprintf(minutes, "%" PRIu32, flash_bytes / bytes / 60);
+		}
+
+		sprintf(output, "%s\t%" PRIu32 "\t%" PRIu32 "\t0x%02X\t\t%d/%d\t\t%" PRIu32 "\t%s\t\t\t%" PRIu32 ".%" PRIu32,
+				log_rate_phase_name(phase), imu_log_hz, baro_log_hz, policy.channels, LOG_PRECISION_IMU(policy.precision),
+				LOG_PRECISION_BARO(policy.precision), bytes, minutes, permille / 10, permille % 10);
+		uart_transmit_line(uart, output);
+	}
+}
+
+/**
+ * @brief Cycles as microseconds with one decimal, e.g. "12.5".
+ */
+static void format_us(uint32_t cycles, char *out)
+{
+	uint32_t tenths = (uint32_t) ((uint64_t) cycles * 10 / (SystemCoreClock / 1000000));
+	sprintf(out, "%" PRIu32 ".%" PRIu32, tenths / 10, tenths % 10);
+}
+
+void profile_menu(char* command, cli_thread_parameters * params){
+
+	UART  uart = params->huart;
+	configuration_data_t * config = params->flightCompConfig;
+
+	char output [256];
+	if(strcmp(command, "help") == 0 || strcmp(command, "prof") == 0){
+
+		uart_transmit_line(uart, "Commands:\r\n"
+						"\t[help] - displays the help menu and more commands\r\n"
+						"\t[return] - Return to main menu\r\n"
+						"\t[a] - CPU share and stack headroom of each task since power on\r\n"
+						"\t[b] - Timings of the hot paths (us)\r\n"
+						"\t[c] - Queue high water marks\r\n"
+						"\t[d] - Clear the timings and high water marks\r\n"
+						"\t[e] - Set if timing (1/0)\r\n"
+						"\t[f] - Set if recording the timings in the flight log every 10 s (1/0)\r\n"
+						);
+
+	}
+	else if (strcmp(command,"return")==0){
+
+	}
+	else if (command[0] == 'a'){
+
+		uint32_t total_time;
+		UBaseType_t count = uxTaskGetSystemState(s_tasks, RAM_REPORT_MAX_TASKS, &total_time);
+		UBaseType_t i;
+
+		//The run time counters are in microseconds.
+		uart_transmit_line(uart, "Task\t\t\tCPU (%)\tRun time (ms)\tStack never used (words)");
+		for(i = 0; i < count; i++){
+			uint32_t permille = (total_time > 0) ? (uint32_t) ((uint64_t) s_tasks[i].ulRunTimeCounter * 1000 / total_time) : 0;
+			sprintf(output, "%-16s\t%" PRIu32 ".%" PRIu32 "\t%" PRIu32 "\t\t%d", s_tasks[i].pcTaskName, permille / 10,
+					permille % 10, (uint32_t) (s_tasks[i].ulRunTimeCounter / 1000), s_tasks[i].usStackHighWaterMark);
+			uart_transmit_line(uart, output);
+		}
+	}
+	else if (command[0] == 'b'){
+
+		char min[12], mean[12], p99[12], max[12];
+
+		sprintf(output, "Timing is %s. CPU clock %" PRIu32 " MHz.", profiler_running ? "on" : "off", SystemCoreClock / 1000000);
+		uart_transmit_line(uart, output);
+		uart_transmit_line(uart, "Span\t\t\tCount\t\tMin\tMean\tp99\tMax");
+		for(int span = 0; span < PROFILER_NUM_SPANS; span++){
+			profiler_span_summary summary;
+			profiler_get_span(span, &summary);
+			format_us(summary.min, min);
+			format_us(summary.mean, mean);
+			format_us(summary.p99, p99);
+			format_us(summary.max, max);
+			sprintf(output, "%-16s\t%-10" PRIu32 "\t%s\t%s\t%s\t%s", profiler_span_name(span), summary.count, min, mean, p99,
+					max);
+			uart_transmit_line(uart, output);
+		}
+	}
+	else if (command[0] == 'c'){
+
+		flash_writer_statistics statistics;
+		flash_writer_get_statistics(&statistics);
+
+		for(int gauge = 0; gauge < PROFILER_NUM_GAUGES; gauge++){
+			sprintf(output, "%-16s\t%" PRIu32, profiler_gauge_name(gauge), profiler_get_gauge(gauge));
+			uart_transmit_line(uart, output);
+		}
+		//The writer keeps its own mark, which the reset above does not clear.
+		sprintf(output, "flash queue since power on\t%" PRIu32 " of %d pages", statistics.queue_high_water,
+				FLASH_WRITER_QUEUE_PAGES);
+		uart_transmit_line(uart, output);
+	}
+	else if (command[0] == 'd'){
+
+		profiler_reset();
+		uart_transmit_line(uart, "Timings and high water marks cleared.");
+	}
+	else if (command[0] == 'e'){
+
+		int value = atoi(&command[1]);
+		profiler_set_running(value == 1);
+		sprintf(output, "Timing is %s.", profiler_running ? "on" : (PROFILER_MODE ? "off" : "compiled out (PROFILER_MODE 0)"));
+		uart_transmit_line(uart, output);
+	}
+	else if (command[0] == 'f'){
+
+		int value = atoi(&command[1]);
+
+		switch(value){
+
+		case 0:
+			sprintf(output,"Turning off recording the timings.\n");
+			uart_transmit_line(uart,output);
+			config->values.flags &= ~(0x20);
+			break;
+		case 1:
+			sprintf(output,"Turning on recording the timings. Save the settings to keep it.\n");
+			uart_transmit_line(uart,output);
+			config->values.flags |= (0x20);
+			break;
+
+		}
+	}
+	else{
+		sprintf(output, "Command [%s] not recognized.", command);
+		uart_transmit_line(uart, output);
+	}
+}
+
 void memory_menu(char* command, cli_thread_parameters * params){
 
 	UART  uart = params->huart;
@@ -229,6 +560,7 @@ void memory_menu(char* command, cli_thread_parameters * params){
 						"\t[c] - Erase data section\r\n"
 						"\t[d] - Erase config section.\r\n"
 						"\t[e] - Erase all flash memory.\r\n"
+						"\t[v] - Verify the CRC and sequence of every log page.\r\n"
 						);
 
 	}
@@ -244,10 +576,10 @@ void memory_menu(char* command, cli_thread_parameters * params){
 
 		uint32_t value = strtol(val_str,NULL,16);
 
-		if(value>=0 && value<= FLASH_END_ADDRESS){
+		if(value <= FLASH_END_ADDRESS){
 
 
-			sprintf(output,"Reading 256 bytes starting at address %ld ...",value);
+			sprintf(output,"Reading 256 bytes starting at address %" PRIu32 " ...",value);
 			uart_transmit_line(uart,output);
 
 			uint8_t data_rx[FLASH_PAGE_SIZE];
@@ -297,8 +629,8 @@ void memory_menu(char* command, cli_thread_parameters * params){
 	else if (command[0] == 'b'){
 
 
-		uint32_t end_Address = flash_scan(flash);
-		sprintf(output,"end address :%ld \n",end_Address);
+		uint32_t end_Address = scan_end_address(uart, flash, params->flightCompConfig->values.end_data_address);
+		sprintf(output,"end address :%" PRIu32 " \n",end_Address);
 		uart_transmit_line(uart,output);
 
 		}
@@ -330,7 +662,7 @@ void memory_menu(char* command, cli_thread_parameters * params){
 				  }
 
 //				  HAL_GPIO_TogglePin(USR_LED_PORT,USR_LED_PIN);
-					sprintf(output,"Erasing sector %ld ...",address);
+					sprintf(output,"Erasing sector %" PRIu32 " ...",address);
 					uart_transmit_line(uart,output);
 			  }
 
@@ -366,6 +698,48 @@ void memory_menu(char* command, cli_thread_parameters * params){
 		}
 	else if (command[0] == 'f'){
 
+		}
+	else if (command[0] == 'v'){
+
+		uint8_t page[FLASH_PAGE_SIZE];
+		uint32_t end_address = scan_end_address(uart, flash, params->flightCompConfig->values.end_data_address);
+		uint32_t pages = 0;
+		uint32_t bad_pages = 0;
+		uint32_t gaps = 0;
+		uint32_t expected = 1;
+
+		while(flash_read(flash, FLASH_START_ADDRESS, page, FLASH_PAGE_SIZE) == FLASH_BUSY){
+			vTaskDelay(1);
+		}
+		if(read_32(page) != LOG_SUPERBLOCK_MAGIC || !log_encoder_verify(page)){
+			uart_transmit_line(uart,"No valid superblock.");
+		}
+
+		//Every page carries its own CRC and sequence number, so a bad one does not hide the ones after it.
+		uint32_t address;
+		for(address = FLASH_START_ADDRESS + FLASH_PAGE_SIZE; address < end_address; address += FLASH_PAGE_SIZE){
+
+			while(flash_read(flash, address, page, FLASH_PAGE_SIZE) == FLASH_BUSY){
+				vTaskDelay(1);
+			}
+			pages++;
+
+			if(page[0] != LOG_PAGE_MARKER || !log_encoder_verify(page)){
+				bad_pages++;
+				continue;
+			}
+
+			uint32_t sequence = read_32(&page[LOG_PAGE_SEQUENCE]);
+			if(sequence != expected){
+				gaps++;
+			}
+			expected = sequence + 1;
+		}
+
+		sprintf(output,"Pages: %" PRIu32 " bad pages: %" PRIu32 " sequence gaps: %" PRIu32,pages,bad_pages,gaps);
+
+		uart_transmit_line(uart,output);
+
 		}
 
 }
@@ -542,7 +916,7 @@ void configure(char* command, cli_thread_parameters * params){
 		uart_transmit_line(uart, "Commands:\r\n"
 						"\t[help] - displays the help menu and more commands\r\n"
 						"\t[return] - Return to main menu\r\n"
-						"\t[a] - Set data rate Hz(0-100)\r\n"
+						"\t[a] - Set the polling rate Hz(0-100), for sensors read without their FIFO or interrupt\r\n"
 						"\t[z] - Set the initial time to wait (0-10000000)\r\n"
 						"\t[b] - set if recording to flash (1/0)\r\n"
 						"\t[c] - set accelerometer bandwidth (0,2,4)\r\n"
@@ -556,6 +930,15 @@ void configure(char* command, cli_thread_parameters * params){
 						"\t[l] - set BMP388 IIR filter coefficient (0,1,3,7,15,31,63,127) \r\n"
 						"\t[m] - Read the current settings\r\n"
 						"\t[n] - Set if in flight (1/0)\r\n"
+						"\t[o] - Set the IMU log rate of a phase: o<phase> <Hz>\r\n"
+						"\t[p] - Set the pressure log rate of a phase: p<phase> <Hz>\r\n"
+						"\t\t(phases 0 pad, 1 ascent, 2 drogue, 3 main, 4 landed. Hz 0 to 254, 0 off, 255 every sample)\r\n"
+						"\t[q] - Set if the log averages the samples between two records (1), or takes the newest (0)\r\n"
+						"\t[r] - Log policy, flash use and CPU load of each phase\r\n"
+						"\t[s] - Set the channels logged in a phase: s<phase> <channels>\r\n"
+						"\t\t(add up 1 acceleration, 2 angular rate, 4 pressure, 8 temperature, 16 altitude)\r\n"
+						"\t[t] - Set the low bits dropped from the logged values in a phase: t<phase> <IMU bits> <pressure sensor bits>\r\n"
+						"\t\t(0 to 12, 0 keeps full precision)\r\n"
 						);
 
 	}
@@ -571,7 +954,7 @@ void configure(char* command, cli_thread_parameters * params){
 		int value = atoi(val_str);
 		if( value >0 && value <=100){
 
-			sprintf(output,"Setting data rate to %d Hz.\n",value);
+			sprintf(output,"Setting polling rate to %d Hz.\n",value);
 
 			uart_transmit_line(uart,output);
 			config->values.data_rate = 1000/value;
@@ -1072,16 +1455,24 @@ void configure(char* command, cli_thread_parameters * params){
 		sprintf(output,"The current settings (not in flash):");
 		uart_transmit_line(uart,output);
 
-		sprintf(output,"ID: %d \tIntitial Time To Wait: %ld \r\n",config->values.id,config->values.initial_time_to_wait);
+		sprintf(output,"ID: %d \tIntitial Time To Wait: %" PRIu32 " \r\n",config->values.id,config->values.initial_time_to_wait);
 		uart_transmit_line(uart,output);
 
-		sprintf(output,"data rate: %d Hz \tSet to record: %d \r\n",1000/config->values.data_rate,IS_RECORDING(config->values.flags));
+		sprintf(output,"polling rate: %d Hz \tSet to record: %d \r\n",1000/config->values.data_rate,IS_RECORDING(config->values.flags));
 		uart_transmit_line(uart,output);
 
-		sprintf(output,"start of data: %ld \tend of data: %ld \r\n",config->values.start_data_address,config->values.end_data_address);
+		for(int phase = 0; phase < LOG_NUM_PHASES; phase++){
+			uint8_t precision = config->values.log_precision[phase];
+			sprintf(output,"%s log rate: IMU %d Hz \tpressure %d Hz \tchannels: %d \tbits dropped: IMU %d pressure %d \r\n",
+					log_rate_phase_name(phase),config->values.imu_log_rate[phase],config->values.baro_log_rate[phase],
+					config->values.log_channels[phase],LOG_PRECISION_IMU(precision),LOG_PRECISION_BARO(precision));
+			uart_transmit_line(uart,output);
+		}
+
+		sprintf(output,"start of data: %" PRIu32 " \tend of data: %" PRIu32 " \r\n",config->values.start_data_address,config->values.end_data_address);
 		uart_transmit_line(uart,output);
 
-		sprintf(output,"reference altitude: %ld \t reference pressure: %ld \r\n",(uint32_t)config->values.ref_alt,(uint32_t)config->values.ref_pres);
+		sprintf(output,"reference altitude: %" PRIu32 " \t reference pressure: %" PRIu32 " \r\n",(uint32_t)config->values.ref_alt,(uint32_t)config->values.ref_pres);
 		uart_transmit_line(uart,output);
 
 	}
@@ -1109,6 +1500,77 @@ void configure(char* command, cli_thread_parameters * params){
 
 		}
 	}
+	else if (command[0] == 'o' || command[0] == 'p'){
+
+		char *rate_str = strchr(command,' ');
+		int phase = atoi(&command[1]);
+		int value = (rate_str != NULL) ? atoi(rate_str) : -1;
+
+		if(phase >= 0 && phase < LOG_NUM_PHASES && value >= 0 && value <= LOG_RATE_ALL){
+
+			uint8_t *rates = (command[0] == 'o') ? config->values.imu_log_rate : config->values.baro_log_rate;
+			rates[phase] = value;
+			sprintf(output,"Setting the %s log rate %s to %d Hz%s.\n",(command[0] == 'o') ? "IMU" : "pressure",
+					log_rate_phase_name(phase),value,(value == LOG_RATE_ALL) ? " (every sample)" : "");
+			uart_transmit_line(uart,output);
+		}
+	}
+	else if (command[0] == 'q'){
+
+		int value = atoi(&command[1]);
+
+		switch(value){
+
+		case 0:
+			sprintf(output,"Logging the newest sample.\n");
+			uart_transmit_line(uart,output);
+			config->values.flags |= (0x40);
+			break;
+		case 1:
+			sprintf(output,"Logging the average of the samples.\n");
+			uart_transmit_line(uart,output);
+			config->values.flags &= ~(0x40);
+			break;
+
+		}
+	}
+	else if (command[0] == 'r'){
+
+		log_budget_report(uart, config);
+	}
+	else if (command[0] == 's'){
+
+		char *channels_str = strchr(command,' ');
+		int phase = atoi(&command[1]);
+		int value = (channels_str != NULL) ? atoi(channels_str) : -1;
+
+		if(phase >= 0 && phase < LOG_NUM_PHASES && value >= 0 && value <= LOG_CHANNELS_ALL){
+
+			config->values.log_channels[phase] = value;
+			sprintf(output,"Logging%s%s%s%s%s%s in phase %s.\n",(value & LOG_CHANNEL_ACC) ? " acceleration" : "",
+					(value & LOG_CHANNEL_GYRO) ? " angular rate" : "",(value & LOG_CHANNEL_PRESSURE) ? " pressure" : "",
+					(value & LOG_CHANNEL_TEMPERATURE) ? " temperature" : "",(value & LOG_CHANNEL_ALTITUDE) ? " altitude" : "",
+					(value == 0) ? " nothing" : "",log_rate_phase_name(phase));
+			uart_transmit_line(uart,output);
+		}
+	}
+	else if (command[0] == 't'){
+
+		char *imu_str = strchr(command,' ');
+		char *baro_str = (imu_str != NULL) ? strchr(imu_str + 1,' ') : NULL;
+		int phase = atoi(&command[1]);
+		int imu_bits = (imu_str != NULL) ? atoi(imu_str) : -1;
+		int baro_bits = (baro_str != NULL) ? atoi(baro_str) : -1;
+
+		if(phase >= 0 && phase < LOG_NUM_PHASES && imu_bits >= 0 && imu_bits <= LOG_PRECISION_MAX_BITS &&
+		   baro_bits >= 0 && baro_bits <= LOG_PRECISION_MAX_BITS){
+
+			config->values.log_precision[phase] = LOG_PRECISION(imu_bits, baro_bits);
+			sprintf(output,"Dropping %d bits from the IMU and %d bits from the pressure sensor in phase %s.\n",imu_bits,baro_bits,
+					log_rate_phase_name(phase));
+			uart_transmit_line(uart,output);
+		}
+	}
 	else{
 		sprintf(output, "Command [%s] not recognized.", command);
 		uart_transmit_line(uart, output);
@@ -1124,7 +1586,7 @@ void cli_read(cli_thread_parameters * params){
 //	HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN,GPIO_PIN_RESET);
 	uart_transmit_line(uart, "Data transfer will start in 20 seconds. The LED will turn off when the transfer is complete.");
 
-	uint8_t buffer[256*5]; 	//Read 5 pages from flash at a time;
+	uint8_t buffer[256*5]; 	//Read 5 pages from flash at a time, in one burst.
 
 	uint32_t bytesRead = 0;
 	uint32_t currentAddress = FLASH_START_ADDRESS;
@@ -1132,10 +1594,10 @@ void cli_read(cli_thread_parameters * params){
 	vTaskDelay(pdMS_TO_TICKS(1000*10));	//Delay 10 seconds
 
 //	HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN,GPIO_PIN_SET);
-	uint32_t endAddress = flash_scan(flash);
+	uint32_t endAddress = scan_end_address(uart, flash, params->flightCompConfig->values.end_data_address);
 	while (bytesRead < endAddress){
 
-		flash_read_page(flash,currentAddress,buffer,256*5);
+		flash_read(flash,currentAddress,buffer,256*5);
 
 		int i;
 		uint16_t empty =0 ;
@@ -0,0 +1,335 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the framed log download.
+//
+//  Two frame buffers take turns: while one is on the wire by DMA, the next chunk is read from the flash into the
+//  other, so the link never waits for the flash. A go back re-reads the flash rather than keeping old frames around.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "tasks/download.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "cmsis_os.h"
+#include "utilities/common.h"
+
+typedef struct
+{
+	uint8_t type;
+	uint32_t sequence;
+	uint32_t offset;
+	uint16_t length;
+	uint8_t payload[DOWNLOAD_CONTROL_MAX];
+} download_frame;
+
+typedef struct
+{
+	uint32_t frames;		//Data frames sent, resends included.
+	uint32_t go_backs;		//NAKs and timeouts that made the sender go back.
+} download_statistics;
+
+static uint8_t s_frames[2][DOWNLOAD_FRAME_MAX];
+static uint8_t s_rx[2 * (DOWNLOAD_HEADER_SIZE + DOWNLOAD_CONTROL_MAX + DOWNLOAD_CRC_SIZE)];
+static uint16_t s_rx_length;
+
+static const uint32_t s_baud_rates[] = {921600, 460800, 230400, DOWNLOAD_DEFAULT_BAUD};
+
+
+/**
+ * @brief Fills in the header and CRC around the payload already at frame + DOWNLOAD_HEADER_SIZE.
+ * @return Size of the whole frame.
+ */
+static uint16_t build_frame(uint8_t *frame, uint8_t type, uint32_t sequence, uint32_t offset, uint16_t length)
+{
+	frame[0] = DOWNLOAD_SYNC_0;
+	frame[1] = DOWNLOAD_SYNC_1;
+	frame[2] = type;
+	frame[3] = 0;
+	frame[4] = (uint8_t) (length >> 8);
+	frame[5] = (uint8_t) length;
+	write_32(sequence, &frame[6]);
+	write_32(offset, &frame[10]);
+	write_32(crc32(frame, DOWNLOAD_HEADER_SIZE + length), &frame[DOWNLOAD_HEADER_SIZE + length]);
+
+	return DOWNLOAD_HEADER_SIZE + length + DOWNLOAD_CRC_SIZE;
+}
+
+/**
+ * @brief Sends a control frame from s_frames[0] and waits until it is out. Only used when no data is in flight.
+ */
+static void send_control(UART uart, uint8_t type, uint32_t offset, uint16_t length)
+{
+	uint16_t size = build_frame(s_frames[0], type, 0, offset, length);
+	uart_wait_transmit_done(uart, DOWNLOAD_ACK_TIMEOUT);
+	uart_transmit_bytes_dma(uart, s_frames[0], size);
+	uart_wait_transmit_done(uart, DOWNLOAD_ACK_TIMEOUT);
+}
+
+static void drop_received(uint16_t count)
+{
+	memmove(s_rx, &s_rx[count], s_rx_length - count);
+	s_rx_length -= count;
+}
+
+/**
+ * @brief Takes the next valid frame out of what the receive DMA has collected. Anything that is not a frame, like the
+ *        echo of the CLI command or a frame with a bad CRC, is skipped a byte at a time until the next sync.
+ * @return true if frame was filled in.
+ */
+static bool receive_frame(UART uart, download_frame *frame)
+{
+	s_rx_length += uart_receive_available(uart, &s_rx[s_rx_length], sizeof(s_rx) - s_rx_length);
+
+	while(s_rx_length >= 2)
+	{
+		if(s_rx[0] != DOWNLOAD_SYNC_0 || s_rx[1] != DOWNLOAD_SYNC_1)
+		{
+			drop_received(1);
+			continue;
+		}
+		if(s_rx_length < DOWNLOAD_HEADER_SIZE)
+		{
+			return false;
+		}
+
+		uint16_t length = ((uint16_t) s_rx[4] << 8) | s_rx[5];
+		if(length > DOWNLOAD_CONTROL_MAX)
+		{
+			drop_received(1);
+			continue;
+		}
+
+		uint16_t size = DOWNLOAD_HEADER_SIZE + length + DOWNLOAD_CRC_SIZE;
+		if(s_rx_length < size)
+		{
+			return false;
+		}
+		if(read_32(&s_rx[DOWNLOAD_HEADER_SIZE + length]) != crc32(s_rx, DOWNLOAD_HEADER_SIZE + length))
+		{
+			drop_received(1);
+			continue;
+		}
+
+		frame->type = s_rx[2];
+		frame->sequence = read_32(&s_rx[6]);
+		frame->offset = read_32(&s_rx[10]);
+		frame->length = length;
+		memcpy(frame->payload, &s_rx[DOWNLOAD_HEADER_SIZE], length);
+		drop_received(size);
+		return true;
+	}
+
+	if(s_rx_length == 1 && s_rx[0] != DOWNLOAD_SYNC_0)
+	{
+		drop_received(1);
+	}
+	return false;
+}
+
+/**
+ * @brief Waits up to timeout ms for a frame of the given type, polling every tick.
+ */
+static bool wait_for_frame(UART uart, download_frame *frame, uint8_t type, uint32_t timeout)
+{
+	TickType_t start = xTaskGetTickCount();
+	while((xTaskGetTickCount() - start) < pdMS_TO_TICKS(timeout))
+	{
+		while(receive_frame(uart, frame))
+		{
+			if(frame->type == type)
+			{
+				return true;
+			}
+		}
+		vTaskDelay(1);
+	}
+	return false;
+}
+
+static uint32_t choose_baud_rate(uint32_t requested)
+{
+	uint32_t i;
+	for(i = 0; i < sizeof(s_baud_rates) / sizeof(s_baud_rates[0]); i++)
+	{
+		if(s_baud_rates[i] <= requested && s_baud_rates[i] <= DOWNLOAD_MAX_BAUD)
+		{
+			return s_baud_rates[i];
+		}
+	}
+	return DOWNLOAD_DEFAULT_BAUD;
+}
+
+static void read_flash(Flash flash, uint32_t address, uint8_t *buffer, uint16_t size)
+{
+	while(flash_read(flash, address, buffer, size) == FLASH_BUSY)
+	{
+		vTaskDelay(1);
+	}
+}
+
+/**
+ * @brief Sends the log from base to total, keeping up to window frames of chunk bytes unacknowledged.
+ * @return true once the receiver has acknowledged everything.
+ */
+static bool send_log(UART uart, Flash flash, uint32_t base, uint32_t total, uint16_t window, uint16_t chunk,
+					 download_statistics *statistics)
+{
+	download_frame reply;
+	uint32_t next = base;			//Offset of the next frame to send.
+	uint32_t sequence = 0;
+	uint8_t fill = 0;				//Buffer being prepared. The other one may be on the wire.
+	uint16_t ready_size = 0;		//Size of the prepared frame, 0 if there is none.
+	uint16_t ready_length = 0;
+	uint32_t ready_offset = 0;
+	uint8_t timeouts = 0;
+	TickType_t last_progress = xTaskGetTickCount();
+
+	while(base < total)
+	{
+		while(receive_frame(uart, &reply))
+		{
+			if(reply.type == DOWNLOAD_ACK && reply.offset > base && reply.offset <= next)
+			{
+				base = reply.offset;
+				timeouts = 0;
+				last_progress = xTaskGetTickCount();
+			}else if(reply.type == DOWNLOAD_NAK && reply.offset >= base && reply.offset < next)
+			{
+				base = reply.offset;
+				next = reply.offset;
+				statistics->go_backs++;
+				last_progress = xTaskGetTickCount();
+			}else if(reply.type == DOWNLOAD_ABORT)
+			{
+				return false;
+			}
+		}
+
+		//Lost acknowledgements look the same as lost data: start again from the last offset the receiver confirmed.
+		if((xTaskGetTickCount() - last_progress) > pdMS_TO_TICKS(DOWNLOAD_ACK_TIMEOUT))
+		{
+			if(++timeouts > DOWNLOAD_MAX_RETRIES)
+			{
+				return false;
+			}
+			next = base;
+			statistics->go_backs++;
+			last_progress = xTaskGetTickCount();
+		}
+
+		if(ready_size != 0 && ready_offset != next)
+		{
+			ready_size = 0;
+		}
+
+		if(ready_size == 0 && next < total && next < base + (uint32_t) window * chunk)
+		{
+			ready_length = (total - next < chunk) ? (uint16_t) (total - next) : chunk;
+			read_flash(flash, FLASH_START_ADDRESS + next, &s_frames[fill][DOWNLOAD_HEADER_SIZE], ready_length);
+			ready_size = build_frame(s_frames[fill], DOWNLOAD_DATA, sequence, next, ready_length);
+			ready_offset = next;
+		}
+
+		if(ready_size != 0)
+		{
+			if(uart_wait_transmit_done(uart, 1))
+			{
+				uart_transmit_bytes_dma(uart, s_frames[fill], ready_size);
+				fill ^= 1;
+				ready_size = 0;
+				next += ready_length;
+				sequence++;
+				statistics->frames++;
+			}
+		}else
+		{
+			//Window full or everything sent, wait for the receiver.
+			vTaskDelay(1);
+		}
+	}
+
+	return uart_wait_transmit_done(uart, DOWNLOAD_ACK_TIMEOUT);
+}
+
+void download_run(UART uart, Flash flash, uint32_t end_address)
+{
+	download_frame frame;
+	download_statistics statistics = {0};
+	uint32_t total = (end_address > FLASH_START_ADDRESS) ? end_address - FLASH_START_ADDRESS : 0;
+	uint32_t baud_rate = DOWNLOAD_DEFAULT_BAUD;
+	bool done = false;
+	char output[100];
+
+	uart_transmit_line(uart, "Download ready, start the receiver.");
+	s_rx_length = 0;
+	uart_receive_start(uart);
+
+	if(!wait_for_frame(uart, &frame, DOWNLOAD_START, DOWNLOAD_START_TIMEOUT) || frame.length < 8)
+	{
+		uart_receive_stop(uart);
+		uart_transmit_line(uart, "No receiver, download cancelled.");
+		return;
+	}
+
+	uint32_t offset = (frame.offset < total) ? frame.offset : total;
+	uint16_t window = ((uint16_t) frame.payload[4] << 8) | frame.payload[5];
+	uint16_t chunk = ((uint16_t) frame.payload[6] << 8) | frame.payload[7];
+	baud_rate = choose_baud_rate(read_32(&frame.payload[0]));
+	window = (window == 0) ? 1 : (window > DOWNLOAD_WINDOW_MAX) ? DOWNLOAD_WINDOW_MAX : window;
+	chunk = (chunk < 16) ? 16 : (chunk > DOWNLOAD_CHUNK_MAX) ? DOWNLOAD_CHUNK_MAX : chunk;
+
+	uint8_t *info = &s_frames[0][DOWNLOAD_HEADER_SIZE];
+	write_32(total, &info[0]);
+	write_32(baud_rate, &info[4]);
+	info[8] = (uint8_t) (window >> 8);
+	info[9] = (uint8_t) window;
+	info[10] = (uint8_t) (chunk >> 8);
+	info[11] = (uint8_t) chunk;
+	send_control(uart, DOWNLOAD_INFO, offset, 12);
+
+	//The receiver switches when it sees INFO, then keeps sending ACKs until data arrives at the new rate.
+	if(baud_rate != DOWNLOAD_DEFAULT_BAUD)
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+		uart_set_baud_rate(uart, baud_rate);
+		s_rx_length = 0;
+	}
+
+	if(wait_for_frame(uart, &frame, DOWNLOAD_ACK, DOWNLOAD_SYNC_TIMEOUT) &&
+	   send_log(uart, flash, offset, total, window, chunk, &statistics))
+	{
+		int tries;
+		for(tries = 0; tries < 3 && !done; tries++)
+		{
+			send_control(uart, DOWNLOAD_END, total, 0);
+			done = wait_for_frame(uart, &frame, DOWNLOAD_ACK, DOWNLOAD_ACK_TIMEOUT) && frame.offset == total;
+		}
+	}else
+	{
+		send_control(uart, DOWNLOAD_ABORT, 0, 0);
+	}
+
+	uart_receive_stop(uart);
+	if(baud_rate != DOWNLOAD_DEFAULT_BAUD)
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+		uart_set_baud_rate(uart, DOWNLOAD_DEFAULT_BAUD);
+	}
+
+	sprintf(output, "Download %s: %" PRIu32 " bytes from %" PRIu32 ", %" PRIu32 " frames, %" PRIu32 " go backs, %" PRIu32 " baud.",
+			done ? "done" : "failed",
+			total - offset, offset, statistics.frames, statistics.go_backs, baud_rate);
+	uart_transmit_line(uart, output);
+}
@@ -0,0 +1,273 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the flash writer task.
+//
+//  The controller (producer) and this task (consumer) share a ring of page slots. Each index is only ever written by
+//  one side: head by the producer, tail by the consumer. So neither side needs a lock, only a barrier between filling
+//  a slot and publishing it.
+//
+//  The eraser works the same way: it is the only one to move erased_address, and the writer never programs past it.
+//
+//  The writer sleeps on a semaphore rather than its task notification. The SPI driver wakes it with the notification
+//  when a page program's DMA is done, and a page queued in the middle of that must not look like the end of it.
+//
+// History
+// 2026-10-17
+// - Created.
+// 2026-10-18
+// - Sectors are 64 kB.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "tasks/flash_writer.h"
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "cmsis_os.h"
+#include "tasks/flight_state_controller.h"
+#include "utilities/profiler.h"
+
+#define QUEUE_INDEX_MASK	(FLASH_WRITER_QUEUE_PAGES - 1)
+
+//The eraser moves a whole sector at a time, and the data area's full size sectors start on a sector boundary.
+#if (FLASH_WRITER_ERASE_AHEAD % FLASH_SECTOR_SIZE) != 0 || ((FLASH_PARAM_END_ADDRESS + 1) % FLASH_SECTOR_SIZE) != 0
+#error "The erase lead and the first full size sector must be aligned to FLASH_SECTOR_SIZE."
+#endif
+
+typedef struct
+{
+	uint8_t pages[FLASH_WRITER_QUEUE_PAGES][DATA_BUFFER_SIZE];
+	volatile uint32_t head;		//Free running count of pages queued. Only written by the producer.
+	volatile uint32_t tail;		//Free running count of pages taken out. Only written by the writer.
+	SemaphoreHandle_t page_queued;	//Given for every page queued, taken by the writer when the queue is empty.
+	StaticSemaphore_t page_queued_buffer;
+	TaskHandle_t eraser_task;		//Only ever sends commands too short for DMA, so it can sleep on its notification.
+	volatile bool eraser_enabled;
+	volatile uint32_t old_data_end;
+	flash_writer_statistics statistics;
+} flash_writer_queue;
+
+static flash_writer_queue s_queue;
+
+
+/**
+ * @brief Programs one page, retrying while another task keeps the flash busy, then waits for the program cycle.
+ * @return true if the page made it into the flash.
+ */
+static bool program_page(Flash flash, uint32_t address, uint8_t *page)
+{
+	FlashStatus stat;
+	while((stat = flash_program_page(flash, address, page, DATA_BUFFER_SIZE)) == FLASH_BUSY)
+	{
+		vTaskDelay(1);
+	}
+
+	if(stat != FLASH_OK)
+	{
+		return false;
+	}
+
+	while(flash_is_programming(flash))
+	{
+		vTaskDelay(1);
+	}
+
+	return !FLASH_WAS_PROGRAMING_ERROR(flash_get_status_register(flash));
+}
+
+static uint32_t sector_size(uint32_t address)
+{
+	return (address > FLASH_PARAM_END_ADDRESS) ? FLASH_SECTOR_SIZE : FLASH_PARAM_SECTOR_SIZE;
+}
+
+/**
+ * @brief Waits until the eraser is past the page at address and records how long that took.
+ */
+static void wait_for_eraser(uint32_t address)
+{
+	if(address + DATA_BUFFER_SIZE <= s_queue.statistics.erased_address)
+	{
+		return;
+	}
+
+	TickType_t start = xTaskGetTickCount();
+	if(s_queue.eraser_task != NULL)
+	{
+		xTaskNotifyGive(s_queue.eraser_task);
+	}
+
+	while(address + DATA_BUFFER_SIZE > s_queue.statistics.erased_address)
+	{
+		vTaskDelay(1);
+	}
+
+	uint32_t stall = xTaskGetTickCount() - start;
+	if(stall > s_queue.statistics.erase_stall_max)
+	{
+		s_queue.statistics.erase_stall_max = stall;
+	}
+}
+
+void thread_flash_writer_start(void const *params)
+{
+	flash_writer_thread_parameters *thread_params = (flash_writer_thread_parameters *) params;
+	Flash flash = thread_params->flash;
+
+	s_queue.statistics.next_address = thread_params->start_address;
+	s_queue.page_queued = xSemaphoreCreateBinaryStatic(&s_queue.page_queued_buffer);
+
+	while(1)
+	{
+		while(s_queue.tail != s_queue.head)
+		{
+			uint8_t *page = s_queue.pages[s_queue.tail & QUEUE_INDEX_MASK];
+
+			if(s_queue.statistics.next_address + DATA_BUFFER_SIZE > FLASH_SIZE_BYTES)
+			{
+				//Out of space. Keep draining so the controller never stalls.
+				s_queue.statistics.pages_lost++;
+			}else
+			{
+				wait_for_eraser(s_queue.statistics.next_address);
+
+				if(program_page(flash, s_queue.statistics.next_address, page))
+				{
+					s_queue.statistics.pages_written++;
+				}else
+				{
+					//Skip the bad page rather than programming the rest of the flight on top of it.
+					s_queue.statistics.pages_lost++;
+				}
+				s_queue.statistics.next_address += DATA_BUFFER_SIZE;
+
+				//Let the eraser keep its lead.
+				if(s_queue.eraser_task != NULL)
+				{
+					xTaskNotifyGive(s_queue.eraser_task);
+				}
+			}
+
+			//The slot must be fully read before the producer is allowed to reuse it.
+			__DMB();
+			s_queue.tail++;
+		}
+
+		//A page queued after the check above leaves the semaphore given, so nothing is missed.
+		xSemaphoreTake(s_queue.page_queued, portMAX_DELAY);
+	}
+}
+
+void thread_flash_eraser_start(void const *params)
+{
+	flash_writer_thread_parameters *thread_params = (flash_writer_thread_parameters *) params;
+	Flash flash = thread_params->flash;
+
+	//After a reset in flight the log continues in the middle of a sector. That sector was erased when the log got
+	//there, so erasing starts at the next boundary.
+	uint32_t address = thread_params->start_address;
+	uint32_t size = sector_size(address);
+	s_queue.statistics.erased_address = ((address + size - 1) / size) * size;
+	s_queue.eraser_task = xTaskGetCurrentTaskHandle();
+
+	while(1)
+	{
+		uint32_t erased = s_queue.statistics.erased_address;
+		uint32_t target = s_queue.statistics.next_address + FLASH_WRITER_ERASE_AHEAD;
+		if(s_queue.old_data_end > target)
+		{
+			target = s_queue.old_data_end;
+		}
+
+		if(!s_queue.eraser_enabled || erased >= target || erased >= FLASH_SIZE_BYTES)
+		{
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+
+		size = sector_size(erased);
+		FlashStatus stat;
+		do
+		{
+			stat = (size == FLASH_SECTOR_SIZE) ? flash_erase_sector(flash, erased) : flash_erase_param_sector(flash, erased);
+			if(stat == FLASH_BUSY)
+			{
+				vTaskDelay(1);
+			}
+		}while(stat == FLASH_BUSY);
+
+		uint8_t status_reg = flash_get_status_register(flash);
+		while(FLASH_IS_DEVICE_BUSY(status_reg))
+		{
+			vTaskDelay(pdMS_TO_TICKS(5));
+			status_reg = flash_get_status_register(flash);
+		}
+
+		if(stat != FLASH_OK || FLASH_WAS_ERASE_ERROR(status_reg))
+		{
+			//Move on anyway, the writer will skip the pages that fail to program.
+			s_queue.statistics.erase_errors++;
+		}
+
+		s_queue.statistics.erased_address = erased + size;
+	}
+}
+
+void flash_writer_start_eraser(uint32_t old_data_end)
+{
+	s_queue.old_data_end = old_data_end;
+	s_queue.eraser_enabled = true;
+
+	if(s_queue.eraser_task != NULL)
+	{
+		xTaskNotifyGive(s_queue.eraser_task);
+	}
+}
+
+bool flash_writer_submit_page(const uint8_t *page, uint32_t timeout)
+{
+	uint32_t head = s_queue.head;
+	TickType_t start = xTaskGetTickCount();
+
+	while((head - s_queue.tail) >= FLASH_WRITER_QUEUE_PAGES)
+	{
+		if((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout))
+		{
+			s_queue.statistics.pages_dropped++;
+			return false;
+		}
+		vTaskDelay(1);
+	}
+
+	memcpy(s_queue.pages[head & QUEUE_INDEX_MASK], page, DATA_BUFFER_SIZE);
+
+	//Publish the page only after its contents are in memory.
+	__DMB();
+	s_queue.head = head + 1;
+
+	uint32_t depth = s_queue.head - s_queue.tail;
+	if(depth > s_queue.statistics.queue_high_water)
+	{
+		s_queue.statistics.queue_high_water = depth;
+	}
+	profiler_gauge_update(PROFILER_GAUGE_FLASH_QUEUE, depth);
+
+	if(s_queue.page_queued != NULL)
+	{
+		xSemaphoreGive(s_queue.page_queued);
+	}
+
+	return true;
+}
+
+void flash_writer_get_statistics(flash_writer_statistics *statistics)
+{
+	taskENTER_CRITICAL();
+	*statistics = s_queue.statistics;
+	taskEXIT_CRITICAL();
+}
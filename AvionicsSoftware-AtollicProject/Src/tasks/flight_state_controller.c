@@ -21,248 +21,280 @@
 #include "flash.h"
 #include "tasks/sensors/pressure_sensor.h"
 #include "tasks/sensors/imu_sensor.h"
+#include "tasks/flash_writer.h"
 #include "buzzer.h"
 #include "recovery.h"
 #include "configuration.h"
 #include "utilities/common.h"
+#include "utilities/altitude_estimator.h"
+#include "utilities/log_encoder.h"
+#include "utilities/log_rate.h"
+#include "utilities/profiler.h"
+
+#define LAUNCHPAD_BUFFER_PAGES 25
+#define LAUNCHPAD_DUMP_TIMEOUT 100	//How long (ms) the launch dump may wait on a full flash writer queue per page.
+#define GRAVITY 9.80665f
+#define PROFILE_LOG_PERIOD_US 10000000	//How often the timings go in the log when IS_PROFILING.
+#define IMU_READ_TIMEOUT 100			//Ticks to wait for an IMU sample. The IMU sets the pace of the loop.
+
+//The state machine runs on every IMU sample, so its hold times are in time, not in samples.
+#define APOGEE_HOLDOUT_US 15000000		//No apogee this soon after launch.
+#define MAIN_ALTITUDE_HOLD_US 300000	//Below the main altitude for this long before the main is fired.
+#define LANDED_STILL_US 10000000		//Altitude within 1 m for this long, and not turning, is landed.
 
-#define HEADER_SIZE 3
-
-typedef struct{
-	uint8_t data[HEADER_SIZE + ACC_LENGTH + GYRO_LENGTH + PRES_LENGTH + TEMP_LENGTH + ALT_LENGTH];
-}data_measurement;
+typedef enum
+{
+	CONTROLLER_STATE_LAUNCHPAD 				= 0,
+	CONTROLLER_STATE_LAUNCHPAD_ARMED,
+	CONTROLLER_STATE_IN_FLIGHT_PRE_APOGEE,
+	CONTROLLER_STATE_IN_FLIGHT_POST_APOGEE,
+	CONTROLLER_STATE_IN_FLIGHT_POST_MAIN,
+	CONTROLLER_STATE_LANDED,
+	CONTROLLER_STATE_EXIT,
+	CONTROLLER_NUM_STATES
+} StateType;
 
+// Everything the controller needs between two samples. There is exactly one instance of this (see s_context below)
+// and every function of the logging loop works on it through a pointer, so nothing here is ever copied.
 typedef struct
 {
-	uint8_t acc_z_filter_index0;
 	uint8_t running;
-	uint8_t data_bufferA[DATA_BUFFER_SIZE];   // This stores the data until we have enough to write to flash.
-	uint8_t data_bufferB[DATA_BUFFER_SIZE];   // This stores the data until we have enough to write to flash.
-	uint8_t launchpadBuffer[DATA_BUFFER_SIZE * 25];
-	uint8_t measurement_length;
-	uint16_t buffer_index_curr;  //The current index in the buffer.
-	uint16_t ring_buff_size;
-	uint32_t flash_address;
-	int32_t acc_z_filtered;
-	flight_state_controller_thread_parameters *flight_state_controller_params;
-	Flash flash;
+	log_encoder encoder;									// Packs the records into the page that is being filled.
+	uint8_t full_page[DATA_BUFFER_SIZE];					// The last page the encoder finished.
+	uint8_t launchpadBuffer[LAUNCHPAD_BUFFER_PAGES][DATA_BUFFER_SIZE];	// Most recent pages while armed on the pad.
+	uint8_t launchpad_next;									// Ring slot the next page goes into.
+	uint8_t launchpad_count;								// Pages in the ring.
+	bool superblock_pending;								// The log still needs its superblock in front of the first page.
+	uint32_t page_sequence;									// Sequence number for the next page that leaves the controller.
+	uint32_t last_profile_us;								// Time of the last timings written to the log.
+	log_decimator imu_log;									// Brings the IMU samples down to the log rate of the phase.
+	log_decimator baro_log;									// Same for the pressure samples.
+	bool imu_log_due;										// The decimators have a value for the record being assembled.
+	bool baro_log_due;
+	log_phase log_phase;									// The phase whose log policy is in force.
 	UART uart;
 	configuration_data_t *config_data;
 	TaskHandle_t *timer_thread_handle;
-	data_measurement measurement;
-	BufferSelection_t buffer_selection;
+	log_record record;										// The measurement that is currently being assembled.
 	imu_sensor_data imu_reading;
 	pressure_sensor_data bmp_reading;
-	float total_filtered_altitude;
-	uint8_t alt_filter_count;
+	sample_ring_reader imu_reader;		// Position in the IMU samples. Its overruns count the samples the log missed.
+	sample_ring_reader pressure_reader;
+	uint8_t pressure_samples_per_pass;	// Pressure samples taken per IMU sample, enough to keep up with the barometer.
+	altitude_estimator estimator;	//Altitude, velocity and acceleration from the IMU and the barometer together.
 	float altitude;
 	float last_altitude;
-	uint8_t alt_count;
-	uint8_t alt_main_count;
-	uint16_t apogee_holdout_count;
-	uint8_t landed_counter;
-	uint32_t start_time;
-} necessary_parameters;
-
-typedef enum
-{
-	CONTROLLER_STATE_LAUNCHPAD 				= 1,
-	CONTROLLER_STATE_LAUNCHPAD_ARMED,
-	CONTROLLER_STATE_IN_FLIGHT_PRE_APOGEE,
-	CONTROLLER_STATE_IN_FLIGHT_POST_APOGEE,
-	CONTROLLER_STATE_IN_FLIGHT_POST_MAIN,
-	CONTROLLER_STATE_LANDED,
-	CONTROLLER_STATE_EXIT,
-	CONTROLLER_NUM_STATES
-} StateType;
+	uint32_t launch_time_us;
+	uint32_t below_main_since_us;
+	uint32_t still_since_us;
+	bool below_main;
+	bool still;
+	StateType state;
+} flight_state_controller_context;
 
 typedef struct
 {
 	StateType state;
-	void (*function)(necessary_parameters);
+	void (*function)(flight_state_controller_context *);
+	log_phase log_phase;		// Whose log policy, from the configuration, applies in the state.
 } state_machine_type;
 
-void sm_STATE_LAUNCHPAD(necessary_parameters);
-void sm_STATE_LAUNCHPAD_ARMED(necessary_parameters);
-void sm_STATE_IN_FLIGHT_PRE_APOGEE(necessary_parameters);
-void sm_STATE_IN_FLIGHT_POST_APOGEE(necessary_parameters);
-void sm_STATE_IN_FLIGHT_POST_MAIN(necessary_parameters);
-void sm_STATE_LANDED(necessary_parameters);
-void sm_STATE_EXIT(necessary_parameters);
+static void sm_STATE_LAUNCHPAD(flight_state_controller_context *context);
+static void sm_STATE_LAUNCHPAD_ARMED(flight_state_controller_context *context);
+static void sm_STATE_IN_FLIGHT_PRE_APOGEE(flight_state_controller_context *context);
+static void sm_STATE_IN_FLIGHT_POST_APOGEE(flight_state_controller_context *context);
+static void sm_STATE_IN_FLIGHT_POST_MAIN(flight_state_controller_context *context);
+static void sm_STATE_LANDED(flight_state_controller_context *context);
+static void sm_STATE_EXIT(flight_state_controller_context *context);
 
-state_machine_type state_machine[] =
+static const state_machine_type state_machine[] =
 {
-	{CONTROLLER_STATE_LAUNCHPAD,				sm_STATE_LAUNCHPAD				},
-	{CONTROLLER_STATE_LAUNCHPAD_ARMED,			sm_STATE_LAUNCHPAD_ARMED		},
-	{CONTROLLER_STATE_IN_FLIGHT_PRE_APOGEE,		sm_STATE_IN_FLIGHT_PRE_APOGEE	},
-	{CONTROLLER_STATE_IN_FLIGHT_POST_APOGEE,	sm_STATE_IN_FLIGHT_POST_APOGEE	},
-	{CONTROLLER_STATE_IN_FLIGHT_POST_MAIN,		sm_STATE_IN_FLIGHT_POST_MAIN	},
-	{CONTROLLER_STATE_LANDED,					sm_STATE_LANDED					},
-	{CONTROLLER_STATE_EXIT,						sm_STATE_EXIT					}
+	{CONTROLLER_STATE_LAUNCHPAD,				sm_STATE_LAUNCHPAD,				LOG_PHASE_PAD		},
+	{CONTROLLER_STATE_LAUNCHPAD_ARMED,			sm_STATE_LAUNCHPAD_ARMED,		LOG_PHASE_PAD		},
+	{CONTROLLER_STATE_IN_FLIGHT_PRE_APOGEE,		sm_STATE_IN_FLIGHT_PRE_APOGEE,	LOG_PHASE_ASCENT	},
+	{CONTROLLER_STATE_IN_FLIGHT_POST_APOGEE,	sm_STATE_IN_FLIGHT_POST_APOGEE,	LOG_PHASE_DROGUE	},
+	{CONTROLLER_STATE_IN_FLIGHT_POST_MAIN,		sm_STATE_IN_FLIGHT_POST_MAIN,	LOG_PHASE_MAIN		},
+	{CONTROLLER_STATE_LANDED,					sm_STATE_LANDED,				LOG_PHASE_LANDED	},
+	{CONTROLLER_STATE_EXIT,						sm_STATE_EXIT,					LOG_PHASE_LANDED	}
 };
 
-StateType sm_state = CONTROLLER_STATE_LAUNCHPAD;
+// The context is far too large for the task stack (the launchpad buffer alone is 25 pages), so it is kept in .bss.
+static flight_state_controller_context s_context;
+
+static void fill_buffer_and_or_write_to_flash(flight_state_controller_context *context);
+static bool try_to_get_data_from_imu(flight_state_controller_context *context);
+static bool try_to_get_data_from_pressure_sensor(flight_state_controller_context *context);
+static void update_estimator(flight_state_controller_context *context, bool new_pressure_reading);
+static void set_log_policy(flight_state_controller_context *context, log_phase phase);
+static void update_log_policy(flight_state_controller_context *context);
+static void store_full_page(flight_state_controller_context *context);
+static void assemble_record(flight_state_controller_context *context);
+static void log_profile(flight_state_controller_context *context);
+
 /**
  * @brief Call this function to run the state machine
  */
-void state_machine_tick(necessary_parameters parameters)
+static void state_machine_tick(flight_state_controller_context *context)
 {
 	// Check to make sure that the state is being entered is valid
-	if(sm_state < CONTROLLER_NUM_STATES)
+	if(context->state < CONTROLLER_NUM_STATES)
 	{
 		// Call the function for the state
-		(*state_machine[sm_state].function)(parameters);
+		(*state_machine[context->state].function)(context);
 	}else
 	{
 		// Throw an exception
 	}
 }
 
-void sm_STATE_LAUNCHPAD(necessary_parameters parameters)
+/**
+ * @brief Sets an event bit in the measurement that is currently being assembled.
+ * The event macros are bits 12 to 19 of the old packet header, the record keeps them as one byte.
+ */
+static void add_event_to_measurement(flight_state_controller_context *context, uint32_t event)
+{
+	context->record.events |= (uint8_t) (event >> 12);
+}
+
+/**
+ * @brief Sends a page to the flash when recording, to the UART otherwise.
+ */
+static void output_page(flight_state_controller_context *context, uint8_t *page, uint32_t timeout)
+{
+	if(IS_RECORDING(context->config_data->values.flags))
+	{
+		flash_writer_submit_page(page, timeout);
+	}else
+	{
+		uart_transmit_bytes(context->uart, page, DATA_BUFFER_SIZE);
+	}
+}
+
+/**
+ * @brief Seals a finished data page with the next sequence number and sends it, after the superblock if the log
+ * does not have one yet.
+ */
+static void send_page(flight_state_controller_context *context, uint8_t *page, uint32_t timeout)
+{
+	if(context->superblock_pending)
+	{
+		uint8_t superblock[DATA_BUFFER_SIZE];
+		log_encoder_superblock(context->config_data, superblock);
+		output_page(context, superblock, timeout);
+		context->superblock_pending = false;
+	}
+
+	uint32_t start = profiler_start();
+	log_encoder_seal(page, context->page_sequence++);
+	output_page(context, page, timeout);
+	profiler_end(PROFILER_SPAN_PAGE_HAND_OFF, start);
+}
+
+/**
+ * @brief Saves the configuration together with the writer's current address, so flash_scan can start there after a reset.
+ */
+static void save_config(flight_state_controller_context *context)
+{
+	flash_writer_statistics statistics;
+	flash_writer_get_statistics(&statistics);
+	context->config_data->values.end_data_address = statistics.next_address;
+	write_config(context->config_data);
+}
+
+static void sm_STATE_LAUNCHPAD(flight_state_controller_context *context)
 {
 	/**
 	 * @todo fill in this method
 	 */
-	 sm_state = CONTROLLER_STATE_LAUNCHPAD_ARMED;
+	context->state = CONTROLLER_STATE_LAUNCHPAD_ARMED;
 }
-void sm_STATE_LAUNCHPAD_ARMED(necessary_parameters parameters)
+static void sm_STATE_LAUNCHPAD_ARMED(flight_state_controller_context *context)
 {
-	if(parameters.imu_reading.acc_x < 10892)
+	if(context->imu_reading.acc_x < 10892)
 		return;
 
 	buzz(250);
-	vTaskResume(*parameters.timer_thread_handle); //start fixed timers.
-	parameters.config_data->values.flags = parameters.config_data->values.flags | 0x04;
+	context->launch_time_us = context->imu_reading.time_us;
+	vTaskResume(*context->timer_thread_handle); //start fixed timers.
+	context->config_data->values.flags = context->config_data->values.flags | 0x04;
 	//Record the launch event.
-	uint32_t header =
-		(parameters.measurement.data[0] << 16) + (parameters.measurement.data[1] << 8) + parameters.measurement.data[2];
-	header |= LAUNCH_DETECT;
-	parameters.config_data->values.flags = parameters.config_data->values.flags | 0x01;
-	write_config(parameters.config_data);
-	write_24(header, &parameters.measurement.data[0]);
-
+	add_event_to_measurement(context, LAUNCH_DETECT);
+	context->config_data->values.flags = context->config_data->values.flags | 0x01;
+	save_config(context);
 
-	uint16_t buff_end = (parameters.ring_buff_size);
-	for(uint8_t j = 0; j < 25; j++)
+	// Dump the launchpad ring, oldest page first. The page being filled stays in the encoder and follows later.
+	uint8_t slot = (context->launchpad_next + LAUNCHPAD_BUFFER_PAGES - context->launchpad_count) % LAUNCHPAD_BUFFER_PAGES;
+	for(uint8_t j = 0; j < context->launchpad_count; j++)
 	{
-		//need to copy last portion into the bufferA. Make sure to start from right place, which wont be the next spot.
-
-		if((parameters.buffer_index_curr + 256) < buff_end)
-		{
-			FlashStatus stat_f2 = flash_program_page(parameters.flash, parameters.flash_address,
-                                                     &parameters.launchpadBuffer[parameters.buffer_index_curr],
-                                                     DATA_BUFFER_SIZE);
-			while(FLASH_IS_DEVICE_BUSY(stat_f2))
-			{
-				stat_f2 = flash_get_status_register(parameters.flash);
-				vTaskDelay(1);
-			}
-			parameters.buffer_index_curr += 256;
-		}else
-		{
-
-			uint8_t buff_temp[256];
-			memcpy(&buff_temp, &parameters.launchpadBuffer[parameters.buffer_index_curr],
-				   buff_end - parameters.buffer_index_curr);
-			memcpy(&buff_temp[buff_end - parameters.buffer_index_curr], &parameters.launchpadBuffer,
-				   DATA_BUFFER_SIZE - (buff_end - parameters.buffer_index_curr));
-
-			FlashStatus stat_f2 = flash_program_page(parameters.flash, parameters.flash_address, buff_temp,
-                                                     DATA_BUFFER_SIZE);
-			while(FLASH_IS_DEVICE_BUSY(stat_f2))
-			{
-				stat_f2 = flash_get_status_register(parameters.flash);
-				vTaskDelay(1);
-			}
-			parameters.buffer_index_curr = DATA_BUFFER_SIZE - (buff_end - parameters.buffer_index_curr);
-		}
-
-		parameters.flash_address += DATA_BUFFER_SIZE;
+		send_page(context, context->launchpadBuffer[slot], LAUNCHPAD_DUMP_TIMEOUT);
+		slot = (slot + 1) % LAUNCHPAD_BUFFER_PAGES;
 	}
-	parameters.buffer_index_curr = 0;
-
+	context->launchpad_count = 0;
 
-	parameters.config_data->values.state = STATE_IN_FLIGHT_PRE_APOGEE;
-	sm_state = CONTROLLER_STATE_IN_FLIGHT_PRE_APOGEE;
+	context->config_data->values.state = STATE_IN_FLIGHT_PRE_APOGEE;
+	context->state = CONTROLLER_STATE_IN_FLIGHT_PRE_APOGEE;
 }
-void sm_STATE_IN_FLIGHT_PRE_APOGEE(necessary_parameters parameters)
+static void sm_STATE_IN_FLIGHT_PRE_APOGEE(flight_state_controller_context *context)
 {
-	parameters.apogee_holdout_count++;
-	if(parameters.apogee_holdout_count > (20 * 15))
+	if(context->imu_reading.time_us - context->launch_time_us > APOGEE_HOLDOUT_US)
 	{
-
-		uint64_t acc_mag = pow(parameters.imu_reading.acc_x, 2) + pow(parameters.imu_reading.acc_y, 2) + pow(parameters.imu_reading.acc_z, 2);
-		uint32_t header;
-		if(acc_mag < 1 && parameters.total_filtered_altitude > 9000.0)
+		float altitude = altitude_estimator_get(&context->estimator, ALTITUDE_ESTIMATOR_ALTITUDE);
+		float velocity = altitude_estimator_get(&context->estimator, ALTITUDE_ESTIMATOR_VELOCITY);
+		if(velocity < 0.0f && altitude > 9000.0)
 		{
-			//5565132 = 3 * 1362^2 (aprox 0.5 g on all direction)
-			//2438m -> 8,000 ft
+			//Apogee: the estimated vertical velocity has turned negative.
 			buzz(250);
 			RecoverySelect event = DROGUE;
 			recovery_enable_mosfet(event);
 			recovery_activate_mosfet(event);
 			RecoveryContinuityStatus cont = recovery_check_continuity(event);
-			header = (parameters.measurement.data[0] << 16) + (parameters.measurement.data[1] << 8) + parameters.measurement.data[2];
-			header |= DROGUE_DETECT;
-			parameters.measurement.data[0] = (header >> 16) & 0xFF;
-			parameters.measurement.data[1] = (header >> 8) & 0xFF;
-			parameters.measurement.data[2] = (header) & 0xFF;
+			add_event_to_measurement(context, DROGUE_DETECT);
 
 			if(cont == OPEN_CIRCUIT)
 			{
-				parameters.config_data->values.flags = parameters.config_data->values.flags | 0x08;
-				write_config(parameters.config_data);
-				header = (parameters.measurement.data[0] << 16) + (parameters.measurement.data[1] << 8) + parameters.measurement.data[2];
-				header |= DROGUE_DEPLOY;
-				parameters.measurement.data[0] = (header >> 16) & 0xFF;
-				parameters.measurement.data[1] = (header >> 8) & 0xFF;
-				parameters.measurement.data[2] = (header) & 0xFF;
-				parameters.config_data->values.state = STATE_IN_FLIGHT_POST_APOGEE;
-				sm_state = CONTROLLER_STATE_IN_FLIGHT_POST_APOGEE;
+				context->config_data->values.flags = context->config_data->values.flags | 0x08;
+				save_config(context);
+				add_event_to_measurement(context, DROGUE_DEPLOY);
+				context->config_data->values.state = STATE_IN_FLIGHT_POST_APOGEE;
+				context->state = CONTROLLER_STATE_IN_FLIGHT_POST_APOGEE;
 			}
 		}
 	}
 }
-void sm_STATE_IN_FLIGHT_POST_APOGEE(necessary_parameters parameters)
+static void sm_STATE_IN_FLIGHT_POST_APOGEE(flight_state_controller_context *context)
 {
-	if(parameters.total_filtered_altitude < 375.0)
+	uint32_t now_us = context->imu_reading.time_us;
+
+	if(altitude_estimator_get(&context->estimator, ALTITUDE_ESTIMATOR_ALTITUDE) < 375.0)
 	{
 		//375m ==  1230 ft
-		parameters.alt_main_count++;
+		if(!context->below_main)
+		{
+			context->below_main = true;
+			context->below_main_since_us = now_us;
+		}
 	}else
 	{
-		parameters.alt_main_count = 0;
+		context->below_main = false;
 	}
-	if(parameters.alt_main_count > 5)
+	if(context->below_main && now_us - context->below_main_since_us >= MAIN_ALTITUDE_HOLD_US)
 	{
-		uint32_t header;
 		//deploy main
 		buzz(250);
 		RecoverySelect event = MAIN;
 		recovery_enable_mosfet(event);
 		recovery_activate_mosfet(event);
 		RecoveryContinuityStatus cont = recovery_check_continuity(event);
-		header = (parameters.measurement.data[0] << 16) + (parameters.measurement.data[1] << 8) +
-						  parameters.measurement.data[2];
-		header |= MAIN_DETECT;
-
-		parameters.measurement.data[0] = (header >> 16) & 0xFF;
-		parameters.measurement.data[1] = (header >> 8) & 0xFF;
-		parameters.measurement.data[2] = (header) & 0xFF;
+		add_event_to_measurement(context, MAIN_DETECT);
 
 		if(cont == OPEN_CIRCUIT)
 		{
-			parameters.config_data->values.flags = parameters.config_data->values.flags | 0x10;
-			write_config(parameters.config_data);
-			header = (parameters.measurement.data[0] << 16) + (parameters.measurement.data[1] << 8) +
-							  parameters.measurement.data[2];
-			header |= MAIN_DEPLOY;
-			parameters.measurement.data[0] = (header >> 16) & 0xFF;
-			parameters.measurement.data[1] = (header >> 8) & 0xFF;
-			parameters.measurement.data[2] = (header) & 0xFF;
-
-			parameters.config_data->values.state = STATE_IN_FLIGHT_POST_MAIN;
-			sm_state = CONTROLLER_STATE_IN_FLIGHT_POST_MAIN;
+			context->config_data->values.flags = context->config_data->values.flags | 0x10;
+			save_config(context);
+			add_event_to_measurement(context, MAIN_DEPLOY);
+
+			context->config_data->values.state = STATE_IN_FLIGHT_POST_MAIN;
+			context->state = CONTROLLER_STATE_IN_FLIGHT_POST_MAIN;
 		}
 		else
 		{
@@ -270,46 +302,33 @@ void sm_STATE_IN_FLIGHT_POST_APOGEE(necessary_parameters parameters)
 		}
 	}
 }
-void sm_STATE_IN_FLIGHT_POST_MAIN(necessary_parameters parameters)
+static void sm_STATE_IN_FLIGHT_POST_MAIN(flight_state_controller_context *context)
 {
-	if(parameters.alt_count > 0)
-	{
-		//If altitude is within a 1m range for 20 samples
-		if(parameters.altitude > (parameters.last_altitude - 1.0) &&
-		   parameters.altitude < (parameters.last_altitude + 1.0))
-		{
-			parameters.alt_count++;
-			if(parameters.alt_count > 245)
-			{
-				parameters.alt_count = 201;
-			}
-		}else
-		{
-			parameters.alt_count = 0;
-		}
+	uint32_t now_us = context->imu_reading.time_us;
 
-	}else
+	//Time how long the altitude stays within 1m of where it was, and start over when it leaves that range.
+	if(!context->still ||
+	   context->altitude <= (context->last_altitude - 1.0) ||
+	   context->altitude >= (context->last_altitude + 1.0))
 	{
-		parameters.last_altitude = parameters.altitude;
-		parameters.alt_count++;
-		if(parameters.alt_count > 245)
-		{
-			parameters.alt_count = 201;
-		}
+		context->last_altitude = context->altitude;
+		context->still_since_us = now_us;
+		context->still = true;
 	}
 
-	if((pow(parameters.imu_reading.gyro_x, 2) +
-        pow(parameters.imu_reading.gyro_y, 2) +
-        pow(parameters.imu_reading.gyro_z, 2)) < 63075)
+	int32_t gyro_x = context->imu_reading.gyro_x;
+	int32_t gyro_y = context->imu_reading.gyro_y;
+	int32_t gyro_z = context->imu_reading.gyro_z;
+	if(((gyro_x * gyro_x) + (gyro_y * gyro_y) + (gyro_z * gyro_z)) < 63075)
 	{
 		//If the gyro readings are all less than ~4.4 deg/sec and the altitude is not changing then the rocket has probably landed.
-		if(parameters.alt_count > 200){
-			parameters.config_data->values.state = STATE_LANDED;
-			sm_state = CONTROLLER_STATE_LANDED;
+		if(now_us - context->still_since_us >= LANDED_STILL_US){
+			context->config_data->values.state = STATE_LANDED;
+			context->state = CONTROLLER_STATE_LANDED;
 		}
 		else
 		{
-			// TODO: What if cont parameters.alt_count <= 200? then what should we do here?
+			// TODO: What if the altitude has not been still for long enough? then what should we do here?
 		}
 	}
 	else
@@ -317,24 +336,18 @@ void sm_STATE_IN_FLIGHT_POST_MAIN(necessary_parameters parameters)
 		// TODO: what to do if we are here?
 	}
 }
-void sm_STATE_LANDED(necessary_parameters parameters)
+static void sm_STATE_LANDED(flight_state_controller_context *context)
 {
-	parameters.config_data->values.flags = parameters.config_data->values.flags & ~(0x01);
-	write_config(parameters.config_data);
-	uint32_t header = (parameters.measurement.data[0] << 16) + (parameters.measurement.data[1] << 8) +
-					  parameters.measurement.data[2];
-	header |= LAND_DETECT;
-
-	parameters.measurement.data[0] = (header >> 16) & 0xFF;
-	parameters.measurement.data[1] = (header >> 8) & 0xFF;
-	parameters.measurement.data[2] = (header) & 0xFF;
+	context->config_data->values.flags = context->config_data->values.flags & ~(0x01);
+	save_config(context);
+	add_event_to_measurement(context, LAND_DETECT);
 
-	sm_state = CONTROLLER_STATE_EXIT;
+	context->state = CONTROLLER_STATE_EXIT;
 }
-void sm_STATE_EXIT(necessary_parameters parameters)
+static void sm_STATE_EXIT(flight_state_controller_context *context)
 {
 	// Put everything into low power mode.
-	parameters.running = 0;
+	context->running = 0;
 }
 
 
@@ -356,278 +369,301 @@ void check_recovery_circuit(configuration_data_t *params)
 	write_config(params);
 }
 
-void fill_buffer_and_or_write_to_flash(necessary_parameters parameters);
-bool try_to_get_data_from_imu(necessary_parameters parameters);
-bool try_to_get_data_from_pressure_sensor(necessary_parameters parameters);
-
 void thread_flight_state_controller_start(void const *params)
 {
-	necessary_parameters parameters =
-	{
-		.flight_state_controller_params	= (flight_state_controller_thread_parameters *) params,
-		.flash							= parameters.flight_state_controller_params->flash_ptr,
-		.uart							= parameters.flight_state_controller_params->uart,
-		.config_data					= parameters.flight_state_controller_params->configuration_data,
-		.timer_thread_handle			= parameters.flight_state_controller_params->timer_thread_handle,
-		.flash_address					= FLASH_START_ADDRESS,
-		.measurement_length				= 0,
-		.buffer_index_curr				= 0,
-		.ring_buff_size					= DATA_BUFFER_SIZE * 25,
-		.buffer_selection				= BUFFER_A,
-		.total_filtered_altitude		= 0,
-		.alt_filter_count				= 0,
-		.last_altitude					= 0,
-		.alt_count						= 0,
-		.alt_main_count					= 0,
-		.apogee_holdout_count			= 0,
-		.landed_counter					= 0,
-		.running						= 1
-	};
-
-	uint8_t running = 1;
-
-	if(IS_IN_FLIGHT(parameters.config_data->values.flags)){
-		parameters.flash_address = parameters.config_data->values.end_data_address;
-	}
-	
-	//Make sure the measurement starts empty.
-	clear_buffer(parameters.measurement.data, sizeof(data_measurement));
-
-	if(!IS_IN_FLIGHT(parameters.config_data->values.flags)){
-		check_recovery_circuit(parameters.config_data);
+	flight_state_controller_thread_parameters *thread_params = (flight_state_controller_thread_parameters *) params;
+	flight_state_controller_context *context = &s_context;
+
+	memset(context, 0, sizeof(flight_state_controller_context));
+	context->uart				= thread_params->uart;
+	context->config_data		= thread_params->configuration_data;
+	context->timer_thread_handle	= thread_params->timer_thread_handle;
+	context->state				= CONTROLLER_STATE_LAUNCHPAD;
+	context->running			= 1;
+
+	//After a reset in flight the log on the flash already has its superblock, and the pages carry on numbering after
+	//the ones that are there.
+	context->superblock_pending	= !IS_IN_FLIGHT(context->config_data->values.flags);
+	context->page_sequence		= context->superblock_pending
+								  ? 1 : (context->config_data->values.end_data_address - FLASH_START_ADDRESS) / DATA_BUFFER_SIZE;
+	set_log_policy(context, state_machine[context->state].log_phase);
+	uint32_t imu_hz = imu_sensor_rate_hz(context->config_data);
+	context->pressure_samples_per_pass = (uint8_t) ((pressure_sensor_rate_hz(context->config_data) + imu_hz - 1) / imu_hz);
+	imu_reader_init(&context->imu_reader);
+	pressure_sensor_reader_init(&context->pressure_reader);
+
+	if(!IS_IN_FLIGHT(context->config_data->values.flags)){
+		check_recovery_circuit(context->config_data);
 	}
 
 	buzz(250); // CHANGE TO 2 SECONDS!!!!!!!
-	parameters.start_time = xTaskGetTickCount();
 	while(1)
 	{
-		if(!try_to_get_data_from_imu(parameters))
+		if(!try_to_get_data_from_imu(context))
 			continue;
 
-		if(!try_to_get_data_from_pressure_sensor(parameters))
-			continue;
+		// A measurement without pressure data is still a valid (short) record.
+		bool new_pressure_reading = try_to_get_data_from_pressure_sensor(context);
+		uint32_t start = profiler_start();
+		update_estimator(context, new_pressure_reading);
+		profiler_end(PROFILER_SPAN_ESTIMATOR, start);
+
+		start = profiler_start();
+		state_machine_tick(context);
+		profiler_end(PROFILER_SPAN_STATE_MACHINE_TICK, start);
 
-		state_machine_tick(parameters);
-		fill_buffer_and_or_write_to_flash(parameters);
+		update_log_policy(context);
+		assemble_record(context);
+		log_profile(context);
+		fill_buffer_and_or_write_to_flash(context);
 
-		clear_buffer(parameters.measurement.data, sizeof(data_measurement));
-		parameters.measurement_length = 0;
+		memset(&context->record, 0, sizeof(log_record));
 
-		if(!running){
+		if(!context->running){
+			//Nothing more is logged, so the last page goes out as it is.
+			if(log_encoder_flush(&context->encoder, context->full_page))
+			{
+				store_full_page(context);
+			}
 			vTaskSuspend(NULL);
 		}
 	};
 
 }
 
-bool try_to_get_data_from_imu(necessary_parameters parameters)
+static bool try_to_get_data_from_imu(flight_state_controller_context *context)
 {
-	//Try and get data from the IMU queue. Block for up to a quarter of the time between the fastest measurement.
-	if(imu_read(&parameters.imu_reading, parameters.config_data->values.data_rate / 4))
+	//Try and get the next IMU sample.
+	if(imu_read(&context->imu_reader, &context->imu_reading, IMU_READ_TIMEOUT))
 	{
-		//Check if the current measurement has data.
-		if(!is_buffer_empty(parameters.measurement.data, sizeof(data_measurement)))
-		{
-			uint16_t timestamp = parameters.imu_reading.time_ticks - parameters.start_time;
-			imu_sensor_data_to_bytes(parameters.imu_reading, &parameters.measurement.data[0], timestamp);
-			parameters.measurement_length = ACC_LENGTH + GYRO_LENGTH;
-			parameters.start_time = parameters.imu_reading.time_ticks;
-		}
+		//Every measurement starts with an IMU reading, and takes its time stamp.
+		const imu_sensor_data *imu = &context->imu_reading;
+		int32_t sample[LOG_DECIMATOR_MAX_VALUES] = {imu->acc_x, imu->acc_y, imu->acc_z, imu->gyro_x, imu->gyro_y, imu->gyro_z};
+
+		context->record.time_us = imu->time_us;
+		context->imu_log_due = log_decimator_add(&context->imu_log, imu->time_us, sample);
 
 		return true;
 	}else
 	{
-		clear_buffer(parameters.measurement.data, sizeof(data_measurement));
+		memset(&context->record, 0, sizeof(log_record));
 		return false;
 	}
 }
 
-bool try_to_get_data_from_pressure_sensor(necessary_parameters parameters)
+static bool try_to_get_data_from_pressure_sensor(flight_state_controller_context *context)
 {
-	//Try and get data from the BMP queue. Block for up to a quarter of the time between the fastest measurement.
-	if(pressure_sensor_read(&parameters.bmp_reading, parameters.config_data->values.data_rate / 4))
+	bool new_reading = false;
+
+	//Take the next pressure samples without waiting: the IMU sets the pace, and the barometer runs at its own rate.
+	//Its samples come in bursts, so only as many are taken as keep up with it on average. Each gets its own pass and
+	//its own record, instead of a burst being averaged into one.
+	for(uint8_t n = 0; n < context->pressure_samples_per_pass &&
+		pressure_sensor_read(&context->pressure_reader, &context->bmp_reading, 0); n++)
 	{
-		if(is_buffer_empty(parameters.measurement.data, sizeof(data_measurement)))
+		const pressure_sensor_data *bmp = &context->bmp_reading;
+		int32_t sample[3] = {(int32_t) (uint32_t) bmp->pressure, (int32_t) bmp->temperature, (int32_t) lroundf(bmp->altitude * 100.0f)};
+
+		if(log_decimator_add(&context->baro_log, bmp->time_us, sample))
 		{
-			// TODO: this does not make sense, how can we have imu
-			//       readings and entering here if Measurement is Empty
-			//We already have a imu reading.
-			//Update the header bytes.
-			pressure_sensor_data_to_bytes(parameters.bmp_reading, &parameters.measurement.data[0]);
-			
-			float approx_altitude = pressure_sensor_calculate_altitude(&parameters.bmp_reading);
-			parameters.total_filtered_altitude += (approx_altitude - parameters.total_filtered_altitude) * 0.2;
-			parameters.measurement_length += (PRES_LENGTH + TEMP_LENGTH + ALT_LENGTH);
-			// TODO: why we are not updating start_time here like in the IMU clause?
+			context->baro_log_due = true;
 		}
 
-		return true;
-	}
-	else
-	{
-		clear_buffer(parameters.measurement.data, sizeof(data_measurement));
-		return false;
+		context->altitude = bmp->altitude;
+		new_reading = true;
 	}
+
+	return new_reading;
 }
 
 
-void fill_buffer_and_or_write_to_flash(necessary_parameters parameters)
+/**
+ * @brief Acceleration along the rocket's axis (+X on the board) in m/s^2, gravity removed.
+ * Assumes the rocket flies close to vertical.
+ */
+static float get_vertical_acceleration(flight_state_controller_context *context)
 {
-	if(is_buffer_empty(parameters.measurement.data, sizeof(data_measurement)) &&
-	   parameters.config_data->values.state == STATE_LAUNCHPAD_ARMED &&
-	   ((parameters.buffer_index_curr + parameters.measurement_length + HEADER_SIZE) <= parameters.ring_buff_size))
-	{
-		//check if room in launchpad buffer.
-
-		memcpy(&parameters.launchpadBuffer[parameters.buffer_index_curr], &(parameters.measurement.data),
-			   parameters.measurement_length + HEADER_SIZE);
-
-		parameters.buffer_index_curr += (parameters.measurement_length + HEADER_SIZE);
-		parameters.buffer_index_curr = parameters.buffer_index_curr % (parameters.ring_buff_size);
-
-		//Reset the parameters.measurement.
-		clear_buffer(parameters.measurement.data, sizeof(data_measurement));
+	//The BMI088 ranges are 3 g << ac_range, over the full int16_t scale.
+	float g_per_lsb = (3 << context->config_data->values.ac_range) / 32768.0f;
+	return (context->imu_reading.acc_x * g_per_lsb - 1.0f) * GRAVITY;
+}
 
-	}else if(((parameters.buffer_index_curr + parameters.measurement_length + HEADER_SIZE) < DATA_BUFFER_SIZE) &&
-			 (is_buffer_empty(parameters.measurement.data, sizeof(data_measurement))))
+/**
+ * @brief Runs the estimator up to the IMU sample just read, then corrects it with that sample and any new altitude.
+ * The filter starts with the first pressure reading.
+ */
+static void update_estimator(flight_state_controller_context *context, bool new_pressure_reading)
+{
+	if(!context->estimator.initialized)
 	{
-
-		//There is room in the current buffer for the full parameters.measurement.
-
-		if(parameters.buffer_selection == BUFFER_A)
-		{
-			memcpy(&parameters.data_bufferA[parameters.buffer_index_curr], &(parameters.measurement.data),
-				   parameters.measurement_length + HEADER_SIZE);
-			//uart_transmit_bytes(uart,&data_bufferA[buffer_index_curr],parameters.measurement_length+2);
-		}else if(parameters.buffer_selection == BUFFER_B)
+		if(new_pressure_reading)
 		{
-
-			memcpy(&parameters.data_bufferB[parameters.buffer_index_curr], &(parameters.measurement.data),
-				   parameters.measurement_length + HEADER_SIZE);
-			//uart_transmit_bytes(uart,&data_bufferB[buffer_index_curr],parameters.measurement_length+2);
+			altitude_estimator_init(&context->estimator, context->altitude, context->imu_reading.time_us);
 		}
+		return;
+	}
 
-		parameters.buffer_index_curr += (parameters.measurement_length + HEADER_SIZE);
+	altitude_estimator_predict(&context->estimator, context->imu_reading.time_us);
+	altitude_estimator_update_acceleration(&context->estimator, get_vertical_acceleration(context));
+	if(new_pressure_reading)
+	{
+		altitude_estimator_update_altitude(&context->estimator, context->altitude);
+	}
+}
 
-		//Reset the parameters.measurement.
-		clear_buffer(parameters.measurement.data, sizeof(data_measurement));
+/**
+ * @brief Puts the log policy of phase in force: the decimator rates, and the channels and precision of the encoder.
+ * The encoder finishes the page it was filling, so all three change between the same two records.
+ */
+static void set_log_policy(flight_state_controller_context *context, log_phase phase)
+{
+	const configuration_data_t *config = context->config_data;
+	bool average = !IS_LOG_DECIMATING(config->values.flags);
+	log_policy policy;
 
+	log_decimator_set_rate(&context->imu_log, 6, log_rate_imu(config, phase), average);
+	log_decimator_set_rate(&context->baro_log, 3, log_rate_baro(config, phase), average);
 
+	log_rate_policy(config, phase, &policy);
+	if(log_encoder_set_policy(&context->encoder, &policy, context->full_page))
+	{
+		store_full_page(context);
 	}
-	else if(is_buffer_empty(parameters.measurement.data, sizeof(data_measurement)))
+
+	context->log_phase = phase;
+}
+
+/**
+ * @brief Changes the log policy when the state machine has moved to a state of another phase. Runs right after the
+ * state machine, so the record of the transition, with its event, is the first one under the new policy.
+ */
+static void update_log_policy(flight_state_controller_context *context)
+{
+	log_phase phase = state_machine[context->state].log_phase;
+	if(phase != context->log_phase)
 	{
+		set_log_policy(context, phase);
+	}
+}
 
-		//Split measurement across the buffers, and write to flash.
-		uint8_t bytesInPrevBuffer = DATA_BUFFER_SIZE - parameters.buffer_index_curr;
-		uint8_t bytesLeft = (parameters.measurement_length + HEADER_SIZE) - bytesInPrevBuffer;
+/**
+ * @brief Fills the record with what the decimators have for the log at this sample. A record with an event is always
+ * logged, with the IMU values so far, so the event keeps the time it happened at.
+ */
+static void assemble_record(flight_state_controller_context *context)
+{
+	int32_t value[LOG_DECIMATOR_MAX_VALUES];
+	bool event = (context->record.events != 0);
 
-		//Put as much data as will fit into the almost full buffer.
-		switch(parameters.buffer_selection)
+	if((context->imu_log_due || event) && log_decimator_take(&context->imu_log, value))
+	{
+		context->record.types |= LOG_RECORD_IMU;
+		for(int i = 0; i < 3; i++)
 		{
-			case BUFFER_A:
-			{
-				memcpy(&parameters.data_bufferA[parameters.buffer_index_curr], &(parameters.measurement.data),bytesInPrevBuffer);
-				parameters.buffer_selection  = BUFFER_B;
-				parameters.buffer_index_curr = 0;
-
-				memcpy(&parameters.data_bufferA[parameters.buffer_index_curr],&(parameters.measurement.data[bytesInPrevBuffer]), bytesLeft);
-				parameters.buffer_index_curr = bytesLeft;
-				break;
-			}
-			case BUFFER_B:
-			{
-				memcpy(&parameters.data_bufferB[parameters.buffer_index_curr], &(parameters.measurement.data),bytesInPrevBuffer);
-				parameters.buffer_selection  = BUFFER_A;
-				parameters.buffer_index_curr = 0;
-
-				//Put the rest of the measurement in the next buffer.
-				memcpy(&parameters.data_bufferB[parameters.buffer_index_curr],&(parameters.measurement.data[bytesInPrevBuffer]), bytesLeft);
-				parameters.buffer_index_curr = bytesLeft;
-				break;
-			}
+			context->record.acc[i] = (int16_t) value[i];
+			context->record.gyro[i] = (int16_t) value[3 + i];
 		}
+	}else if(event)
+	{
+		//The IMU is not logged in this phase, but the event needs a record to go in.
+		context->record.types |= LOG_RECORD_IMU;
+		context->record.acc[0] = context->imu_reading.acc_x;
+		context->record.acc[1] = context->imu_reading.acc_y;
+		context->record.acc[2] = context->imu_reading.acc_z;
+		context->record.gyro[0] = context->imu_reading.gyro_x;
+		context->record.gyro[1] = context->imu_reading.gyro_y;
+		context->record.gyro[2] = context->imu_reading.gyro_z;
+	}
+
+	if(context->baro_log_due && log_decimator_take(&context->baro_log, value))
+	{
+		context->record.types |= LOG_RECORD_BARO;
+		context->record.pressure = (uint32_t) value[0];
+		context->record.temperature = value[1];
+		context->record.altitude_cm = value[2];
+	}
 
+	context->imu_log_due = false;
+	context->baro_log_due = false;
+}
 
-		// Put the rest of the measurement in the next buffer.
-		switch(parameters.buffer_selection)
+/**
+ * @brief Sends the page the encoder finished on to the launchpad ring or the output.
+ */
+static void store_full_page(flight_state_controller_context *context)
+{
+	if(context->config_data->values.state == STATE_LAUNCHPAD_ARMED)
+	{
+		//Keep the most recent pages in the launchpad ring, overwriting the oldest one.
+		memcpy(context->launchpadBuffer[context->launchpad_next], context->full_page, DATA_BUFFER_SIZE);
+		context->launchpad_next = (context->launchpad_next + 1) % LAUNCHPAD_BUFFER_PAGES;
+		if(context->launchpad_count < LAUNCHPAD_BUFFER_PAGES)
 		{
-			case BUFFER_A:
-			{
-				memcpy(&parameters.data_bufferA[parameters.buffer_index_curr],&(parameters.measurement.data[bytesInPrevBuffer]), bytesLeft);
-				parameters.buffer_index_curr = bytesLeft;
-				break;
-			}
-			case BUFFER_B:
-			{
-				memcpy(&parameters.data_bufferB[parameters.buffer_index_curr],&(parameters.measurement.data[bytesInPrevBuffer]), bytesLeft);
-				parameters.buffer_index_curr = bytesLeft;
-				break;
-			}
+			context->launchpad_count++;
 		}
+		return;
+	}
 
+	//Never wait here: a full queue costs one page, waiting would cost samples.
+	send_page(context, context->full_page, 0);
+}
 
-		//reset the measurement.
-		clear_buffer(parameters.measurement.data, sizeof(data_measurement));
-		parameters.measurement_length = 0;
+/**
+ * @brief Adds a record to the log, and stores the page it finished, if any.
+ */
+static void append_record(flight_state_controller_context *context, const log_record *record)
+{
+	if(log_encoder_append(&context->encoder, record, context->full_page))
+	{
+		store_full_page(context);
+	}
+}
 
+static void fill_buffer_and_or_write_to_flash(flight_state_controller_context *context)
+{
+	if(context->record.types == 0)
+	{
+		return;
+	}
 
-		//Flash write buffer not in use! then clear old buffer?
+	append_record(context, &context->record);
+}
 
-		if(parameters.buffer_selection == 0)
-		{
-			//We just switched to A so uart_transmit B.
-			if(IS_RECORDING(parameters.config_data->values.flags))
-			{
-				FlashStatus stat_f = flash_program_page(parameters.flash, parameters.flash_address,
-                                                        parameters.data_bufferB, DATA_BUFFER_SIZE);
-				while(FLASH_IS_DEVICE_BUSY(stat_f))
-				{
-					stat_f = flash_get_status_register(parameters.flash);
-					vTaskDelay(1);
-				}
-
-				parameters.flash_address += DATA_BUFFER_SIZE;
-				if(parameters.flash_address >= FLASH_SIZE_BYTES)
-				{
-					while(1)
-					{
-						;
-					}
-				}
-
-			}else
-			{
-				uart_transmit_bytes(parameters.uart, parameters.data_bufferB, 256);
-			}
-		}else if(parameters.buffer_selection == 1)
-		{
-			//We just switched to B so uart_transmit A
+/**
+ * @brief Every PROFILE_LOG_PERIOD_US, when IS_PROFILING, logs a profile record for each span and gauge. They take the
+ * time stamp of the measurement that follows them.
+ */
+static void log_profile(flight_state_controller_context *context)
+{
+	if(!IS_PROFILING(context->config_data->values.flags) || context->record.types == 0 ||
+	   context->record.time_us - context->last_profile_us < PROFILE_LOG_PERIOD_US)
+	{
+		return;
+	}
+	context->last_profile_us = context->record.time_us;
 
-			if(IS_RECORDING(parameters.config_data->values.flags))
-			{
-				FlashStatus stat_f2 = flash_program_page(parameters.flash, parameters.flash_address,
-                                                         parameters.data_bufferA, DATA_BUFFER_SIZE);
-				while(FLASH_IS_DEVICE_BUSY(stat_f2))
-				{
-					stat_f2 = flash_get_status_register(parameters.flash);
-					vTaskDelay(1);
-				}
-
-				parameters.flash_address += DATA_BUFFER_SIZE;
-
-				if(parameters.flash_address >= FLASH_SIZE_BYTES)
-				{
-					while(1)
-					{
-						;
-					}
-				}
-			}else
-			{
-				uart_transmit_bytes(parameters.uart, parameters.data_bufferA, 256);
-			}
-		}
+	log_record profile;
+	memset(&profile, 0, sizeof(log_record));
+	profile.time_us = context->record.time_us;
+	profile.types = LOG_RECORD_PROFILE;
 
+	for(uint8_t span = 0; span < PROFILER_NUM_SPANS; span++)
+	{
+		profiler_span_summary summary;
+		profiler_get_span(span, &summary);
+		profile.profile_id = LOG_PROFILE_SPAN + span;
+		profile.profile[0] = summary.count;
+		profile.profile[1] = summary.min;
+		profile.profile[2] = summary.mean;
+		profile.profile[3] = summary.p99;
+		profile.profile[4] = summary.max;
+		append_record(context, &profile);
+	}
 
+	for(uint8_t gauge = 0; gauge < PROFILER_NUM_GAUGES; gauge++)
+	{
+		profile.profile_id = LOG_PROFILE_GAUGE + gauge;
+		profile.profile[0] = profiler_get_gauge(gauge);
+		append_record(context, &profile);
 	}
 }
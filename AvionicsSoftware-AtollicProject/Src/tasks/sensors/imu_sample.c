@@ -0,0 +1,52 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for reading one BMI088 sample in two SPI bursts.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "tasks/sensors/imu_sample.h"
+#include "bmi08x_defs.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Little endian register pair to a signed reading.
+#define BMI08X_LE16(buffer, index)	((int16_t) ((uint16_t) (buffer)[(index)] | ((uint16_t) (buffer)[(index) + 1] << 8)))
+
+#define IMU_SAMPLE_TIMEOUT	10	//ms, as the driver's reads.
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool imu_sample_read(SPI accel, SPI gyro, imu_sensor_data *sample)
+{
+	uint8_t accel_reg = BMI08X_ACCEL_X_LSB_REG | BMI08X_SPI_RD_MASK;
+	uint8_t gyro_reg = BMI08X_GYRO_X_LSB_REG | BMI08X_SPI_RD_MASK;
+	uint8_t accel_data[1 + 6];
+	uint8_t gyro_data[6];
+	
+	if(spi_receive(accel, &accel_reg, 1, accel_data, sizeof(accel_data), IMU_SAMPLE_TIMEOUT) != HAL_OK ||
+	   spi_receive(gyro, &gyro_reg, 1, gyro_data, sizeof(gyro_data), IMU_SAMPLE_TIMEOUT) != HAL_OK)
+	{
+		return false;
+	}
+	
+	sample->acc_x = BMI08X_LE16(accel_data, 1);
+	sample->acc_y = BMI08X_LE16(accel_data, 3);
+	sample->acc_z = BMI08X_LE16(accel_data, 5);
+	sample->gyro_x = BMI08X_LE16(gyro_data, 0);
+	sample->gyro_y = BMI08X_LE16(gyro_data, 2);
+	sample->gyro_z = BMI08X_LE16(gyro_data, 4);
+	return true;
+}
@@ -19,29 +19,92 @@
 // INCLUDES
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 #include "tasks/sensors/imu_sensor.h"
+#include "tasks/sensors/imu_sample.h"
 #include "bmi088.h"
 #include "SPI.h"
 #include "bmi08x.h"
 #include "configuration.h"
 #include "hardware_definitions.h"
 #include "cmsis_os.h"
+#include "STM32.h"
 #include "utilities/common.h"
+#include "utilities/sample_ring.h"
+#include "utilities/profiler.h"
 
-#define INTERNAL_ERROR -127
-#define ACC_TYPE 			0x800000
-#define GYRO_TYPE			0x400000
+#if IMU_SENSOR_FIFO_MODE
+#define IMU_RING_LENGTH	(2 * IMU_FIFO_MAX_FRAMES)	// Room for a full burst while the slowest reader is still on the last one.
+#else
+#define IMU_RING_LENGTH	16
+#endif
 
 
 // Keep SPI connection and BMI sensor struct together
 typedef struct _bmi088_sensor_struct{
 	struct bmi08x_dev* bmi088_ptr;
-	SPI hspi_ptr;
+	SPI accel_spi;
+	SPI gyro_spi;
 }_bmi_sensor;
 
-static QueueHandle_t bmi088_queue;
+//The BMI088 is rated 10 MHz in SPI modes 0 and 3. From the 42 MHz APB1 this gives 5.25 MHz.
+static const spi_device_config s_accel_spi_config =
+{
+	.bus = SPI_BUS_3,
+	.cs_port = IMU_SPI_ACC_CS_PORT,
+	.cs_pin = IMU_SPI_ACC_CS_PIN,
+	.max_clock_hz = 10000000,
+	.mode = 0,
+};
+
+static const spi_device_config s_gyro_spi_config =
+{
+	.bus = SPI_BUS_3,
+	.cs_port = IMU_SPI_GYRO_CS_PORT,
+	.cs_pin = IMU_SPI_GYRO_CS_PIN,
+	.max_clock_hz = 10000000,
+	.mode = 0,
+};
+
 static _bmi_sensor* s_bmp3_sensor;
 
-static uint8_t __imu_init(_bmi_sensor* bmi_sensor_ptr);
+//Placed at link time: there is one IMU, and nothing is ever freed.
+static _bmi_sensor s_bmi_sensor;
+static struct bmi08x_dev s_bmi088_dev;
+
+//Every sample the task reads, for as many readers as want them.
+SAMPLE_RING_DEFINE(s_imu_ring, imu_sensor_data, IMU_RING_LENGTH);
+
+#if IMU_SENSOR_FIFO_MODE
+// Burst read buffers. One extra accel frame of room for the sensor time frame and the SPI dummy byte.
+static uint8_t s_accel_fifo_buffer[(IMU_FIFO_MAX_FRAMES + 1) * BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH];
+static uint8_t s_gyro_fifo_buffer[IMU_FIFO_MAX_FRAMES * BMI08X_GYRO_FIFO_FRAME_LENGTH];
+static struct bmi08x_sensor_data s_accel_frames[IMU_FIFO_MAX_FRAMES];
+static struct bmi08x_sensor_data s_gyro_frames[IMU_FIFO_MAX_FRAMES];
+
+#define NOMINAL_US_PER_SENSOR_TICK	(1000000.0f / BMI08X_ACCEL_SENSORTIME_HZ)
+
+//Maps the accelerometer's sensor time onto the stm32_get_time_us clock.
+typedef struct
+{
+	uint32_t anchor_us;				//MCU time of one known frame...
+	uint32_t anchor_sensor_time;	//...and its sensor time.
+	float us_per_tick;				//Measured length of a sensor time tick. The two clocks drift apart by up to a few %.
+	uint32_t last_sensor_time;		//Sensor time of the newest frame read so far.
+	bool anchor_valid;
+	bool last_valid;
+	bool drained;					//The last burst ended with a sensor time frame, so the FIFO was empty after it.
+} imu_time_base;
+
+static imu_time_base s_time_base = {.us_per_tick = NOMINAL_US_PER_SENSOR_TICK};
+#endif
+
+#if IMU_SENSOR_INTERRUPT_MODE
+static SemaphoreHandle_t s_data_ready;		//Given by the INT1 interrupt. The SPI driver owns the task notification.
+static StaticSemaphore_t s_data_ready_buffer;
+static volatile uint32_t s_irq_time_us;		//stm32_get_time_us() at the newest INT1 edge.
+static volatile uint32_t s_irq_count;		//INT1 edges the task has not looked at yet.
+#endif
+
+static bool __imu_init(_bmi_sensor* bmi_sensor_ptr);
 static bool __imu_config(configuration_data_t * parameters);
 
 
@@ -60,13 +123,11 @@ int8_t gyro_config(struct bmi08x_dev *bmi088dev, configuration_data_t * configPa
 
 bool imu_sensor_init(configuration_data_t * parameters){
 	
-	_bmi_sensor* bmi_sensor_ptr = pvPortMalloc(sizeof(_bmi_sensor));
-	if(bmi_sensor_ptr == NULL)
-	{
-		return false;
-	}
+	_bmi_sensor* bmi_sensor_ptr = &s_bmi_sensor;
 	
-	if(false == __imu_init(bmi_sensor_ptr)){
+	s_bmp3_sensor = bmi_sensor_ptr;
+	
+	if(!__imu_init(bmi_sensor_ptr)){
 		return false;
 	}
 	
@@ -75,6 +136,229 @@ bool imu_sensor_init(configuration_data_t * parameters){
 
 
 
+//Converts a BMI08X_ACCEL_ODR_* register value to Hz (12.5 Hz at 0x05, doubling with every step).
+static uint32_t accel_odr_hz(uint8_t odr)
+{
+	if(odr < BMI08X_ACCEL_ODR_12_5_HZ)
+	{
+		odr = BMI08X_ACCEL_ODR_12_5_HZ;
+	}
+	return (25u << (odr - BMI08X_ACCEL_ODR_12_5_HZ)) / 2;
+}
+
+#if IMU_SENSOR_FIFO_MODE
+//Sensor time ticks between two accelerometer frames: 2048 at 12.5 Hz, halving with every ODR step.
+static uint32_t accel_frame_ticks(uint8_t odr)
+{
+	if(odr < BMI08X_ACCEL_ODR_12_5_HZ)
+	{
+		odr = BMI08X_ACCEL_ODR_12_5_HZ;
+	}
+	return 2048u >> (odr - BMI08X_ACCEL_ODR_12_5_HZ);
+}
+
+//later - earlier on the 24 bit sensor time counter, sign extended.
+static int32_t sensor_time_diff(uint32_t later, uint32_t earlier)
+{
+	return ((int32_t) ((later - earlier) << 8)) >> 8;
+}
+
+static uint32_t sensor_time_to_us(uint32_t sensor_time)
+{
+	int32_t ticks = sensor_time_diff(sensor_time, s_time_base.anchor_sensor_time);
+	return s_time_base.anchor_us + (int32_t) (ticks * s_time_base.us_per_tick);
+}
+
+//The FIFO was empty after the last burst, so the frame that raised the watermark interrupt at irq_time_us is
+//IMU_FIFO_BATCH_FRAMES frames after the newest one read then. That pins a sensor time to an MCU time, and the
+//spacing between two such pins measures the sensor clock.
+static void update_time_anchor(uint32_t irq_time_us, uint32_t frame_ticks)
+{
+	uint32_t sensor_time = (s_time_base.last_sensor_time + IMU_FIFO_BATCH_FRAMES * frame_ticks) & BMI08X_ACCEL_SENSORTIME_MASK;
+	
+	if(s_time_base.anchor_valid)
+	{
+		int32_t ticks = sensor_time_diff(sensor_time, s_time_base.anchor_sensor_time);
+		if(ticks > 0)
+		{
+			float us_per_tick = (float) (int32_t) (irq_time_us - s_time_base.anchor_us) / ticks;
+			
+			//A late interrupt (masked by a critical section) shows up as an outlier. Smooth the rest.
+			if(us_per_tick > NOMINAL_US_PER_SENSOR_TICK * 0.95f && us_per_tick < NOMINAL_US_PER_SENSOR_TICK * 1.05f)
+			{
+				s_time_base.us_per_tick += (us_per_tick - s_time_base.us_per_tick) / 16;
+			}
+		}
+	}
+	
+	s_time_base.anchor_us = irq_time_us;
+	s_time_base.anchor_sensor_time = sensor_time;
+	s_time_base.anchor_valid = true;
+}
+
+//Empties both FIFOs in one burst each and queues one imu_sensor_data per accelerometer frame.
+//The gyroscope runs at its own rate, so each accelerometer frame is paired with the gyroscope frame at the same
+//relative position in the burst.
+//Frames are timestamped from the accelerometer's sensor time. irq_valid says irq_time_us is the time of the single
+//watermark interrupt that caused this read.
+static void read_fifo_batch(uint32_t frame_ticks, bool irq_valid, uint32_t irq_time_us)
+{
+	static struct bmi08x_sensor_data s_last_gyro;
+	struct bmi08x_dev *dev = s_bmp3_sensor->bmi088_ptr;
+	struct bmi08x_fifo_frame fifo;
+	uint16_t accel_bytes = 0;
+	uint8_t gyro_count = 0;
+	uint16_t num_accel = IMU_FIFO_MAX_FRAMES;
+	uint16_t num_gyro = IMU_FIFO_MAX_FRAMES;
+	uint32_t now_us = stm32_get_time_us();
+	TickType_t now = xTaskGetTickCount();
+
+	if(bmi08a_get_fifo_length(&accel_bytes, dev) != BMI08X_OK ||
+	   bmi08g_get_fifo_frame_count(&gyro_count, NULL, dev) != BMI08X_OK)
+	{
+		return;
+	}
+
+	//Frames that were in the FIFO, including any left behind for the next burst.
+	uint16_t fifo_frames = accel_bytes / BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH;
+
+	//Accel: stop on a frame boundary, and ask for 4 more bytes so the sensor appends its sensor time.
+	if(accel_bytes > IMU_FIFO_MAX_FRAMES * BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH)
+	{
+		accel_bytes = IMU_FIFO_MAX_FRAMES * BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH;
+	}
+	fifo.data = s_accel_fifo_buffer;
+	fifo.length = accel_bytes + BMI08X_ACCEL_FIFO_SENSOR_TIME_FRAME_LENGTH;
+	if(bmi08a_read_fifo_data(&fifo, dev) != BMI08X_OK)
+	{
+		return;
+	}
+	bmi08a_extract_accel(s_accel_frames, &num_accel, &fifo);
+	
+	if(irq_valid && s_time_base.drained && s_time_base.last_valid)
+	{
+		update_time_anchor(irq_time_us, frame_ticks);
+	}
+	
+	//Sensor time of the newest frame. Read from the sensor time frame when the burst reached the end of the FIFO,
+	//otherwise counted on from the last burst as long as nothing was skipped.
+	bool have_sensor_time = (num_accel > 0);
+	uint32_t newest_sensor_time = 0;
+	if(fifo.sensor_time != BMI08X_ACCEL_FIFO_NO_SENSOR_TIME)
+	{
+		newest_sensor_time = fifo.sensor_time;
+	}else if(s_time_base.last_valid && fifo.skipped_frame_count == 0)
+	{
+		newest_sensor_time = (s_time_base.last_sensor_time + num_accel * frame_ticks) & BMI08X_ACCEL_SENSORTIME_MASK;
+	}else
+	{
+		have_sensor_time = false;
+	}
+	s_time_base.drained = (fifo.sensor_time != BMI08X_ACCEL_FIFO_NO_SENSOR_TIME);
+
+	if(gyro_count > IMU_FIFO_MAX_FRAMES)
+	{
+		gyro_count = IMU_FIFO_MAX_FRAMES;
+	}
+	num_gyro = 0;
+	if(gyro_count > 0)
+	{
+		num_gyro = gyro_count;
+		fifo.data = s_gyro_fifo_buffer;
+		fifo.length = gyro_count * BMI08X_GYRO_FIFO_FRAME_LENGTH;
+		if(bmi08g_read_fifo_data(&fifo, dev) == BMI08X_OK)
+		{
+			bmi08g_extract_gyro(s_gyro_frames, &num_gyro, &fifo);
+		}else
+		{
+			num_gyro = 0;
+		}
+	}
+
+	for(uint16_t i = 0; i < num_accel; i++)
+	{
+		imu_sensor_data dataStruct;
+		struct bmi08x_sensor_data *gyro = &s_last_gyro;
+
+		if(num_gyro > 0)
+		{
+			gyro = &s_gyro_frames[(i * num_gyro) / num_accel];
+		}
+
+		dataStruct.acc_x = s_accel_frames[i].x;
+		dataStruct.acc_y = s_accel_frames[i].y;
+		dataStruct.acc_z = s_accel_frames[i].z;
+		dataStruct.gyro_x = gyro->x;
+		dataStruct.gyro_y = gyro->y;
+		dataStruct.gyro_z = gyro->z;
+
+		uint32_t frames_back = num_accel - 1 - i;
+		if(have_sensor_time && s_time_base.anchor_valid)
+		{
+			dataStruct.time_us = sensor_time_to_us(newest_sensor_time - frames_back * frame_ticks);
+		}else
+		{
+			//No reference yet: assume the newest frame in the FIFO was sampled just before the read. After a
+			//start-up backlog that is not one of the frames read now, and the times would go back on the next burst.
+			if(fifo_frames > num_accel)
+			{
+				frames_back += fifo_frames - num_accel;
+			}
+			dataStruct.time_us = now_us - (uint32_t) (frames_back * frame_ticks * NOMINAL_US_PER_SENSOR_TICK);
+		}
+		dataStruct.time_ticks = now - (TickType_t) ((int32_t) (now_us - dataStruct.time_us) / 1000);	//1 ms ticks.
+
+		sample_ring_write(&s_imu_ring, &dataStruct);
+	}
+
+	if(num_gyro > 0)
+	{
+		s_last_gyro = s_gyro_frames[num_gyro - 1];
+	}
+	
+	if(have_sensor_time)
+	{
+		s_time_base.last_sensor_time = newest_sensor_time;
+	}
+	s_time_base.last_valid = have_sensor_time || (s_time_base.last_valid && num_accel == 0);
+}
+#endif
+
+#if IMU_SENSOR_INTERRUPT_MODE
+//Waits up to timeout for INT1. Returns how many edges there were since the last call and the time of the newest.
+static uint32_t wait_for_interrupt(TickType_t timeout, uint32_t *time_us)
+{
+	xSemaphoreTake(s_data_ready, timeout);
+	
+	taskENTER_CRITICAL();
+	uint32_t count = s_irq_count;
+	*time_us = s_irq_time_us;
+	s_irq_count = 0;
+	taskEXIT_CRITICAL();
+	
+	return count;
+}
+#endif
+
+void imu_sensor_interrupt(uint32_t time_us)
+{
+#if IMU_SENSOR_INTERRUPT_MODE
+	BaseType_t higher_priority_task_woken = pdFALSE;
+	
+	if(s_data_ready == NULL)
+	{
+		return;
+	}
+	
+	s_irq_time_us = time_us;
+	s_irq_count++;
+	xSemaphoreGiveFromISR(s_data_ready, &higher_priority_task_woken);
+	portYIELD_FROM_ISR(higher_priority_task_woken);
+#else
+	(void) time_us;
+#endif
+}
+
 void imu_thread_start(void const *param){
 	
 
@@ -82,9 +366,40 @@ void imu_thread_start(void const *param){
 	imu_sensor_thread_parameters * params = (imu_sensor_thread_parameters *)param;
 
 	configuration_data_t * configParams = params->configuration_data;
-	
-	TickType_t prevTime;
 
+#if IMU_SENSOR_FIFO_MODE
+	//Wake up once the accelerometer FIFO should hold about IMU_FIFO_BATCH_FRAMES frames.
+	uint32_t accel_hz = accel_odr_hz(configParams->values.ac_odr);
+	TickType_t period = pdMS_TO_TICKS((IMU_FIFO_BATCH_FRAMES * 1000u) / accel_hz);
+	if(period == 0)
+	{
+		period = 1;
+	}
+
+	uint32_t frame_ticks = accel_frame_ticks(configParams->values.ac_odr);
+	
+#if IMU_SENSOR_INTERRUPT_MODE
+	//The watermark interrupt sets the pace. The timeout only matters if an edge is missed, e.g. when a capped
+	//burst left the FIFO above the watermark and the pin never went low.
+	while(1){
+		uint32_t irq_time_us;
+		uint32_t irq_count = wait_for_interrupt(2 * period, &irq_time_us);
+		
+		//With more than one edge pending it is unknown which frame raised the newest one.
+		uint32_t start = profiler_start();
+		read_fifo_batch(frame_ticks, irq_count == 1, irq_time_us);
+		profiler_end(PROFILER_SPAN_IMU_READ, start);
+	}
+#else
+	TickType_t prevTime = xTaskGetTickCount();
+	while(1){
+		vTaskDelayUntil(&prevTime, period);
+		uint32_t start = profiler_start();
+		read_fifo_batch(frame_ticks, false, 0);
+		profiler_end(PROFILER_SPAN_IMU_READ, start);
+	}
+#endif
+#else
 	imu_sensor_data dataStruct;
 	
 	
@@ -92,54 +407,84 @@ void imu_thread_start(void const *param){
 	//main loop: continuously read sensor data
 	//vTaskDelay(pdMS_TO_TICKS(100));//Wait so to make sure the other tasks have started.
 
-	prevTime=xTaskGetTickCount();
+#if IMU_SENSOR_INTERRUPT_MODE
+	(void) configParams;	//The sensor's data rate sets the pace.
+#else
+	TickType_t prevTime = xTaskGetTickCount();
+#endif
 	
-	int8_t result_flag;
-	struct bmi08x_sensor_data container;
 	while(1){
+#if IMU_SENSOR_INTERRUPT_MODE
+		//Data ready interrupt: the edge is the sample time.
+		uint32_t irq_time_us;
+		if(wait_for_interrupt(pdMS_TO_TICKS(100), &irq_time_us) == 0)
+		{
+			continue;
+		}
+#endif
 		
-		result_flag = bmi08a_get_data(&container, s_bmp3_sensor->bmi088_ptr);
-//		if(BMI08X_E_NULL_PTR == result_flag)
-//		{
-//			continue;
-//		}
-		dataStruct.acc_x = container.x,
-		dataStruct.acc_y = container.y,
-		dataStruct.acc_z = container.z;
-		
-		result_flag = bmi08g_get_data(&container, s_bmp3_sensor->bmi088_ptr);
-//		if(BMI08X_E_NULL_PTR == result_flag)
-//		{
-//			continue;
-//		}
-		
-		dataStruct.gyro_x = container.x,
-		dataStruct.gyro_y = container.y,
-		dataStruct.gyro_z = container.z;
+		uint32_t start = profiler_start();
+		//A failed read is dropped, the readers keep the last good sample.
+		bool ok = imu_sample_read(s_bmp3_sensor->accel_spi, s_bmp3_sensor->gyro_spi, &dataStruct);
 		
+#if IMU_SENSOR_INTERRUPT_MODE
+		dataStruct.time_us = irq_time_us;
+		dataStruct.time_ticks = xTaskGetTickCount() - (stm32_get_time_us() - irq_time_us) / 1000;	//1 ms ticks.
+		if(ok)
+		{
+			sample_ring_write(&s_imu_ring, &dataStruct);
+		}
+		profiler_end(PROFILER_SPAN_IMU_READ, start);
+#else
+		dataStruct.time_us = stm32_get_time_us();
 		dataStruct.time_ticks = xTaskGetTickCount();
-		xQueueSend(bmi088_queue,&dataStruct,1);
+		if(ok)
+		{
+			sample_ring_write(&s_imu_ring, &dataStruct);
+		}
+		profiler_end(PROFILER_SPAN_IMU_READ, start);
 		
 		vTaskDelayUntil(&prevTime,configParams->values.data_rate);
+#endif
 	}
+#endif
+}
+
+uint32_t imu_sensor_rate_hz(const configuration_data_t * parameters)
+{
+	uint32_t odr_hz = accel_odr_hz(parameters->values.ac_odr);
+#if IMU_SENSOR_FIFO_MODE || IMU_SENSOR_INTERRUPT_MODE
+	return odr_hz;
+#else
+	uint32_t poll_hz = 1000 / parameters->values.data_rate;
+	return (poll_hz < odr_hz) ? poll_hz : odr_hz;
+#endif
+}
+
+void imu_reader_init(sample_ring_reader * reader)
+{
+	sample_ring_reader_init(&s_imu_ring, reader);
 }
 
-bool imu_read(imu_sensor_data * buffer, uint8_t data_rate)
+bool imu_read(sample_ring_reader * reader, imu_sensor_data * buffer, uint8_t timeout)
 {
-	return pdPASS == xQueueReceive(bmi088_queue, buffer, data_rate);
+	TickType_t start = xTaskGetTickCount();
+
+	profiler_gauge_update(PROFILER_GAUGE_IMU_BACKLOG, sample_ring_available(&s_imu_ring, reader));
+	while(!sample_ring_read(&s_imu_ring, reader, buffer))
+	{
+		if(xTaskGetTickCount() - start >= timeout)
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
 }
 
-void imu_sensor_data_to_bytes(imu_sensor_data reading, uint8_t* buffer, uint32_t timestamp)
+bool imu_read_latest(imu_sensor_data * buffer)
 {
-	// Make sure time doesn't overwrite type and event bits.
-	uint32_t header = (ACC_TYPE | GYRO_TYPE) + (timestamp & 0x0FFF);
-	write_24(header, &buffer[0]);
-	write_16(reading.acc_x, &buffer[3]);
-	write_16(reading.acc_y, &buffer[5]);
-	write_16(reading.acc_z, &buffer[7]);
-	write_16(reading.gyro_x, &buffer[9]);
-	write_16(reading.gyro_y, &buffer[11]);
-	write_16(reading.gyro_z, &buffer[13]);
+	return sample_ring_read_latest(&s_imu_ring, buffer, NULL);
 }
 
 //set the accelerometer starting configurations
@@ -200,35 +545,52 @@ int8_t gyro_config(struct bmi08x_dev *dev, configuration_data_t * configParams,
 	return rslt;
 }
 
+/**
+ * @brief The SPI device behind a BMI088 driver dev_addr. The driver passes accel_id or gyro_id, which start as 0 and
+ * 1 and are the chip ids (0x1E and 0x0F) once the two halves have been configured.
+ */
+static SPI get_spi_device(uint8_t dev_addr)
+{
+	if(dev_addr == 0x00 || dev_addr == 0x1E)
+	{
+		return s_bmp3_sensor->accel_spi;
+	}else if(dev_addr == 0x01 || dev_addr == 0x0F)
+	{
+		return s_bmp3_sensor->gyro_spi;
+	}
+	return NULL;
+}
+
 int8_t user_spi_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len){
-	//debug removeHAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN, GPIO_PIN_SET);
-	if(dev_addr == 0x00|| dev_addr == 0x1E){
-		//Accelerometer.
-		spi_receive(s_bmp3_sensor->hspi_ptr, &reg_addr,1, data, len, 10); // The register address will always be 1.
-	}
-	else if(dev_addr == 0x01|| dev_addr == 0x0F){
-//		//Gyroscope.
-		spi_receive(s_bmp3_sensor->hspi_ptr, &reg_addr,1, data, len, 11); // The register address will always be 1.
-	}
-	//delay_ms(500);
-	//HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN, GPIO_PIN_RESET);
-	//delay_ms(500);
+	SPI device = get_spi_device(dev_addr);
+	if(device == NULL){
+		return BMI08X_E_COM_FAIL;
+	}
+	if(spi_receive(device, &reg_addr, 1, data, len, 10) != HAL_OK){ // The register address will always be 1.
+		return BMI08X_E_COM_FAIL;
+	}
 	return BMI08X_OK;
 }
 int8_t user_spi_write(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len){
-
-	if(dev_addr == 0x00 || dev_addr == 0x1E){
-	spi_send(s_bmp3_sensor->hspi_ptr, &reg_addr,1, data, len, 10);
+	SPI device = get_spi_device(dev_addr);
+	if(device == NULL){
+		return BMI08X_E_COM_FAIL;
 	}
-	else if(dev_addr == 0x01 || dev_addr == 0x0F){
-		spi_send(s_bmp3_sensor->hspi_ptr, &reg_addr,1, data, len, 11);
-
+	if(spi_send(device, &reg_addr, 1, data, len, 10) != HAL_OK){
+		return BMI08X_E_COM_FAIL;
 	}
 	return BMI08X_OK;
 }
 
 void delay_ms(uint32_t period)
 {
+	//The sensors are set up from main, before there is a scheduler to delay with.
+	if(xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+	{
+		stm32_delay(period);
+		return;
+	}
+
 	vTaskDelay(pdMS_TO_TICKS(period)); // wait for the given amount of milliseconds
 }
 
@@ -236,36 +598,89 @@ void delay_ms(uint32_t period)
 static bool __imu_config(configuration_data_t * parameters){
 	struct bmi08x_dev * dev = s_bmp3_sensor->bmi088_ptr;
 	int8_t result = 0;
-	accel_config(dev, parameters, result);
+	result = accel_config(dev, parameters, result);
 	if(result != BMI08X_OK)
 	{
 		return false;
 	}
-	gyro_config(dev, parameters, result);
+	result = gyro_config(dev, parameters, result);
+	
+#if IMU_SENSOR_FIFO_MODE
+	if(result == BMI08X_OK)
+	{
+		//Stream mode: when a FIFO is full the oldest frames are dropped, so a late wakeup never stalls the sensor.
+		struct bmi08x_accel_fifo_config accel_fifo = {BMI08X_ACCEL_FIFO_MODE_STREAM, BMI08X_ENABLE, BMI08X_DISABLE, BMI08X_DISABLE};
+		struct bmi08x_gyro_fifo_config gyro_fifo = {BMI08X_GYRO_FIFO_MODE_STREAM, 0};
+		
+		result = bmi08a_set_fifo_config(&accel_fifo, dev);
+		if(result == BMI08X_OK)
+		{
+			result = bmi08g_set_fifo_config(&gyro_fifo, dev);
+		}
+	}
+#endif
+	
+#if IMU_SENSOR_INTERRUPT_MODE
+	if(result == BMI08X_OK)
+	{
+		//INT1 rises when the FIFO reaches the watermark, or on every sample when the FIFO is not used.
+		struct bmi08x_accel_int_channel_cfg int_config;
+		int_config.int_channel = BMI08X_INT_CHANNEL_1;
+		int_config.int_pin_cfg.lvl = BMI08X_INT_ACTIVE_HIGH;
+		int_config.int_pin_cfg.output_mode = BMI08X_INT_MODE_PUSH_PULL;
+		int_config.int_pin_cfg.enable_int_pin = BMI08X_ENABLE;
+#if IMU_SENSOR_FIFO_MODE
+		int_config.int_type = BMI08X_ACCEL_FIFO_WM_INT;
+		result = bmi08a_set_fifo_wm(IMU_FIFO_BATCH_FRAMES * BMI08X_ACCEL_FIFO_ACCEL_FRAME_LENGTH, dev);
+		if(result == BMI08X_OK)
+		{
+			result = bmi08a_set_int_config(&int_config, dev);
+		}
+#else
+		int_config.int_type = BMI08X_ACCEL_DATA_RDY_INT;
+		result = bmi08a_set_int_config(&int_config, dev);
+#endif
+	}
+#endif
 	
 	return result == BMI08X_OK;
 }
 
-static uint8_t __imu_init(_bmi_sensor* bmi_sensor_ptr)
+#if IMU_SENSOR_INTERRUPT_MODE
+//Accelerometer INT1 as a rising edge EXTI. The gyroscope pins are not used, the accelerometer paces both reads.
+static void interrupt_pin_init(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+	
+	GPIO_InitStruct.Pin = IMU_ACC_INT_PIN;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(IMU_ACC_INT_PORT, &GPIO_InitStruct);
+	
+	HAL_NVIC_SetPriority(SENSOR_INT_IRQn, SENSOR_INT_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(SENSOR_INT_IRQn);
+}
+#endif
+
+//Registers the two SPI devices, brings up the BMI088 through the driver and sets up INT1. False if any of it failed.
+static bool __imu_init(_bmi_sensor* bmi_sensor_ptr)
 {
 	struct bmi08x_dev* bmi088dev_ptr;
 	
-	SPI hspi_ptr = spi3_init();
-	if(hspi_ptr == NULL)
+	SPI accel_spi = spi_register_device(&s_accel_spi_config);
+	SPI gyro_spi = spi_register_device(&s_gyro_spi_config);
+	if(accel_spi == NULL || gyro_spi == NULL)
 	{
-		return INTERNAL_ERROR;
+		return false;
 	}
 	
 	//Initialize BMP3 Handler
-	bmi088dev_ptr = pvPortMalloc(sizeof(struct bmi08x_dev));
-	if(bmi088dev_ptr == NULL)
-	{
-		return INTERNAL_ERROR;
-	}
+	bmi088dev_ptr = &s_bmi088_dev;
 	
 	/* Set bmp3_sensor_ptr members to newly initialized handlers */
 	bmi_sensor_ptr->bmi088_ptr = bmi088dev_ptr;
-	bmi_sensor_ptr->hspi_ptr = hspi_ptr;
+	bmi_sensor_ptr->accel_spi = accel_spi;
+	bmi_sensor_ptr->gyro_spi = gyro_spi;
 	
 	/* Map the delay function pointer with the function responsible for implementing the delay_ms */
 	/* Select the interface mode as SPI */
@@ -277,22 +692,22 @@ static uint8_t __imu_init(_bmi_sensor* bmi_sensor_ptr)
 	bmi088dev_ptr->delay_ms = delay_ms;     //user_delay_milli_sec
 	
 	int8_t result_flag = bmi088_init(bmi088dev_ptr); // bosch API initialization method
-	if(result_flag == BMI08X_OK)
+	if(result_flag != BMI08X_OK)
 	{
-		bmi088_queue = xQueueCreate(10,sizeof(imu_sensor_data));
-		if(bmi088_queue == NULL)
-		{
-			return INTERNAL_ERROR;
-		}
-		
-		vQueueAddToRegistry(bmi088_queue,"bmi088_queue");
+		return false;
 	}
-	else
+	
+#if IMU_SENSOR_INTERRUPT_MODE
+	s_data_ready = xSemaphoreCreateBinaryStatic(&s_data_ready_buffer);
+	if(s_data_ready == NULL)
 	{
-		return result_flag;
+		return false;
 	}
 	
-	return INTERNAL_ERROR;
+	interrupt_pin_init();
+#endif
+	
+	return true;
 }
 
 
@@ -315,17 +730,14 @@ bool imu_sensor_test()
 	uint8_t id_dummy[] = {0x00,0x00};
 	
 	
-	spi_receive(s_bmp3_sensor->hspi_ptr,command,1,id_dummy,2,10);
-	spi_receive(s_bmp3_sensor->hspi_ptr,command,1,id_read,2,10);
+	spi_receive(s_bmp3_sensor->accel_spi,command,1,id_dummy,2,10);
 	
-	if(id_read[1] == id)
+	if(spi_receive(s_bmp3_sensor->accel_spi,command,1,id_read,2,10) == HAL_OK && id_read[1] == id)
 	{
 		res += 1;
 	}
 	
-	spi_receive(s_bmp3_sensor->hspi_ptr,command,1,id_read,2,11);
-	
-	if(id_read[0] == 0x0F)
+	if(spi_receive(s_bmp3_sensor->gyro_spi,command,1,id_read,2,10) == HAL_OK && id_read[0] == 0x0F)
 	{
 		res += 1;
 	}
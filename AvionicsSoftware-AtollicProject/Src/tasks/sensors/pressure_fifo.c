@@ -0,0 +1,75 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for parsing BMP388 FIFO bursts. bmp3_extract_fifo_data does the unpacking and compensation; this
+//  only keeps it to the whole frames of the burst.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "tasks/sensors/pressure_fifo.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Frame headers, as in bmp3.c.
+#define FIFO_TEMP_PRESS_FRAME	0x94
+#define FIFO_TEMP_FRAME			0x90
+#define FIFO_PRESS_FRAME		0x84
+#define FIFO_TIME_FRAME			0xA0
+
+
+/**
+ * @brief Bytes in the frame that starts with header, counting the header.
+ */
+static uint16_t frame_length(uint8_t header)
+{
+	switch(header)
+	{
+		case FIFO_TEMP_PRESS_FRAME:
+			return 1 + BMP3_P_T_DATA_LEN;
+		case FIFO_TEMP_FRAME:
+			return 1 + BMP3_T_DATA_LEN;
+		case FIFO_PRESS_FRAME:
+			return 1 + BMP3_P_DATA_LEN;
+		case FIFO_TIME_FRAME:
+			return 1 + BMP3_SENSOR_TIME_LEN;
+		default:
+			//Config change, error and empty frames: bmp3_extract_fifo_data steps over one byte after the header.
+			return 2;
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int8_t pressure_fifo_parse(struct bmp3_dev *dev, struct bmp3_data *frames, uint8_t max_frames, uint8_t *count,
+						   uint32_t *sensor_time)
+{
+	struct bmp3_fifo_data *data = &dev->fifo->data;
+
+	//Past the last whole frame there is only the start of one that arrived while the burst was being read.
+	uint16_t whole = data->start_idx;
+	while(whole < data->byte_count && whole + frame_length(data->buffer[whole]) <= data->byte_count)
+	{
+		whole += frame_length(data->buffer[whole]);
+	}
+	data->byte_count = whole;
+
+	data->req_frames = max_frames;
+	data->sensor_time = PRESSURE_FIFO_NO_SENSOR_TIME;
+	int8_t result = bmp3_extract_fifo_data(frames, dev);
+
+	*count = (result == BMP3_OK) ? data->parsed_frames : 0;
+	*sensor_time = data->sensor_time;
+	return result;
+}
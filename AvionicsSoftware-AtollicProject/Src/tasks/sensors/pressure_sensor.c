@@ -17,6 +17,7 @@
 // INCLUDES
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------
 #include "tasks/sensors/pressure_sensor.h"
+#include "tasks/sensors/pressure_fifo.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
@@ -29,11 +30,14 @@
 
 #include "FreeRTOS.h"
 #include "queue.h"
+#include "STM32.h"
+#include "hardware_definitions.h"
 #include "utilities/common.h"
+#include "utilities/math.h"
+#include "utilities/sample_ring.h"
+#include "utilities/profiler.h"
 
 #define INTERNAL_ERROR -127
-#define PRES_TYPE			0x200000
-#define	TEMP_TYPE			0x100000
 
 #define GND_ALT					0
 #define GND_PRES				101325
@@ -47,12 +51,57 @@ typedef struct _bmp3_sensor_struct
 	struct bmp3_dev *bmp_ptr;
 	SPI hspi_ptr;
 } _bmp3_sensor;
+
+//The BMP388 is rated 10 MHz in SPI modes 0 and 3. From the 42 MHz APB1 this gives 5.25 MHz.
+static const spi_device_config s_bmp388_spi =
+{
+	.bus = SPI_BUS_2,
+	.cs_port = PRES_SPI_CS_PORT,
+	.cs_pin = PRES_SPI_CS_PIN,
+	.max_clock_hz = 10000000,
+	.mode = 0,
+};
 static UART uart;
 static char buf[128];
 static _bmp3_sensor *s_bmp3_sensor;
-static QueueHandle_t bmp388_queue;
 static struct bmp3_data sensor_data;
 
+#if PRESSURE_SENSOR_FIFO_MODE
+#define PRESSURE_RING_LENGTH	(2 * PRESSURE_FIFO_MAX_FRAMES)
+static struct bmp3_fifo s_fifo;
+static struct bmp3_data s_fifo_frames[PRESSURE_FIFO_MAX_FRAMES];
+
+//The BMP388 sensor time is not needed to place its frames: they are numbered as they are read, and the watermark
+//interrupt pins one frame number to an MCU time. Two such pins measure the real frame period.
+typedef struct
+{
+	uint32_t anchor_us;			//MCU time of one known frame...
+	uint32_t anchor_frame;		//...and its number.
+	float period_us;			//Measured frame period. The BMP388 ODR is only accurate to a few %.
+	uint32_t next_frame;		//Number of the next frame to come out of the FIFO.
+	bool anchor_valid;
+	bool drained;				//The last burst ended with a sensor time frame, so the FIFO was empty after it.
+} pressure_time_base;
+
+static pressure_time_base s_time_base;
+#else
+#define PRESSURE_RING_LENGTH	16
+#endif
+
+//Placed at link time: there is one pressure sensor, and nothing is ever freed.
+static _bmp3_sensor s_bmp3_sensor_storage;
+static struct bmp3_dev s_bmp3_dev;
+
+//Every sample the task reads, for as many readers as want them.
+SAMPLE_RING_DEFINE(s_pressure_ring, pressure_sensor_data, PRESSURE_RING_LENGTH);
+
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+static SemaphoreHandle_t s_data_ready;		//Given by the INT interrupt. The SPI driver owns the task notification.
+static StaticSemaphore_t s_data_ready_buffer;
+static volatile uint32_t s_irq_time_us;		//stm32_get_time_us() at the newest INT edge.
+static volatile uint32_t s_irq_count;		//INT edges the task has not looked at yet.
+#endif
+
 static void delay_ms(uint32_t period_ms);
 static int8_t spi_reg_write(uint8_t cs, uint8_t reg_addr, uint8_t *reg_data, uint16_t length);
 static int8_t spi_reg_read(uint8_t cs, uint8_t reg_addr, uint8_t *reg_data, uint16_t length);
@@ -63,21 +112,35 @@ static void bmp3_print_result(const char *api_name, int8_t rslt);
 
 
 
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+//BMP388 INT as a rising edge EXTI.
+static void interrupt_pin_init(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+	
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	GPIO_InitStruct.Pin = PRES_INT_PIN;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(PRES_INT_PORT, &GPIO_InitStruct);
+	
+	HAL_NVIC_SetPriority(SENSOR_INT_IRQn, SENSOR_INT_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(SENSOR_INT_IRQn);
+}
+#endif
+
 int8_t __pressure_sensor_init(_bmp3_sensor *bmp3_sensor_ptr)
 {
 	struct bmp3_dev *bmp3_ptr;
-	SPI hspi_ptr = spi2_init();
+	SPI hspi_ptr = spi_register_device(&s_bmp388_spi);
 	if(hspi_ptr == NULL)
 	{
-		return INTERNAL_ERROR;
+		//The caller only takes 0 as a failure.
+		return false;
 	}
 	
 	//Initialize BMP3 Handler
-	bmp3_ptr = pvPortMalloc(sizeof(struct bmp3_dev));
-	if(bmp3_ptr == NULL)
-	{
-		return INTERNAL_ERROR;
-	}
+	bmp3_ptr = &s_bmp3_dev;
 	
 	/* Set bmp3_sensor_ptr members to newly initialized handlers */
 	bmp3_sensor_ptr->bmp_ptr = bmp3_ptr;
@@ -101,13 +164,15 @@ int8_t __pressure_sensor_init(_bmp3_sensor *bmp3_sensor_ptr)
 	
 	if(result == BMP3_OK)
 	{
-		bmp388_queue = xQueueCreate(10, sizeof(pressure_sensor_data));
-		if(bmp388_queue == NULL)
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+		s_data_ready = xSemaphoreCreateBinaryStatic(&s_data_ready_buffer);
+		if(s_data_ready == NULL)
 		{
-			return INTERNAL_ERROR;
+			return false;
 		}
 		
-		vQueueAddToRegistry(bmp388_queue,"bmp388_queue");
+		interrupt_pin_init();
+#endif
 	}else
 	{
 		return result;
@@ -133,10 +198,43 @@ static bool __pressure_sensor_config(uint8_t iir, uint8_t os_pres, uint8_t os_te
 	/* Assign the settings which needs to be set in the sensor */
 	settings_sel = BMP3_PRESS_EN_SEL | BMP3_TEMP_EN_SEL | BMP3_PRESS_OS_SEL | BMP3_TEMP_OS_SEL | BMP3_ODR_SEL |
 				   BMP3_IIR_FILTER_SEL;
-	if(0 == bmp3_set_sensor_settings(settings_sel, dev))
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+	//Push-pull, active high, not latched. Data ready only drives the pin when the FIFO is not used,
+	//otherwise the FIFO watermark enabled below does.
+	dev->settings.int_settings.output_mode = BMP3_INT_PIN_PUSH_PULL;
+	dev->settings.int_settings.level = BMP3_INT_PIN_ACTIVE_HIGH;
+	dev->settings.int_settings.latch = BMP3_INT_PIN_NON_LATCH;
+	dev->settings.int_settings.drdy_en = PRESSURE_SENSOR_FIFO_MODE ? BMP3_DISABLE : BMP3_ENABLE;
+	settings_sel |= BMP3_OUTPUT_MODE_SEL | BMP3_LEVEL_SEL | BMP3_LATCH_SEL | BMP3_DRDY_EN_SEL;
+#endif
+	if(BMP3_OK != bmp3_set_sensor_settings(settings_sel, dev))
+	{
+		return false;
+	}
+	
+#if PRESSURE_SENSOR_FIFO_MODE
+	//Pressure and temperature frames plus a sensor time frame at the end of every burst.
+	dev->fifo = &s_fifo;
+	dev->fifo->settings.mode = BMP3_ENABLE;
+	dev->fifo->settings.stop_on_full_en = BMP3_DISABLE;
+	dev->fifo->settings.time_en = BMP3_ENABLE;
+	dev->fifo->settings.press_en = BMP3_ENABLE;
+	dev->fifo->settings.temp_en = BMP3_ENABLE;
+	dev->fifo->settings.down_sampling = BMP3_FIFO_NO_SUBSAMPLING;
+	dev->fifo->settings.filter_en = BMP3_ENABLE;
+	dev->fifo->settings.fwtm_en = BMP3_ENABLE;
+	dev->fifo->settings.ffull_en = BMP3_DISABLE;
+	if(BMP3_OK != bmp3_set_fifo_settings(BMP3_FIFO_ALL_SETTINGS, dev))
+	{
+		return false;
+	}
+	
+	dev->fifo->data.req_frames = PRESSURE_FIFO_BATCH_FRAMES;
+	if(BMP3_OK != bmp3_set_fifo_watermark(dev))
 	{
 		return false;
 	}
+#endif
 	
 	/* Set the power mode to normal mode */
 	dev->settings.op_mode = BMP3_NORMAL_MODE;
@@ -144,6 +242,122 @@ static bool __pressure_sensor_config(uint8_t iir, uint8_t os_pres, uint8_t os_te
 	return (bmp3_set_op_mode(dev) == 0) ? true : false;
 }
 
+#if PRESSURE_SENSOR_FIFO_MODE
+//The FIFO was empty after the last burst, so the frame that raised the watermark interrupt at irq_time_us is the
+//PRESSURE_FIFO_BATCH_FRAMES'th one after it.
+static void update_time_anchor(uint32_t irq_time_us, uint32_t nominal_period_us)
+{
+	uint32_t frame = s_time_base.next_frame + PRESSURE_FIFO_BATCH_FRAMES - 1;
+	
+	if(s_time_base.anchor_valid && frame != s_time_base.anchor_frame)
+	{
+		float period_us = (float) (irq_time_us - s_time_base.anchor_us) / (frame - s_time_base.anchor_frame);
+		
+		//A late interrupt (masked by a critical section) shows up as an outlier. Smooth the rest.
+		if(period_us > nominal_period_us * 0.9f && period_us < nominal_period_us * 1.1f)
+		{
+			s_time_base.period_us += (period_us - s_time_base.period_us) / 16;
+		}
+	}
+	
+	s_time_base.anchor_us = irq_time_us;
+	s_time_base.anchor_frame = frame;
+	s_time_base.anchor_valid = true;
+}
+
+//Reads the whole FIFO in one burst, compensates every frame and queues them oldest first.
+//irq_valid says irq_time_us is the time of the single watermark interrupt that caused this read.
+static void read_fifo_batch(uint32_t nominal_period_us, bool irq_valid, uint32_t irq_time_us)
+{
+	struct bmp3_dev *dev = s_bmp3_sensor->bmp_ptr;
+	uint32_t now_us = stm32_get_time_us();
+	TickType_t now = xTaskGetTickCount();
+	
+	if(BMP3_OK != bmp3_get_fifo_data(dev))
+	{
+		return;
+	}
+	
+	uint8_t num_frames;
+	uint32_t sensor_time;
+	if(BMP3_OK != pressure_fifo_parse(dev, s_fifo_frames, PRESSURE_FIFO_MAX_FRAMES, &num_frames, &sensor_time))
+	{
+		return;
+	}
+	
+	if(irq_valid && s_time_base.drained)
+	{
+		update_time_anchor(irq_time_us, nominal_period_us);
+	}
+	
+	for(uint8_t i = 0; i < num_frames; i++)
+	{
+		pressure_sensor_data dataStruct;
+		dataStruct.pressure = s_fifo_frames[i].pressure;
+		dataStruct.temperature = s_fifo_frames[i].temperature;
+		dataStruct.sensor_time = sensor_time;
+		dataStruct.altitude = pressure_sensor_calculate_altitude(&dataStruct);
+		
+		if(s_time_base.anchor_valid)
+		{
+			int32_t frames_after = (int32_t) (s_time_base.next_frame + i - s_time_base.anchor_frame);
+			dataStruct.time_us = s_time_base.anchor_us + (int32_t) (frames_after * s_time_base.period_us);
+		}else
+		{
+			//No reference yet: assume the newest frame was sampled just before the read.
+			dataStruct.time_us = now_us - (uint32_t) ((num_frames - 1 - i) * s_time_base.period_us);
+		}
+		dataStruct.time_ticks = now - (TickType_t) ((int32_t) (now_us - dataStruct.time_us) / 1000);	//1 ms ticks.
+		
+		sample_ring_write(&s_pressure_ring, &dataStruct);
+	}
+	
+	s_time_base.next_frame += num_frames;
+	s_time_base.drained = (sensor_time != PRESSURE_FIFO_NO_SENSOR_TIME);
+	
+	//Frames beyond PRESSURE_FIFO_MAX_FRAMES were read out but thrown away, so the numbering no longer matches.
+	if(num_frames >= PRESSURE_FIFO_MAX_FRAMES)
+	{
+		s_time_base.anchor_valid = false;
+	}
+}
+#endif
+
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+//Waits up to timeout for INT. Returns how many edges there were since the last call and the time of the newest.
+static uint32_t wait_for_interrupt(TickType_t timeout, uint32_t *time_us)
+{
+	xSemaphoreTake(s_data_ready, timeout);
+	
+	taskENTER_CRITICAL();
+	uint32_t count = s_irq_count;
+	*time_us = s_irq_time_us;
+	s_irq_count = 0;
+	taskEXIT_CRITICAL();
+	
+	return count;
+}
+#endif
+
+void pressure_sensor_interrupt(uint32_t time_us)
+{
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+	BaseType_t higher_priority_task_woken = pdFALSE;
+	
+	if(s_data_ready == NULL)
+	{
+		return;
+	}
+	
+	s_irq_time_us = time_us;
+	s_irq_count++;
+	xSemaphoreGiveFromISR(s_data_ready, &higher_priority_task_woken);
+	portYIELD_FROM_ISR(higher_priority_task_woken);
+#else
+	(void) time_us;
+#endif
+}
+
 float pressure_sensor_calculate_altitude(pressure_sensor_data * reading)
 {
 	if(reading == NULL)
@@ -151,9 +365,12 @@ float pressure_sensor_calculate_altitude(pressure_sensor_data * reading)
 		return 0.0;
 	}
 	
-	float p_term = powf((s_reference_pressure / (reading->pressure / 100)), (1 / 5.257F)) - 1;
-	float t_term = (reading->temperature / 100) + 273.15F;
-	return (uint32_t) (p_term * t_term) / 0.0065F + s_reference_altitude;
+	//The compensated readings are in 1/100 Pa and 1/100 C.
+	uint32_t start = profiler_start();
+	float altitude = math_fast_altitude(reading->pressure / 100.0F, reading->temperature / 100.0F,
+										s_reference_pressure, s_reference_altitude);
+	profiler_end(PROFILER_SPAN_ALTITUDE, start);
+	return altitude;
 }
 
 int8_t get_sensor_data(struct bmp3_dev *dev, struct bmp3_data *data)
@@ -163,11 +380,7 @@ int8_t get_sensor_data(struct bmp3_dev *dev, struct bmp3_data *data)
 
 bool pressure_sensor_init(configuration_data_t *parameters)
 {
-	_bmp3_sensor *bmp3_sensor_ptr = pvPortMalloc(sizeof(_bmp3_sensor));
-	if(bmp3_sensor_ptr == NULL)
-	{
-		return false;
-	}
+	_bmp3_sensor *bmp3_sensor_ptr = &s_bmp3_sensor_storage;
 	
 	if(false == __pressure_sensor_init(bmp3_sensor_ptr))
 	{
@@ -222,12 +435,56 @@ void thread_pressure_sensor_start(void const*pvParameters)
 		
 		configParams->values.ref_pres = dataStruct.pressure / 100;
 		s_reference_pressure = dataStruct.pressure / 100;
+	}else
+	{
+		//Restarted mid flight: keep measuring against the ground reference saved before launch.
+		s_reference_pressure = configParams->values.ref_pres;
+		s_reference_altitude = configParams->values.ref_alt;
 	}
 	
+#if PRESSURE_SENSOR_FIFO_MODE
+	//The BMP388 ODR setting halves the rate with every step from 200 Hz, i.e. 5 ms per frame doubling each step.
+	uint32_t period_ms = 5u << configParams->values.bmp_odr;
+	s_time_base.period_us = period_ms * 1000.0f;
+	
+	//The single-shot reads above went through the FIFO as well, start from an empty one.
+	bmp3_get_fifo_data(s_bmp3_sensor->bmp_ptr);
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+	//The watermark interrupt sets the pace. The timeout only matters if an edge is missed.
+	while(1)
+	{
+		uint32_t irq_time_us;
+		uint32_t irq_count = wait_for_interrupt(pdMS_TO_TICKS(2 * PRESSURE_FIFO_BATCH_FRAMES * period_ms), &irq_time_us);
+		
+		//With more than one edge pending it is unknown which frame raised the newest one.
+		uint32_t start = profiler_start();
+		read_fifo_batch(period_ms * 1000, irq_count == 1, irq_time_us);
+		profiler_end(PROFILER_SPAN_PRESSURE_READ, start);
+	}
+#else
+	prevTime = xTaskGetTickCount();
+	while(1)
+	{
+		vTaskDelayUntil(&prevTime, pdMS_TO_TICKS(PRESSURE_FIFO_BATCH_FRAMES * period_ms));
+		uint32_t start = profiler_start();
+		read_fifo_batch(period_ms * 1000, false, 0);
+		profiler_end(PROFILER_SPAN_PRESSURE_READ, start);
+	}
+#endif
+#else
 	int8_t result_flag;
 	while(1)
 	{
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+		//Data ready interrupt: the edge is the sample time.
+		uint32_t irq_time_us;
+		if(wait_for_interrupt(pdMS_TO_TICKS(100), &irq_time_us) == 0)
+		{
+			continue;
+		}
+#endif
 		
+		uint32_t start = profiler_start();
 		result_flag = get_sensor_data(s_bmp3_sensor->bmp_ptr, &sensor_data);
 		if(BMP3_E_NULL_PTR == result_flag)
 		{
@@ -236,14 +493,33 @@ void thread_pressure_sensor_start(void const*pvParameters)
 		dataStruct.pressure = sensor_data.pressure;
 		dataStruct.temperature = sensor_data.temperature;
 		
+		dataStruct.sensor_time = 0;
+		dataStruct.altitude = pressure_sensor_calculate_altitude(&dataStruct);
+#if PRESSURE_SENSOR_INTERRUPT_MODE
+		dataStruct.time_us = irq_time_us;
+		dataStruct.time_ticks = xTaskGetTickCount() - (stm32_get_time_us() - irq_time_us) / 1000;	//1 ms ticks.
+		sample_ring_write(&s_pressure_ring, &dataStruct);
+		profiler_end(PROFILER_SPAN_PRESSURE_READ, start);
+#else
+		dataStruct.time_us = stm32_get_time_us();
 		dataStruct.time_ticks = xTaskGetTickCount();
-		xQueueSend(bmp388_queue, &dataStruct, 1);
+		sample_ring_write(&s_pressure_ring, &dataStruct);
+		profiler_end(PROFILER_SPAN_PRESSURE_READ, start);
 		vTaskDelayUntil(&prevTime, configParams->values.data_rate);
+#endif
 	}
+#endif
 }
 
 static void delay_ms(uint32_t period_ms)
 {
+	//The sensor is set up from main, before there is a scheduler to delay with.
+	if(xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+	{
+		stm32_delay(period_ms);
+		return;
+	}
+
 	vTaskDelay((TickType_t) period_ms);
 }
 
@@ -262,9 +538,11 @@ static void delay_ms(uint32_t period_ms)
  */
 static int8_t spi_reg_write(uint8_t cs, uint8_t reg_addr, uint8_t *reg_data, uint16_t length)
 {
-	int8_t rslt = 0; //assume success
-	spi_send(s_bmp3_sensor->hspi_ptr, &reg_addr, 1, reg_data, length, TIMEOUT);
-	return rslt;
+	if(spi_send(s_bmp3_sensor->hspi_ptr, &reg_addr, 1, reg_data, length, TIMEOUT) != HAL_OK)
+	{
+		return BMP3_E_COMM_FAIL;
+	}
+	return BMP3_OK;
 }
 /*!
  *  @brief Function for reading the sensor's registers through SPI bus.
@@ -281,9 +559,11 @@ static int8_t spi_reg_write(uint8_t cs, uint8_t reg_addr, uint8_t *reg_data, uin
  */
 static int8_t spi_reg_read(uint8_t cs, uint8_t reg_addr, uint8_t *reg_data, uint16_t length)
 {
-	int8_t rslt = 0; // assume success
-	spi_receive(s_bmp3_sensor->hspi_ptr, &reg_addr, 1, reg_data, length, TIMEOUT);
-	return rslt;
+	if(spi_receive(s_bmp3_sensor->hspi_ptr, &reg_addr, 1, reg_data, length, TIMEOUT) != HAL_OK)
+	{
+		return BMP3_E_COMM_FAIL;
+	}
+	return BMP3_OK;
 }
 /*!
  *  @brief Prints the execution status of the APIs.
@@ -342,7 +622,10 @@ bool pressure_sensor_test(void)
 	uint8_t command[] = {0x80};
 	uint8_t id_read[] = {0x00,0x00};
 	
-	spi_receive(s_bmp3_sensor->hspi_ptr,command,1,id_read,2,10);
+	if(spi_receive(s_bmp3_sensor->hspi_ptr,command,1,id_read,2,10) != HAL_OK)
+	{
+		return false;
+	}
 	
 	if(id_read[1] == id)
 	{
@@ -352,21 +635,45 @@ bool pressure_sensor_test(void)
 	return result == 1;
 }
 
-bool pressure_sensor_read(pressure_sensor_data * buffer, uint8_t data_rate)
+uint32_t pressure_sensor_rate_hz(const configuration_data_t * parameters)
 {
-	return pdPASS == xQueueReceive(bmp388_queue, buffer, data_rate);
+	//The BMP388 ODR setting halves the rate with every step from 200 Hz.
+	uint32_t odr_hz = 200u >> parameters->values.bmp_odr;
+	if(odr_hz == 0)
+	{
+		odr_hz = 1;
+	}
+#if PRESSURE_SENSOR_FIFO_MODE || PRESSURE_SENSOR_INTERRUPT_MODE
+	return odr_hz;
+#else
+	uint32_t poll_hz = 1000 / parameters->values.data_rate;
+	return (poll_hz < odr_hz) ? poll_hz : odr_hz;
+#endif
 }
 
+void pressure_sensor_reader_init(sample_ring_reader * reader)
+{
+	sample_ring_reader_init(&s_pressure_ring, reader);
+}
+
+bool pressure_sensor_read(sample_ring_reader * reader, pressure_sensor_data * buffer, uint8_t timeout)
+{
+	TickType_t start = xTaskGetTickCount();
+
+	profiler_gauge_update(PROFILER_GAUGE_PRESSURE_BACKLOG, sample_ring_available(&s_pressure_ring, reader));
+	while(!sample_ring_read(&s_pressure_ring, reader, buffer))
+	{
+		if(xTaskGetTickCount() - start >= timeout)
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
+}
 
-void pressure_sensor_data_to_bytes(pressure_sensor_data bmp_reading, uint8_t * bytes)
+bool pressure_sensor_read_latest(pressure_sensor_data * buffer)
 {
-	//Update the header bytes.
-	uint32_t header = (bytes[0] << 16) + (bytes[1] << 8) + bytes[2];
-	header |= PRES_TYPE | TEMP_TYPE;
-	
-	write_24(header, &bytes[0]);
-	write_24(bmp_reading.pressure,    &bytes[15]);
-	write_24(bmp_reading.temperature, &bytes[18]);
-	float altitude = pressure_sensor_calculate_altitude(&bmp_reading);
-	float2bytes(altitude, &bytes[21]);
+	return sample_ring_read_latest(&s_pressure_ring, buffer, NULL);
 }
+
@@ -21,96 +21,7 @@
 #include "configuration.h"
 #include "flash.h"
 #include "hardware_definitions.h"
-
-//-------------------------------------------------------------------------------------------------------------------------------------------------------------
-// Description:
-//  This task will check if the memory is empty and erase it if it is not.
-//
-//	Right now the function assumes that if the first page of memory is empty,
-//	then the whole memory is empty.
-//
-// Returns:
-//
-
-static void eraseFlash(startup_thread_parameters * params){
-
-	  HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN,GPIO_PIN_RESET);
-
-	  FlashStatus stat;
-
-	  Flash flash = params->flash_ptr;
-	  UART  huart = params->huart_ptr;
-	  configuration_data_t * config = params->configuration_data;
-
-	  uint8_t dataRX[256];
-	  uart_transmit_line(huart,"Checking flash memory...");
-	 // Read the first page of memory. If its empty, assume the whole memory is empty.
-	  stat = flash_read_page(flash,config->values.start_data_address,dataRX,256);
-
-	  uint16_t good= 0xFFFF;
-
-	  int i;
-	  for(i=0;i<256;i++){
-
-		  if(dataRX[i] != 0xFF){
-			  good --;
-		  }
-	  }
-
-	  if(good == 0xFFFF){
-		  		  uart_transmit_line(huart,"flash empty.");
-		  		  HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN,GPIO_PIN_RESET);
-
-	  }else{
-
-
-		  uart_transmit_line(huart,"flash not empty.");
-		  //Erase the whole flash. This could take up to 2 minutes.
-	  	  //stat = erase_device(flash);
-		  uint32_t address = FLASH_START_ADDRESS;
-
-		  while(address < config->values.end_data_address){
-
-			  if(address>FLASH_PARAM_END_ADDRESS){
-			  stat = flash_erase_sector(flash,address);
-			  address += FLASH_SECTOR_SIZE;
-			  }
-			  else{
-				  stat = flash_erase_param_sector(flash,address);
-				  address += FLASH_PARAM_SECTOR_SIZE;
-			  }
-			  //Wait for erase to finish
-			  while(FLASH_IS_DEVICE_BUSY(stat)){
-
-				  stat = flash_get_status_register(flash);
-
-				  vTaskDelay(pdMS_TO_TICKS(1));
-			  }
-
-
-		  }
-
-		  flash_read_page(flash,FLASH_START_ADDRESS,dataRX,256);
-		  uint16_t empty = 0xFFFF;
-
-		  for(i=0;i<256;i++){
-
-			  if(dataRX[i] != 0xFF){
-				 empty --;
-			  }
-		  }
-
-		  if(empty == 0xFFFF){
-
-			  uart_transmit_line(huart,"Flash Erased Success!");
-			  HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN,GPIO_PIN_SET);
-			  HAL_Delay(1000);
-			  HAL_GPIO_WritePin(USR_LED_PORT,USR_LED_PIN,GPIO_PIN_RESET);
-		  }
-
-	  }
-}
-
+#include "tasks/flash_writer.h"
 
 void thread_startup_start(void const* pvParams){
 
@@ -120,7 +31,6 @@ void thread_startup_start(void const* pvParams){
 	osThreadId bmpTask_h = sp->pressure_sensor_thread_handle;
 	osThreadId imuTask_h = sp->imu_thread_handle;
 	osThreadId cliTask_h = sp->cli_thread_params;
-	Flash flash = sp->flash_ptr;
 	UART huart = sp->huart_ptr;
 	configuration_data_t * config = sp->configuration_data;
 
@@ -167,7 +77,13 @@ void thread_startup_start(void const* pvParams){
 
 				  }
 
-			  	  eraseFlash(sp);
+				  //The old flight is erased in the background from here on, so arming does not wait for it.
+				  uart_transmit_line(huart, "Erasing old data in the background.");
+				  flash_writer_start_eraser(config->values.end_data_address);
+			  }else{
+
+				  //Keep the data already logged in this flight, only erase ahead of it.
+				  flash_writer_start_eraser(0);
 			  }
 
 			  osThreadResume(dataLoggingTask_h);
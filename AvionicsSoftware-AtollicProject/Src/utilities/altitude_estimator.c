@@ -0,0 +1,122 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the vertical state Kalman filter.
+//
+//  Constant acceleration model, driven by white jerk. Both measurements observe a single state, so each update is
+//  a scalar one: no matrix inverse, and the whole filter is a few dozen multiplies on fixed 3x3 arrays.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "utilities/altitude_estimator.h"
+#include <string.h>
+
+#define N	ALTITUDE_ESTIMATOR_STATES
+
+
+/**
+ * @brief Standard Kalman update for a measurement of x[state] alone (H is a unit row).
+ */
+static void update_single_state(altitude_estimator *estimator, uint8_t state, float measurement, float variance)
+{
+	float innovation_variance = estimator->P[state][state] + variance;
+	float innovation = measurement - estimator->x[state];
+	float gain[N];
+	float row[N];
+
+	for(uint8_t i = 0; i < N; i++)
+	{
+		gain[i] = estimator->P[i][state] / innovation_variance;
+		row[i] = estimator->P[state][i];
+	}
+
+	for(uint8_t i = 0; i < N; i++)
+	{
+		estimator->x[i] += gain[i] * innovation;
+		for(uint8_t j = 0; j < N; j++)
+		{
+			estimator->P[i][j] -= gain[i] * row[j];
+		}
+	}
+}
+
+void altitude_estimator_init(altitude_estimator *estimator, float altitude, uint32_t time_us)
+{
+	memset(estimator, 0, sizeof(altitude_estimator));
+	estimator->x[ALTITUDE_ESTIMATOR_ALTITUDE] = altitude;
+	estimator->P[ALTITUDE_ESTIMATOR_ALTITUDE][ALTITUDE_ESTIMATOR_ALTITUDE] = ALTITUDE_ESTIMATOR_ALTITUDE_NOISE;
+	estimator->P[ALTITUDE_ESTIMATOR_VELOCITY][ALTITUDE_ESTIMATOR_VELOCITY] = 1.0f;
+	estimator->P[ALTITUDE_ESTIMATOR_ACCELERATION][ALTITUDE_ESTIMATOR_ACCELERATION] = ALTITUDE_ESTIMATOR_ACC_NOISE;
+	estimator->last_time_us = time_us;
+	estimator->initialized = true;
+}
+
+void altitude_estimator_predict(altitude_estimator *estimator, uint32_t time_us)
+{
+	int32_t elapsed_us = (int32_t) (time_us - estimator->last_time_us);
+	if(elapsed_us <= 0)
+	{
+		return;
+	}
+	estimator->last_time_us = time_us;
+
+	float dt = elapsed_us * 1e-6f;
+	if(dt > ALTITUDE_ESTIMATOR_MAX_DT)
+	{
+		dt = ALTITUDE_ESTIMATOR_MAX_DT;
+	}
+	float dt2 = dt * dt / 2;
+
+	//x = F x with F = [1 dt dt^2/2; 0 1 dt; 0 0 1]
+	float *x = estimator->x;
+	x[0] += dt * x[1] + dt2 * x[2];
+	x[1] += dt * x[2];
+
+	//P = F P F'. Done as (F P) then (F P) F', using the zeros in F.
+	float (*P)[N] = estimator->P;
+	for(uint8_t j = 0; j < N; j++)
+	{
+		P[0][j] += dt * P[1][j] + dt2 * P[2][j];
+		P[1][j] += dt * P[2][j];
+	}
+	for(uint8_t i = 0; i < N; i++)
+	{
+		P[i][0] += dt * P[i][1] + dt2 * P[i][2];
+		P[i][1] += dt * P[i][2];
+	}
+
+	//P += Q for white jerk of spectral density q.
+	float q = ALTITUDE_ESTIMATOR_JERK_NOISE;
+	float dt3 = dt * dt * dt;
+	float dt4 = dt3 * dt;
+	float dt5 = dt4 * dt;
+	P[0][0] += q * dt5 / 20;
+	P[0][1] += q * dt4 / 8;
+	P[0][2] += q * dt3 / 6;
+	P[1][0] += q * dt4 / 8;
+	P[1][1] += q * dt3 / 3;
+	P[1][2] += q * dt * dt / 2;
+	P[2][0] += q * dt3 / 6;
+	P[2][1] += q * dt * dt / 2;
+	P[2][2] += q * dt;
+}
+
+void altitude_estimator_update_acceleration(altitude_estimator *estimator, float acceleration)
+{
+	update_single_state(estimator, ALTITUDE_ESTIMATOR_ACCELERATION, acceleration, ALTITUDE_ESTIMATOR_ACC_NOISE);
+}
+
+void altitude_estimator_update_altitude(altitude_estimator *estimator, float altitude)
+{
+	update_single_state(estimator, ALTITUDE_ESTIMATOR_ALTITUDE, altitude, ALTITUDE_ESTIMATOR_ALTITUDE_NOISE);
+}
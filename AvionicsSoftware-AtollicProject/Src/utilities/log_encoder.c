@@ -0,0 +1,237 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the version 2 log encoder.
+//
+//  Deltas are zig-zag mapped (0, -1, 1, -2, ... become 0, 1, 2, 3, ...) so small changes of either sign take few
+//  bits, then written as little endian base 128 varints: 7 bits per byte, top bit set on every byte but the last.
+//  With a lower precision the values are rounded before the deltas are taken, so the deltas are smaller too.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "utilities/log_encoder.h"
+#include <string.h>
+#include "utilities/common.h"
+
+
+static uint8_t *put_varint(uint8_t *out, uint32_t value)
+{
+	while(value >= 0x80)
+	{
+		*out++ = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8_t) value;
+	return out;
+}
+
+static uint8_t *put_delta(uint8_t *out, int32_t delta)
+{
+	return put_varint(out, ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31));
+}
+
+/**
+ * @brief value rounded to the nearest multiple of 1 << bits, in units of 1 << bits.
+ */
+static int32_t quantize(int32_t value, uint8_t bits)
+{
+	if(bits == 0)
+	{
+		return value;
+	}
+	return (int32_t) (((int64_t) value + (1 << (bits - 1))) >> bits);
+}
+
+/**
+ * @brief Encodes record against previous and moves previous on to it, with the channels and precision of policy.
+ * @return Number of bytes written to out, at most LOG_RECORD_MAX_SIZE.
+ */
+static uint16_t encode_record(log_record *previous, const log_record *record, const log_policy *policy, uint8_t *out)
+{
+	uint8_t *start = out;
+
+	*out++ = record->types | (record->events ? LOG_RECORD_EVENTS : 0);
+	if(record->events)
+	{
+		*out++ = record->events;
+	}
+
+	out = put_varint(out, record->time_us - previous->time_us);
+	previous->time_us = record->time_us;
+
+	if(record->types & LOG_RECORD_PROFILE)
+	{
+		*out++ = record->profile_id;
+		int values = (record->profile_id < LOG_PROFILE_GAUGE) ? LOG_PROFILE_SPAN_VALUES : 1;
+		for(int i = 0; i < values; i++)
+		{
+			out = put_varint(out, record->profile[i]);
+		}
+		return (uint16_t) (out - start);
+	}
+
+	uint8_t imu_bits = LOG_PRECISION_IMU(policy->precision);
+	uint8_t baro_bits = LOG_PRECISION_BARO(policy->precision);
+
+	if((record->types & LOG_RECORD_IMU) && (policy->channels & LOG_CHANNEL_ACC))
+	{
+		for(int i = 0; i < 3; i++)
+		{
+			int16_t value = (int16_t) quantize(record->acc[i], imu_bits);
+			out = put_delta(out, (int32_t) value - previous->acc[i]);
+			previous->acc[i] = value;
+		}
+	}
+	if((record->types & LOG_RECORD_IMU) && (policy->channels & LOG_CHANNEL_GYRO))
+	{
+		for(int i = 0; i < 3; i++)
+		{
+			int16_t value = (int16_t) quantize(record->gyro[i], imu_bits);
+			out = put_delta(out, (int32_t) value - previous->gyro[i]);
+			previous->gyro[i] = value;
+		}
+	}
+
+	if((record->types & LOG_RECORD_BARO) && (policy->channels & LOG_CHANNEL_PRESSURE))
+	{
+		uint32_t value = (uint32_t) quantize((int32_t) record->pressure, baro_bits);
+		out = put_delta(out, (int32_t) (value - previous->pressure));
+		previous->pressure = value;
+	}
+	if((record->types & LOG_RECORD_BARO) && (policy->channels & LOG_CHANNEL_TEMPERATURE))
+	{
+		int32_t value = quantize(record->temperature, baro_bits);
+		out = put_delta(out, value - previous->temperature);
+		previous->temperature = value;
+	}
+	if((record->types & LOG_RECORD_BARO) && (policy->channels & LOG_CHANNEL_ALTITUDE))
+	{
+		int32_t value = quantize(record->altitude_cm, baro_bits);
+		out = put_delta(out, value - previous->altitude_cm);
+		previous->altitude_cm = value;
+	}
+
+	return (uint16_t) (out - start);
+}
+
+/**
+ * @brief Starts an empty page under the encoder's policy.
+ */
+static void start_page(log_encoder *encoder)
+{
+	//The unused end of a page stays 0xFF, like erased flash.
+	memset(encoder->page, 0xFF, LOG_PAGE_SIZE);
+	encoder->page[0] = LOG_PAGE_MARKER;
+	encoder->page[LOG_PAGE_COUNT] = 0;
+	encoder->page[LOG_PAGE_FIRST_RECORD] = LOG_PAGE_HEADER_SIZE;
+	encoder->page[LOG_PAGE_PHASE] = encoder->policy.phase;
+	encoder->page[LOG_PAGE_CHANNELS] = encoder->policy.channels;
+	encoder->page[LOG_PAGE_PRECISION] = encoder->policy.precision;
+	encoder->length = LOG_PAGE_HEADER_SIZE;
+
+	//The first record of a page is coded against zero, which makes it a keyframe.
+	memset(&encoder->previous, 0, sizeof(log_record));
+}
+
+void log_encoder_init(log_encoder *encoder, const log_policy *policy)
+{
+	encoder->policy = *policy;
+	start_page(encoder);
+}
+
+bool log_encoder_set_policy(log_encoder *encoder, const log_policy *policy, uint8_t *full_page)
+{
+	bool page_full = log_encoder_flush(encoder, full_page);
+
+	encoder->policy = *policy;
+	start_page(encoder);
+	return page_full;
+}
+
+bool log_encoder_flush(log_encoder *encoder, uint8_t *full_page)
+{
+	if(encoder->page[LOG_PAGE_COUNT] == 0)
+	{
+		return false;
+	}
+
+	memcpy(full_page, encoder->page, LOG_PAGE_SIZE);
+	start_page(encoder);
+	return true;
+}
+
+bool log_encoder_append(log_encoder *encoder, const log_record *record, uint8_t *full_page)
+{
+	uint8_t bytes[LOG_RECORD_MAX_SIZE];
+	log_record previous = encoder->previous;
+	bool page_full = false;
+
+	uint16_t length = encode_record(&previous, record, &encoder->policy, bytes);
+	if(encoder->length + length > LOG_PAGE_CRC || encoder->page[LOG_PAGE_COUNT] == UINT8_MAX)
+	{
+		page_full = log_encoder_flush(encoder, full_page);
+		previous = encoder->previous;
+		length = encode_record(&previous, record, &encoder->policy, bytes);
+	}
+
+	memcpy(&encoder->page[encoder->length], bytes, length);
+	encoder->length += length;
+	encoder->page[LOG_PAGE_COUNT]++;
+	encoder->previous = previous;
+
+	return page_full;
+}
+
+void log_encoder_seal(uint8_t *page, uint32_t sequence)
+{
+	write_32(sequence, &page[LOG_PAGE_SEQUENCE]);
+	write_32(crc32(page, LOG_PAGE_CRC), &page[LOG_PAGE_CRC]);
+}
+
+bool log_encoder_verify(const uint8_t *page)
+{
+	return read_32(&page[LOG_PAGE_CRC]) == crc32(page, LOG_PAGE_CRC);
+}
+
+void log_encoder_superblock(const configuration_data_t *configuration, uint8_t *page)
+{
+	memset(page, 0xFF, LOG_PAGE_SIZE);
+
+	write_32(LOG_SUPERBLOCK_MAGIC, &page[0]);
+	page[4] = LOG_FORMAT_VERSION;
+	page[5] = configuration->values.data_rate;
+
+	page[6] = configuration->values.ac_range;
+	page[7] = configuration->values.ac_odr;
+	page[8] = configuration->values.ac_bw;
+
+	page[9] = configuration->values.gy_range;
+	page[10] = configuration->values.gy_odr;
+	page[11] = configuration->values.gy_bw;
+
+	page[12] = configuration->values.bmp_odr;
+	page[13] = configuration->values.pres_os;
+	page[14] = configuration->values.temp_os;
+	page[15] = configuration->values.iir_coef;
+
+	float2bytes(configuration->values.ref_alt, &page[16]);
+	float2bytes(configuration->values.ref_pres, &page[20]);
+
+	memcpy(&page[24], configuration->values.imu_log_rate, CONFIG_LOG_PHASES);
+	memcpy(&page[24 + CONFIG_LOG_PHASES], configuration->values.baro_log_rate, CONFIG_LOG_PHASES);
+	page[24 + 2 * CONFIG_LOG_PHASES] = !IS_LOG_DECIMATING(configuration->values.flags);
+	memcpy(&page[25 + 2 * CONFIG_LOG_PHASES], configuration->values.log_channels, CONFIG_LOG_PHASES);
+	memcpy(&page[25 + 3 * CONFIG_LOG_PHASES], configuration->values.log_precision, CONFIG_LOG_PHASES);
+
+	write_32(crc32(page, LOG_PAGE_CRC), &page[LOG_PAGE_CRC]);
+}
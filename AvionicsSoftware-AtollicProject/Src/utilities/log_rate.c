@@ -0,0 +1,202 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the log rates.
+//
+//  A decimator is scheduled on the sample time stamps, not on a sample count, so the log rate stays the same when the
+//  sensor ODR changes or samples are lost.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "utilities/log_rate.h"
+#include <string.h>
+
+typedef struct
+{
+	uint8_t channel;
+	uint8_t values;
+	uint8_t bits;		//Typical size of a zig-zag mapped delta at full precision, from SITL flights.
+	bool imu;
+} log_rate_channel;
+
+static const char *const s_phase_names[LOG_NUM_PHASES] =
+{
+	"pad",
+	"ascent",
+	"drogue",
+	"main",
+	"landed",
+};
+
+static const log_rate_channel s_channels[] =
+{
+	{LOG_CHANNEL_ACC,			3,	7,	true	},
+	{LOG_CHANNEL_GYRO,			3,	7,	true	},
+	{LOG_CHANNEL_PRESSURE,		1,	12,	false	},
+	{LOG_CHANNEL_TEMPERATURE,	1,	7,	false	},
+	{LOG_CHANNEL_ALTITUDE,		1,	10,	false	},
+};
+
+/**
+ * @brief Estimated bytes of the deltas of one sensor's channels in a record.
+ */
+static uint32_t channel_bytes(const log_policy *policy, bool imu)
+{
+	uint8_t dropped = imu ? LOG_PRECISION_IMU(policy->precision) : LOG_PRECISION_BARO(policy->precision);
+	uint32_t bytes = 0;
+
+	for(uint8_t i = 0; i < sizeof(s_channels) / sizeof(s_channels[0]); i++)
+	{
+		const log_rate_channel *channel = &s_channels[i];
+		if(channel->imu != imu || !(policy->channels & channel->channel))
+		{
+			continue;
+		}
+
+		//7 bits per varint byte, never less than one byte.
+		uint8_t bits = (channel->bits > dropped + 7) ? channel->bits - dropped : 7;
+		bytes += channel->values * ((bits + 6) / 7);
+	}
+	return bytes;
+}
+
+const char *log_rate_phase_name(log_phase phase)
+{
+	return s_phase_names[phase];
+}
+
+uint32_t log_rate_effective_hz(uint8_t rate_hz, uint32_t sensor_hz)
+{
+	if(rate_hz == 0)
+	{
+		return 0;
+	}
+	if(rate_hz == LOG_RATE_ALL || rate_hz > sensor_hz)
+	{
+		return sensor_hz;
+	}
+	return rate_hz;
+}
+
+void log_rate_policy(const configuration_data_t *configuration, log_phase phase, log_policy *policy)
+{
+	policy->phase = phase;
+	policy->channels = configuration->values.log_channels[phase] & LOG_CHANNELS_ALL;
+	policy->precision = configuration->values.log_precision[phase];
+}
+
+uint8_t log_rate_imu(const configuration_data_t *configuration, log_phase phase)
+{
+	return (configuration->values.log_channels[phase] & LOG_CHANNELS_IMU) ? configuration->values.imu_log_rate[phase] : 0;
+}
+
+uint8_t log_rate_baro(const configuration_data_t *configuration, log_phase phase)
+{
+	return (configuration->values.log_channels[phase] & LOG_CHANNELS_BARO) ? configuration->values.baro_log_rate[phase] : 0;
+}
+
+uint32_t log_rate_bytes_per_second(const log_policy *policy, uint32_t imu_hz, uint32_t baro_hz)
+{
+	uint32_t combined = (imu_hz < baro_hz) ? imu_hz : baro_hz;
+	uint32_t record_bytes = (imu_hz + baro_hz - combined) * LOG_RATE_RECORD_BYTES
+							+ imu_hz * channel_bytes(policy, true) + baro_hz * channel_bytes(policy, false);
+
+	//Only the bytes between the page header and the CRC hold records.
+	return (uint32_t) ((uint64_t) record_bytes * LOG_PAGE_SIZE / (LOG_PAGE_CRC - LOG_PAGE_HEADER_SIZE));
+}
+
+void log_decimator_set_rate(log_decimator *decimator, uint8_t values, uint8_t rate_hz, bool average)
+{
+	uint32_t period_us = (rate_hz == 0 || rate_hz == LOG_RATE_ALL) ? 0 : 1000000u / rate_hz;
+
+	if(decimator->values != values)
+	{
+		memset(decimator, 0, sizeof(log_decimator));
+		decimator->values = values;
+	}
+
+	//The next record stays where it was due, unless the new period brings it closer.
+	if(decimator->started && period_us < decimator->period_us)
+	{
+		decimator->due_us -= decimator->period_us - period_us;
+	}
+
+	decimator->period_us = period_us;
+	decimator->enabled = (rate_hz != 0);
+	decimator->average = average;
+}
+
+bool log_decimator_add(log_decimator *decimator, uint32_t time_us, const int32_t *sample)
+{
+	if(!decimator->enabled)
+	{
+		return false;
+	}
+
+	if(decimator->average && decimator->count < UINT16_MAX)
+	{
+		for(uint8_t i = 0; i < decimator->values; i++)
+		{
+			decimator->sum[i] += sample[i];
+		}
+		decimator->count++;
+	}else
+	{
+		for(uint8_t i = 0; i < decimator->values; i++)
+		{
+			decimator->sum[i] = sample[i];
+		}
+		decimator->count = 1;
+	}
+
+	//Starts the schedule, or starts it over if the clock went back, as it does when the IMU time base first locks on.
+	if(!decimator->started || (int32_t) (decimator->due_us - time_us) > 2 * (int32_t) decimator->period_us)
+	{
+		decimator->started = true;
+		decimator->due_us = time_us;
+	}
+
+	//A sample up to half a period early is taken. Otherwise a log rate at or close to the sensor rate would skip
+	//every sample that the jitter brings in just before it is due.
+	if((int32_t) (time_us - decimator->due_us) < -(int32_t) (decimator->period_us / 2))
+	{
+		return false;
+	}
+
+	//Keep to the schedule, but do not try to catch up after a gap.
+	decimator->due_us += decimator->period_us;
+	if((int32_t) (time_us - decimator->due_us) >= 0)
+	{
+		decimator->due_us = time_us + decimator->period_us;
+	}
+	return true;
+}
+
+bool log_decimator_take(log_decimator *decimator, int32_t *value)
+{
+	if(decimator->count == 0)
+	{
+		return false;
+	}
+
+	for(uint8_t i = 0; i < decimator->values; i++)
+	{
+		//Rounded to the nearest, halves away from zero.
+		int64_t sum = decimator->sum[i];
+		int64_t half = decimator->count / 2;
+		value[i] = (int32_t) ((sum >= 0 ? sum + half : sum - half) / decimator->count);
+		decimator->sum[i] = 0;
+	}
+	decimator->count = 0;
+	return true;
+}
@@ -0,0 +1,81 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the math utilities that need more than a header: the barometric altitude kernel.
+//
+//  The barometric formula needs (ref / p)^(1/5.257). Rather than calling powf for every sample, p^(-1/5.257) is
+//  tabulated every 1 kPa and interpolated with a cubic Hermite spline. The slope at each node is exact
+//  (d/dp p^-e = -e * p^-e / p), so no second table is needed.
+//
+//  Between 20 kPa and 120 kPa (about 12 km above to 1 km below sea level) the interpolation itself is good to under
+//  1 mm of altitude. With float rounding the result stays within 2 cm of the exact formula evaluated in double, for
+//  reference pressures of 80 kPa to 105 kPa. Outside that range the kernel falls back to powf.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "utilities/math.h"
+
+#define PRESSURE_EXPONENT		(1 / 5.257F)
+#define TABLE_MIN_PA			20000.0F
+#define TABLE_STEP_PA			1000.0F
+#define TABLE_SIZE				101
+
+//p^(-1/5.257) for p = 20 kPa, 21 kPa, ... 120 kPa.
+static const float s_pressure_power_table[TABLE_SIZE] =
+{
+	0.152001216f, 0.150597020f, 0.149270243f, 0.148013376f, 0.146819927f, 0.145684246f, 0.144601389f, 0.143567004f,
+	0.142577243f, 0.141628686f, 0.140718284f, 0.139843305f, 0.139001292f, 0.138190029f, 0.137407513f, 0.136651921f,
+	0.135921598f, 0.135215031f, 0.134530835f, 0.133867741f, 0.133224582f, 0.132600281f, 0.131993846f, 0.131404357f,
+	0.130830964f, 0.130272876f, 0.129729357f, 0.129199723f, 0.128683334f, 0.128179594f, 0.127687944f, 0.127207860f,
+	0.126738852f, 0.126280458f, 0.125832244f, 0.125393802f, 0.124964748f, 0.124544716f, 0.124133366f, 0.123730371f,
+	0.123335425f, 0.122948237f, 0.122568531f, 0.122196046f, 0.121830532f, 0.121471753f, 0.121119484f, 0.120773512f,
+	0.120433631f, 0.120099649f, 0.119771378f, 0.119448642f, 0.119131271f, 0.118819104f, 0.118511986f, 0.118209768f,
+	0.117912308f, 0.117619471f, 0.117331126f, 0.117047148f, 0.116767416f, 0.116491815f, 0.116220235f, 0.115952568f,
+	0.115688712f, 0.115428569f, 0.115172043f, 0.114919043f, 0.114669481f, 0.114423271f, 0.114180333f, 0.113940586f,
+	0.113703955f, 0.113470365f, 0.113239746f, 0.113012029f, 0.112787147f, 0.112565035f, 0.112345633f, 0.112128880f,
+	0.111914716f, 0.111703087f, 0.111493937f, 0.111287213f, 0.111082865f, 0.110880842f, 0.110681096f, 0.110483581f,
+	0.110288250f, 0.110095060f, 0.109903969f, 0.109714934f, 0.109527915f, 0.109342873f, 0.109159770f, 0.108978569f,
+	0.108799233f, 0.108621728f, 0.108446020f, 0.108272075f, 0.108099862f
+};
+
+
+float math_pressure_power(float pressure)
+{
+	float position = (pressure - TABLE_MIN_PA) / TABLE_STEP_PA;
+	if(!(position >= 0.0F && position < (TABLE_SIZE - 1)))
+	{
+		return powf(pressure, -PRESSURE_EXPONENT);
+	}
+	
+	uint32_t i = (uint32_t) position;
+	float t = position - i;
+	float p0 = TABLE_MIN_PA + i * TABLE_STEP_PA;
+	float y0 = s_pressure_power_table[i];
+	float y1 = s_pressure_power_table[i + 1];
+	
+	//Node slopes scaled to one table step.
+	float m0 = -PRESSURE_EXPONENT * TABLE_STEP_PA * y0 / p0;
+	float m1 = -PRESSURE_EXPONENT * TABLE_STEP_PA * y1 / (p0 + TABLE_STEP_PA);
+	
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return (2 * t3 - 3 * t2 + 1) * y0 + (t3 - 2 * t2 + t) * m0 + (-2 * t3 + 3 * t2) * y1 + (t3 - t2) * m1;
+}
+
+float math_fast_altitude(float pressure, float temperature, float ref_pres, float ref_alt)
+{
+	//(ref / p)^e = p^-e / ref^-e
+	float p_term = math_pressure_power(pressure) / math_pressure_power(ref_pres) - 1;
+	float t_term = temperature + 273.15F;
+	return (p_term * t_term) / 0.0065F + ref_alt;
+}
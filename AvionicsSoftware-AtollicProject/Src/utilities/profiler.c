@@ -0,0 +1,205 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the hot path timing.
+//
+//  Spans end in several tasks, and the SPI one at more than one priority, so each update is done with interrupts
+//  masked. It is a few dozen cycles: no division, and the histogram bucket comes from one CLZ.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "utilities/profiler.h"
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct
+{
+	uint32_t count;
+	uint64_t total;
+	uint32_t min;
+	uint32_t max;
+	uint32_t histogram[PROFILER_HISTOGRAM_BUCKETS];
+} span_statistics;
+
+volatile bool profiler_running;
+
+static span_statistics s_spans[PROFILER_NUM_SPANS];
+static uint32_t s_gauges[PROFILER_NUM_GAUGES];
+
+static const char *const s_span_names[PROFILER_NUM_SPANS] =
+{
+	"spi transaction",
+	"imu read",
+	"pressure read",
+	"altitude",
+	"estimator",
+	"state machine",
+	"page hand off",
+	"flash program",
+};
+
+static const char *const s_gauge_names[PROFILER_NUM_GAUGES] =
+{
+	"imu backlog",
+	"pressure backlog",
+	"flash queue",
+};
+
+
+/**
+ * @brief Histogram bucket of a duration. Below 4 cycles each value has its own bucket, above that each power of two
+ * is split in four.
+ */
+static uint32_t bucket_of(uint32_t cycles)
+{
+	if(cycles < 4)
+	{
+		return cycles;
+	}
+
+	uint32_t octave = 31 - __builtin_clz(cycles);
+	uint32_t bucket = 4 * (octave - 1) + ((cycles >> (octave - 2)) & 3);
+	return (bucket < PROFILER_HISTOGRAM_BUCKETS) ? bucket : PROFILER_HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * @brief Largest duration that goes in a bucket.
+ */
+static uint32_t bucket_upper_edge(uint32_t bucket)
+{
+	if(bucket < 4)
+	{
+		return bucket;
+	}
+	if(bucket == PROFILER_HISTOGRAM_BUCKETS - 1)
+	{
+		return UINT32_MAX;
+	}
+
+	uint32_t shift = bucket / 4 - 1;
+	return ((5 + bucket % 4) << shift) - 1;
+}
+
+static void clear(void)
+{
+	memset(s_spans, 0, sizeof(s_spans));
+	memset(s_gauges, 0, sizeof(s_gauges));
+	for(int i = 0; i < PROFILER_NUM_SPANS; i++)
+	{
+		s_spans[i].min = UINT32_MAX;
+	}
+}
+
+void profiler_init(void)
+{
+	clear();
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	profiler_running = PROFILER_MODE;
+}
+
+void profiler_set_running(bool running)
+{
+	profiler_running = running && PROFILER_MODE;
+}
+
+void profiler_reset(void)
+{
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	clear();
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void profiler_record(profiler_span span, uint32_t cycles)
+{
+	span_statistics *statistics = &s_spans[span];
+	uint32_t bucket = bucket_of(cycles);
+
+	//Saves and restores the mask, so it also works before the scheduler has started and inside a critical section.
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	statistics->count++;
+	statistics->total += cycles;
+	if(cycles < statistics->min)
+	{
+		statistics->min = cycles;
+	}
+	if(cycles > statistics->max)
+	{
+		statistics->max = cycles;
+	}
+	statistics->histogram[bucket]++;
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void profiler_record_gauge(profiler_gauge gauge, uint32_t value)
+{
+	//A lost race only loses a value that was about to be overtaken anyway, so no lock.
+	if(value > s_gauges[gauge])
+	{
+		s_gauges[gauge] = value;
+	}
+}
+
+void profiler_get_span(profiler_span span, profiler_span_summary *summary)
+{
+	const span_statistics *statistics = &s_spans[span];
+
+	memset(summary, 0, sizeof(profiler_span_summary));
+
+	//Summed up straight from the span with interrupts masked, so a duration recorded meanwhile is either all in or
+	//all out, and two tasks asking at once each get their own. The walk is at most one pass over the buckets.
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	if(statistics->count > 0)
+	{
+		summary->count = statistics->count;
+		summary->min = statistics->min;
+		summary->max = statistics->max;
+		summary->mean = (uint32_t) (statistics->total / statistics->count);
+
+		//The bucket where the running count reaches 99% of all the samples.
+		uint32_t target = statistics->count - statistics->count / 100;
+		uint32_t seen = 0;
+		uint32_t bucket;
+		for(bucket = 0; bucket < PROFILER_HISTOGRAM_BUCKETS - 1; bucket++)
+		{
+			seen += statistics->histogram[bucket];
+			if(seen >= target)
+			{
+				break;
+			}
+		}
+
+		uint32_t edge = bucket_upper_edge(bucket);
+		summary->p99 = (edge < statistics->max) ? edge : statistics->max;
+	}
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+uint32_t profiler_get_gauge(profiler_gauge gauge)
+{
+	return s_gauges[gauge];
+}
+
+const char *profiler_span_name(profiler_span span)
+{
+	return s_span_names[span];
+}
+
+const char *profiler_gauge_name(profiler_gauge gauge)
+{
+	return s_gauge_names[gauge];
+}
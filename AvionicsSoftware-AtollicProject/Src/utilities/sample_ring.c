@@ -0,0 +1,135 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Source file for the single writer, many reader sample ring.
+//
+//  The writer marks a slot as being written (sequence 0), copies the sample in, then stamps the slot with the
+//  sample's number. A reader checks the stamp before and after copying a sample out: if it changed, the writer got
+//  to the slot in the meantime and the copy is thrown away. The barriers are the GCC __atomic builtins, which are a
+//  DMB on the Cortex-M4 and also hold on a multi core host.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "utilities/sample_ring.h"
+#include <string.h>
+
+
+/**
+ * @brief Copies sample number out of its slot.
+ * @return false if the slot no longer (or does not yet) hold that sample.
+ */
+static bool copy_sample(const sample_ring *ring, uint32_t number, void *sample)
+{
+	uint32_t slot = number & ring->mask;
+	uint32_t before = __atomic_load_n(&ring->sequences[slot], __ATOMIC_ACQUIRE);
+
+	if(before != number + 1)
+	{
+		return false;
+	}
+
+	memcpy(sample, &ring->samples[slot * ring->sample_size], ring->sample_size);
+
+	//The copy has to be done before the stamp is looked at again.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&ring->sequences[slot], __ATOMIC_RELAXED) == before;
+}
+
+void sample_ring_init(sample_ring *ring, void *samples, uint32_t *sequences, size_t sample_size, uint32_t capacity)
+{
+	ring->samples = (uint8_t *) samples;
+	ring->sequences = sequences;
+	ring->sample_size = sample_size;
+	ring->mask = capacity - 1;
+	ring->written = 0;
+	memset(sequences, 0, capacity * sizeof(uint32_t));
+}
+
+void sample_ring_write(sample_ring *ring, const void *sample)
+{
+	uint32_t number = ring->written;
+	uint32_t slot = number & ring->mask;
+
+	__atomic_store_n(&ring->sequences[slot], 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(&ring->samples[slot * ring->sample_size], sample, ring->sample_size);
+
+	__atomic_store_n(&ring->sequences[slot], number + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->written, number + 1, __ATOMIC_RELEASE);
+}
+
+void sample_ring_reader_init(const sample_ring *ring, sample_ring_reader *reader)
+{
+	reader->next = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+	reader->overruns = 0;
+}
+
+bool sample_ring_read(const sample_ring *ring, sample_ring_reader *reader, void *sample)
+{
+	while(1)
+	{
+		uint32_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+		uint32_t behind = written - reader->next;
+
+		if(behind == 0)
+		{
+			return false;
+		}
+
+		if(behind > ring->mask + 1)
+		{
+			uint32_t lost = behind - (ring->mask + 1);
+			reader->overruns += lost;
+			reader->next += lost;
+		}
+
+		if(copy_sample(ring, reader->next, sample))
+		{
+			reader->next++;
+			return true;
+		}
+
+		//Overwritten while it was being copied, so it is lost as well.
+		reader->overruns++;
+		reader->next++;
+	}
+}
+
+bool sample_ring_read_latest(const sample_ring *ring, void *sample, uint32_t *number)
+{
+	while(1)
+	{
+		uint32_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+
+		if(written == 0)
+		{
+			return false;
+		}
+
+		if(copy_sample(ring, written - 1, sample))
+		{
+			if(number != NULL)
+			{
+				*number = written - 1;
+			}
+			return true;
+		}
+	}
+}
+
+uint32_t sample_ring_available(const sample_ring *ring, const sample_ring_reader *reader)
+{
+	uint32_t behind = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE) - reader->next;
+	return (behind > ring->mask + 1) ? ring->mask + 1 : behind;
+}
@@ -0,0 +1,36 @@
+#ifndef SITL_CMSIS_GCC_H
+#define SITL_CMSIS_GCC_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Stand in for the CMSIS core intrinsics in the host build, with just what cmsis_os.c uses.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Interrupt program status, from the port.
+//
+// Returns:
+//  Non zero while a simulated interrupt handler is running.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t __get_IPSR(void);
+
+#define __DMB()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif // SITL_CMSIS_GCC_H
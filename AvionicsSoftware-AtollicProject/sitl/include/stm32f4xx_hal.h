@@ -0,0 +1,285 @@
+#ifndef SITL_STM32F4XX_HAL_H
+#define SITL_STM32F4XX_HAL_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Stand in for the STM32F4 HAL in the host build, with the GPIO and NVIC calls the firmware makes outside the
+//  drivers that sitl/ replaces. Pins are simulated in sim_board.c.
+//
+//  Also the SPI, DMA and RCC parts of the HAL that SPI.c uses. The SITL build replaces SPI.c with sim_spi.c, so only
+//  tests/test_spi.c builds against them, and it simulates the peripheral behind them.
+//
+// History
+// 2026-10-17
+// - Created.
+// 2026-10-18
+// - The SPI, DMA and RCC parts SPI.c uses.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdint.h>
+#include "cmsis_gcc.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define GPIO_PIN_0				((uint16_t) 0x0001)
+#define GPIO_PIN_1				((uint16_t) 0x0002)
+#define GPIO_PIN_2				((uint16_t) 0x0004)
+#define GPIO_PIN_3				((uint16_t) 0x0008)
+#define GPIO_PIN_4				((uint16_t) 0x0010)
+#define GPIO_PIN_5				((uint16_t) 0x0020)
+#define GPIO_PIN_6				((uint16_t) 0x0040)
+#define GPIO_PIN_7				((uint16_t) 0x0080)
+#define GPIO_PIN_8				((uint16_t) 0x0100)
+#define GPIO_PIN_9				((uint16_t) 0x0200)
+#define GPIO_PIN_10				((uint16_t) 0x0400)
+#define GPIO_PIN_11				((uint16_t) 0x0800)
+#define GPIO_PIN_12				((uint16_t) 0x1000)
+#define GPIO_PIN_13				((uint16_t) 0x2000)
+#define GPIO_PIN_14				((uint16_t) 0x4000)
+#define GPIO_PIN_15				((uint16_t) 0x8000)
+
+#define GPIO_MODE_INPUT			0x00000000U
+#define GPIO_MODE_OUTPUT_PP		0x00000001U
+#define GPIO_MODE_AF_PP			0x00000002U
+#define GPIO_MODE_IT_RISING		0x10110000U
+
+#define GPIO_NOPULL				0x00000000U
+#define GPIO_PULLUP				0x00000001U
+#define GPIO_PULLDOWN			0x00000002U
+
+#define GPIO_SPEED_FREQ_LOW			0x00000000U
+#define GPIO_SPEED_FREQ_MEDIUM		0x00000001U
+#define GPIO_SPEED_FREQ_HIGH		0x00000002U
+#define GPIO_SPEED_FREQ_VERY_HIGH	0x00000003U
+
+typedef struct
+{
+	uint16_t inputs;	//Level the outside world drives each pin to.
+	uint16_t outputs;	//Level the firmware drives each pin to.
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef sim_gpio_a;
+extern GPIO_TypeDef sim_gpio_b;
+extern GPIO_TypeDef sim_gpio_c;
+
+#define GPIOA					(&sim_gpio_a)
+#define GPIOB					(&sim_gpio_b)
+#define GPIOC					(&sim_gpio_c)
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()
+#define __HAL_RCC_GPIOB_CLK_ENABLE()
+#define __HAL_RCC_GPIOC_CLK_ENABLE()
+
+typedef enum
+{
+	HAL_OK = 0,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct
+{
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+	uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+	DMA1_Stream0_IRQn = 11,
+	DMA1_Stream3_IRQn = 14,
+	DMA1_Stream4_IRQn = 15,
+	DMA1_Stream5_IRQn = 16,
+	EXTI9_5_IRQn = 23,
+	DMA2_Stream0_IRQn = 56,
+	DMA2_Stream3_IRQn = 59
+} IRQn_Type;
+
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)		((REG) = (((REG) & ~(CLEARMASK)) | (SETMASK)))
+
+//SPI. Only CR1 is there, for the clock and mode bits SPI.c changes between devices.
+typedef struct
+{
+	uint32_t CR1;
+} SPI_TypeDef;
+
+extern SPI_TypeDef sim_spi1;
+extern SPI_TypeDef sim_spi2;
+extern SPI_TypeDef sim_spi3;
+
+#define SPI1						(&sim_spi1)
+#define SPI2						(&sim_spi2)
+#define SPI3						(&sim_spi3)
+
+#define SPI_CR1_CPHA				0x00000001U
+#define SPI_CR1_CPOL				0x00000002U
+#define SPI_CR1_BR_Pos				3U
+#define SPI_CR1_BR					0x00000038U
+#define SPI_CR1_SPE					0x00000040U
+
+#define SPI_MODE_MASTER				0x00000104U
+#define SPI_DIRECTION_2LINES		0x00000000U
+#define SPI_DATASIZE_8BIT			0x00000000U
+#define SPI_POLARITY_LOW			0x00000000U
+#define SPI_POLARITY_HIGH			SPI_CR1_CPOL
+#define SPI_PHASE_1EDGE				0x00000000U
+#define SPI_PHASE_2EDGE				SPI_CR1_CPHA
+#define SPI_NSS_SOFT				0x00000200U
+#define SPI_BAUDRATEPRESCALER_256	0x00000038U
+#define SPI_FIRSTBIT_MSB			0x00000000U
+#define SPI_TIMODE_DISABLE			0x00000000U
+#define SPI_CRCCALCULATION_DISABLE	0x00000000U
+
+#define GPIO_AF5_SPI1				0x05U
+#define GPIO_AF5_SPI2				0x05U
+#define GPIO_AF6_SPI3				0x06U
+
+#define __HAL_RCC_SPI1_CLK_ENABLE()
+#define __HAL_RCC_SPI2_CLK_ENABLE()
+#define __HAL_RCC_SPI3_CLK_ENABLE()
+#define __HAL_RCC_DMA1_CLK_ENABLE()
+#define __HAL_RCC_DMA2_CLK_ENABLE()
+
+#define __HAL_SPI_DISABLE(__HANDLE__)	((__HANDLE__)->Instance->CR1 &= ~SPI_CR1_SPE)
+
+//DMA. A stream is only told apart by its address.
+typedef struct
+{
+	uint32_t CR;
+} DMA_Stream_TypeDef;
+
+extern DMA_Stream_TypeDef sim_dma1_streams[8];
+extern DMA_Stream_TypeDef sim_dma2_streams[8];
+
+#define DMA1_Stream0				(&sim_dma1_streams[0])
+#define DMA1_Stream3				(&sim_dma1_streams[3])
+#define DMA1_Stream4				(&sim_dma1_streams[4])
+#define DMA1_Stream5				(&sim_dma1_streams[5])
+#define DMA2_Stream0				(&sim_dma2_streams[0])
+#define DMA2_Stream3				(&sim_dma2_streams[3])
+
+#define DMA_CHANNEL_0				0x00000000U
+#define DMA_CHANNEL_3				0x06000000U
+#define DMA_PERIPH_TO_MEMORY		0x00000000U
+#define DMA_MEMORY_TO_PERIPH		0x00000040U
+#define DMA_PINC_DISABLE			0x00000000U
+#define DMA_MINC_ENABLE				0x00000400U
+#define DMA_PDATAALIGN_BYTE			0x00000000U
+#define DMA_MDATAALIGN_BYTE			0x00000000U
+#define DMA_NORMAL					0x00000000U
+#define DMA_PRIORITY_MEDIUM			0x00010000U
+#define DMA_PRIORITY_HIGH			0x00020000U
+#define DMA_FIFOMODE_DISABLE		0x00000000U
+
+typedef struct
+{
+	uint32_t Channel;
+	uint32_t Direction;
+	uint32_t PeriphInc;
+	uint32_t MemInc;
+	uint32_t PeriphDataAlignment;
+	uint32_t MemDataAlignment;
+	uint32_t Mode;
+	uint32_t Priority;
+	uint32_t FIFOMode;
+} DMA_InitTypeDef;
+
+typedef struct
+{
+	DMA_Stream_TypeDef *Instance;
+	DMA_InitTypeDef Init;
+	void *Parent;
+} DMA_HandleTypeDef;
+
+typedef struct
+{
+	uint32_t Mode;
+	uint32_t Direction;
+	uint32_t DataSize;
+	uint32_t CLKPolarity;
+	uint32_t CLKPhase;
+	uint32_t NSS;
+	uint32_t BaudRatePrescaler;
+	uint32_t FirstBit;
+	uint32_t TIMode;
+	uint32_t CRCCalculation;
+	uint32_t CRCPolynomial;
+} SPI_InitTypeDef;
+
+typedef struct
+{
+	SPI_TypeDef *Instance;
+	SPI_InitTypeDef Init;
+	DMA_HandleTypeDef *hdmatx;
+	DMA_HandleTypeDef *hdmarx;
+} SPI_HandleTypeDef;
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+	do \
+	{ \
+		(__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__); \
+		(__DMA_HANDLE__).Parent = (__HANDLE__); \
+	} while(0)
+
+//The DWT cycle counter, which counts simulated time at the core clock. Reading DWT brings CYCCNT up to date.
+typedef struct
+{
+	uint32_t CTRL;
+	uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+	uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern CoreDebug_Type sim_core_debug;
+
+#define DWT								(sim_dwt())
+#define CoreDebug						(&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk			0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk		0x01000000U
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+DWT_Type *sim_dwt(void);
+
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi);
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi);
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi);
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi);
+
+#endif // SITL_STM32F4XX_HAL_H
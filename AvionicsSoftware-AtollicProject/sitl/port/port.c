@@ -0,0 +1,290 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  FreeRTOS port for the host software in the loop build.
+//
+//  Each task gets a host stack and a ucontext; pxTopOfStack in its control block points at the task's context, so
+//  a switch is vTaskSwitchContext followed by swapcontext. Nothing runs concurrently: an interrupt handler runs on
+//  the stack of whatever task was running when it fell due, with s_in_isr set, and a switch it asks for happens once
+//  it returns, like PendSV. The clock only moves in vPortSimConsume and, when every task is blocked, in the idle
+//  hook, which jumps straight to the next interrupt.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SIM_TASK_STACK_BYTES	(256 * 1024)	//Host stack of each task. The firmware's own stack arrays go unused.
+#define SIM_TICK_US				(1000000 / configTICK_RATE_HZ)
+
+typedef struct
+{
+	ucontext_t context;
+	TaskFunction_t code;
+	void *parameters;
+} sim_task;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+extern void * volatile pxCurrentTCB;
+void xPortSysTickHandler(void);
+
+static ucontext_t s_main_context;			//Where xPortStartScheduler was called from.
+
+static uint64_t s_now_us;
+static uint64_t s_next_tick_us = SIM_TICK_US;
+static uint64_t s_next_interrupt_us;		//Next call to ulApplicationSimInterrupts, 0 to call it as soon as allowed.
+
+static UBaseType_t s_critical_nesting;
+static BaseType_t s_interrupts_disabled;
+static BaseType_t s_in_isr;
+static BaseType_t s_yield_pending;
+static BaseType_t s_scheduler_running;
+
+
+/**
+ * @brief The context of the task pxCurrentTCB points at. The first member of a TCB is pxTopOfStack.
+ */
+static sim_task *current_task(void)
+{
+	StackType_t *top_of_stack = *(StackType_t **) pxCurrentTCB;
+	sim_task *task;
+
+	memcpy(&task, top_of_stack, sizeof(task));
+	return task;
+}
+
+static void task_entry(void)
+{
+	sim_task *task = current_task();
+	task->code(task->parameters);
+
+	//Tasks have to delete themselves rather than return.
+	vPortAssert(__FILE__, __LINE__);
+}
+
+static BaseType_t interrupts_allowed(void)
+{
+	return s_scheduler_running && s_critical_nesting == 0 && !s_interrupts_disabled && !s_in_isr;
+}
+
+static uint64_t next_interrupt(void)
+{
+	return (s_next_tick_us < s_next_interrupt_us) ? s_next_tick_us : s_next_interrupt_us;
+}
+
+static void switch_context(void)
+{
+	sim_task *from = current_task();
+	vTaskSwitchContext();
+	sim_task *to = current_task();
+
+	if(from != to)
+	{
+		swapcontext(&from->context, &to->context);
+	}
+}
+
+/**
+ * @brief Runs the interrupts that are due, then switches task if one of them (or the running task) asked to.
+ */
+static void service_interrupts(void)
+{
+	if(!interrupts_allowed())
+	{
+		return;
+	}
+
+	s_in_isr = pdTRUE;
+	while(next_interrupt() <= s_now_us)
+	{
+		if(s_next_tick_us <= s_next_interrupt_us)
+		{
+			s_next_tick_us += SIM_TICK_US;
+			xPortSysTickHandler();
+		}
+		else
+		{
+			s_next_interrupt_us = ulApplicationSimInterrupts(s_now_us);
+		}
+	}
+	s_in_isr = pdFALSE;
+
+	if(s_yield_pending)
+	{
+		s_yield_pending = pdFALSE;
+		switch_context();
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters)
+{
+	sim_task *task = calloc(1, sizeof(sim_task));
+	void *stack = malloc(SIM_TASK_STACK_BYTES);
+	configASSERT(task != NULL && stack != NULL);
+
+	task->code = pxCode;
+	task->parameters = pvParameters;
+	getcontext(&task->context);
+	task->context.uc_stack.ss_sp = stack;
+	task->context.uc_stack.ss_size = SIM_TASK_STACK_BYTES;
+	task->context.uc_link = NULL;
+	makecontext(&task->context, task_entry, 0);
+
+	//pxTopOfStack is 8 byte aligned, so two words below it hold the pointer.
+	pxTopOfStack -= sizeof(sim_task *) / sizeof(StackType_t);
+	memcpy(pxTopOfStack, &task, sizeof(task));
+	return pxTopOfStack;
+}
+
+BaseType_t xPortStartScheduler(void)
+{
+	s_scheduler_running = pdTRUE;
+	s_interrupts_disabled = pdFALSE;
+	s_critical_nesting = 0;
+	s_yield_pending = pdFALSE;
+	s_next_tick_us = s_now_us + SIM_TICK_US;
+
+	swapcontext(&s_main_context, &current_task()->context);
+	return pdFALSE;
+}
+
+void vPortEndScheduler(void)
+{
+	s_scheduler_running = pdFALSE;
+	swapcontext(&current_task()->context, &s_main_context);
+}
+
+void vPortYield(void)
+{
+	if(interrupts_allowed())
+	{
+		switch_context();
+	}
+	else
+	{
+		s_yield_pending = pdTRUE;
+	}
+}
+
+void vPortYieldFromISR(BaseType_t xSwitchRequired)
+{
+	if(xSwitchRequired != pdFALSE)
+	{
+		vPortYield();
+	}
+}
+
+void vPortEnterCritical(void)
+{
+	s_critical_nesting++;
+}
+
+void vPortExitCritical(void)
+{
+	configASSERT(s_critical_nesting > 0);
+	if(--s_critical_nesting == 0)
+	{
+		service_interrupts();
+	}
+}
+
+void vPortDisableInterrupts(void)
+{
+	s_interrupts_disabled = pdTRUE;
+}
+
+void vPortEnableInterrupts(void)
+{
+	s_interrupts_disabled = pdFALSE;
+	service_interrupts();
+}
+
+void xPortSysTickHandler(void)
+{
+	if(xTaskIncrementTick() != pdFALSE)
+	{
+		s_yield_pending = pdTRUE;
+	}
+}
+
+void vApplicationIdleHook(void)
+{
+	//Nothing else can run until the next interrupt, so there is no point simulating the time in between.
+	uint64_t next = next_interrupt();
+	if(next > s_now_us)
+	{
+		s_now_us = next;
+	}
+	service_interrupts();
+}
+
+void vPortAssert(const char *pcFile, int xLine)
+{
+	fprintf(stderr, "sitl: assert failed at %s:%d, %.6f s into the flight\n", pcFile, xLine, s_now_us / 1e6);
+	exit(EXIT_FAILURE);
+}
+
+uint64_t ulPortSimTime(void)
+{
+	return s_now_us;
+}
+
+void vPortSimConsume(uint64_t us)
+{
+	uint64_t remaining = us;
+
+	while(interrupts_allowed())
+	{
+		uint64_t next = next_interrupt();
+		if(next > s_now_us + remaining)
+		{
+			break;
+		}
+
+		//Whatever is left of the time is spent after the interrupt, and after any task it switched to.
+		if(next > s_now_us)
+		{
+			remaining -= next - s_now_us;
+			s_now_us = next;
+		}
+		service_interrupts();
+	}
+
+	s_now_us += remaining;
+}
+
+void vPortSimInterruptAt(uint64_t us)
+{
+	if(us < s_next_interrupt_us)
+	{
+		s_next_interrupt_us = us;
+	}
+}
+
+uint32_t __get_IPSR(void)
+{
+	return s_in_isr ? 1 : 0;
+}
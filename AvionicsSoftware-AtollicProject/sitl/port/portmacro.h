@@ -0,0 +1,132 @@
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  FreeRTOS port for the host software in the loop build, see Documentation/SoftwareInTheLoop.md.
+//
+//  Every task runs on its own ucontext in one host thread, against a simulated clock. Interrupts (the tick, sensor
+//  pins, DMA completions) only happen where the firmware could see them on the board: when a task spends time, is
+//  blocked, or leaves a critical section. A flight is therefore the same every time it is run with the same inputs,
+//  and runs as fast as the host can go.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Same types as the Cortex-M4 port, so the firmware sees the sizes it was written for.
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		long
+#define portSHORT		short
+#define portSTACK_TYPE	uint32_t
+#define portBASE_TYPE	long
+#define portPOINTER_SIZE_TYPE	uintptr_t
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH			( -1 )
+#define portTICK_PERIOD_MS			( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT			8
+
+void vPortYield( void );
+void vPortYieldFromISR( BaseType_t xSwitchRequired );
+#define portYIELD()									vPortYield()
+#define portEND_SWITCHING_ISR( xSwitchRequired )	vPortYieldFromISR( xSwitchRequired )
+#define portYIELD_FROM_ISR( x )						portEND_SWITCHING_ISR( x )
+
+void vPortEnterCritical( void );
+void vPortExitCritical( void );
+void vPortDisableInterrupts( void );
+void vPortEnableInterrupts( void );
+#define portSET_INTERRUPT_MASK_FROM_ISR()		0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)	( void ) ( x )
+#define portDISABLE_INTERRUPTS()				vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()					vPortEnableInterrupts()
+#define portENTER_CRITICAL()					vPortEnterCritical()
+#define portEXIT_CRITICAL()						vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#define portRECORD_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) |= ( 1UL << ( uxPriority ) )
+#define portRESET_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) &= ~( 1UL << ( uxPriority ) )
+#define portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities ) uxTopPriority = ( 31UL - ( uint32_t ) __builtin_clz( ( uint32_t ) ( uxReadyPriorities ) ) )
+
+#define portASSERT_IF_INTERRUPT_PRIORITY_INVALID()
+#define portNOP()
+#define portINLINE			__inline
+#define portFORCE_INLINE	inline __attribute__(( always_inline))
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Simulated time since the board was powered on, in microseconds.
+//
+// Returns:
+//  Time in us.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64_t ulPortSimTime( void );
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Spends us of CPU time in the calling code, as a busy loop or a peripheral access would. Interrupts that fall due
+//	in that time run at their time, and can switch to another task, unless the caller is in a critical section or
+//	an interrupt, or the scheduler has not started.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void vPortSimConsume( uint64_t us );
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Tells the port an interrupt is now due at us, earlier than the simulation said when it last ran. For events set
+//	off by the firmware itself, such as a DMA transfer or a sensor being switched on.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void vPortSimInterruptAt( uint64_t us );
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Provided by the simulation, called by the port as an interrupt once the time it last asked for has come. It
+//	runs every interrupt handler that is due by now_us (the tick is the port's own).
+//
+// Returns:
+//  The time of the next interrupt the simulation knows of, in us, or UINT64_MAX if there is none.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64_t ulApplicationSimInterrupts( uint64_t now_us );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PORTMACRO_H
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Flies seeds 1 to N of the software in the loop build, one per core, and prints one CSV line per flight.
+# A flight that hangs or ends in stm32_error_handler is reported as "failed" with no other columns.
+#
+#	./run_flights.sh [N] > flights.csv
+
+FLIGHTS=${1:-1000}
+JOBS=$(nproc 2>/dev/null || echo 1)
+LIMIT_S=120
+
+# A flight cut off at power on, only for the header line.
+./sitl --csv-header --max-time 0 2>/dev/null | head -n 1
+
+seq 1 "$FLIGHTS" | xargs -P "$JOBS" -I SEED sh -c \
+	"timeout $LIMIT_S ./sitl --seed SEED 2>/dev/null || echo SEED,failed"
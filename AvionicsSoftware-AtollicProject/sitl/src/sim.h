@@ -0,0 +1,275 @@
+#ifndef SITL_SIM_H
+#define SITL_SIM_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  What the pieces of the host software in the loop build share: the flight the sensors measure, the sensor and
+//  flash models on the simulated SPI buses, and the sampler that keeps the sensors up to date with the simulated
+//  clock. See Documentation/SoftwareInTheLoop.md.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SIM_GRAVITY				9.80665
+#define SIM_NS_PER_US			1000ULL
+#define SIM_US_PER_S			1000000ULL
+
+//What the rocket is doing at one instant, as the sensors on the board would feel it.
+typedef struct
+{
+	double time_s;				//Since power on.
+	double altitude_m;			//Above the pad.
+	double velocity_mps;		//Vertical, up is positive.
+	double accel_g;				//Specific force along the board's X axis (up the rocket), 1 g on the pad.
+	double gyro_dps[3];
+	double pressure_pa;
+	double temperature_c;
+} sim_state;
+
+//A chip on one of the simulated SPI buses. exchange is called once per byte clocked while the chip is selected.
+typedef struct
+{
+	const char *name;
+	void (*select)(void);
+	uint8_t (*exchange)(uint8_t mosi);
+	void (*deselect)(void);
+	uint32_t transactions;		//Times the chip was selected.
+	uint64_t bytes;				//Bytes clocked while it was selected.
+	uint32_t timeouts;			//DMA transfers that were aborted because they ran past the caller's timeout.
+} sim_spi_device;
+
+//A device that takes samples at its own rate, driven by the sampler in sim_board.c. Samples fall on whole
+//multiples of the period since power on, so a device clock counts the same on every sample.
+typedef struct
+{
+	void (*sample)(const sim_state *state, uint64_t number);
+	bool running;
+	double period_ns;			//Already scaled by the device's clock error.
+	uint64_t next;				//Number of the next sample. It is taken at next * period_ns.
+} sim_sampler;
+
+//Where and how fast a parachute came out.
+typedef struct
+{
+	bool deployed;
+	double time_s;
+	double altitude_m;
+	double speed_mps;
+} sim_deployment;
+
+typedef struct
+{
+	uint64_t seed;
+	const char *trajectory_file;	//CSV of time_s, altitude_m, accel_g to replay instead of the physics, or NULL.
+	double pad_time_s;				//Time on the pad before the motor lights.
+	double base_pressure_pa;
+	double base_temperature_c;
+	double clock_error[4];			//Relative error of each sensor's clock: accel, gyro, barometer, spare.
+	double max_time_s;				//The flight ends here if the rocket has not landed by then.
+} sim_options;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+extern sim_spi_device sim_flash_device;
+extern sim_spi_device sim_bmp388_device;
+extern sim_spi_device sim_bmi088_accel_device;
+extern sim_spi_device sim_bmi088_gyro_device;
+
+extern sim_sampler sim_bmp388_sampler;
+extern sim_sampler sim_bmi088_accel_sampler;
+extern sim_sampler sim_bmi088_gyro_sampler;
+
+extern int sim_verbose;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Random numbers for one flight, the same sequence for the same seed (xorshift64*).
+//
+// Returns:
+//  A uniform value in [0, 1), or a standard normal one.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_random_seed(uint64_t seed);
+double sim_random_uniform(void);
+double sim_random_normal(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sets up the flight. Either the physics model, varied by the seed through options, or a replay of
+//	options->trajectory_file. Exits if the file can not be read.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_trajectory_init(const sim_options *options);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Moves the flight on to time_ns and returns it there. Time only goes forwards; asking for an earlier time
+//	returns the current state.
+//
+// Returns:
+//  The state of the rocket.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+const sim_state *sim_trajectory_advance(uint64_t time_ns);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Opens a parachute at the current point of the flight. Later calls for the same chute do nothing.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_trajectory_deploy(int chute);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Facts about the flight so far, for the summary.
+//
+// Returns:
+//  The highest altitude in m, the deployment of chute (0 drogue, 1 main), the touchdown time in s (negative
+//	before touchdown).
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+double sim_trajectory_apogee(void);
+const sim_deployment *sim_trajectory_deployment(int chute);
+double sim_trajectory_touchdown(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sets up the board for the flight in options: when it starts and when it has to end.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_board_init(const sim_options *options);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Whether the firmware has fired the e-match of chute (0 drogue, 1 main).
+//
+// Returns:
+//  true once it has been fired.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool sim_board_fired(int chute);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Runs every sensor sample that falls due up to now_us, in time order across the sensors.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_sensors_catch_up(uint64_t now_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts a device sampling every period_ns from the next multiple of it, or stops it.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_sampler_start(sim_sampler *sampler, double period_ns);
+void sim_sampler_stop(sim_sampler *sampler);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Completes the SPI DMA transfers that are done by now_us, as their completion interrupts.
+//
+// Returns:
+//  The time the next transfer in flight completes, or UINT64_MAX.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint64_t sim_spi_interrupts(uint64_t now_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Raises one of the sensor interrupt pins. The edge reaches the firmware's handler at the next chance the port
+//	has to run interrupts.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_raise_imu_interrupt(void);
+void sim_raise_pressure_interrupt(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Puts the sensor models in their power on state, with the clock errors in the options.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_bmi088_init(const sim_options *options);
+void sim_bmp388_init(const sim_options *options);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Sets up the NOR flash model, erased, in RAM or (if file is not NULL) in a file mapped into memory, which keeps
+//	what is already in it.
+//
+// Returns:
+//  true on success.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool sim_flash_init(const char *file);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Direct access to the flash array, for setting up the configuration journal and reading it back after the flight.
+//
+// Returns:
+//  The byte at address 0.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t *sim_flash_memory(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Moves a flash program or erase in progress on to now_us, so the status register reads what the chip would say.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_flash_update(uint64_t now_us);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  The host side of a UART port (a UART from UART_Port2_Init or UART_Port6_Init), for tests that talk to the
+//	firmware over it. Connecting the peer discards what was sent before. sim_uart_peer_read takes the bytes the
+//	firmware sent that are on the wire by now, and sim_uart_peer_write puts bytes in the port's receive DMA. Bytes are
+//	lost while the two ends are at different baud rates, or while the firmware is not receiving.
+//
+// Returns:
+//  The number of bytes read.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_uart_peer_connect(void *uart, uint32_t baud_rate);
+void sim_uart_peer_set_baud_rate(void *uart, uint32_t baud_rate);
+uint32_t sim_uart_peer_read(void *uart, uint8_t *bytes, uint32_t max);
+void sim_uart_peer_write(void *uart, const uint8_t *bytes, uint32_t count);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Ends the flight: prints the summary line and stops the program.
+//
+// Returns:
+//  Does not return.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_finish(const char *reason);
+
+#endif // SITL_SIM_H
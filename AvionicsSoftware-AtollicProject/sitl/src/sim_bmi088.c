@@ -0,0 +1,558 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Register level model of the BMI088 accelerometer and gyroscope on SPI3, as far as bmi08a.c, bmi08g.c and
+//  imu_sensor.c use them: the data, sensor time and FIFO registers, the FIFO watermark on the accelerometer INT1
+//  pin, and soft reset. Each half has its own clock, a little off from the MCU's.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define ACC_CHIP_ID				0x1E
+#define ACC_REG_CHIP_ID			0x00
+#define ACC_REG_STATUS			0x03
+#define ACC_REG_DATA			0x12
+#define ACC_REG_SENSORTIME		0x18
+#define ACC_REG_FIFO_LENGTH		0x24
+#define ACC_REG_FIFO_DATA		0x26
+#define ACC_REG_CONF			0x40
+#define ACC_REG_RANGE			0x41
+#define ACC_REG_FIFO_WTM		0x46
+#define ACC_REG_FIFO_CONFIG_0	0x48
+#define ACC_REG_FIFO_CONFIG_1	0x49
+#define ACC_REG_INT1_IO_CONF	0x53
+#define ACC_REG_INT_MAP			0x58
+#define ACC_REG_PWR_CONF		0x7C
+#define ACC_REG_PWR_CTRL		0x7D
+#define ACC_REG_CMD				0x7E
+
+#define ACC_FIFO_MODE			0x01	//FIFO_CONFIG_0: stop when full rather than stream.
+#define ACC_FIFO_ACC_EN			0x40	//FIFO_CONFIG_1
+#define ACC_INT1_OUT			0x08	//INT1_IO_CONF
+#define ACC_INT1_FWM			0x02	//INT_MAP
+#define ACC_INT1_DRDY			0x04	//INT_MAP
+#define ACC_ENABLE				0x04	//PWR_CTRL
+#define ACC_CMD_FIFO_FLUSH		0xB0
+#define ACC_CMD_SOFTRESET		0xB6
+
+#define ACC_FIFO_SIZE			1024
+#define ACC_FRAME_ACCEL			0x84
+#define ACC_FRAME_ACCEL_LENGTH	7
+#define ACC_FRAME_SKIP			0x40
+#define ACC_FRAME_SKIP_LENGTH	2
+#define ACC_FRAME_TIME			0x44
+#define ACC_FRAME_EMPTY			0x80
+#define ACC_SENSORTIME_HZ		25600.0
+#define ACC_SENSORTIME_MASK		0xFFFFFF
+#define ACC_NOISE_G				0.003
+
+#define GYRO_CHIP_ID			0x0F
+#define GYRO_REG_CHIP_ID		0x00
+#define GYRO_REG_DATA			0x02
+#define GYRO_REG_FIFO_STATUS	0x0E
+#define GYRO_REG_RANGE			0x0F
+#define GYRO_REG_BANDWIDTH		0x10
+#define GYRO_REG_LPM1			0x11
+#define GYRO_REG_SOFTRESET		0x14
+#define GYRO_REG_FIFO_CONFIG_1	0x3E
+#define GYRO_REG_FIFO_DATA		0x3F
+
+#define GYRO_FIFO_STREAM		0x80	//FIFO_CONFIG_1 mode, 0 is bypass.
+#define GYRO_FIFO_FIFO			0x40
+#define GYRO_FIFO_OVERRUN		0x80	//FIFO_STATUS
+#define GYRO_SOFTRESET			0xB6
+#define GYRO_FRAME_LENGTH		6
+#define GYRO_FIFO_FRAMES		100
+#define GYRO_NOISE_DPS			0.1
+
+typedef struct
+{
+	uint8_t address;
+	bool write;
+	uint32_t index;				//Bytes clocked since the chip was selected.
+	uint32_t fifo_read;			//FIFO bytes clocked out in this transaction.
+} transaction;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void accel_select(void);
+static uint8_t accel_exchange(uint8_t mosi);
+static void accel_deselect(void);
+static void gyro_select(void);
+static uint8_t gyro_exchange(uint8_t mosi);
+static void gyro_deselect(void);
+static void accel_sample(const sim_state *state, uint64_t number);
+static void gyro_sample(const sim_state *state, uint64_t number);
+
+sim_spi_device sim_bmi088_accel_device = {"bmi088_accel", accel_select, accel_exchange, accel_deselect, 0, 0, 0};
+sim_spi_device sim_bmi088_gyro_device = {"bmi088_gyro", gyro_select, gyro_exchange, gyro_deselect, 0, 0, 0};
+sim_sampler sim_bmi088_accel_sampler = {accel_sample};
+sim_sampler sim_bmi088_gyro_sampler = {gyro_sample};
+
+static double s_accel_clock = 1.0;		//Device seconds per real second.
+static double s_gyro_clock = 1.0;
+
+static uint8_t s_accel_regs[128];
+static uint8_t s_accel_fifo[ACC_FIFO_SIZE];
+static uint32_t s_accel_fifo_fill;
+static uint32_t s_accel_skipped;		//Frames dropped since the last skip frame went in.
+static uint32_t s_accel_newest_time;	//Sensor time of the newest frame in the FIFO.
+static transaction s_accel;
+
+static uint8_t s_gyro_regs[64];
+static uint8_t s_gyro_fifo[GYRO_FIFO_FRAMES * GYRO_FRAME_LENGTH];
+static uint32_t s_gyro_fifo_frames;
+static bool s_gyro_overrun;
+static transaction s_gyro;
+
+
+static void put_le16(uint8_t *buffer, int32_t value)
+{
+	if(value > 32767)
+	{
+		value = 32767;
+	}else if(value < -32768)
+	{
+		value = -32768;
+	}
+	buffer[0] = (uint8_t) (value & 0xFF);
+	buffer[1] = (uint8_t) ((value >> 8) & 0xFF);
+}
+
+static uint64_t now_ns(void)
+{
+	return ulPortSimTime() * SIM_NS_PER_US;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Accelerometer
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t accel_frame_ticks(void)
+{
+	uint8_t odr = s_accel_regs[ACC_REG_CONF] & 0x0F;
+	if(odr < 0x05)
+	{
+		odr = 0x05;
+	}
+	return 2048u >> (odr - 0x05);
+}
+
+static uint32_t accel_sensortime(uint64_t time_ns)
+{
+	return (uint32_t) llround(time_ns * 1e-9 * s_accel_clock * ACC_SENSORTIME_HZ) & ACC_SENSORTIME_MASK;
+}
+
+static void accel_reset(void)
+{
+	memset(s_accel_regs, 0, sizeof(s_accel_regs));
+	s_accel_regs[ACC_REG_CHIP_ID] = ACC_CHIP_ID;
+	s_accel_regs[ACC_REG_CONF] = 0xA8;
+	s_accel_regs[ACC_REG_RANGE] = 0x01;
+	s_accel_regs[ACC_REG_FIFO_WTM] = 0x88;
+	s_accel_regs[ACC_REG_FIFO_WTM + 1] = 0x02;
+	s_accel_regs[ACC_REG_FIFO_CONFIG_0] = 0x02;
+	s_accel_regs[ACC_REG_FIFO_CONFIG_1] = 0x10;
+	s_accel_regs[ACC_REG_INT1_IO_CONF] = 0x01;
+	s_accel_regs[ACC_REG_PWR_CONF] = 0x03;
+	s_accel_fifo_fill = 0;
+	s_accel_skipped = 0;
+	sim_sampler_stop(&sim_bmi088_accel_sampler);
+}
+
+//Starts, stops or retimes the sampling after a register write.
+static void accel_update_sampling(void)
+{
+	if((s_accel_regs[ACC_REG_PWR_CTRL] & ACC_ENABLE) == 0)
+	{
+		sim_sampler_stop(&sim_bmi088_accel_sampler);
+		return;
+	}
+
+	double period_ns = accel_frame_ticks() * 1e9 / (ACC_SENSORTIME_HZ * s_accel_clock);
+	if(!sim_bmi088_accel_sampler.running || sim_bmi088_accel_sampler.period_ns != period_ns)
+	{
+		sim_sampler_start(&sim_bmi088_accel_sampler, period_ns);
+	}
+}
+
+static uint32_t accel_fifo_watermark(void)
+{
+	return s_accel_regs[ACC_REG_FIFO_WTM] | ((s_accel_regs[ACC_REG_FIFO_WTM + 1] & 0x1F) << 8);
+}
+
+//Length of the frame at the start of buffer.
+static uint32_t accel_frame_length(const uint8_t *buffer)
+{
+	return (buffer[0] == ACC_FRAME_SKIP) ? ACC_FRAME_SKIP_LENGTH : ACC_FRAME_ACCEL_LENGTH;
+}
+
+static void accel_fifo_drop(uint32_t bytes)
+{
+	memmove(s_accel_fifo, s_accel_fifo + bytes, s_accel_fifo_fill - bytes);
+	s_accel_fifo_fill -= bytes;
+}
+
+static void accel_fifo_push(const uint8_t *frame, uint32_t length)
+{
+	bool stream = (s_accel_regs[ACC_REG_FIFO_CONFIG_0] & ACC_FIFO_MODE) == 0;
+
+	while(s_accel_fifo_fill + length > ACC_FIFO_SIZE)
+	{
+		if(!stream)
+		{
+			return;
+		}
+		if(s_accel_fifo[0] == ACC_FRAME_ACCEL)
+		{
+			s_accel_skipped++;
+		}
+		accel_fifo_drop(accel_frame_length(s_accel_fifo));
+	}
+
+	memcpy(s_accel_fifo + s_accel_fifo_fill, frame, length);
+	s_accel_fifo_fill += length;
+}
+
+static void accel_sample(const sim_state *state, uint64_t number)
+{
+	uint8_t range = s_accel_regs[ACC_REG_RANGE] & 0x03;
+	double lsb_per_g = 32768.0 / (3 << range);
+	uint8_t frame[ACC_FRAME_ACCEL_LENGTH] = {ACC_FRAME_ACCEL};
+	uint32_t fill_before = s_accel_fifo_fill;
+
+	put_le16(&frame[1], (int32_t) lround((state->accel_g + ACC_NOISE_G * sim_random_normal()) * lsb_per_g));
+	put_le16(&frame[3], (int32_t) lround(ACC_NOISE_G * sim_random_normal() * lsb_per_g));
+	put_le16(&frame[5], (int32_t) lround(ACC_NOISE_G * sim_random_normal() * lsb_per_g));
+	memcpy(&s_accel_regs[ACC_REG_DATA], &frame[1], 6);
+	s_accel_regs[ACC_REG_STATUS] = 0x80;
+
+	if(s_accel_regs[ACC_REG_FIFO_CONFIG_1] & ACC_FIFO_ACC_EN)
+	{
+		if(s_accel_skipped > 0 && s_accel_fifo_fill + ACC_FRAME_SKIP_LENGTH + ACC_FRAME_ACCEL_LENGTH <= ACC_FIFO_SIZE)
+		{
+			uint8_t skip[ACC_FRAME_SKIP_LENGTH] = {ACC_FRAME_SKIP, (uint8_t) (s_accel_skipped > 255 ? 255 : s_accel_skipped)};
+			accel_fifo_push(skip, sizeof(skip));
+			s_accel_skipped = 0;
+		}
+		accel_fifo_push(frame, sizeof(frame));
+		s_accel_newest_time = (uint32_t) (number * accel_frame_ticks()) & ACC_SENSORTIME_MASK;
+	}
+
+	if((s_accel_regs[ACC_REG_INT1_IO_CONF] & ACC_INT1_OUT) == 0)
+	{
+		return;
+	}
+
+	uint32_t watermark = accel_fifo_watermark();
+	if(((s_accel_regs[ACC_REG_INT_MAP] & ACC_INT1_FWM) && fill_before < watermark && s_accel_fifo_fill >= watermark) ||
+	   (s_accel_regs[ACC_REG_INT_MAP] & ACC_INT1_DRDY))
+	{
+		sim_raise_imu_interrupt();
+	}
+}
+
+static uint8_t accel_read(transaction *t)
+{
+	uint8_t address = t->address;
+
+	if(address == ACC_REG_FIFO_DATA)
+	{
+		uint32_t offset = t->fifo_read++;
+
+		if(offset < s_accel_fifo_fill)
+		{
+			return s_accel_fifo[offset];
+		}
+
+		//Past the data: a sensor time frame, then empty frames.
+		offset -= s_accel_fifo_fill;
+		if(offset == 0)
+		{
+			return ACC_FRAME_TIME;
+		}
+		if(offset <= 3)
+		{
+			return (uint8_t) (s_accel_newest_time >> (8 * (offset - 1)));
+		}
+		return ((offset - 4) % 2 == 0) ? ACC_FRAME_EMPTY : 0x00;
+	}
+
+	t->address = (address + 1) & 0x7F;
+	switch(address)
+	{
+		case ACC_REG_SENSORTIME:
+		case ACC_REG_SENSORTIME + 1:
+		case ACC_REG_SENSORTIME + 2:
+			return (uint8_t) (accel_sensortime(now_ns()) >> (8 * (address - ACC_REG_SENSORTIME)));
+		case ACC_REG_FIFO_LENGTH:
+			return (uint8_t) (s_accel_fifo_fill & 0xFF);
+		case ACC_REG_FIFO_LENGTH + 1:
+			return (uint8_t) ((s_accel_fifo_fill >> 8) & 0x3F);
+		default:
+			return s_accel_regs[address];
+	}
+}
+
+static void accel_write(uint8_t address, uint8_t value)
+{
+	switch(address)
+	{
+		case ACC_REG_CMD:
+			if(value == ACC_CMD_SOFTRESET)
+			{
+				accel_reset();
+			}else if(value == ACC_CMD_FIFO_FLUSH)
+			{
+				s_accel_fifo_fill = 0;
+				s_accel_skipped = 0;
+			}
+			return;
+		case ACC_REG_CHIP_ID:
+		case ACC_REG_STATUS:
+		case ACC_REG_FIFO_LENGTH:
+		case ACC_REG_FIFO_LENGTH + 1:
+			return;
+		default:
+			s_accel_regs[address] = value;
+			break;
+	}
+
+	if(address == ACC_REG_PWR_CTRL || address == ACC_REG_CONF)
+	{
+		accel_update_sampling();
+	}
+}
+
+static void accel_select(void)
+{
+	sim_sensors_catch_up(now_ns() / SIM_NS_PER_US);
+	memset(&s_accel, 0, sizeof(s_accel));
+}
+
+static uint8_t accel_exchange(uint8_t mosi)
+{
+	uint32_t index = s_accel.index++;
+
+	if(index == 0)
+	{
+		s_accel.write = (mosi & 0x80) == 0;
+		s_accel.address = mosi & 0x7F;
+		return 0xFF;
+	}
+
+	if(s_accel.write)
+	{
+		accel_write(s_accel.address, mosi);
+		s_accel.address = (s_accel.address + 1) & 0x7F;
+		return 0xFF;
+	}
+
+	//Reads start with a dummy byte.
+	return (index == 1) ? 0xFF : accel_read(&s_accel);
+}
+
+static void accel_deselect(void)
+{
+	//Only frames that were read to the end leave the FIFO.
+	uint32_t consumed = 0;
+	while(consumed < s_accel_fifo_fill && consumed + accel_frame_length(&s_accel_fifo[consumed]) <= s_accel.fifo_read)
+	{
+		consumed += accel_frame_length(&s_accel_fifo[consumed]);
+	}
+	if(consumed > 0)
+	{
+		accel_fifo_drop(consumed);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Gyroscope
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static double gyro_odr_hz(void)
+{
+	static const double odr[8] = {2000.0, 2000.0, 1000.0, 400.0, 200.0, 100.0, 200.0, 100.0};
+	return odr[s_gyro_regs[GYRO_REG_BANDWIDTH] & 0x07];
+}
+
+static void gyro_reset(void)
+{
+	memset(s_gyro_regs, 0, sizeof(s_gyro_regs));
+	s_gyro_regs[GYRO_REG_CHIP_ID] = GYRO_CHIP_ID;
+	s_gyro_regs[GYRO_REG_BANDWIDTH] = 0x80;
+	s_gyro_fifo_frames = 0;
+	s_gyro_overrun = false;
+
+	//The gyroscope comes out of reset running.
+	sim_sampler_start(&sim_bmi088_gyro_sampler, 1e9 / (gyro_odr_hz() * s_gyro_clock));
+}
+
+static void gyro_update_sampling(void)
+{
+	if(s_gyro_regs[GYRO_REG_LPM1] != 0x00)
+	{
+		sim_sampler_stop(&sim_bmi088_gyro_sampler);
+		return;
+	}
+
+	double period_ns = 1e9 / (gyro_odr_hz() * s_gyro_clock);
+	if(!sim_bmi088_gyro_sampler.running || sim_bmi088_gyro_sampler.period_ns != period_ns)
+	{
+		sim_sampler_start(&sim_bmi088_gyro_sampler, period_ns);
+	}
+}
+
+static void gyro_sample(const sim_state *state, uint64_t number)
+{
+	static const double range_dps[5] = {2000.0, 1000.0, 500.0, 250.0, 125.0};
+	uint8_t range = s_gyro_regs[GYRO_REG_RANGE];
+	double lsb_per_dps = 32768.0 / range_dps[range < 5 ? range : 0];
+	uint8_t frame[GYRO_FRAME_LENGTH];
+	uint8_t mode = s_gyro_regs[GYRO_REG_FIFO_CONFIG_1];
+
+	(void) number;
+	for(int axis = 0; axis < 3; axis++)
+	{
+		double rate = state->gyro_dps[axis] + GYRO_NOISE_DPS * sim_random_normal();
+		put_le16(&frame[2 * axis], (int32_t) lround(rate * lsb_per_dps));
+	}
+	memcpy(&s_gyro_regs[GYRO_REG_DATA], frame, sizeof(frame));
+
+	if(mode != GYRO_FIFO_STREAM && mode != GYRO_FIFO_FIFO)
+	{
+		return;
+	}
+
+	if(s_gyro_fifo_frames == GYRO_FIFO_FRAMES)
+	{
+		s_gyro_overrun = true;
+		if(mode == GYRO_FIFO_FIFO)
+		{
+			return;
+		}
+		memmove(s_gyro_fifo, s_gyro_fifo + GYRO_FRAME_LENGTH, (GYRO_FIFO_FRAMES - 1) * GYRO_FRAME_LENGTH);
+		s_gyro_fifo_frames--;
+	}
+	memcpy(&s_gyro_fifo[s_gyro_fifo_frames * GYRO_FRAME_LENGTH], frame, sizeof(frame));
+	s_gyro_fifo_frames++;
+}
+
+static uint8_t gyro_read(transaction *t)
+{
+	uint8_t address = t->address;
+
+	if(address == GYRO_REG_FIFO_DATA)
+	{
+		uint32_t offset = t->fifo_read++;
+		return (offset < s_gyro_fifo_frames * GYRO_FRAME_LENGTH) ? s_gyro_fifo[offset] : 0x00;
+	}
+
+	t->address = (address + 1) & 0x3F;
+	if(address == GYRO_REG_FIFO_STATUS)
+	{
+		return (uint8_t) ((s_gyro_fifo_frames & 0x7F) | (s_gyro_overrun ? GYRO_FIFO_OVERRUN : 0));
+	}
+	return s_gyro_regs[address];
+}
+
+static void gyro_write(uint8_t address, uint8_t value)
+{
+	switch(address)
+	{
+		case GYRO_REG_SOFTRESET:
+			if(value == GYRO_SOFTRESET)
+			{
+				gyro_reset();
+			}
+			return;
+		case GYRO_REG_CHIP_ID:
+		case GYRO_REG_FIFO_STATUS:
+			return;
+		case GYRO_REG_FIFO_CONFIG_1:
+			//Writing the mode clears the FIFO.
+			s_gyro_fifo_frames = 0;
+			s_gyro_overrun = false;
+			break;
+		default:
+			break;
+	}
+
+	s_gyro_regs[address] = value;
+	if(address == GYRO_REG_LPM1 || address == GYRO_REG_BANDWIDTH)
+	{
+		gyro_update_sampling();
+	}
+}
+
+static void gyro_select(void)
+{
+	sim_sensors_catch_up(now_ns() / SIM_NS_PER_US);
+	memset(&s_gyro, 0, sizeof(s_gyro));
+}
+
+static uint8_t gyro_exchange(uint8_t mosi)
+{
+	uint32_t index = s_gyro.index++;
+
+	if(index == 0)
+	{
+		s_gyro.write = (mosi & 0x80) == 0;
+		s_gyro.address = mosi & 0x3F;
+		return 0xFF;
+	}
+
+	if(s_gyro.write)
+	{
+		gyro_write(s_gyro.address, mosi);
+		s_gyro.address = (s_gyro.address + 1) & 0x3F;
+		return 0xFF;
+	}
+
+	//No dummy byte on the gyroscope.
+	return gyro_read(&s_gyro);
+}
+
+static void gyro_deselect(void)
+{
+	uint32_t consumed = s_gyro.fifo_read / GYRO_FRAME_LENGTH;
+
+	if(consumed > s_gyro_fifo_frames)
+	{
+		consumed = s_gyro_fifo_frames;
+	}
+	if(consumed > 0)
+	{
+		memmove(s_gyro_fifo, s_gyro_fifo + consumed * GYRO_FRAME_LENGTH, (s_gyro_fifo_frames - consumed) * GYRO_FRAME_LENGTH);
+		s_gyro_fifo_frames -= consumed;
+		s_gyro_overrun = false;
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_bmi088_init(const sim_options *options)
+{
+	s_accel_clock = 1.0 + options->clock_error[0];
+	s_gyro_clock = 1.0 + options->clock_error[1];
+	accel_reset();
+	gyro_reset();
+}
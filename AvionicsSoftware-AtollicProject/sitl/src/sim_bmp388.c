@@ -0,0 +1,608 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Register level model of the BMP388 barometer on SPI2, as far as bmp3.c and pressure_sensor.c use it: the
+//  calibration, data, sensor time and FIFO registers, the IIR filter, the watermark and data ready interrupts and
+//  the soft reset and FIFO flush commands.
+//
+//  The raw values are made the other way round from bmp3.c: the model searches for the raw reading that the
+//  driver's own integer compensation turns into the pressure and temperature of the flight.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define BMP_CHIP_ID				0x50
+#define BMP_REG_CHIP_ID			0x00
+#define BMP_REG_ERR				0x02
+#define BMP_REG_STATUS			0x03
+#define BMP_REG_DATA			0x04
+#define BMP_REG_SENSORTIME		0x0C
+#define BMP_REG_INT_STATUS		0x11
+#define BMP_REG_FIFO_LENGTH		0x12
+#define BMP_REG_FIFO_DATA		0x14
+#define BMP_REG_FIFO_WM			0x15
+#define BMP_REG_FIFO_CONFIG_1	0x17
+#define BMP_REG_FIFO_CONFIG_2	0x18
+#define BMP_REG_INT_CTRL		0x19
+#define BMP_REG_PWR_CTRL		0x1B
+#define BMP_REG_OSR				0x1C
+#define BMP_REG_ODR				0x1D
+#define BMP_REG_CONFIG			0x1F
+#define BMP_REG_CALIBRATION		0x31
+#define BMP_REG_CMD				0x7E
+
+#define BMP_STATUS_CMD_READY	0x10
+#define BMP_STATUS_PRESS_READY	0x20
+#define BMP_STATUS_TEMP_READY	0x40
+#define BMP_INT_FWTM			0x01	//INT_STATUS
+#define BMP_INT_FFULL			0x02
+#define BMP_INT_DRDY			0x08
+#define BMP_FIFO_MODE			0x01	//FIFO_CONFIG_1
+#define BMP_FIFO_STOP_ON_FULL	0x02
+#define BMP_FIFO_TIME_EN		0x04
+#define BMP_FIFO_PRESS_EN		0x08
+#define BMP_FIFO_TEMP_EN		0x10
+#define BMP_FIFO_SUBSAMPLING	0x07	//FIFO_CONFIG_2
+#define BMP_FIFO_FILTERED		0x08
+#define BMP_INT_CTRL_FWTM		0x08
+#define BMP_INT_CTRL_FFULL		0x10
+#define BMP_INT_CTRL_DRDY		0x40
+#define BMP_PRESS_EN			0x01	//PWR_CTRL
+#define BMP_TEMP_EN				0x02
+#define BMP_MODE_MASK			0x30
+#define BMP_MODE_NORMAL			0x30
+#define BMP_CMD_FIFO_FLUSH		0xB0
+#define BMP_CMD_SOFTRESET		0xB6
+
+#define BMP_FIFO_SIZE			512
+#define BMP_FRAME_PRESS_TEMP	0x94
+#define BMP_FRAME_TEMP			0x90
+#define BMP_FRAME_PRESS			0x84
+#define BMP_FRAME_TIME			0xA0
+#define BMP_FRAME_EMPTY			0x80
+#define BMP_SENSORTIME_HZ		25600.0
+#define BMP_NOISE_PA			1.0
+#define BMP_NOISE_C				0.005
+
+//Calibration of a typical part, in the order the registers hold it.
+typedef struct
+{
+	uint16_t par_t1;
+	uint16_t par_t2;
+	int8_t par_t3;
+	int16_t par_p1;
+	int16_t par_p2;
+	int8_t par_p3;
+	int8_t par_p4;
+	uint16_t par_p5;
+	uint16_t par_p6;
+	int8_t par_p7;
+	int8_t par_p8;
+	int16_t par_p9;
+	int8_t par_p10;
+	int8_t par_p11;
+} calibration;
+
+typedef struct
+{
+	uint8_t address;
+	bool write;
+	uint32_t index;
+	uint32_t fifo_read;
+} transaction;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void bmp_select(void);
+static uint8_t bmp_exchange(uint8_t mosi);
+static void bmp_deselect(void);
+static void bmp_sample(const sim_state *state, uint64_t number);
+
+sim_spi_device sim_bmp388_device = {"bmp388", bmp_select, bmp_exchange, bmp_deselect, 0, 0, 0};
+sim_sampler sim_bmp388_sampler = {bmp_sample};
+
+static const calibration s_calibration = {27701, 19224, -7, -1036, -3139, 35, 0, 25153, 30875, 3, -8, 16162, 9, -60};
+
+static double s_clock = 1.0;
+static uint8_t s_regs[128];
+static uint8_t s_fifo[BMP_FIFO_SIZE];
+static uint32_t s_fifo_fill;
+static uint32_t s_newest_time;
+static uint32_t s_subsample_count;
+static double s_filtered_pa;
+static double s_filtered_c;
+static bool s_filter_primed;
+static transaction s_transaction;
+
+
+static uint64_t now_ns(void)
+{
+	return ulPortSimTime() * SIM_NS_PER_US;
+}
+
+//bmp3.c compensate_temperature, also giving t_lin for the pressure.
+static int64_t compensate_temperature(uint32_t raw, int64_t *t_lin)
+{
+	uint64_t partial_data1 = raw - (256 * (uint64_t) s_calibration.par_t1);
+	uint64_t partial_data2 = s_calibration.par_t2 * partial_data1;
+	uint64_t partial_data3 = partial_data1 * partial_data1;
+	int64_t partial_data4 = (int64_t) partial_data3 * s_calibration.par_t3;
+	int64_t partial_data5 = ((int64_t) (partial_data2 * 262144) + partial_data4);
+
+	*t_lin = partial_data5 / 4294967296;
+	return (*t_lin * 25) / 16384;
+}
+
+//bmp3.c compensate_pressure, in 0.01 Pa, with 128 bit intermediates. The driver's 64 bit ones overflow in
+//partial_data5 once the raw pressure gets high enough (below about 50 to 70 kPa, depending on the temperature), and
+//from there on it reads about 8 kPa low. The model works out the raw value the chip would really give, so the
+//firmware sees that error just as it would in flight.
+static uint64_t compensate_pressure(uint32_t raw, int64_t t_lin)
+{
+	typedef __int128 wide;
+	const calibration *c = &s_calibration;
+	wide partial_data1 = (wide) t_lin * t_lin;
+	wide partial_data2 = partial_data1 / 64;
+	wide partial_data3 = (partial_data2 * t_lin) / 256;
+	wide partial_data4 = (c->par_p8 * partial_data3) / 32;
+	wide partial_data5 = (c->par_p7 * partial_data1) * 16;
+	wide partial_data6 = ((wide) c->par_p6 * t_lin) * 4194304;
+	wide offset = ((wide) c->par_p5 * 140737488355328) + partial_data4 + partial_data5 + partial_data6;
+
+	partial_data2 = (c->par_p4 * partial_data3) / 32;
+	partial_data4 = (c->par_p3 * partial_data1) * 4;
+	partial_data5 = (wide) (c->par_p2 - 16384) * t_lin * 2097152;
+	wide sensitivity = ((wide) (c->par_p1 - 16384) * 70368744177664) + partial_data2 + partial_data4 + partial_data5;
+
+	partial_data1 = (sensitivity / 16777216) * raw;
+	partial_data2 = (wide) c->par_p10 * t_lin;
+	partial_data3 = partial_data2 + (65536 * c->par_p9);
+	partial_data4 = (partial_data3 * raw) / 8192;
+	partial_data5 = (partial_data4 * raw) / 512;
+	partial_data6 = (wide) raw * raw;
+	partial_data2 = (c->par_p11 * partial_data6) / 65536;
+	partial_data3 = (partial_data2 * raw) / 128;
+	partial_data4 = (offset / 4) + partial_data1 + partial_data5 + partial_data3;
+	return (uint64_t) ((partial_data4 * 25) / 1099511627776);
+}
+
+/**
+ * @brief Raw temperature and pressure that compensate to temperature_c and pressure_pa. With this calibration the
+ * temperature grows with its raw value and the pressure falls with its raw value, over the range a flight covers
+ * (down to about 18 kPa, some 12 km up), so a bisection finds them.
+ */
+static void make_raw(double temperature_c, double pressure_pa, uint32_t *raw_temperature, uint32_t *raw_pressure)
+{
+	int64_t target_temperature = llround(temperature_c * 100.0);
+	uint64_t target_pressure = (uint64_t) llround(pressure_pa * 100.0);
+	uint32_t low = 1u << 21;
+	uint32_t high = 1u << 24;
+	int64_t t_lin;
+
+	while(low + 1 < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		if(compensate_temperature(middle, &t_lin) <= target_temperature)
+		{
+			low = middle;
+		}else
+		{
+			high = middle;
+		}
+	}
+	*raw_temperature = low;
+	compensate_temperature(low, &t_lin);
+
+	low = 3u << 20;
+	high = 11u << 20;
+	while(low + 1 < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		if(compensate_pressure(middle, t_lin) >= target_pressure)
+		{
+			low = middle;
+		}else
+		{
+			high = middle;
+		}
+	}
+	*raw_pressure = low;
+}
+
+static void put_le24(uint8_t *buffer, uint32_t value)
+{
+	buffer[0] = (uint8_t) (value & 0xFF);
+	buffer[1] = (uint8_t) ((value >> 8) & 0xFF);
+	buffer[2] = (uint8_t) ((value >> 16) & 0xFF);
+}
+
+static void write_calibration(void)
+{
+	const calibration *c = &s_calibration;
+	uint8_t *r = &s_regs[BMP_REG_CALIBRATION];
+
+	r[0] = (uint8_t) c->par_t1;
+	r[1] = (uint8_t) (c->par_t1 >> 8);
+	r[2] = (uint8_t) c->par_t2;
+	r[3] = (uint8_t) (c->par_t2 >> 8);
+	r[4] = (uint8_t) c->par_t3;
+	r[5] = (uint8_t) c->par_p1;
+	r[6] = (uint8_t) ((uint16_t) c->par_p1 >> 8);
+	r[7] = (uint8_t) c->par_p2;
+	r[8] = (uint8_t) ((uint16_t) c->par_p2 >> 8);
+	r[9] = (uint8_t) c->par_p3;
+	r[10] = (uint8_t) c->par_p4;
+	r[11] = (uint8_t) c->par_p5;
+	r[12] = (uint8_t) (c->par_p5 >> 8);
+	r[13] = (uint8_t) c->par_p6;
+	r[14] = (uint8_t) (c->par_p6 >> 8);
+	r[15] = (uint8_t) c->par_p7;
+	r[16] = (uint8_t) c->par_p8;
+	r[17] = (uint8_t) c->par_p9;
+	r[18] = (uint8_t) ((uint16_t) c->par_p9 >> 8);
+	r[19] = (uint8_t) c->par_p10;
+	r[20] = (uint8_t) c->par_p11;
+}
+
+static void bmp_reset(void)
+{
+	memset(s_regs, 0, sizeof(s_regs));
+	s_regs[BMP_REG_CHIP_ID] = BMP_CHIP_ID;
+	s_regs[BMP_REG_STATUS] = BMP_STATUS_CMD_READY;
+	s_regs[BMP_REG_FIFO_WM] = 0x01;
+	s_regs[BMP_REG_FIFO_CONFIG_1] = 0x02;
+	s_regs[BMP_REG_FIFO_CONFIG_2] = 0x02;
+	s_regs[BMP_REG_INT_CTRL] = 0x02;
+	s_regs[BMP_REG_OSR] = 0x02;
+	write_calibration();
+	s_fifo_fill = 0;
+	s_subsample_count = 0;
+	s_filter_primed = false;
+	sim_sampler_stop(&sim_bmp388_sampler);
+}
+
+static void update_sampling(void)
+{
+	uint8_t mode = s_regs[BMP_REG_PWR_CTRL] & BMP_MODE_MASK;
+
+	if(mode == 0)
+	{
+		sim_sampler_stop(&sim_bmp388_sampler);
+		return;
+	}
+
+	//Normal mode samples every 5 ms << ODR. A forced measurement is taken once, one conversion time later.
+	double period_ns = (5e6 * (1u << (s_regs[BMP_REG_ODR] & 0x1F))) / s_clock;
+	if(mode != BMP_MODE_NORMAL)
+	{
+		period_ns = 5e6 / s_clock;
+	}
+	if(!sim_bmp388_sampler.running || sim_bmp388_sampler.period_ns != period_ns)
+	{
+		sim_sampler_start(&sim_bmp388_sampler, period_ns);
+	}
+}
+
+static uint32_t fifo_watermark(void)
+{
+	return s_regs[BMP_REG_FIFO_WM] | ((s_regs[BMP_REG_FIFO_WM + 1] & 0x01) << 8);
+}
+
+static uint32_t frame_length(uint8_t header)
+{
+	return (header == BMP_FRAME_PRESS_TEMP) ? 7 : 4;
+}
+
+static void fifo_drop(uint32_t bytes)
+{
+	memmove(s_fifo, s_fifo + bytes, s_fifo_fill - bytes);
+	s_fifo_fill -= bytes;
+}
+
+static void raise_interrupt(uint8_t status)
+{
+	uint8_t enabled = 0;
+
+	if(s_regs[BMP_REG_INT_CTRL] & BMP_INT_CTRL_FWTM)
+	{
+		enabled |= BMP_INT_FWTM;
+	}
+	if(s_regs[BMP_REG_INT_CTRL] & BMP_INT_CTRL_FFULL)
+	{
+		enabled |= BMP_INT_FFULL;
+	}
+	if(s_regs[BMP_REG_INT_CTRL] & BMP_INT_CTRL_DRDY)
+	{
+		enabled |= BMP_INT_DRDY;
+	}
+
+	s_regs[BMP_REG_INT_STATUS] |= status;
+	if(status & enabled)
+	{
+		sim_raise_pressure_interrupt();
+	}
+}
+
+static void fifo_push(const uint8_t *frame, uint32_t length)
+{
+	uint32_t fill_before = s_fifo_fill;
+	uint8_t status = 0;
+
+	while(s_fifo_fill + length > BMP_FIFO_SIZE)
+	{
+		if(s_regs[BMP_REG_FIFO_CONFIG_1] & BMP_FIFO_STOP_ON_FULL)
+		{
+			return;
+		}
+		fifo_drop(frame_length(s_fifo[0]));
+	}
+
+	memcpy(s_fifo + s_fifo_fill, frame, length);
+	s_fifo_fill += length;
+
+	if(fill_before < fifo_watermark() && s_fifo_fill >= fifo_watermark())
+	{
+		status |= BMP_INT_FWTM;
+	}
+	if(s_fifo_fill + 7 > BMP_FIFO_SIZE)
+	{
+		status |= BMP_INT_FFULL;
+	}
+	if(status != 0)
+	{
+		raise_interrupt(status);
+	}
+}
+
+static void bmp_sample(const sim_state *state, uint64_t number)
+{
+	static const double iir[8] = {0, 1, 3, 7, 15, 31, 63, 127};
+	double coefficient = iir[(s_regs[BMP_REG_CONFIG] >> 1) & 0x07];
+	double pressure = state->pressure_pa + BMP_NOISE_PA * sim_random_normal();
+	double temperature = state->temperature_c + BMP_NOISE_C * sim_random_normal();
+	uint8_t config = s_regs[BMP_REG_FIFO_CONFIG_1];
+	uint8_t power = s_regs[BMP_REG_PWR_CTRL];
+	uint32_t raw_temperature;
+	uint32_t raw_pressure;
+	uint32_t filtered_temperature;
+	uint32_t filtered_pressure;
+
+	if(!s_filter_primed)
+	{
+		s_filtered_pa = pressure;
+		s_filtered_c = temperature;
+		s_filter_primed = true;
+	}
+	s_filtered_pa = (s_filtered_pa * coefficient + pressure) / (coefficient + 1.0);
+	s_filtered_c = (s_filtered_c * coefficient + temperature) / (coefficient + 1.0);
+
+	make_raw(temperature, pressure, &raw_temperature, &raw_pressure);
+	make_raw(s_filtered_c, s_filtered_pa, &filtered_temperature, &filtered_pressure);
+
+	//The data registers always hold the filtered values.
+	if(power & BMP_PRESS_EN)
+	{
+		put_le24(&s_regs[BMP_REG_DATA], filtered_pressure);
+	}
+	if(power & BMP_TEMP_EN)
+	{
+		put_le24(&s_regs[BMP_REG_DATA + 3], filtered_temperature);
+	}
+	s_regs[BMP_REG_STATUS] |= BMP_STATUS_PRESS_READY | BMP_STATUS_TEMP_READY;
+	s_newest_time = (uint32_t) llround(number * sim_bmp388_sampler.period_ns * 1e-9 * s_clock * BMP_SENSORTIME_HZ) & 0xFFFFFF;
+	put_le24(&s_regs[BMP_REG_SENSORTIME], s_newest_time);
+	raise_interrupt(BMP_INT_DRDY);
+
+	if((power & BMP_MODE_MASK) != BMP_MODE_NORMAL)
+	{
+		//A forced measurement puts the sensor back to sleep.
+		s_regs[BMP_REG_PWR_CTRL] &= (uint8_t) ~BMP_MODE_MASK;
+		sim_sampler_stop(&sim_bmp388_sampler);
+	}
+
+	if((config & BMP_FIFO_MODE) == 0)
+	{
+		return;
+	}
+
+	uint32_t subsampling = 1u << (s_regs[BMP_REG_FIFO_CONFIG_2] & BMP_FIFO_SUBSAMPLING);
+	if(++s_subsample_count < subsampling)
+	{
+		return;
+	}
+	s_subsample_count = 0;
+
+	if((s_regs[BMP_REG_FIFO_CONFIG_2] & BMP_FIFO_FILTERED) == 0)
+	{
+		filtered_temperature = raw_temperature;
+		filtered_pressure = raw_pressure;
+	}
+
+	bool with_pressure = (config & BMP_FIFO_PRESS_EN) && (power & BMP_PRESS_EN);
+	bool with_temperature = (config & BMP_FIFO_TEMP_EN) && (power & BMP_TEMP_EN);
+	uint8_t frame[7];
+
+	if(with_pressure && with_temperature)
+	{
+		frame[0] = BMP_FRAME_PRESS_TEMP;
+		put_le24(&frame[1], filtered_temperature);
+		put_le24(&frame[4], filtered_pressure);
+		fifo_push(frame, 7);
+	}else if(with_temperature)
+	{
+		frame[0] = BMP_FRAME_TEMP;
+		put_le24(&frame[1], filtered_temperature);
+		fifo_push(frame, 4);
+	}else if(with_pressure)
+	{
+		frame[0] = BMP_FRAME_PRESS;
+		put_le24(&frame[1], filtered_pressure);
+		fifo_push(frame, 4);
+	}
+}
+
+static uint8_t bmp_read(transaction *t)
+{
+	uint8_t address = t->address;
+
+	if(address == BMP_REG_FIFO_DATA)
+	{
+		uint32_t offset = t->fifo_read++;
+
+		if(offset < s_fifo_fill)
+		{
+			return s_fifo[offset];
+		}
+
+		//Past the data: a sensor time frame if enabled, then empty frames.
+		offset -= s_fifo_fill;
+		if(s_regs[BMP_REG_FIFO_CONFIG_1] & BMP_FIFO_TIME_EN)
+		{
+			if(offset == 0)
+			{
+				return BMP_FRAME_TIME;
+			}
+			if(offset <= 3)
+			{
+				return (uint8_t) (s_newest_time >> (8 * (offset - 1)));
+			}
+			offset -= 4;
+		}
+		return (offset % 2 == 0) ? BMP_FRAME_EMPTY : 0x00;
+	}
+
+	t->address = (address + 1) & 0x7F;
+	switch(address)
+	{
+		case BMP_REG_INT_STATUS:
+		{
+			//Cleared by reading.
+			uint8_t status = s_regs[BMP_REG_INT_STATUS];
+			s_regs[BMP_REG_INT_STATUS] = 0;
+			return status;
+		}
+		case BMP_REG_FIFO_LENGTH:
+			return (uint8_t) (s_fifo_fill & 0xFF);
+		case BMP_REG_FIFO_LENGTH + 1:
+			return (uint8_t) ((s_fifo_fill >> 8) & 0x01);
+		default:
+			return s_regs[address];
+	}
+}
+
+static void bmp_write(uint8_t address, uint8_t value)
+{
+	switch(address)
+	{
+		case BMP_REG_CMD:
+			if(value == BMP_CMD_SOFTRESET)
+			{
+				bmp_reset();
+			}else if(value == BMP_CMD_FIFO_FLUSH)
+			{
+				s_fifo_fill = 0;
+			}
+			return;
+		case BMP_REG_CHIP_ID:
+		case BMP_REG_ERR:
+		case BMP_REG_STATUS:
+		case BMP_REG_INT_STATUS:
+		case BMP_REG_FIFO_LENGTH:
+		case BMP_REG_FIFO_LENGTH + 1:
+			return;
+		default:
+			break;
+	}
+
+	if(address >= BMP_REG_CALIBRATION && address < BMP_REG_CALIBRATION + 21)
+	{
+		return;
+	}
+
+	s_regs[address] = value;
+	if(address == BMP_REG_CONFIG)
+	{
+		s_filter_primed = false;
+	}
+	if(address == BMP_REG_PWR_CTRL || address == BMP_REG_ODR)
+	{
+		update_sampling();
+	}
+}
+
+static void bmp_select(void)
+{
+	sim_sensors_catch_up(now_ns() / SIM_NS_PER_US);
+	memset(&s_transaction, 0, sizeof(s_transaction));
+}
+
+static uint8_t bmp_exchange(uint8_t mosi)
+{
+	transaction *t = &s_transaction;
+	uint32_t index = t->index++;
+
+	if(index == 0)
+	{
+		t->write = (mosi & 0x80) == 0;
+		t->address = mosi & 0x7F;
+		return 0xFF;
+	}
+
+	if(t->write)
+	{
+		//Writes are address, data pairs, not a burst.
+		if(index % 2 == 1)
+		{
+			bmp_write(t->address, mosi);
+		}else
+		{
+			t->address = mosi & 0x7F;
+		}
+		return 0xFF;
+	}
+
+	//Reads start with a dummy byte.
+	return (index == 1) ? 0xFF : bmp_read(t);
+}
+
+static void bmp_deselect(void)
+{
+	//Only frames that were read to the end leave the FIFO.
+	uint32_t consumed = 0;
+	while(consumed < s_fifo_fill && consumed + frame_length(s_fifo[consumed]) <= s_transaction.fifo_read)
+	{
+		consumed += frame_length(s_fifo[consumed]);
+	}
+	if(consumed > 0)
+	{
+		fifo_drop(consumed);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_bmp388_init(const sim_options *options)
+{
+	s_clock = 1.0 + options->clock_error[2];
+	bmp_reset();
+}
@@ -0,0 +1,372 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  The rest of the board in the host build: the GPIO pins, the sensor interrupt lines, and stand ins for STM32.c,
+//  buzzer.c and recovery.c. Firing an e-match opens the matching parachute in the simulated flight.
+//
+//  Also the simulated interrupt controller. The port calls ulApplicationSimInterrupts when the next event is due;
+//  it brings the sensors up to date, delivers their interrupt edges and the SPI DMA completions, and ends the
+//  flight once the rocket has been on the ground for a while.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "STM32.h"
+#include "buzzer.h"
+#include "recovery.h"
+#include "hardware_definitions.h"
+#include "task.h"
+#include "tasks/sensors/imu_sensor.h"
+#include "tasks/sensors/pressure_sensor.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define LANDED_TIME_S		30.0	//How long the flight goes on after touchdown, for the landing to be detected and logged.
+#define CPU_CLOCK_HZ		84000000	//HCLK, as system_clock_config sets it up.
+#define NUM_SAMPLERS		3
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+GPIO_TypeDef sim_gpio_a;
+GPIO_TypeDef sim_gpio_b = {USR_PB_PIN, 0};	//USR_PB reads high while it is not pressed. Held at power on, it sends the board to the CLI.
+GPIO_TypeDef sim_gpio_c;
+
+uint32_t SystemCoreClock = CPU_CLOCK_HZ;
+CoreDebug_Type sim_core_debug;
+static DWT_Type s_dwt;
+
+//Symbols from the linker script, for the CLI's memory report. The host has no such layout, so the report is noise.
+uint8_t _sdata;
+uint8_t _ebss;
+uint8_t _estack;
+
+static sim_sampler *const s_samplers[NUM_SAMPLERS] =
+{
+	&sim_bmi088_accel_sampler,
+	&sim_bmi088_gyro_sampler,
+	&sim_bmp388_sampler,
+};
+
+static double s_pad_time_s;
+static double s_max_time_s;
+
+static bool s_sensor_irq_enabled;
+static bool s_imu_pending;
+static bool s_pressure_pending;
+
+static bool s_fired[2];
+
+
+static double sample_time_ns(const sim_sampler *sampler)
+{
+	return (double) sampler->next * sampler->period_ns;
+}
+
+static uint64_t sample_time_us(const sim_sampler *sampler)
+{
+	return (uint64_t) ceil(sample_time_ns(sampler) / SIM_NS_PER_US);
+}
+
+/**
+ * @brief The sampler whose next sample is the earliest, or NULL if none is running.
+ */
+static sim_sampler *next_sampler(void)
+{
+	sim_sampler *next = NULL;
+
+	for(int i = 0; i < NUM_SAMPLERS; i++)
+	{
+		sim_sampler *sampler = s_samplers[i];
+		if(sampler->running && (next == NULL || sample_time_ns(sampler) < sample_time_ns(next)))
+		{
+			next = sampler;
+		}
+	}
+	return next;
+}
+
+static uint64_t earliest(uint64_t a, uint64_t b)
+{
+	return (a < b) ? a : b;
+}
+
+static uint64_t seconds_to_us(double seconds)
+{
+	return (uint64_t) (seconds * SIM_US_PER_S);
+}
+
+/**
+ * @brief Delivers the sensor edges that are waiting, once the firmware has enabled their EXTI line.
+ */
+static void deliver_sensor_interrupts(uint64_t now_us)
+{
+	if(!s_sensor_irq_enabled)
+	{
+		return;
+	}
+
+	if(s_imu_pending)
+	{
+		s_imu_pending = false;
+		imu_sensor_interrupt((uint32_t) now_us);
+	}
+
+	if(s_pressure_pending)
+	{
+		s_pressure_pending = false;
+		pressure_sensor_interrupt((uint32_t) now_us);
+	}
+}
+
+static void raise_interrupt(bool *pending)
+{
+	*pending = true;
+	vPortSimInterruptAt(ulPortSimTime());
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_board_init(const sim_options *options)
+{
+	s_pad_time_s = options->pad_time_s;
+	s_max_time_s = options->max_time_s;
+}
+
+bool sim_board_fired(int chute)
+{
+	return s_fired[chute];
+}
+
+void sim_sampler_start(sim_sampler *sampler, double period_ns)
+{
+	sampler->period_ns = period_ns;
+	sampler->next = (uint64_t) floor(ulPortSimTime() * SIM_NS_PER_US / period_ns) + 1;
+	sampler->running = true;
+	vPortSimInterruptAt(sample_time_us(sampler));
+}
+
+void sim_sampler_stop(sim_sampler *sampler)
+{
+	sampler->running = false;
+}
+
+void sim_sensors_catch_up(uint64_t now_us)
+{
+	sim_sampler *sampler;
+
+	while((sampler = next_sampler()) != NULL && sample_time_ns(sampler) <= (double) (now_us * SIM_NS_PER_US))
+	{
+		const sim_state *state = sim_trajectory_advance((uint64_t) sample_time_ns(sampler));
+		sampler->sample(state, sampler->next++);
+	}
+}
+
+void sim_raise_imu_interrupt(void)
+{
+	raise_interrupt(&s_imu_pending);
+}
+
+void sim_raise_pressure_interrupt(void)
+{
+	raise_interrupt(&s_pressure_pending);
+}
+
+uint64_t ulApplicationSimInterrupts(uint64_t now_us)
+{
+	sim_sensors_catch_up(now_us);
+	deliver_sensor_interrupts(now_us);
+
+	uint64_t next = sim_spi_interrupts(now_us);
+
+	sim_sampler *sampler = next_sampler();
+	if(sampler != NULL)
+	{
+		next = earliest(next, sample_time_us(sampler));
+	}
+
+	uint64_t end_us = seconds_to_us(s_max_time_s);
+	double touchdown_s = sim_trajectory_touchdown();
+	if(touchdown_s >= 0.0)
+	{
+		end_us = earliest(end_us, seconds_to_us(s_pad_time_s + touchdown_s + LANDED_TIME_S));
+	}
+
+	if(now_us >= end_us)
+	{
+		sim_finish((touchdown_s >= 0.0) ? "landed" : "time limit");
+	}
+
+	return earliest(next, end_us);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// GPIO and NVIC
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	(void) GPIOx;
+	(void) GPIO_Init;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return ((GPIOx->inputs | GPIOx->outputs) & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if(PinState == GPIO_PIN_SET)
+	{
+		GPIOx->outputs |= GPIO_Pin;
+	}else
+	{
+		GPIOx->outputs &= (uint16_t) ~GPIO_Pin;
+	}
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	GPIOx->outputs ^= GPIO_Pin;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	(void) IRQn;
+	(void) PreemptPriority;
+	(void) SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	if(IRQn == SENSOR_INT_IRQn)
+	{
+		//Like the EXTI pending bit, an edge from before the line was enabled still gets through.
+		s_sensor_irq_enabled = true;
+		vPortSimInterruptAt(ulPortSimTime());
+	}
+}
+
+DWT_Type *sim_dwt(void)
+{
+	//Code takes no simulated time, so only waiting shows up in the cycle count.
+	if(s_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)
+	{
+		s_dwt.CYCCNT = (uint32_t) (ulPortSimTime() * (CPU_CLOCK_HZ / SIM_US_PER_S));
+	}
+	return &s_dwt;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// STM32.h
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+STM32Status stm32_init(void)
+{
+	return STM32_OK;
+}
+
+void stm32_error_handler(void)
+{
+	fprintf(stderr, "sitl: stm32_error_handler called %.6f s after power on\n", ulPortSimTime() / 1e6);
+	exit(EXIT_FAILURE);
+}
+
+void stm32_delay(uint32_t ms)
+{
+	//HAL_Delay spins, so the time is spent whether or not there is a scheduler.
+	vPortSimConsume((uint64_t) ms * 1000);
+}
+
+void stm32_led_blink()
+{
+	if(HAL_GPIO_ReadPin(USR_PB_PORT, USR_PB_PIN))
+	{
+		HAL_GPIO_WritePin(USR_LED_PORT, USR_LED_PIN, GPIO_PIN_SET);
+	}else
+	{
+		HAL_GPIO_WritePin(USR_LED_PORT, USR_LED_PIN, GPIO_PIN_RESET);
+	}
+}
+
+STM32Status stm32_timestamp_init(void)
+{
+	return STM32_OK;
+}
+
+uint32_t stm32_get_time_us(void)
+{
+	//TIM5 counts microseconds from power on and wraps at 32 bits, like this.
+	return (uint32_t) ulPortSimTime();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// buzzer.h
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void buzzer_init(void)
+{
+}
+
+void buzz(int milliseconds)
+{
+	//The real one toggles the pin off TIM2 in a busy loop.
+	vPortSimConsume((uint64_t) milliseconds * 1000);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// recovery.h
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void recovery_init()
+{
+}
+
+void recovery_enable_mosfet(RecoverySelect recov_event)
+{
+	(void) recov_event;
+}
+
+void recovery_activate_mosfet(RecoverySelect recov_event)
+{
+	int chute = (recov_event == MAIN) ? 1 : 0;
+	uint64_t now_us = ulPortSimTime();
+
+	//The charge goes off at the start of the pulse, wherever the rocket is by then.
+	sim_sensors_catch_up(now_us);
+	sim_trajectory_advance(now_us * SIM_NS_PER_US);
+	sim_trajectory_deploy(chute);
+	s_fired[chute] = true;
+
+	if(sim_verbose)
+	{
+		fprintf(stderr, "sitl: %s fired %.3f s after power on\n", chute ? "main" : "drogue", now_us / 1e6);
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(EMATCH_ON_TIME));
+}
+
+RecoveryContinuityStatus recovery_check_continuity(RecoverySelect recov_event)
+{
+	//An e-match reads shorted until it has been fired.
+	return s_fired[(recov_event == MAIN) ? 1 : 0] ? OPEN_CIRCUIT : SHORT_CIRCUIT;
+}
+
+RecoveryOverCurrentStatus recovery_check_overcurrent(RecoverySelect recov_event)
+{
+	(void) recov_event;
+	return NO_OVERCURRENT;
+}
@@ -0,0 +1,345 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Model of the 8 MB NOR flash on SPI1, with the commands flash.c sends: ID, status, write enable, read and fast
+//  read, page program, sector, parameter sector and bulk erase, and erase suspend and resume. Programs and erases
+//  take the typical times from the datasheet, with WIP set until they are done, and programming can only clear
+//  bits, as on the chip.
+//
+//  The array lives in RAM, or in a file mapped into memory so a flight's log can be looked at (or downloaded
+//  again) after the program ends.
+//
+// History
+// 2026-10-17
+// - Created.
+// 2026-10-18
+// - Sector erases clear the chip's 64 kB, whatever flash.h says.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "flash.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define FLASH_MODEL_BYTES			(FLASH_END_ADDRESS + 1)
+#define PROGRAM_TIME_US				1500
+#define SECTOR_ERASE_TIME_US		500000
+#define PARAM_SECTOR_ERASE_TIME_US	200000
+#define BULK_ERASE_TIME_US			64000000
+#define SUSPEND_LATENCY_US			20			//Typical, the limit is 45 us.
+#define SECTOR_BYTES				0x10000		//From the datasheet rather than flash.h, so a wrong size there shows up.
+#define PARAM_SECTOR_BYTES			0x1000
+
+#define STATUS_WIP					(1 << FLASH_WIP_BIT)
+#define STATUS_WEL					(1 << FLASH_WEL_BIT)
+#define STATUS_E_ERR				(1 << FLASH_E_ERR_BIT)
+#define STATUS_P_ERR				(1 << FLASH_P_ERR_BIT)
+
+typedef enum
+{
+	OPERATION_NONE,
+	OPERATION_PROGRAM,
+	OPERATION_ERASE,
+	OPERATION_SUSPENDING	//Erase suspend issued, WIP still set for the suspend latency.
+} operation;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void flash_select(void);
+static uint8_t flash_exchange(uint8_t mosi);
+static void flash_deselect(void);
+
+sim_spi_device sim_flash_device = {"flash", flash_select, flash_exchange, flash_deselect, 0, 0, 0};
+
+static uint8_t *s_memory;
+static uint8_t s_status;
+
+static operation s_operation;
+static uint64_t s_operation_end_us;
+static uint32_t s_erase_address;
+static uint32_t s_erase_size;
+static bool s_erase_suspended;
+static uint64_t s_erase_remaining_us;
+
+static uint8_t s_command;
+static uint32_t s_index;
+static uint32_t s_address;
+static uint8_t s_page[FLASH_PAGE_SIZE];
+static bool s_page_touched[FLASH_PAGE_SIZE];
+
+
+static bool busy(void)
+{
+	return s_operation != OPERATION_NONE;
+}
+
+static void finish_operation(void)
+{
+	switch(s_operation)
+	{
+		case OPERATION_ERASE:
+			memset(&s_memory[s_erase_address], 0xFF, s_erase_size);
+			s_erase_size = 0;
+			break;
+		case OPERATION_SUSPENDING:
+			s_erase_suspended = true;
+			break;
+		default:
+			break;
+	}
+	s_operation = OPERATION_NONE;
+	s_status &= (uint8_t) ~(STATUS_WIP | STATUS_WEL);
+}
+
+static void start_operation(operation op, uint64_t duration_us)
+{
+	s_operation = op;
+	s_operation_end_us = ulPortSimTime() + duration_us;
+	s_status |= STATUS_WIP;
+}
+
+static void start_erase(uint32_t address, uint32_t size, uint64_t duration_us)
+{
+	if(!(s_status & STATUS_WEL))
+	{
+		return;
+	}
+
+	s_erase_address = address & ~(size - 1);
+	s_erase_size = size;
+	s_status &= (uint8_t) ~(STATUS_E_ERR | STATUS_P_ERR);
+	start_operation(OPERATION_ERASE, duration_us);
+}
+
+/**
+ * @brief Runs a command once the chip is deselected, which is when the chip acts on program and erase commands.
+ */
+static void execute(void)
+{
+	switch(s_command)
+	{
+		case FLASH_ENABLE_WRITE_COMMAND:
+			if(s_index == 1)
+			{
+				s_status |= STATUS_WEL;
+			}
+			break;
+		case FLASH_PP_COMMAND:
+			if(s_index > 4 && (s_status & STATUS_WEL))
+			{
+				//Programming only clears bits, within the page the address is in.
+				uint32_t page = s_address & ~(FLASH_PAGE_SIZE - 1) & (FLASH_MODEL_BYTES - 1);
+				for(uint32_t i = 0; i < FLASH_PAGE_SIZE; i++)
+				{
+					if(s_page_touched[i])
+					{
+						s_memory[page + i] &= s_page[i];
+					}
+				}
+				s_status &= (uint8_t) ~STATUS_P_ERR;
+				start_operation(OPERATION_PROGRAM, PROGRAM_TIME_US);
+			}
+			break;
+		case FLASH_ERASE_SEC_COMMAND:
+			if(s_index == 4)
+			{
+				start_erase(s_address & (FLASH_MODEL_BYTES - 1), SECTOR_BYTES, SECTOR_ERASE_TIME_US);
+			}
+			break;
+		case FLASH_ERASE_PARAM_SEC_COMMAND:
+			if(s_index == 4)
+			{
+				if(s_address > FLASH_PARAM_END_ADDRESS)
+				{
+					//There are only parameter sectors at the bottom of the array.
+					s_status |= STATUS_E_ERR;
+					s_status &= (uint8_t) ~STATUS_WEL;
+				}else
+				{
+					start_erase(s_address, PARAM_SECTOR_BYTES, PARAM_SECTOR_ERASE_TIME_US);
+				}
+			}
+			break;
+		case FLASH_BULK_ERASE_COMMAND:
+			if(s_index == 1)
+			{
+				start_erase(0, FLASH_MODEL_BYTES, BULK_ERASE_TIME_US);
+			}
+			break;
+		case FLASH_ERASE_SUSPEND_COMMAND:
+			if(s_operation == OPERATION_ERASE && s_erase_size < FLASH_MODEL_BYTES)
+			{
+				s_erase_remaining_us = s_operation_end_us - ulPortSimTime();
+				start_operation(OPERATION_SUSPENDING, SUSPEND_LATENCY_US);
+			}
+			break;
+		case FLASH_ERASE_RESUME_COMMAND:
+			if(s_erase_suspended && !busy())
+			{
+				s_erase_suspended = false;
+				start_operation(OPERATION_ERASE, s_erase_remaining_us);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void flash_select(void)
+{
+	sim_flash_update(ulPortSimTime());
+	s_command = 0;
+	s_index = 0;
+	s_address = 0;
+	memset(s_page_touched, 0, sizeof(s_page_touched));
+}
+
+static uint8_t flash_exchange(uint8_t mosi)
+{
+	uint32_t index = s_index++;
+
+	if(index == 0)
+	{
+		s_command = mosi;
+		//While busy the chip only answers status reads, and a suspend during an erase.
+		if(busy() && mosi != FLASH_GET_STATUS_REG_COMMAND &&
+		   !(mosi == FLASH_ERASE_SUSPEND_COMMAND && s_operation == OPERATION_ERASE))
+		{
+			s_command = 0;
+		}
+		return 0xFF;
+	}
+
+	switch(s_command)
+	{
+		case FLASH_GET_STATUS_REG_COMMAND:
+			return s_status;
+		case FLASH_READ_ID_COMMAND:
+		{
+			static const uint8_t id[3] = {FLASH_MANUFACTURER_ID, FLASH_DEVICE_ID_MSB, FLASH_DEVICE_ID_LSB};
+			return (index <= 3) ? id[index - 1] : 0xFF;
+		}
+		case FLASH_READ_COMMAND:
+		case FLASH_FAST_READ_COMMAND:
+		case FLASH_PP_COMMAND:
+		case FLASH_ERASE_SEC_COMMAND:
+		case FLASH_ERASE_PARAM_SEC_COMMAND:
+			break;
+		default:
+			return 0xFF;
+	}
+
+	if(index <= 3)
+	{
+		s_address = (s_address << 8) | mosi;
+		return 0xFF;
+	}
+
+	uint32_t data_index = index - 4;
+	if(s_command == FLASH_FAST_READ_COMMAND)
+	{
+		if(data_index == 0)
+		{
+			return 0xFF;
+		}
+		data_index--;
+	}
+
+	if(s_command == FLASH_PP_COMMAND)
+	{
+		uint32_t offset = (s_address + data_index) & (FLASH_PAGE_SIZE - 1);
+		s_page[offset] = mosi;
+		s_page_touched[offset] = true;
+		return 0xFF;
+	}
+
+	if(s_command == FLASH_READ_COMMAND || s_command == FLASH_FAST_READ_COMMAND)
+	{
+		return s_memory[(s_address + data_index) & (FLASH_MODEL_BYTES - 1)];
+	}
+	return 0xFF;
+}
+
+static void flash_deselect(void)
+{
+	execute();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool sim_flash_init(const char *file)
+{
+	if(file == NULL)
+	{
+		s_memory = malloc(FLASH_MODEL_BYTES);
+		if(s_memory == NULL)
+		{
+			return false;
+		}
+		memset(s_memory, 0xFF, FLASH_MODEL_BYTES);
+		return true;
+	}
+
+	int fd = open(file, O_RDWR | O_CREAT, 0644);
+	struct stat info;
+	if(fd < 0 || fstat(fd, &info) != 0)
+	{
+		perror(file);
+		return false;
+	}
+
+	bool created = (info.st_size == 0);
+	if(info.st_size != FLASH_MODEL_BYTES && ftruncate(fd, FLASH_MODEL_BYTES) != 0)
+	{
+		perror(file);
+		close(fd);
+		return false;
+	}
+
+	s_memory = mmap(NULL, FLASH_MODEL_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(s_memory == MAP_FAILED)
+	{
+		perror(file);
+		return false;
+	}
+
+	//A new file is an erased chip.
+	if(created)
+	{
+		memset(s_memory, 0xFF, FLASH_MODEL_BYTES);
+	}
+	return true;
+}
+
+uint8_t *sim_flash_memory(void)
+{
+	return s_memory;
+}
+
+void sim_flash_update(uint64_t now_us)
+{
+	if(busy() && now_us >= s_operation_end_us)
+	{
+		finish_operation();
+	}
+}
@@ -0,0 +1,296 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Stand in for SPI.c in the host build. It keeps the behaviour the rest of the firmware sees: devices registered
+//  with their chip select and clock, a lock on each bus for the whole transaction, the same split into polled
+//  transfers and DMA transfers that block the calling task until the completion interrupt, with the same timeout,
+//  and the time the bytes take on the wire at the prescaler SPI.c would pick. The bytes go to the simulated chips
+//  instead of a peripheral.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdio.h>
+
+#include "SPI.h"
+#include "hardware_definitions.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "utilities/profiler.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SPI_DMA_MIN_TRANSFER_SIZE	16		//As in SPI.c.
+#define SPI_CALL_OVERHEAD_NS		2000	//HAL call and chip select toggling, per transfer.
+#define SPI_MAX_DEVICES				4		//As in SPI.c.
+#define APB2_CLOCK_HZ				84000000
+#define APB1_CLOCK_HZ				42000000
+
+typedef struct
+{
+	const char *name;
+	uint32_t pclk_hz;
+	SemaphoreHandle_t lock;
+	StaticSemaphore_t lock_buffer;
+
+	//The DMA transfer in flight, if any. Its bytes are exchanged when it completes or is aborted.
+	bool dma_active;
+	sim_spi_device *dma_device;
+	uint8_t *dma_tx;
+	uint8_t *dma_rx;
+	uint32_t dma_size;
+	uint64_t dma_start_ns;
+	uint64_t dma_done_us;
+	TaskHandle_t dma_task;
+} spi_bus;
+
+typedef struct
+{
+	spi_bus *bus;
+	sim_spi_device *chip;
+	uint32_t clock_hz;
+	uint32_t byte_ns;				//8 bits at clock_hz.
+} spi_device;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static spi_bus s_buses[SPI_NUM_BUSES] =
+{
+	{"spi1", APB2_CLOCK_HZ},
+	{"spi2", APB1_CLOCK_HZ},
+	{"spi3", APB1_CLOCK_HZ},
+};
+
+static spi_device s_devices[SPI_MAX_DEVICES];
+static uint8_t s_device_count;
+
+
+/**
+ * @brief The simulated chip wired to a chip select, or NULL.
+ */
+static sim_spi_device *get_chip(GPIO_TypeDef *cs_port, uint16_t cs_pin)
+{
+	if(cs_port == FLASH_SPI_CS_PORT && cs_pin == FLASH_SPI_CS_PIN)
+	{
+		return &sim_flash_device;
+	}else if(cs_port == PRES_SPI_CS_PORT && cs_pin == PRES_SPI_CS_PIN)
+	{
+		return &sim_bmp388_device;
+	}else if(cs_port == IMU_SPI_ACC_CS_PORT && cs_pin == IMU_SPI_ACC_CS_PIN)
+	{
+		return &sim_bmi088_accel_device;
+	}else if(cs_port == IMU_SPI_GYRO_CS_PORT && cs_pin == IMU_SPI_GYRO_CS_PIN)
+	{
+		return &sim_bmi088_gyro_device;
+	}
+	return NULL;
+}
+
+static void exchange(sim_spi_device *device, uint8_t *tx_buffer, uint8_t *rx_buffer, uint32_t size)
+{
+	for(uint32_t i = 0; i < size; i++)
+	{
+		//HAL_SPI_Receive clocks out whatever is in the receive buffer. The models ignore it.
+		uint8_t miso = device->exchange((tx_buffer != NULL) ? tx_buffer[i] : 0xFF);
+		if(rx_buffer != NULL)
+		{
+			rx_buffer[i] = miso;
+		}
+	}
+	device->bytes += size;
+}
+
+static uint64_t now_ns(void)
+{
+	return ulPortSimTime() * SIM_NS_PER_US;
+}
+
+static HAL_StatusTypeDef transfer_dma(spi_bus *bus, sim_spi_device *device, uint32_t byte_ns, uint8_t *tx_buffer, uint8_t *rx_buffer,
+						 uint32_t size, uint32_t timeout)
+{
+	ulTaskNotifyTake(pdTRUE, 0);
+
+	bus->dma_device = device;
+	bus->dma_tx = tx_buffer;
+	bus->dma_rx = rx_buffer;
+	bus->dma_size = size;
+	bus->dma_start_ns = now_ns();
+	bus->dma_done_us = (bus->dma_start_ns + (uint64_t) size * byte_ns + SIM_NS_PER_US - 1) / SIM_NS_PER_US;
+	bus->dma_task = xTaskGetCurrentTaskHandle();
+	bus->dma_active = true;
+	vPortSimInterruptAt(bus->dma_done_us);
+
+	if(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout)) != 0)
+	{
+		//Only the completion interrupt may wake the task. Anything else sharing its notification ends the wait while the
+		//bytes are still on the wire, as it would on the board.
+		configASSERT(!bus->dma_active);
+	}else if(bus->dma_active)
+	{
+		//HAL_SPI_Abort: the chip only saw the bytes clocked so far.
+		uint32_t clocked = (uint32_t) ((now_ns() - bus->dma_start_ns) / byte_ns);
+		bus->dma_active = false;
+		exchange(device, tx_buffer, rx_buffer, (clocked < size) ? clocked : size);
+		device->timeouts++;
+
+		if(sim_verbose)
+		{
+			fprintf(stderr, "sitl: %s transfer of %u bytes timed out after %u ms, %.6f s after power on\n",
+					device->name, size, timeout, ulPortSimTime() / 1e6);
+		}
+		return HAL_TIMEOUT;
+	}
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef transfer(spi_device *device, uint8_t *tx_buffer, uint8_t *rx_buffer, uint32_t size,
+								  uint32_t timeout)
+{
+	if(size == 0)
+	{
+		return HAL_OK;
+	}
+
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && size >= SPI_DMA_MIN_TRANSFER_SIZE)
+	{
+		return transfer_dma(device->bus, device->chip, device->byte_ns, tx_buffer, rx_buffer, size, timeout);
+	}
+
+	exchange(device->chip, tx_buffer, rx_buffer, size);
+	vPortSimConsume(((uint64_t) size * device->byte_ns + SPI_CALL_OVERHEAD_NS) / SIM_NS_PER_US);
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef transaction(SPI hspi, uint32_t timeout, uint8_t *first, uint32_t first_size,
+									 uint8_t *tx_buffer, uint8_t *rx_buffer, uint32_t size)
+{
+	spi_device *device = (spi_device *) hspi;
+	bool locked = xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+	uint32_t start = profiler_start();
+
+	if(locked)
+	{
+		xSemaphoreTake(device->bus->lock, portMAX_DELAY);
+	}
+
+	device->chip->transactions++;
+	device->chip->select();
+	HAL_StatusTypeDef stat = transfer(device, first, NULL, first_size, timeout);
+	if(stat == HAL_OK)
+	{
+		stat = transfer(device, tx_buffer, rx_buffer, size, timeout);
+	}
+	device->chip->deselect();
+
+	if(locked)
+	{
+		xSemaphoreGive(device->bus->lock);
+	}
+
+	//Timed like the public functions of SPI.c.
+	profiler_end(PROFILER_SPAN_SPI_TRANSACTION, start);
+	return stat;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+SPI spi_register_device(const spi_device_config *config)
+{
+	sim_spi_device *chip = get_chip(config->cs_port, config->cs_pin);
+	if(s_device_count == SPI_MAX_DEVICES || chip == NULL)
+	{
+		return NULL;
+	}
+
+	spi_bus *bus = &s_buses[config->bus];
+	if(bus->lock == NULL)
+	{
+		bus->lock = xSemaphoreCreateMutexStatic(&bus->lock_buffer);
+	}
+
+	//The prescaler SPI.c picks: the fastest power of two from 2 to 256 that stays at or below the rating.
+	uint32_t prescaler = 0;
+	while(prescaler < 7 && (bus->pclk_hz >> (prescaler + 1)) > config->max_clock_hz)
+	{
+		prescaler++;
+	}
+
+	spi_device *device = &s_devices[s_device_count++];
+	device->bus = bus;
+	device->chip = chip;
+	device->clock_hz = bus->pclk_hz >> (prescaler + 1);
+	device->byte_ns = (uint32_t) (8ULL * SIM_NS_PER_US * 1000000 / device->clock_hz);
+	return device;
+}
+
+uint32_t spi_get_clock_hz(SPI device)
+{
+	return ((spi_device *) device)->clock_hz;
+}
+
+HAL_StatusTypeDef spi_transmit(SPI hspi, uint8_t *addr_buffer, uint8_t *tx_buffer, uint16_t total_size, uint32_t timeout)
+{
+	return transaction(hspi, timeout, addr_buffer, 1, tx_buffer, NULL, (total_size > 1) ? total_size : 0);
+}
+
+HAL_StatusTypeDef spi_read(SPI hspi, uint8_t *addr_buffer, uint8_t *rx_buffer, uint16_t total_size, uint32_t timeout)
+{
+	return transaction(hspi, timeout, addr_buffer, 1, NULL, rx_buffer, (total_size > 0) ? total_size - 1u : 0);
+}
+
+HAL_StatusTypeDef spi_send(SPI hspi, uint8_t *reg_addr, uint8_t reg_addr_size, uint8_t *tx_buffer,
+						   uint32_t tx_buffer_size, uint32_t timeout)
+{
+	return transaction(hspi, timeout, reg_addr, reg_addr_size, tx_buffer, NULL, tx_buffer_size);
+}
+
+HAL_StatusTypeDef spi_receive(SPI hspi, uint8_t *addr_buffer, uint8_t addr_buffer_size, uint8_t *rx_buffer,
+							  uint32_t rx_buffer_size, uint32_t timeout)
+{
+	return transaction(hspi, timeout, addr_buffer, addr_buffer_size, NULL, rx_buffer, rx_buffer_size);
+}
+
+uint64_t sim_spi_interrupts(uint64_t now_us)
+{
+	uint64_t next = UINT64_MAX;
+
+	for(int i = 0; i < SPI_NUM_BUSES; i++)
+	{
+		spi_bus *bus = &s_buses[i];
+
+		if(!bus->dma_active)
+		{
+			continue;
+		}
+
+		if(bus->dma_done_us > now_us)
+		{
+			next = (bus->dma_done_us < next) ? bus->dma_done_us : next;
+			continue;
+		}
+
+		//The DMA completion interrupt.
+		BaseType_t higher_priority_task_woken = pdFALSE;
+		bus->dma_active = false;
+		exchange(bus->dma_device, bus->dma_tx, bus->dma_rx, bus->dma_size);
+		vTaskNotifyGiveFromISR(bus->dma_task, &higher_priority_task_woken);
+		portYIELD_FROM_ISR(higher_priority_task_woken);
+	}
+
+	return next;
+}
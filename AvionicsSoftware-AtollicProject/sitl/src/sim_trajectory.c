@@ -0,0 +1,354 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  The flight the simulated sensors measure.
+//
+//  By default a one dimensional model: the rocket sits on the pad, burns its motor, coasts against drag in an
+//  exponential atmosphere and comes down on whichever parachutes the firmware fired. The seed varies thrust, drag
+//  and the weather a little from flight to flight. With a trajectory file the altitude and acceleration are
+//  replayed from it instead, and the parachutes change nothing.
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define DRY_MASS_KG				25.0
+#define PROPELLANT_MASS_KG		6.0
+#define BURN_TIME_S				6.0
+#define THRUST_N				3200.0		//Nominal, varied by up to 5% per flight.
+#define BODY_CDA_M2				0.004		//Drag coefficient times area of the rocket, varied by up to 10% per flight.
+#define DROGUE_CDA_M2			0.45
+#define MAIN_CDA_M2				11.0
+#define SCALE_HEIGHT_M			8500.0
+#define SEA_LEVEL_DENSITY		1.225
+#define LAPSE_RATE_K_PER_M		0.0065		//Of the atmosphere, for the pressure.
+#define BAY_TIME_CONSTANT_S		600.0		//How slowly the avionics bay, where the temperature sensor is, follows the air outside.
+#define STEP_NS					1000000ULL	//Longest integration step.
+#define CHUTE_SWAY_DPS			15.0
+#define CHUTE_SWAY_HZ			0.5
+
+#define REPLAY_MAX_ROWS			200000
+
+typedef struct
+{
+	double time_s;
+	double altitude_m;
+	double accel_g;
+} replay_row;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static sim_state s_state;
+static uint64_t s_time_ns;
+
+static double s_pad_time_s;
+static double s_thrust_n;
+static double s_body_cda;
+static double s_base_pressure_pa;
+static double s_base_temperature_c;
+
+static double s_apogee_m;
+static double s_touchdown_s = -1.0;
+static sim_deployment s_deployments[2];
+
+static replay_row *s_replay;
+static size_t s_replay_rows;
+static size_t s_replay_index;
+
+static uint64_t s_random_state = 0x9E3779B97F4A7C15ULL;
+
+
+void sim_random_seed(uint64_t seed)
+{
+	//xorshift must not start at 0.
+	s_random_state = seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL;
+	if(s_random_state == 0)
+	{
+		s_random_state = 1;
+	}
+}
+
+double sim_random_uniform(void)
+{
+	s_random_state ^= s_random_state >> 12;
+	s_random_state ^= s_random_state << 25;
+	s_random_state ^= s_random_state >> 27;
+	return ((s_random_state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double sim_random_normal(void)
+{
+	//Box-Muller. The second value is thrown away, which keeps the sequence simple to reproduce.
+	double u1 = sim_random_uniform();
+	double u2 = sim_random_uniform();
+
+	if(u1 < 1e-300)
+	{
+		u1 = 1e-300;
+	}
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * @brief Fills in what the board measures from the altitude, for both the model and the replay. The bay warms or
+ * cools toward the outside air over minutes, so a flight only gets it below freezing on a cold day.
+ */
+static void update_atmosphere(sim_state *state, double dt)
+{
+	double base_k = s_base_temperature_c + 273.15;
+	double ratio = 1.0 - LAPSE_RATE_K_PER_M * state->altitude_m / base_k;
+
+	state->pressure_pa = s_base_pressure_pa * pow(ratio, SIM_GRAVITY * 0.0289644 / (8.31446 * LAPSE_RATE_K_PER_M));
+	double air_c = s_base_temperature_c - LAPSE_RATE_K_PER_M * state->altitude_m;
+	state->temperature_c += (air_c - state->temperature_c) * dt / BAY_TIME_CONSTANT_S;
+}
+
+static void update_gyro(sim_state *state, bool launched)
+{
+	double flight_s = state->time_s - s_pad_time_s;
+
+	memset(state->gyro_dps, 0, sizeof(state->gyro_dps));
+
+	if(!launched || s_touchdown_s >= 0.0)
+	{
+		return;
+	}
+
+	if(s_deployments[0].deployed || s_deployments[1].deployed)
+	{
+		//Swinging under the parachute.
+		state->gyro_dps[1] = CHUTE_SWAY_DPS * sin(2.0 * M_PI * CHUTE_SWAY_HZ * flight_s);
+		state->gyro_dps[2] = CHUTE_SWAY_DPS * cos(2.0 * M_PI * CHUTE_SWAY_HZ * flight_s);
+	}else
+	{
+		//A slow roll on the way up.
+		state->gyro_dps[0] = 20.0;
+	}
+}
+
+static void step_model(double dt)
+{
+	sim_state *state = &s_state;
+	double flight_s = state->time_s - s_pad_time_s;
+
+	state->time_s += dt;
+
+	if(flight_s < 0.0 || s_touchdown_s >= 0.0)
+	{
+		state->accel_g = 1.0;
+		state->velocity_mps = 0.0;
+		update_gyro(state, false);
+		update_atmosphere(state, dt);
+		return;
+	}
+
+	double burnt = (flight_s < BURN_TIME_S) ? flight_s / BURN_TIME_S : 1.0;
+	double mass = DRY_MASS_KG + PROPELLANT_MASS_KG * (1.0 - burnt);
+	double thrust = (flight_s < BURN_TIME_S) ? s_thrust_n : 0.0;
+	double cda = s_body_cda;
+
+	if(s_deployments[0].deployed)
+	{
+		cda += DROGUE_CDA_M2;
+	}
+	if(s_deployments[1].deployed)
+	{
+		cda += MAIN_CDA_M2;
+	}
+
+	double density = SEA_LEVEL_DENSITY * exp(-state->altitude_m / SCALE_HEIGHT_M);
+	double drag = 0.5 * density * state->velocity_mps * fabs(state->velocity_mps) * cda;
+	double specific_force = (thrust - drag) / mass;
+
+	state->velocity_mps += (specific_force - SIM_GRAVITY) * dt;
+	state->altitude_m += state->velocity_mps * dt;
+	state->accel_g = specific_force / SIM_GRAVITY;
+
+	//The ground. Once the motor has burnt out, reaching it is the touchdown.
+	if(state->altitude_m <= 0.0)
+	{
+		state->altitude_m = 0.0;
+		if(state->velocity_mps < 0.0)
+		{
+			state->velocity_mps = 0.0;
+			if(flight_s > BURN_TIME_S)
+			{
+				s_touchdown_s = state->time_s;
+				state->accel_g = 1.0;
+			}
+		}
+	}
+
+	update_gyro(state, true);
+	update_atmosphere(state, dt);
+}
+
+static void step_replay(double dt)
+{
+	sim_state *state = &s_state;
+	double flight_s;
+	double previous_altitude = state->altitude_m;
+
+	state->time_s += dt;
+	flight_s = state->time_s - s_pad_time_s;
+
+	while(s_replay_index + 1 < s_replay_rows && s_replay[s_replay_index + 1].time_s <= flight_s)
+	{
+		s_replay_index++;
+	}
+
+	const replay_row *row = &s_replay[s_replay_index];
+	if(flight_s < s_replay[0].time_s)
+	{
+		state->altitude_m = s_replay[0].altitude_m;
+		state->accel_g = 1.0;
+	}else if(s_replay_index + 1 >= s_replay_rows)
+	{
+		state->altitude_m = row->altitude_m;
+		state->accel_g = 1.0;
+		if(s_touchdown_s < 0.0)
+		{
+			s_touchdown_s = state->time_s;
+		}
+	}else
+	{
+		const replay_row *next = row + 1;
+		double f = (flight_s - row->time_s) / (next->time_s - row->time_s);
+		state->altitude_m = row->altitude_m + f * (next->altitude_m - row->altitude_m);
+		state->accel_g = row->accel_g + f * (next->accel_g - row->accel_g);
+	}
+
+	update_gyro(state, flight_s >= s_replay[0].time_s);
+	update_atmosphere(state, dt);
+	state->velocity_mps = (state->altitude_m - previous_altitude) / dt;
+}
+
+static void load_replay(const char *file)
+{
+	FILE *f = fopen(file, "r");
+	char line[256];
+
+	if(f == NULL)
+	{
+		fprintf(stderr, "sitl: can not open trajectory %s\n", file);
+		exit(EXIT_FAILURE);
+	}
+
+	s_replay = calloc(REPLAY_MAX_ROWS, sizeof(replay_row));
+	while(s_replay_rows < REPLAY_MAX_ROWS && fgets(line, sizeof(line), f) != NULL)
+	{
+		replay_row row;
+		//Anything that is not three numbers, like a header, is skipped.
+		if(sscanf(line, "%lf,%lf,%lf", &row.time_s, &row.altitude_m, &row.accel_g) == 3)
+		{
+			s_replay[s_replay_rows++] = row;
+		}
+	}
+	fclose(f);
+
+	if(s_replay_rows < 2)
+	{
+		fprintf(stderr, "sitl: %s needs at least two rows of time_s,altitude_m,accel_g\n", file);
+		exit(EXIT_FAILURE);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_trajectory_init(const sim_options *options)
+{
+	memset(&s_state, 0, sizeof(s_state));
+	s_time_ns = 0;
+	s_pad_time_s = options->pad_time_s;
+	s_base_pressure_pa = options->base_pressure_pa;
+	s_base_temperature_c = options->base_temperature_c;
+	s_thrust_n = THRUST_N * (1.0 + 0.05 * (2.0 * sim_random_uniform() - 1.0));
+	s_body_cda = BODY_CDA_M2 * (1.0 + 0.10 * (2.0 * sim_random_uniform() - 1.0));
+
+	if(options->trajectory_file != NULL)
+	{
+		load_replay(options->trajectory_file);
+	}
+
+	s_state.accel_g = 1.0;
+	s_state.temperature_c = s_base_temperature_c;
+	update_atmosphere(&s_state, 0.0);
+}
+
+const sim_state *sim_trajectory_advance(uint64_t time_ns)
+{
+	while(s_time_ns < time_ns)
+	{
+		uint64_t step = time_ns - s_time_ns;
+		if(step > STEP_NS)
+		{
+			step = STEP_NS;
+		}
+		s_time_ns += step;
+
+		if(s_replay != NULL)
+		{
+			step_replay(step / 1e9);
+		}else
+		{
+			step_model(step / 1e9);
+		}
+
+		if(s_state.altitude_m > s_apogee_m)
+		{
+			s_apogee_m = s_state.altitude_m;
+		}
+	}
+
+	return &s_state;
+}
+
+void sim_trajectory_deploy(int chute)
+{
+	sim_deployment *deployment = &s_deployments[chute];
+
+	if(deployment->deployed)
+	{
+		return;
+	}
+
+	deployment->deployed = true;
+	deployment->time_s = s_state.time_s - s_pad_time_s;
+	deployment->altitude_m = s_state.altitude_m;
+	deployment->speed_mps = fabs(s_state.velocity_mps);
+}
+
+double sim_trajectory_apogee(void)
+{
+	return s_apogee_m;
+}
+
+const sim_deployment *sim_trajectory_deployment(int chute)
+{
+	return &s_deployments[chute];
+}
+
+double sim_trajectory_touchdown(void)
+{
+	return (s_touchdown_s < 0.0) ? s_touchdown_s : s_touchdown_s - s_pad_time_s;
+}
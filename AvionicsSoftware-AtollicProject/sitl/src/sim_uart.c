@@ -0,0 +1,252 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Stand in for UART.c in the host build. Nothing is plugged into the ports, so the only thing that matters is the
+//  time a transmission takes at the port's baud rate: blocking transmits spend it, DMA transmits finish after it.
+//  Text lines go to stderr with --verbose. Nothing is ever received, so the CLI waits forever for a command.
+//
+//  A test can connect a peer to a port, the host side of the line: what the firmware sends reaches it once it is on
+//  the wire, and what it sends goes to the receive DMA. Bytes only get across while both ends are at the same baud
+//  rate, like on a real line, where they would come out as garbage.
+//
+// History
+// 2026-10-17
+// - Created.
+// 2026-10-18
+// - Added the peer, for the host test of the download.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "UART.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define UART_BITS_PER_BYTE		10		//8N1.
+#define UART_PEER_BUFFER_SIZE	4096	//Bytes sent by the firmware that the peer has not read yet.
+
+typedef struct
+{
+	const char *name;
+	uint32_t baud_rate;
+	uint64_t tx_done_us;		//When the last DMA transmission finishes.
+
+	bool peer_connected;
+	uint32_t peer_baud_rate;
+	uint8_t to_peer[UART_PEER_BUFFER_SIZE];
+	uint32_t to_peer_length;
+	uint32_t to_peer_on_wire;	//Where the bytes of the DMA transmission still going out start in to_peer.
+	bool receiving;
+	uint8_t from_peer[UART_RX_RING_SIZE];
+	uint16_t from_peer_length;
+} sim_uart;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static sim_uart s_port2 = {"uart2", 9600};
+static sim_uart s_port6 = {"uart6", 115200};
+
+
+static uint64_t transmit_time_us(sim_uart *port, uint32_t bytes)
+{
+	return ((uint64_t) bytes * UART_BITS_PER_BYTE * SIM_US_PER_S + port->baud_rate - 1) / port->baud_rate;
+}
+
+/**
+ * @brief Passes bytes the firmware sends on to the peer, if there is one listening at the port's baud rate.
+ */
+static void send_to_peer(sim_uart *port, const uint8_t *bytes, uint32_t count)
+{
+	if(!port->peer_connected || port->peer_baud_rate != port->baud_rate)
+	{
+		return;
+	}
+	if(count > UART_PEER_BUFFER_SIZE - port->to_peer_length)
+	{
+		count = UART_PEER_BUFFER_SIZE - port->to_peer_length;
+	}
+	memcpy(&port->to_peer[port->to_peer_length], bytes, count);
+	port->to_peer_length += count;
+}
+
+static void transmit(UART uart, const char *text, const uint8_t *bytes, uint32_t count)
+{
+	sim_uart *port = (sim_uart *) uart;
+
+	if(sim_verbose && text != NULL)
+	{
+		fprintf(stderr, "%s %10.6f: %s\n", port->name, ulPortSimTime() / 1e6, text);
+	}
+
+	//HAL_UART_Transmit polls until the last byte is out.
+	vPortSimConsume(transmit_time_us(port, count));
+
+	send_to_peer(port, bytes, count);
+	port->to_peer_on_wire = port->to_peer_length;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+UART UART_Port2_Init(void)
+{
+	return &s_port2;
+}
+
+UART UART_Port6_Init(void)
+{
+	return &s_port6;
+}
+
+void uart_transmit(UART uart, const char * message)
+{
+	transmit(uart, message, (const uint8_t *) message, strlen(message));
+}
+
+void uart_transmit_line(UART uart, const char * message)
+{
+	char line[256];
+	int length = snprintf(line, sizeof(line), "%s\r\n", message);
+	transmit(uart, message, (const uint8_t *) line, (length < (int) sizeof(line)) ? (uint32_t) length : sizeof(line) - 1);
+}
+
+void uart_transmit_bytes(UART uart, uint8_t * bytes, uint16_t numBytes)
+{
+	transmit(uart, NULL, bytes, numBytes);
+}
+
+bool uart_transmit_bytes_dma(UART uart, uint8_t * bytes, uint16_t numBytes)
+{
+	sim_uart *port = (sim_uart *) uart;
+
+	port->tx_done_us = ulPortSimTime() + transmit_time_us(port, numBytes);
+
+	//The caller waits for the last transmission to finish before it starts the next.
+	port->to_peer_on_wire = port->to_peer_length;
+	send_to_peer(port, bytes, numBytes);
+	return true;
+}
+
+bool uart_wait_transmit_done(UART uart, uint32_t timeout)
+{
+	sim_uart *port = (sim_uart *) uart;
+	uint64_t now_us = ulPortSimTime();
+
+	if(now_us >= port->tx_done_us)
+	{
+		return true;
+	}
+
+	uint64_t wait_us = port->tx_done_us - now_us;
+	if(wait_us > (uint64_t) timeout * 1000)
+	{
+		wait_us = (uint64_t) timeout * 1000;
+	}
+
+	if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+	{
+		vTaskDelay((TickType_t) ((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000)));
+	}else
+	{
+		vPortSimConsume(wait_us);
+	}
+	return ulPortSimTime() >= port->tx_done_us;
+}
+
+void uart_set_baud_rate(UART uart, uint32_t baud_rate)
+{
+	((sim_uart *) uart)->baud_rate = baud_rate;
+}
+
+void uart_receive_start(UART uart)
+{
+	sim_uart *port = (sim_uart *) uart;
+
+	port->receiving = true;
+	port->from_peer_length = 0;
+}
+
+uint16_t uart_receive_available(UART uart, uint8_t * bytes, uint16_t max)
+{
+	sim_uart *port = (sim_uart *) uart;
+	uint16_t count = (port->from_peer_length < max) ? port->from_peer_length : max;
+
+	memcpy(bytes, port->from_peer, count);
+	memmove(port->from_peer, &port->from_peer[count], port->from_peer_length - count);
+	port->from_peer_length -= count;
+	return count;
+}
+
+void uart_receive_stop(UART uart)
+{
+	((sim_uart *) uart)->receiving = false;
+}
+
+char* uart_receive_command(UART uart)
+{
+	(void) uart;
+
+	//HAL_UART_Receive would block until a key is pressed, which never happens here.
+	for(;;)
+	{
+		vTaskSuspend(NULL);
+	}
+}
+
+void sim_uart_peer_connect(void *uart, uint32_t baud_rate)
+{
+	sim_uart *port = (sim_uart *) uart;
+
+	port->peer_connected = true;
+	port->peer_baud_rate = baud_rate;
+	port->to_peer_length = 0;
+	port->to_peer_on_wire = 0;
+}
+
+void sim_uart_peer_set_baud_rate(void *uart, uint32_t baud_rate)
+{
+	((sim_uart *) uart)->peer_baud_rate = baud_rate;
+}
+
+uint32_t sim_uart_peer_read(void *uart, uint8_t *bytes, uint32_t max)
+{
+	sim_uart *port = (sim_uart *) uart;
+	uint32_t available = (ulPortSimTime() >= port->tx_done_us) ? port->to_peer_length : port->to_peer_on_wire;
+	uint32_t count = (available < max) ? available : max;
+
+	memcpy(bytes, port->to_peer, count);
+	memmove(port->to_peer, &port->to_peer[count], port->to_peer_length - count);
+	port->to_peer_length -= count;
+	port->to_peer_on_wire -= (count < port->to_peer_on_wire) ? count : port->to_peer_on_wire;
+	return count;
+}
+
+void sim_uart_peer_write(void *uart, const uint8_t *bytes, uint32_t count)
+{
+	sim_uart *port = (sim_uart *) uart;
+
+	//Nothing takes in what arrives while the receive DMA is stopped, and what does not fit in the ring is lost.
+	if(!port->receiving || port->peer_baud_rate != port->baud_rate)
+	{
+		return;
+	}
+	if(count > UART_RX_RING_SIZE - port->from_peer_length)
+	{
+		count = UART_RX_RING_SIZE - port->from_peer_length;
+	}
+	memcpy(&port->from_peer[port->from_peer_length], bytes, count);
+	port->from_peer_length += count;
+}
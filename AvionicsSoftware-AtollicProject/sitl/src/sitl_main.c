@@ -0,0 +1,281 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Entry point of the host software in the loop build. Sets up one simulated flight from the seed (or a trajectory
+//  file), arms the board the way it would be on the pad, runs the unmodified firmware main, and prints one CSV line
+//  that sums up what the firmware did when the flight is over.
+//
+//	sitl [--seed N] [--trajectory FILE] [--flash-file FILE] [--max-time S] [--no-record] [--profile] [--csv-header]
+//		 [--verbose]
+//
+// History
+// 2026-10-17
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "configuration.h"
+#include "FreeRTOS.h"
+#include "tasks/flash_writer.h"
+#include "utilities/profiler.h"
+#include "utilities/common.h"
+#include "sim.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//The journal record layout, as in configuration.c.
+#define CONFIG_RECORD_MAGIC			0xC7
+#define CONFIG_PAYLOAD_SIZE			offsetof(configuration_data_values, flash)
+#define CONFIG_RECORD_SEQUENCE		1
+#define CONFIG_RECORD_PAYLOAD		5
+#define CONFIG_RECORD_CRC			(CONFIG_RECORD_PAYLOAD + CONFIG_PAYLOAD_SIZE)
+#define CONFIG_SLOT_COUNT			(CONFIG_JOURNAL_SECTORS * FLASH_PARAM_SECTOR_SIZE / CONFIG_RECORD_SIZE)
+
+#define DEFAULT_MAX_TIME_S			1800.0
+#define FLAG_RECORDING				0x02
+#define FLAG_PROFILING				0x20
+
+int firmware_main(void);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int sim_verbose;
+
+static sim_options s_options;
+static bool s_profile;
+static struct timespec s_wall_start;
+
+static const struct option s_long_options[] =
+{
+	{"seed",		required_argument,	NULL, 's'},
+	{"trajectory",	required_argument,	NULL, 't'},
+	{"flash-file",	required_argument,	NULL, 'f'},
+	{"max-time",	required_argument,	NULL, 'm'},
+	{"no-record",	no_argument,		NULL, 'n'},
+	{"profile",		no_argument,		NULL, 'p'},
+	{"csv-header",	no_argument,		NULL, 'c'},
+	{"verbose",		no_argument,		NULL, 'v'},
+	{NULL, 0, NULL, 0}
+};
+
+
+static double uniform(double low, double high)
+{
+	return low + (high - low) * sim_random_uniform();
+}
+
+static uint8_t *journal_slot(uint32_t slot)
+{
+	return &sim_flash_memory()[CONFIG_JOURNAL_ADDRESS + slot * CONFIG_RECORD_SIZE];
+}
+
+/**
+ * @brief The newest valid configuration record in the flash, or NULL.
+ */
+static const uint8_t *newest_config_record(void)
+{
+	const uint8_t *newest = NULL;
+
+	for(uint32_t slot = 0; slot < CONFIG_SLOT_COUNT; slot++)
+	{
+		const uint8_t *record = journal_slot(slot);
+		if(record[0] != CONFIG_RECORD_MAGIC || read_16(&record[CONFIG_RECORD_CRC]) != crc16_ccitt(record, CONFIG_RECORD_CRC))
+		{
+			continue;
+		}
+		if(newest == NULL || read_32(&record[CONFIG_RECORD_SEQUENCE]) > read_32(&newest[CONFIG_RECORD_SEQUENCE]))
+		{
+			newest = record;
+		}
+	}
+	return newest;
+}
+
+/**
+ * @brief Writes the configuration the board would have been given over the CLI before the flight, unless the flash
+ * already has one.
+ */
+static void set_up_configuration(bool record, bool profile)
+{
+	if(newest_config_record() != NULL)
+	{
+		return;
+	}
+
+	configuration_data_t configuration;
+	init_config(&configuration);
+	if(record)
+	{
+		configuration.values.flags |= FLAG_RECORDING;
+	}
+	if(profile)
+	{
+		configuration.values.flags |= FLAG_PROFILING;
+	}
+
+	uint8_t *slot = journal_slot(0);
+	slot[0] = CONFIG_RECORD_MAGIC;
+	write_32(1, &slot[CONFIG_RECORD_SEQUENCE]);
+	memcpy(&slot[CONFIG_RECORD_PAYLOAD], configuration.bytes, CONFIG_PAYLOAD_SIZE);
+	write_16(crc16_ccitt(slot, CONFIG_RECORD_CRC), &slot[CONFIG_RECORD_CRC]);
+}
+
+static void print_csv_header(void)
+{
+	printf("seed,result,apogee_m,"
+		   "drogue_fired,drogue_time_s,drogue_altitude_m,drogue_speed_mps,"
+		   "main_fired,main_time_s,main_altitude_m,main_speed_mps,"
+		   "touchdown_s,config_flags,"
+		   "pages_written,pages_dropped,pages_lost,queue_high_water,next_address,erase_errors,erase_stall_max_ms,"
+		   "flash_transactions,bmp388_transactions,accel_transactions,gyro_transactions,spi_timeouts,"
+		   "sim_time_s,wall_time_s\n");
+}
+
+/**
+ * @brief The [prof] span table, on stderr. The SPI and flash spans are simulated bus time, the rest are 0 because
+ * only waiting moves the simulated clock.
+ */
+static void print_profile(void)
+{
+	fprintf(stderr, "span              count      min_us     mean_us    p99_us     max_us\n");
+	for(int span = 0; span < PROFILER_NUM_SPANS; span++)
+	{
+		profiler_span_summary summary;
+		profiler_get_span(span, &summary);
+		fprintf(stderr, "%-16s  %-9u  %-9.1f  %-9.1f  %-9.1f  %.1f\n", profiler_span_name(span), summary.count,
+				summary.min * 1e6 / SystemCoreClock, summary.mean * 1e6 / SystemCoreClock,
+				summary.p99 * 1e6 / SystemCoreClock, summary.max * 1e6 / SystemCoreClock);
+	}
+	for(int gauge = 0; gauge < PROFILER_NUM_GAUGES; gauge++)
+	{
+		fprintf(stderr, "%-16s  %u\n", profiler_gauge_name(gauge), profiler_get_gauge(gauge));
+	}
+}
+
+static void print_deployment(int chute)
+{
+	const sim_deployment *deployment = sim_trajectory_deployment(chute);
+	printf("%d,%.3f,%.1f,%.1f,", sim_board_fired(chute), deployment->time_s, deployment->altitude_m,
+		   deployment->speed_mps);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void sim_finish(const char *reason)
+{
+	struct timespec wall_end;
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+	const uint8_t *record = newest_config_record();
+	int flags = (record != NULL) ? record[CONFIG_RECORD_PAYLOAD + offsetof(configuration_data_values, flags)] : -1;
+
+	flash_writer_statistics statistics;
+	flash_writer_get_statistics(&statistics);
+
+	printf("%llu,%s,%.1f,", (unsigned long long) s_options.seed, reason, sim_trajectory_apogee());
+	print_deployment(0);
+	print_deployment(1);
+	printf("%.3f,%d,", sim_trajectory_touchdown(), flags);
+	printf("%u,%u,%u,%u,%u,%u,%u,", statistics.pages_written, statistics.pages_dropped, statistics.pages_lost,
+		   statistics.queue_high_water, statistics.next_address, statistics.erase_errors, statistics.erase_stall_max);
+	printf("%u,%u,%u,%u,%u,", sim_flash_device.transactions, sim_bmp388_device.transactions,
+		   sim_bmi088_accel_device.transactions, sim_bmi088_gyro_device.transactions,
+		   sim_flash_device.timeouts + sim_bmp388_device.timeouts + sim_bmi088_accel_device.timeouts +
+		   sim_bmi088_gyro_device.timeouts);
+	printf("%.3f,%.3f\n", ulPortSimTime() / 1e6,
+		   (wall_end.tv_sec - s_wall_start.tv_sec) + (wall_end.tv_nsec - s_wall_start.tv_nsec) / 1e9);
+
+	fflush(stdout);
+	if(s_profile)
+	{
+		print_profile();
+	}
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	const char *flash_file = NULL;
+	bool record = true;
+	int option;
+
+	clock_gettime(CLOCK_MONOTONIC, &s_wall_start);
+
+	s_options.seed = 1;
+	s_options.max_time_s = DEFAULT_MAX_TIME_S;
+
+	while((option = getopt_long(argc, argv, "s:t:f:m:npcv", s_long_options, NULL)) != -1)
+	{
+		switch(option)
+		{
+			case 's':
+				s_options.seed = strtoull(optarg, NULL, 0);
+				break;
+			case 't':
+				s_options.trajectory_file = optarg;
+				break;
+			case 'f':
+				flash_file = optarg;
+				break;
+			case 'm':
+				s_options.max_time_s = strtod(optarg, NULL);
+				break;
+			case 'n':
+				record = false;
+				break;
+			case 'p':
+				s_profile = true;
+				break;
+			case 'c':
+				print_csv_header();
+				break;
+			case 'v':
+				sim_verbose = 1;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [--seed N] [--trajectory FILE] [--flash-file FILE] [--max-time S] "
+						"[--no-record] [--profile] [--csv-header] [--verbose]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	//Everything that changes from one flight to the next comes from the seed.
+	sim_random_seed(s_options.seed);
+	s_options.pad_time_s = uniform(30.0, 40.0);
+	s_options.base_pressure_pa = uniform(101325.0 - 1500.0, 101325.0 + 1500.0);
+	s_options.base_temperature_c = uniform(5.0, 25.0);
+	for(int i = 0; i < 4; i++)
+	{
+		s_options.clock_error[i] = uniform(-0.01, 0.01);
+	}
+
+	if(!sim_flash_init(flash_file))
+	{
+		return EXIT_FAILURE;
+	}
+	set_up_configuration(record, s_profile);
+
+	sim_trajectory_init(&s_options);
+	sim_board_init(&s_options);
+	sim_bmi088_init(&s_options);
+	sim_bmp388_init(&s_options);
+
+	firmware_main();
+
+	sim_finish("returned");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Runs the ground station parser on a log for the host tests, through the same CSV it writes for a flight.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+
+#include "log_parser.h"
+#include "log_decode.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int log_decode(const uint8_t *log, size_t size, int threads, log_decode_row *rows, int max_rows, log_decode_stats *stats)
+{
+	static log_parser_stats parser_stats;
+	FILE *csv = tmpfile();
+	if(csv == NULL)
+	{
+		return -1;
+	}
+
+	if(log_parser_decode_v2(log, size, csv, NULL, threads, 1, &parser_stats) != 0)
+	{
+		fclose(csv);
+		return -1;
+	}
+
+	stats->pages = parser_stats.pages;
+	stats->bad_pages = parser_stats.bad_pages;
+	stats->gaps = parser_stats.gaps;
+	stats->records = parser_stats.records;
+	stats->profiles = parser_stats.profiles;
+	for(int phase = 0; phase < LOG_PHASES; phase++)
+	{
+		stats->phase_pages[phase] = parser_stats.phase_pages[phase];
+	}
+
+	//"%.3f,%d,%d,%d,%d,%d,%d,%d,%d,%f,%d\n": milliseconds, the IMU, pressure, temperature, altitude in m and events.
+	rewind(csv);
+	int count = 0;
+	double time_ms;
+	int acc[3];
+	int gyro[3];
+	int pressure;
+	int temperature;
+	double altitude_m;
+	int events;
+	while(fscanf(csv, "%lf,%d,%d,%d,%d,%d,%d,%d,%d,%lf,%d\n", &time_ms, &acc[0], &acc[1], &acc[2], &gyro[0], &gyro[1],
+				 &gyro[2], &pressure, &temperature, &altitude_m, &events) == 11)
+	{
+		if(count < max_rows)
+		{
+			log_decode_row *row = &rows[count];
+			row->time_us = (uint64_t) llround(time_ms * 1000);
+			for(int i = 0; i < 3; i++)
+			{
+				row->acc[i] = (int16_t) acc[i];
+				row->gyro[i] = (int16_t) gyro[i];
+			}
+			row->pressure = (uint32_t) pressure;
+			row->temperature = temperature;
+			row->altitude_cm = (int32_t) lround(altitude_m * 100);
+			row->events = (uint8_t) events;
+		}
+		count++;
+	}
+
+	fclose(csv);
+	return count;
+}
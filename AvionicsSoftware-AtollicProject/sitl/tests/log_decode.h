@@ -0,0 +1,65 @@
+#ifndef SITL_LOG_DECODE_H
+#define SITL_LOG_DECODE_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  For the host tests of the log encoder: decodes a log with the ground station parser in
+//  SoftwareTools/Data_Parser_Utility, so the tests check the firmware against what is actually used to read the
+//  flights. The parser's header defines the page layout under the same names as log_encoder.h, so the two can not
+//  be included in one file, and this is the only one that includes the parser's.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//One row of the parser's CSV. Channels a record does not hold repeat the last value logged, and the events are
+//those of every record up to this one.
+typedef struct
+{
+	uint64_t time_us;			//Since the first record.
+	int16_t acc[3];
+	int16_t gyro[3];
+	uint32_t pressure;
+	int32_t temperature;
+	int32_t altitude_cm;
+	uint8_t events;
+} log_decode_row;
+
+typedef struct
+{
+	int pages;
+	int bad_pages;				//Pages with a bad marker or CRC, or with a record that runs off the end.
+	int gaps;					//Pages whose sequence number does not follow the page before.
+	int records;
+	int profiles;
+	int phase_pages[5];			//Pages written in each log_phase.
+} log_decode_stats;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Decodes log, a superblock and the data pages after it, with log_parser_decode_v2 on threads threads, and reads
+//	back its CSV into rows. At most max_rows rows are kept.
+//
+// Returns:
+//  The number of rows in the CSV, or -1 if the parser failed.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int log_decode(const uint8_t *log, size_t size, int threads, log_decode_row *rows, int max_rows, log_decode_stats *stats);
+
+#endif // SITL_LOG_DECODE_H
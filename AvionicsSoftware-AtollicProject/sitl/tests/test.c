@@ -0,0 +1,53 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Checks for the host tests in sitl/tests.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static const char *s_case = "";
+static uint32_t s_checks;
+static uint32_t s_failures;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool test_check(bool ok, const char *expression, const char *file, int line)
+{
+	s_checks++;
+	if(!ok)
+	{
+		s_failures++;
+		fprintf(stderr, "%s:%d: %s: check failed: %s\n", file, line, s_case, expression);
+	}
+	return ok;
+}
+
+void test_case(const char *name)
+{
+	s_case = name;
+}
+
+int test_summary(const char *name)
+{
+	printf("%s: %u checks, %u failed\n", name, s_checks, s_failures);
+	return (s_failures == 0 && s_checks > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+#ifndef SITL_TEST_H
+#define SITL_TEST_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Checks for the host tests in sitl/tests. A failed check is printed and counted, and the test carries on, so one
+//  run shows every case that fails. See Documentation/SoftwareInTheLoop.md.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Reports a failed check with where it is, and carries on.
+#define TEST_CHECK(condition)	test_check((condition), #condition, __FILE__, __LINE__)
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Counts one check, and prints it on stderr if it failed. Use TEST_CHECK rather than calling this.
+//
+// Returns:
+//  ok.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool test_check(bool ok, const char *expression, const char *file, int line);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts a group of checks. Only used to say which case a failure was in.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void test_case(const char *name);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Prints how many checks passed, as "name: N checks, M failed".
+//
+// Returns:
+//  The exit status of the test program: EXIT_SUCCESS if every check passed.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int test_summary(const char *name);
+
+#endif // SITL_TEST_H
@@ -0,0 +1,201 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the altitude estimator against the flight the SITL flies: the trajectory of the physics model is
+//  recorded at the sensor rates, the measurements are made noisy the way the sensors are, and the filter has to
+//  follow the true altitude and velocity and see apogee when the rocket gets there.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+
+#include "utilities/altitude_estimator.h"
+#include "sim.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SEEDS					3
+#define PAD_TIME_S				5
+#define FLIGHT_TIME_S			60			//Apogee comes about 48 s after launch, and the model falls without parachutes after it.
+#define IMU_RATE_HZ				100			//As configured by ACC_ODR.
+#define IMU_PERIOD_US			(SIM_US_PER_S / IMU_RATE_HZ)
+#define BARO_DECIMATION			2			//50 Hz, as configured by BMP_ODR.
+#define SAMPLES					((PAD_TIME_S + FLIGHT_TIME_S) * IMU_RATE_HZ)
+
+#define BARO_SIGMA_M			1.0
+#define ACC_SIGMA_MPS2			1.0
+
+#define SETTLE_S				2.0			//The filter starts at rest and gets this long before it is held to anything.
+#define MAX_ALTITUDE_ERROR_M	3.0
+#define MAX_RMS_ALTITUDE_M		1.0
+#define MAX_VELOCITY_ERROR_MPS	3.0
+#define APOGEE_HOLDOUT_S		10.0		//Like the controller, apogee is not looked for during the boost.
+#define MAX_APOGEE_ERROR_S		0.25
+
+typedef struct
+{
+	uint32_t time_us;
+	double altitude_m;
+	double velocity_mps;
+	double acceleration_mps2;
+} recorded_sample;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static recorded_sample s_flight[SAMPLES];
+
+
+/**
+ * @brief Flies the SITL physics model for one seed and keeps its true state at every IMU sample.
+ * @return The time of apogee, where the true velocity turns negative [s].
+ */
+static double record_flight(uint64_t seed)
+{
+	sim_options options = {0};
+	options.seed = seed;
+	options.pad_time_s = PAD_TIME_S;
+	options.base_pressure_pa = 101325.0;
+	options.base_temperature_c = 15.0;
+
+	sim_random_seed(seed);
+	sim_trajectory_init(&options);
+
+	double apogee_s = -1;
+	for(uint32_t i = 0; i < SAMPLES; i++)
+	{
+		uint64_t time_us = (uint64_t) i * IMU_PERIOD_US;
+		const sim_state *state = sim_trajectory_advance(time_us * SIM_NS_PER_US);
+
+		s_flight[i].time_us = (uint32_t) time_us;
+		s_flight[i].altitude_m = state->altitude_m;
+		s_flight[i].velocity_mps = state->velocity_mps;
+		s_flight[i].acceleration_mps2 = (state->accel_g - 1.0) * SIM_GRAVITY;
+
+		if(apogee_s < 0 && state->time_s > PAD_TIME_S + 1.0 && state->velocity_mps < 0.0)
+		{
+			apogee_s = state->time_s;
+		}
+	}
+	return apogee_s;
+}
+
+static void test_flight(uint64_t seed)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "flight of seed %u", (unsigned) seed);
+	test_case(name);
+
+	double true_apogee_s = record_flight(seed);
+	TEST_CHECK(true_apogee_s > 0);
+
+	altitude_estimator estimator;
+	double worst_altitude = 0;
+	double worst_velocity = 0;
+	double squares = 0;
+	uint32_t held = 0;
+	double seen_apogee_s = -1;
+
+	//The noise is drawn after the flight, so the same seed flies the same flight with or without it.
+	altitude_estimator_init(&estimator, (float) (s_flight[0].altitude_m + BARO_SIGMA_M * sim_random_normal()), 0);
+	for(uint32_t i = 1; i < SAMPLES; i++)
+	{
+		const recorded_sample *truth = &s_flight[i];
+		double time_s = truth->time_us / 1e6;
+
+		altitude_estimator_predict(&estimator, truth->time_us);
+		altitude_estimator_update_acceleration(&estimator,
+											   (float) (truth->acceleration_mps2 + ACC_SIGMA_MPS2 * sim_random_normal()));
+		if(i % BARO_DECIMATION == 0)
+		{
+			altitude_estimator_update_altitude(&estimator, (float) (truth->altitude_m + BARO_SIGMA_M * sim_random_normal()));
+		}
+
+		if(time_s < SETTLE_S)
+		{
+			continue;
+		}
+
+		double altitude_error = fabs(altitude_estimator_get(&estimator, ALTITUDE_ESTIMATOR_ALTITUDE) - truth->altitude_m);
+		double velocity_error = fabs(altitude_estimator_get(&estimator, ALTITUDE_ESTIMATOR_VELOCITY) - truth->velocity_mps);
+		worst_altitude = (altitude_error > worst_altitude) ? altitude_error : worst_altitude;
+		worst_velocity = (velocity_error > worst_velocity) ? velocity_error : worst_velocity;
+		squares += altitude_error * altitude_error;
+		held++;
+
+		if(seen_apogee_s < 0 && time_s > PAD_TIME_S + APOGEE_HOLDOUT_S &&
+		   altitude_estimator_get(&estimator, ALTITUDE_ESTIMATOR_VELOCITY) < 0.0f)
+		{
+			seen_apogee_s = time_s;
+		}
+	}
+
+	double rms_altitude = sqrt(squares / held);
+	printf("  seed %u: altitude worst %.2f m rms %.2f m, velocity worst %.2f m/s, apogee seen %+.3f s from the true one\n",
+		   (unsigned) seed, worst_altitude, rms_altitude, worst_velocity, seen_apogee_s - true_apogee_s);
+	TEST_CHECK(worst_altitude < MAX_ALTITUDE_ERROR_M);
+	TEST_CHECK(rms_altitude < MAX_RMS_ALTITUDE_M);
+	TEST_CHECK(worst_velocity < MAX_VELOCITY_ERROR_MPS);
+	TEST_CHECK(seen_apogee_s > 0);
+	TEST_CHECK(fabs(seen_apogee_s - true_apogee_s) < MAX_APOGEE_ERROR_S);
+}
+
+static void test_time(void)
+{
+	test_case("time");
+	altitude_estimator estimator;
+	altitude_estimator_init(&estimator, 100.0f, 1000000);
+	estimator.x[ALTITUDE_ESTIMATOR_VELOCITY] = 10.0f;
+
+	//A sample from before the last one does not move the filter back.
+	altitude_estimator_predict(&estimator, 500000);
+	TEST_CHECK(estimator.last_time_us == 1000000);
+	TEST_CHECK(altitude_estimator_get(&estimator, ALTITUDE_ESTIMATOR_ALTITUDE) == 100.0f);
+
+	//A long gap only moves it ALTITUDE_ESTIMATOR_MAX_DT.
+	altitude_estimator_predict(&estimator, 11000000);
+	TEST_CHECK(estimator.last_time_us == 11000000);
+	TEST_CHECK(fabsf(altitude_estimator_get(&estimator, ALTITUDE_ESTIMATOR_ALTITUDE) -
+					 (100.0f + 10.0f * ALTITUDE_ESTIMATOR_MAX_DT)) < 1e-3f);
+
+	//The microsecond clock wraps after 71 minutes, and the filter carries on across it.
+	altitude_estimator_init(&estimator, 0.0f, UINT32_MAX - 4999);
+	estimator.x[ALTITUDE_ESTIMATOR_VELOCITY] = 10.0f;
+	altitude_estimator_predict(&estimator, 5000);
+	TEST_CHECK(fabsf(altitude_estimator_get(&estimator, ALTITUDE_ESTIMATOR_ALTITUDE) - 0.1f) < 1e-4f);
+
+	for(int i = 0; i < ALTITUDE_ESTIMATOR_STATES; i++)
+	{
+		TEST_CHECK(estimator.P[i][i] > 0.0f);
+		for(int j = 0; j < ALTITUDE_ESTIMATOR_STATES; j++)
+		{
+			TEST_CHECK(isfinite(estimator.P[i][j]) && estimator.P[i][j] == estimator.P[j][i]);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	for(uint64_t seed = 1; seed <= SEEDS; seed++)
+	{
+		test_flight(seed);
+	}
+	test_time();
+	return test_summary("test_altitude_estimator");
+}
@@ -0,0 +1,184 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the configuration journal on the flash model: saving and loading, wrapping around the two sectors
+//  with the background erase, and recovering from a reset that left a torn record or a sector that was never erased.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+
+#include "configuration.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SLOTS_PER_SECTOR	(FLASH_PARAM_SECTOR_SIZE / CONFIG_RECORD_SIZE)
+#define SLOT_COUNT			(SLOTS_PER_SECTOR * CONFIG_JOURNAL_SECTORS)
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static configuration_data_t s_config;
+
+
+static uint8_t *slot_memory(uint32_t slot)
+{
+	return &sim_flash_memory()[CONFIG_JOURNAL_ADDRESS + slot * CONFIG_RECORD_SIZE];
+}
+
+static bool is_blank(const uint8_t *memory, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		if(memory[i] != 0xFF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void wait_for_erase(void)
+{
+	while(FLASH_IS_DEVICE_BUSY(flash_get_status_register(s_config.values.flash)))
+	{
+		vTaskDelay(1);
+	}
+}
+
+/**
+ * @brief Saves the configuration with number in its initial wait time, which tells the records apart.
+ */
+static bool save(uint32_t number)
+{
+	s_config.values.initial_time_to_wait = number;
+	return write_config(&s_config) == CONFIG_OK;
+}
+
+/**
+ * @brief Loads the configuration the way the board does after a reset, which also scans the journal again.
+ * @return The number saved with it, or 0 if nothing could be loaded.
+ */
+static uint32_t load(void)
+{
+	configuration_data_t loaded;
+	memset(&loaded, 0, sizeof(loaded));
+	loaded.values.flash = s_config.values.flash;
+	if(read_config(&loaded) != CONFIG_OK)
+	{
+		return 0;
+	}
+	return loaded.values.initial_time_to_wait;
+}
+
+static void test_body(void)
+{
+	init_config(&s_config);
+	s_config.values.flash = flash_initialize();
+	TEST_CHECK(s_config.values.flash != NULL);
+
+	test_case("empty journal");
+	TEST_CHECK(load() == 0);
+
+	test_case("save and load");
+	s_config.values.flags = 0x5A;
+	s_config.values.ref_pres = 98765.5f;
+	TEST_CHECK(save(1));
+	configuration_data_t loaded;
+	memset(&loaded, 0, sizeof(loaded));
+	loaded.values.flash = s_config.values.flash;
+	loaded.values.state = STATE_LANDED;
+	TEST_CHECK(read_config(&loaded) == CONFIG_OK);
+	TEST_CHECK(loaded.values.initial_time_to_wait == 1);
+	TEST_CHECK(loaded.values.flags == 0x5A);
+	TEST_CHECK(loaded.values.ref_pres == 98765.5f);
+	TEST_CHECK(memcmp(loaded.values.log_precision, s_config.values.log_precision, CONFIG_LOG_PHASES) == 0);
+	TEST_CHECK(loaded.values.state == STATE_LANDED);
+
+	//Filling the first sector starts the erase of the second without waiting for it.
+	test_case("sector fills");
+	for(uint32_t number = 2; number < SLOTS_PER_SECTOR; number++)
+	{
+		TEST_CHECK(save(number));
+	}
+	memset(slot_memory(SLOTS_PER_SECTOR + 1), 0x00, CONFIG_RECORD_SIZE);
+	TEST_CHECK(save(SLOTS_PER_SECTOR));
+	TEST_CHECK(FLASH_IS_DEVICE_BUSY(flash_get_status_register(s_config.values.flash)));
+	TEST_CHECK(!is_blank(slot_memory(SLOTS_PER_SECTOR + 1), CONFIG_RECORD_SIZE));
+	wait_for_erase();
+	TEST_CHECK(is_blank(slot_memory(SLOTS_PER_SECTOR), FLASH_PARAM_SECTOR_SIZE));
+	TEST_CHECK(load() == SLOTS_PER_SECTOR);
+	TEST_CHECK(save(SLOTS_PER_SECTOR + 1));
+	TEST_CHECK(load() == SLOTS_PER_SECTOR + 1);
+
+	//The last record of the second sector starts erasing the first, which still holds the oldest records. The save
+	//returns while the erase is still running.
+	test_case("journal wraps");
+	for(uint32_t number = SLOTS_PER_SECTOR + 2; number <= SLOT_COUNT; number++)
+	{
+		TEST_CHECK(save(number));
+	}
+	TEST_CHECK(FLASH_IS_DEVICE_BUSY(flash_get_status_register(s_config.values.flash)));
+	TEST_CHECK(!is_blank(slot_memory(0), CONFIG_RECORD_SIZE));
+	wait_for_erase();
+	TEST_CHECK(is_blank(slot_memory(0), FLASH_PARAM_SECTOR_SIZE));
+	TEST_CHECK(load() == SLOT_COUNT);
+
+	TEST_CHECK(save(SLOT_COUNT + 1));
+	TEST_CHECK(!is_blank(slot_memory(0), CONFIG_RECORD_SIZE));
+	TEST_CHECK(load() == SLOT_COUNT + 1);
+	TEST_CHECK(save(SLOT_COUNT + 2));
+	TEST_CHECK(load() == SLOT_COUNT + 2);
+
+	//A reset in the middle of a program leaves part of a record in the next slot. It is not loaded, and the next
+	//save goes past it.
+	test_case("torn slot");
+	uint8_t torn[CONFIG_RECORD_SIZE];
+	memcpy(torn, slot_memory(1), CONFIG_RECORD_SIZE);
+	memset(&torn[CONFIG_RECORD_SIZE / 4], 0xFF, CONFIG_RECORD_SIZE * 3 / 4);
+	memcpy(slot_memory(2), torn, CONFIG_RECORD_SIZE);
+	TEST_CHECK(load() == SLOT_COUNT + 2);
+	TEST_CHECK(save(SLOT_COUNT + 3));
+	TEST_CHECK(memcmp(slot_memory(2), torn, CONFIG_RECORD_SIZE) == 0);
+	TEST_CHECK(!is_blank(slot_memory(3), CONFIG_RECORD_SIZE));
+	TEST_CHECK(load() == SLOT_COUNT + 3);
+
+	//A reset in the middle of the background erase leaves old records in the sector the next save goes to. The save
+	//erases it first, and the old records do not come back.
+	test_case("sector never erased");
+	for(uint32_t number = SLOT_COUNT + 4; number < SLOT_COUNT + SLOTS_PER_SECTOR; number++)
+	{
+		TEST_CHECK(save(number));
+	}
+	TEST_CHECK(load() == SLOT_COUNT + SLOTS_PER_SECTOR - 1);
+	wait_for_erase();
+	TEST_CHECK(is_blank(slot_memory(SLOTS_PER_SECTOR), FLASH_PARAM_SECTOR_SIZE));
+	memcpy(slot_memory(SLOTS_PER_SECTOR), slot_memory(0), (SLOTS_PER_SECTOR - 1) * CONFIG_RECORD_SIZE);
+	TEST_CHECK(load() == SLOT_COUNT + SLOTS_PER_SECTOR - 1);
+	TEST_CHECK(save(SLOT_COUNT + SLOTS_PER_SECTOR));
+	TEST_CHECK(!is_blank(slot_memory(SLOTS_PER_SECTOR), CONFIG_RECORD_SIZE));
+	TEST_CHECK(is_blank(slot_memory(SLOTS_PER_SECTOR + 1), FLASH_PARAM_SECTOR_SIZE - CONFIG_RECORD_SIZE));
+	TEST_CHECK(load() == SLOT_COUNT + SLOTS_PER_SECTOR);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_run_task(test_body, 60.0);
+	return test_summary("test_configuration");
+}
@@ -0,0 +1,469 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the framed download: download_run sends a log from the flash model over the simulated UART to a
+//  receiver that follows serialReader.py download, the way it does in data_reader.py. The receiver can lose a data
+//  frame or the acknowledgements of the last frames, repeat its acknowledgements, and resume part way through.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "tasks/download.h"
+#include "utilities/common.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define LOG_SIZE			150007		//Not a whole number of chunks.
+#define NO_FAULT			UINT32_MAX
+#define START_TRIES			30
+#define SYNC_TRIES			20
+#define FRAME_TIMEOUT_MS	2000		//As the receiver, which gives up when the line goes quiet.
+#define SUMMARY_TIMEOUT_MS	1000
+
+typedef struct
+{
+	uint32_t offset;			//START offset, what the receiver already has.
+	uint32_t baud_rate;
+	uint16_t window;
+	uint16_t chunk;
+	uint32_t lose_data_at;		//The data frame at this offset is lost the first time it is sent.
+	uint32_t lose_acks_from;	//The acknowledgements of the frames from here to the end of the log are lost.
+	bool repeat_acks;			//Every acknowledgement goes out twice, followed by the one before it.
+} receiver_setup;
+
+typedef struct
+{
+	bool info;					//INFO came back.
+	uint32_t start;				//INFO: the offset, the log size, baud rate, window and chunk.
+	uint32_t total;
+	uint32_t baud_rate;
+	uint16_t window;
+	uint16_t chunk;
+	uint32_t offset;			//Everything before it arrived.
+	uint32_t naks;
+	bool done;					//END was acknowledged with the whole log in.
+	bool summary;				//The firmware's summary line, after the download.
+	uint32_t summary_bytes;
+	uint32_t summary_from;
+	uint32_t frames;
+	uint32_t go_backs;
+	uint32_t summary_baud_rate;
+} receiver_result;
+
+typedef struct
+{
+	uint8_t type;
+	uint32_t offset;
+	uint16_t length;
+	uint8_t payload[DOWNLOAD_CHUNK_MAX];
+} received_frame;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static UART s_uart;
+static Flash s_flash;
+static uint8_t s_log[LOG_SIZE];				//What the receiver has written to its file.
+static uint8_t s_line[2 * DOWNLOAD_FRAME_MAX];	//Bytes from the firmware not yet taken as a frame or text.
+static uint32_t s_line_length;
+static char s_text[1024];					//Everything that was not a frame, like the CLI lines.
+static uint32_t s_text_length;
+
+
+static uint8_t log_byte(uint32_t offset)
+{
+	return (uint8_t) ((offset * 131) ^ (offset >> 9));
+}
+
+/**
+ * @brief Runs download_run after download_run, like the CLI does for each download command.
+ */
+static void download_task(void const *params)
+{
+	(void) params;
+	for(;;)
+	{
+		download_run(s_uart, s_flash, FLASH_START_ADDRESS + LOG_SIZE);
+	}
+}
+
+static void send_frame(uint8_t type, uint32_t offset, const uint8_t *payload, uint16_t length)
+{
+	uint8_t frame[DOWNLOAD_HEADER_SIZE + DOWNLOAD_CONTROL_MAX + DOWNLOAD_CRC_SIZE];
+	frame[0] = DOWNLOAD_SYNC_0;
+	frame[1] = DOWNLOAD_SYNC_1;
+	frame[2] = type;
+	frame[3] = 0;
+	frame[4] = (uint8_t) (length >> 8);
+	frame[5] = (uint8_t) length;
+	write_32(0, &frame[6]);
+	write_32(offset, &frame[10]);
+	if(length > 0)
+	{
+		memcpy(&frame[DOWNLOAD_HEADER_SIZE], payload, length);
+	}
+	write_32(crc32(frame, DOWNLOAD_HEADER_SIZE + length), &frame[DOWNLOAD_HEADER_SIZE + length]);
+	sim_uart_peer_write(s_uart, frame, DOWNLOAD_HEADER_SIZE + length + DOWNLOAD_CRC_SIZE);
+}
+
+/**
+ * @brief Moves count bytes from the front of the line to the text.
+ */
+static void take_text(uint32_t count)
+{
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if(s_text_length < sizeof(s_text) - 1)
+		{
+			s_text[s_text_length++] = (char) s_line[i];
+			s_text[s_text_length] = '\0';
+		}
+	}
+	memmove(s_line, &s_line[count], s_line_length - count);
+	s_line_length -= count;
+}
+
+/**
+ * @brief Takes the next good frame out of what the firmware has sent so far, like the receiver's FrameReader.
+ */
+static bool next_frame(received_frame *frame)
+{
+	s_line_length += sim_uart_peer_read(s_uart, &s_line[s_line_length], sizeof(s_line) - s_line_length);
+
+	while(s_line_length >= 2)
+	{
+		if(s_line[0] != DOWNLOAD_SYNC_0 || s_line[1] != DOWNLOAD_SYNC_1)
+		{
+			take_text(1);
+			continue;
+		}
+		if(s_line_length < DOWNLOAD_HEADER_SIZE)
+		{
+			return false;
+		}
+		uint16_t length = ((uint16_t) s_line[4] << 8) | s_line[5];
+		if(length > DOWNLOAD_CHUNK_MAX)
+		{
+			take_text(1);
+			continue;
+		}
+		uint32_t size = DOWNLOAD_HEADER_SIZE + length + DOWNLOAD_CRC_SIZE;
+		if(s_line_length < size)
+		{
+			return false;
+		}
+		if(read_32(&s_line[DOWNLOAD_HEADER_SIZE + length]) != crc32(s_line, DOWNLOAD_HEADER_SIZE + length))
+		{
+			take_text(1);
+			continue;
+		}
+
+		frame->type = s_line[2];
+		frame->offset = read_32(&s_line[10]);
+		frame->length = length;
+		memcpy(frame->payload, &s_line[DOWNLOAD_HEADER_SIZE], length);
+		memmove(s_line, &s_line[size], s_line_length - size);
+		s_line_length -= size;
+		return true;
+	}
+
+	if(s_line_length == 1 && s_line[0] != DOWNLOAD_SYNC_0)
+	{
+		take_text(1);
+	}
+	return false;
+}
+
+static bool wait_for_frame(received_frame *frame, uint32_t timeout)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(!next_frame(frame))
+	{
+		if(xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout))
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
+}
+
+static void acknowledge(const receiver_setup *setup, uint32_t offset, uint32_t previous)
+{
+	send_frame(DOWNLOAD_ACK, offset, NULL, 0);
+	if(setup->repeat_acks)
+	{
+		send_frame(DOWNLOAD_ACK, offset, NULL, 0);
+		send_frame(DOWNLOAD_ACK, previous, NULL, 0);
+	}
+}
+
+/**
+ * @brief Waits for the firmware's summary line at the CLI baud rate and reads it.
+ */
+static void read_summary(receiver_result *result)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(xTaskGetTickCount() - start < pdMS_TO_TICKS(SUMMARY_TIMEOUT_MS))
+	{
+		received_frame frame;
+		while(next_frame(&frame))
+		{
+		}
+
+		const char *line = strstr(s_text, "Download done:");
+		line = (line != NULL) ? line : strstr(s_text, "Download failed:");
+		if(line != NULL && strchr(line, '\n') != NULL)
+		{
+			line = strchr(line, ':');
+			result->summary = sscanf(line, ": %u bytes from %u, %u frames, %u go backs, %u baud.", &result->summary_bytes,
+									 &result->summary_from, &result->frames, &result->go_backs, &result->summary_baud_rate) == 5;
+			return;
+		}
+		vTaskDelay(1);
+	}
+}
+
+/**
+ * @brief Downloads the log into s_log as data_reader.py does, with the faults in setup.
+ */
+static void receive(const receiver_setup *setup, receiver_result *result)
+{
+	received_frame frame;
+	uint8_t start[8];
+
+	memset(result, 0, sizeof(*result));
+	memset(s_log, 0, sizeof(s_log));
+	s_line_length = 0;
+	s_text_length = 0;
+	s_text[0] = '\0';
+	sim_uart_peer_connect(s_uart, DOWNLOAD_DEFAULT_BAUD);
+
+	//START until INFO comes back.
+	write_32(setup->baud_rate, &start[0]);
+	start[4] = (uint8_t) (setup->window >> 8);
+	start[5] = (uint8_t) setup->window;
+	start[6] = (uint8_t) (setup->chunk >> 8);
+	start[7] = (uint8_t) setup->chunk;
+	for(int i = 0; i < START_TRIES && !result->info; i++)
+	{
+		send_frame(DOWNLOAD_START, setup->offset, start, sizeof(start));
+		while(!result->info && wait_for_frame(&frame, 100))
+		{
+			result->info = frame.type == DOWNLOAD_INFO && frame.length == 12;
+		}
+	}
+	if(!result->info)
+	{
+		return;
+	}
+	result->start = frame.offset;
+	result->total = read_32(&frame.payload[0]);
+	result->baud_rate = read_32(&frame.payload[4]);
+	result->window = ((uint16_t) frame.payload[8] << 8) | frame.payload[9];
+	result->chunk = ((uint16_t) frame.payload[10] << 8) | frame.payload[11];
+
+	//The flight computer switches a few ms after INFO, so acknowledge the start until data arrives.
+	uint32_t offset = result->start;
+	vTaskDelay(pdMS_TO_TICKS(5));
+	sim_uart_peer_set_baud_rate(s_uart, result->baud_rate);
+	s_line_length = 0;
+	bool have_frame = false;
+	for(int i = 0; i < SYNC_TRIES && !have_frame; i++)
+	{
+		send_frame(DOWNLOAD_ACK, offset, NULL, 0);
+		have_frame = wait_for_frame(&frame, 100);
+	}
+
+	bool data_lost = false;
+	uint32_t nak_sent = NO_FAULT;
+	while(have_frame)
+	{
+		if(frame.type == DOWNLOAD_DATA)
+		{
+			if(frame.offset == setup->lose_data_at && !data_lost)
+			{
+				data_lost = true;
+			}else if(frame.offset == offset && offset + frame.length <= LOG_SIZE)
+			{
+				memcpy(&s_log[offset], frame.payload, frame.length);
+				offset += frame.length;
+				nak_sent = NO_FAULT;
+				if(frame.offset < setup->lose_acks_from)
+				{
+					acknowledge(setup, offset, frame.offset);
+				}
+			}else if(frame.offset > offset)
+			{
+				//Something in between got lost, ask once per gap.
+				if(nak_sent != offset)
+				{
+					send_frame(DOWNLOAD_NAK, offset, NULL, 0);
+					nak_sent = offset;
+					result->naks++;
+				}
+			}else
+			{
+				acknowledge(setup, offset, offset);
+			}
+		}else if(frame.type == DOWNLOAD_END)
+		{
+			//data_reader.py goes on answering END for a while, in case its ACK got lost. Nothing is lost on this line,
+			//so the receiver goes back to the CLI rate straight away, in time for the summary line.
+			send_frame(DOWNLOAD_ACK, offset, NULL, 0);
+			result->done = offset == result->total;
+			break;
+		}else if(frame.type == DOWNLOAD_ABORT)
+		{
+			break;
+		}
+		have_frame = wait_for_frame(&frame, FRAME_TIMEOUT_MS);
+	}
+	result->offset = offset;
+
+	vTaskDelay(pdMS_TO_TICKS(5));
+	sim_uart_peer_set_baud_rate(s_uart, DOWNLOAD_DEFAULT_BAUD);
+	read_summary(result);
+}
+
+/**
+ * @brief Checks that the whole log from the receiver's offset arrived intact and the firmware says so.
+ */
+static void check_download(const receiver_setup *setup, const receiver_result *result)
+{
+	uint32_t start = (setup->offset < LOG_SIZE) ? setup->offset : LOG_SIZE;
+	TEST_CHECK(result->info);
+	TEST_CHECK(result->start == start);
+	TEST_CHECK(result->total == LOG_SIZE);
+	TEST_CHECK(result->done);
+	TEST_CHECK(result->offset == LOG_SIZE);
+	TEST_CHECK(result->summary);
+	TEST_CHECK(result->summary_bytes == LOG_SIZE - start);
+	TEST_CHECK(result->summary_from == start);
+	TEST_CHECK(result->summary_baud_rate == result->baud_rate);
+	TEST_CHECK(strstr(s_text, "Download done:") != NULL);
+
+	uint32_t wrong = 0;
+	for(uint32_t offset = start; offset < LOG_SIZE; offset++)
+	{
+		wrong += (s_log[offset] != log_byte(offset)) ? 1 : 0;
+	}
+	TEST_CHECK(wrong == 0);
+}
+
+static uint32_t chunks(uint32_t from, uint16_t chunk)
+{
+	return (LOG_SIZE - from + chunk - 1) / chunk;
+}
+
+static void test_body(void)
+{
+	receiver_result result;
+
+	for(uint32_t offset = 0; offset < LOG_SIZE; offset++)
+	{
+		sim_flash_memory()[FLASH_START_ADDRESS + offset] = log_byte(offset);
+	}
+	s_flash = flash_initialize();
+	s_uart = UART_Port6_Init();
+	TEST_CHECK(s_flash != NULL);
+	test_create_task(download_task, NULL, osPriorityAboveNormal);
+
+	test_case("clean download");
+	receiver_setup clean = {0, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, NO_FAULT, NO_FAULT, false};
+	receive(&clean, &result);
+	check_download(&clean, &result);
+	TEST_CHECK(result.baud_rate == DOWNLOAD_MAX_BAUD);
+	TEST_CHECK(result.window == 8 && result.chunk == DOWNLOAD_CHUNK_MAX);
+	TEST_CHECK(result.frames == chunks(0, DOWNLOAD_CHUNK_MAX));
+	TEST_CHECK(result.go_backs == 0);
+	TEST_CHECK(result.naks == 0);
+
+	//The flight computer picks the next rate down and clamps the window and chunk.
+	test_case("odd baud rate, window and chunk");
+	receiver_setup odd = {0, 500000, 40, 5000, NO_FAULT, NO_FAULT, false};
+	receive(&odd, &result);
+	check_download(&odd, &result);
+	TEST_CHECK(result.baud_rate == 460800);
+	TEST_CHECK(result.window == DOWNLOAD_WINDOW_MAX && result.chunk == DOWNLOAD_CHUNK_MAX);
+	receiver_setup small = {0, DOWNLOAD_DEFAULT_BAUD, 0, 100, NO_FAULT, NO_FAULT, false};
+	receive(&small, &result);
+	check_download(&small, &result);
+	TEST_CHECK(result.baud_rate == DOWNLOAD_DEFAULT_BAUD);
+	TEST_CHECK(result.window == 1 && result.chunk == 100);
+	TEST_CHECK(result.go_backs == 0);
+
+	//The frame after the gap gets a NAK, and the sender goes back to the lost one.
+	test_case("lost data frame");
+	receiver_setup lost = {0, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, 40 * DOWNLOAD_CHUNK_MAX, NO_FAULT, false};
+	receive(&lost, &result);
+	check_download(&lost, &result);
+	TEST_CHECK(result.naks == 1);
+	TEST_CHECK(result.go_backs == 1);
+	TEST_CHECK(result.frames > chunks(0, DOWNLOAD_CHUNK_MAX));
+	TEST_CHECK(result.frames <= chunks(0, DOWNLOAD_CHUNK_MAX) + 8);
+
+	//With nothing after them to cover for them, the sender only finds out by its timeout, and sends the last frames
+	//again. The receiver acknowledges the copies.
+	test_case("lost acknowledgements");
+	receiver_setup no_acks = {0, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, NO_FAULT, LOG_SIZE - 3 * DOWNLOAD_CHUNK_MAX, false};
+	receive(&no_acks, &result);
+	check_download(&no_acks, &result);
+	TEST_CHECK(result.naks == 0);
+	TEST_CHECK(result.go_backs >= 1);
+	TEST_CHECK(result.frames >= chunks(0, DOWNLOAD_CHUNK_MAX) + 3);
+
+	//Repeated and stale ACKs must not make the sender go back or send anything twice.
+	test_case("duplicate acknowledgements");
+	receiver_setup repeats = {0, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, NO_FAULT, NO_FAULT, true};
+	receive(&repeats, &result);
+	check_download(&repeats, &result);
+	TEST_CHECK(result.go_backs == 0);
+	TEST_CHECK(result.frames == chunks(0, DOWNLOAD_CHUNK_MAX));
+
+	test_case("resume");
+	receiver_setup resume = {123457, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, NO_FAULT, NO_FAULT, false};
+	receive(&resume, &result);
+	check_download(&resume, &result);
+	TEST_CHECK(result.frames == chunks(resume.offset, DOWNLOAD_CHUNK_MAX));
+	TEST_CHECK(s_log[resume.offset - 1] == 0);
+	receiver_setup resume_lost = {100000, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, 100000 + 5 * DOWNLOAD_CHUNK_MAX, NO_FAULT, false};
+	receive(&resume_lost, &result);
+	check_download(&resume_lost, &result);
+	TEST_CHECK(result.go_backs == 1);
+
+	//A receiver that already has the whole log, or asks for more than there is, only gets END.
+	test_case("resume with nothing left");
+	receiver_setup complete = {LOG_SIZE, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, NO_FAULT, NO_FAULT, false};
+	receive(&complete, &result);
+	check_download(&complete, &result);
+	TEST_CHECK(result.frames == 0);
+	receiver_setup past_end = {LOG_SIZE + 5000, DOWNLOAD_MAX_BAUD, 8, DOWNLOAD_CHUNK_MAX, NO_FAULT, NO_FAULT, false};
+	receive(&past_end, &result);
+	check_download(&past_end, &result);
+	TEST_CHECK(result.frames == 0);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_run_task(test_body, 120.0);
+	return test_summary("test_download");
+}
@@ -0,0 +1,315 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the flash driver on the flash model: the SPI transactions a program and a read take, reads and
+//  programs that suspend an erase in another sector, and a chip whose status register only reads back 0xFF, which has
+//  to end in an error rather than a hang.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "flash.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define ERASED_SECTOR		(FLASH_PARAM_END_ADDRESS + 1)				//The one being erased.
+#define DATA_SECTOR			(ERASED_SECTOR + FLASH_SECTOR_SIZE)			//Read and programmed during the erase.
+#define READY_TIMEOUT_MS	10											//FLASH_READY_TIMEOUT_MS in flash.c.
+#define WAIT_TIMEOUT_MS		3000
+#define MAX_RECORDED		16
+#define LONG_READ_BYTES		70000										//Past the HAL's 16 bit transfer size.
+
+//One chip select of the flash: the command byte and how many bytes were clocked in all.
+typedef struct
+{
+	uint8_t command;
+	uint32_t bytes;
+} flash_transaction;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static Flash s_flash;
+static volatile uint32_t s_background_runs;
+
+static void (*s_model_select)(void);
+static uint8_t (*s_model_exchange)(uint8_t mosi);
+static flash_transaction s_recorded[MAX_RECORDED];
+static uint32_t s_recorded_count;
+static uint8_t s_long_read[LONG_READ_BYTES];
+
+
+/**
+ * @brief Sits between the SPI stand in and the flash model, and notes down every transaction.
+ */
+static void recording_select(void)
+{
+	if(s_recorded_count < MAX_RECORDED)
+	{
+		s_recorded[s_recorded_count] = (flash_transaction) {0, 0};
+	}
+	s_recorded_count++;
+	s_model_select();
+}
+
+static uint8_t recording_exchange(uint8_t mosi)
+{
+	if(s_recorded_count > 0 && s_recorded_count <= MAX_RECORDED)
+	{
+		flash_transaction *transaction = &s_recorded[s_recorded_count - 1];
+		if(transaction->bytes++ == 0)
+		{
+			transaction->command = mosi;
+		}
+	}
+	return s_model_exchange(mosi);
+}
+
+static void start_recording(void)
+{
+	s_recorded_count = 0;
+	sim_flash_device.select = recording_select;
+	sim_flash_device.exchange = recording_exchange;
+}
+
+static void stop_recording(void)
+{
+	sim_flash_device.select = s_model_select;
+	sim_flash_device.exchange = s_model_exchange;
+}
+
+/**
+ * @brief Counts the recorded transactions that sent command, and checks there was exactly one, of bytes bytes.
+ */
+static bool recorded_once(uint8_t command, uint32_t bytes)
+{
+	uint32_t count = 0;
+	bool size_ok = false;
+	for(uint32_t i = 0; i < s_recorded_count && i < MAX_RECORDED; i++)
+	{
+		if(s_recorded[i].command == command)
+		{
+			count++;
+			size_ok = (s_recorded[i].bytes == bytes);
+		}
+	}
+	return count == 1 && size_ok;
+}
+
+/**
+ * @brief Checks that every recorded transaction other than the one carrying data was a one or two byte command.
+ */
+static bool others_are_short(uint8_t command)
+{
+	for(uint32_t i = 0; i < s_recorded_count && i < MAX_RECORDED; i++)
+	{
+		if(s_recorded[i].command != command && s_recorded[i].bytes > 2)
+		{
+			return false;
+		}
+	}
+	return s_recorded_count <= MAX_RECORDED;
+}
+
+
+/**
+ * @brief A chip that does not answer: MISO is pulled up, so every byte reads 0xFF.
+ */
+static uint8_t stuck_exchange(uint8_t mosi)
+{
+	(void) mosi;
+	return 0xFF;
+}
+
+/**
+ * @brief Stands in for the tasks waiting on the flash. It only gets to run if the driver does not spin.
+ */
+static void background_task(void const *params)
+{
+	(void) params;
+	while(1)
+	{
+		s_background_runs++;
+		vTaskDelay(1);
+	}
+}
+
+static bool is_blank(uint32_t from, uint32_t to)
+{
+	for(uint32_t address = from; address < to; address++)
+	{
+		if(sim_flash_memory()[address] != 0xFF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool wait_until_idle(void)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(FLASH_IS_DEVICE_BUSY(flash_get_status_register(s_flash)))
+	{
+		if(xTaskGetTickCount() - start > pdMS_TO_TICKS(WAIT_TIMEOUT_MS))
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
+}
+
+static void start_erase(void)
+{
+	memset(&sim_flash_memory()[ERASED_SECTOR], 0x5A, FLASH_SECTOR_SIZE);
+	TEST_CHECK(flash_erase_sector(s_flash, ERASED_SECTOR) == FLASH_OK);
+	TEST_CHECK(FLASH_IS_DEVICE_BUSY(flash_get_status_register(s_flash)));
+}
+
+static void test_transactions(void)
+{
+	uint8_t page[FLASH_PAGE_SIZE];
+	uint8_t read[4 * FLASH_PAGE_SIZE];
+	memset(page, 0xA5, sizeof(page));
+
+	//The opcode, address and data of a program go out under one chip select. Around it there are only the status
+	//reads and the write enable.
+	test_case("one transaction per program");
+	start_recording();
+	TEST_CHECK(flash_program_page(s_flash, DATA_SECTOR, page, sizeof(page)) == FLASH_OK);
+	stop_recording();
+	TEST_CHECK(recorded_once(FLASH_PP_COMMAND, 4 + FLASH_PAGE_SIZE));
+	TEST_CHECK(recorded_once(FLASH_ENABLE_WRITE_COMMAND, 1));
+	TEST_CHECK(others_are_short(FLASH_PP_COMMAND));
+	printf("  program: %u transactions\n", (unsigned) s_recorded_count);
+	TEST_CHECK(wait_until_idle());
+	TEST_CHECK(memcmp(&sim_flash_memory()[DATA_SECTOR], page, sizeof(page)) == 0);
+
+	//A read needs no write enable, and its dummy byte comes after the address.
+	test_case("one transaction per read");
+	start_recording();
+	TEST_CHECK(flash_read(s_flash, DATA_SECTOR, read, FLASH_PAGE_SIZE) == FLASH_OK);
+	stop_recording();
+	TEST_CHECK(recorded_once(FLASH_FAST_READ_COMMAND, 5 + FLASH_PAGE_SIZE));
+	TEST_CHECK(recorded_once(FLASH_ENABLE_WRITE_COMMAND, 1) == false);
+	TEST_CHECK(others_are_short(FLASH_FAST_READ_COMMAND));
+	TEST_CHECK(s_recorded_count == 2);
+	TEST_CHECK(memcmp(read, page, sizeof(page)) == 0);
+
+	test_case("multi-page read is one stream");
+	memcpy(&sim_flash_memory()[DATA_SECTOR + FLASH_PAGE_SIZE], page, sizeof(page));
+	start_recording();
+	TEST_CHECK(flash_read(s_flash, DATA_SECTOR + 8, read, sizeof(read)) == FLASH_OK);
+	stop_recording();
+	TEST_CHECK(recorded_once(FLASH_FAST_READ_COMMAND, 5 + sizeof(read)));
+	TEST_CHECK(s_recorded_count == 2);
+	TEST_CHECK(memcmp(read, &sim_flash_memory()[DATA_SECTOR + 8], sizeof(read)) == 0);
+
+	//SPI.c splits a transfer past 65535 bytes into several HAL calls, all under the one chip select.
+	test_case("long read is one stream");
+	start_recording();
+	TEST_CHECK(flash_read(s_flash, FLASH_START_ADDRESS, s_long_read, sizeof(s_long_read)) == FLASH_OK);
+	stop_recording();
+	TEST_CHECK(recorded_once(FLASH_FAST_READ_COMMAND, 5 + sizeof(s_long_read)));
+	TEST_CHECK(s_recorded_count == 2);
+	TEST_CHECK(memcmp(s_long_read, &sim_flash_memory()[FLASH_START_ADDRESS], sizeof(s_long_read)) == 0);
+
+	memset(&sim_flash_memory()[DATA_SECTOR], 0xFF, 2 * FLASH_PAGE_SIZE);
+}
+
+static void test_suspend(void)
+{
+	uint8_t page[FLASH_PAGE_SIZE];
+	uint8_t read[FLASH_PAGE_SIZE];
+	for(uint32_t i = 0; i < FLASH_PAGE_SIZE; i++)
+	{
+		page[i] = (uint8_t) (i * 7);
+	}
+
+	test_case("read and program during an erase");
+	start_erase();
+	TEST_CHECK(flash_program_page(s_flash, DATA_SECTOR, page, sizeof(page)) == FLASH_OK);
+	TEST_CHECK(flash_read(s_flash, DATA_SECTOR, read, sizeof(read)) == FLASH_OK);
+	TEST_CHECK(memcmp(read, page, sizeof(page)) == 0);
+	TEST_CHECK(flash_read(s_flash, ERASED_SECTOR + FLASH_PAGE_SIZE, read, sizeof(read)) == FLASH_BUSY);
+	TEST_CHECK(wait_until_idle());
+	TEST_CHECK(is_blank(ERASED_SECTOR, ERASED_SECTOR + FLASH_SECTOR_SIZE));
+	TEST_CHECK(memcmp(&sim_flash_memory()[DATA_SECTOR], page, sizeof(page)) == 0);
+}
+
+static void test_stuck_status(void)
+{
+	uint8_t page[FLASH_PAGE_SIZE];
+	memset(page, 0x11, sizeof(page));
+
+	//The erase is running when the chip stops answering, so the driver tries to suspend it and waits for WIP to clear.
+	test_case("status register stuck at 0xFF");
+	start_erase();
+	uint8_t (*exchange)(uint8_t mosi) = sim_flash_device.exchange;
+	sim_flash_device.exchange = stuck_exchange;
+
+	uint32_t runs = s_background_runs;
+	TickType_t start = xTaskGetTickCount();
+	TEST_CHECK(flash_read(s_flash, DATA_SECTOR, page, sizeof(page)) == FLASH_ERROR);
+	TickType_t waited = xTaskGetTickCount() - start;
+	printf("  read gave up after %u ms, background task ran %u times\n", (unsigned) waited,
+		   (unsigned) (s_background_runs - runs));
+	TEST_CHECK(waited >= pdMS_TO_TICKS(READY_TIMEOUT_MS));
+	TEST_CHECK(waited <= pdMS_TO_TICKS(2 * READY_TIMEOUT_MS));
+	TEST_CHECK(s_background_runs - runs >= READY_TIMEOUT_MS / 2);
+
+	start = xTaskGetTickCount();
+	TEST_CHECK(flash_program_page(s_flash, DATA_SECTOR + FLASH_PAGE_SIZE, page, sizeof(page)) == FLASH_ERROR);
+	TEST_CHECK(xTaskGetTickCount() - start <= pdMS_TO_TICKS(2 * READY_TIMEOUT_MS));
+
+	//Nothing can be suspended for, so these give up at once.
+	TEST_CHECK(flash_read(s_flash, ERASED_SECTOR, page, sizeof(page)) == FLASH_BUSY);
+	TEST_CHECK(flash_erase_sector(s_flash, DATA_SECTOR) == FLASH_BUSY);
+
+	test_case("chip answers again");
+	sim_flash_device.exchange = exchange;
+	TEST_CHECK(wait_until_idle());
+	TEST_CHECK(is_blank(ERASED_SECTOR, ERASED_SECTOR + FLASH_SECTOR_SIZE));
+	TEST_CHECK(is_blank(DATA_SECTOR + FLASH_PAGE_SIZE, DATA_SECTOR + 2 * FLASH_PAGE_SIZE));
+	TEST_CHECK(flash_program_page(s_flash, DATA_SECTOR + FLASH_PAGE_SIZE, page, sizeof(page)) == FLASH_OK);
+	TEST_CHECK(wait_until_idle());
+	TEST_CHECK(memcmp(&sim_flash_memory()[DATA_SECTOR + FLASH_PAGE_SIZE], page, sizeof(page)) == 0);
+}
+
+static void test_body(void)
+{
+	s_flash = flash_initialize();
+	TEST_CHECK(s_flash != NULL);
+	test_create_task(background_task, NULL, osPriorityLow);
+	s_model_select = sim_flash_device.select;
+	s_model_exchange = sim_flash_device.exchange;
+
+	test_transactions();
+	test_suspend();
+	test_stuck_status();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_run_task(test_body, 30.0);
+	return test_summary("test_flash");
+}
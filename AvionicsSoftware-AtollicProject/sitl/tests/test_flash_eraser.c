@@ -0,0 +1,240 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the background eraser on the flash model, with the flash's real erase times: that it clears the old
+//  flight and then stops, that it keeps its lead on a writer logging at a steady rate so the writer never waits, and
+//  that a writer going faster than the flash can erase waits for it instead of programming over old data.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "tasks/flash_writer.h"
+#include "tasks/flight_state_controller.h"
+#include "utilities/common.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define FIRST_SECTOR		(FLASH_PARAM_END_ADDRESS + 1)			//Where the full size sectors start.
+#define OLD_DATA_END		(FIRST_SECTOR + FLASH_SECTOR_SIZE)		//The old flight.
+#define SECTOR_ERASE_MS		500										//Of the flash model.
+#define STEADY_PERIOD_MS	20			//One page every 20 ms is 12.8 kB/s, well inside what the flash erases.
+#define OLD_DATA_PAGES		250			//Logged while the old flight is still being cleared.
+#define PAST_OLD_PAGES		1000		//Takes the log a whole erase lead past the end of the old flight.
+#define BURST_PAGES			(3 * FLASH_SECTOR_SIZE / DATA_BUFFER_SIZE)
+#define WAIT_TIMEOUT_MS		30000
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static flash_writer_thread_parameters s_params;
+static uint32_t s_submitted;
+static uint32_t s_lead_min = UINT32_MAX;
+static uint32_t s_lead_max;
+static bool s_blank_ahead = true;
+
+
+static void make_page(uint32_t number, uint8_t *page)
+{
+	memset(page, (uint8_t) number, DATA_BUFFER_SIZE);
+	write_32(number, page);
+}
+
+static flash_writer_statistics statistics(void)
+{
+	flash_writer_statistics result;
+	flash_writer_get_statistics(&result);
+	return result;
+}
+
+static bool is_blank(uint32_t from, uint32_t to)
+{
+	for(uint32_t address = from; address < to; address++)
+	{
+		if(sim_flash_memory()[address] != 0xFF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Waits until the eraser has cleared up to address.
+ */
+static bool wait_for_erased(uint32_t address)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(statistics().erased_address < address)
+	{
+		if(xTaskGetTickCount() - start > pdMS_TO_TICKS(WAIT_TIMEOUT_MS))
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
+}
+
+static bool wait_for_written(uint32_t pages)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(statistics().pages_written < pages)
+	{
+		if(xTaskGetTickCount() - start > pdMS_TO_TICKS(WAIT_TIMEOUT_MS))
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
+}
+
+/**
+ * @brief Queues the next page, first checking that what the eraser claims is erased ahead of the writer really is.
+ * Leaves out the page at next_address, which the writer may be programming.
+ */
+static bool submit(uint32_t timeout)
+{
+	uint8_t page[DATA_BUFFER_SIZE];
+	flash_writer_statistics stats = statistics();
+
+	if(stats.erased_address > stats.next_address + DATA_BUFFER_SIZE)
+	{
+		s_blank_ahead = s_blank_ahead && is_blank(stats.next_address + DATA_BUFFER_SIZE, stats.erased_address);
+	}
+	if(stats.next_address >= OLD_DATA_END)
+	{
+		uint32_t lead = (stats.erased_address > stats.next_address) ? stats.erased_address - stats.next_address : 0;
+		s_lead_min = (lead < s_lead_min) ? lead : s_lead_min;
+		s_lead_max = (lead > s_lead_max) ? lead : s_lead_max;
+	}
+
+	make_page(s_submitted, page);
+	if(!flash_writer_submit_page(page, timeout))
+	{
+		return false;
+	}
+	s_submitted++;
+	return true;
+}
+
+static bool submit_steadily(uint32_t pages)
+{
+	bool ok = true;
+	for(uint32_t i = 0; i < pages; i++)
+	{
+		ok = submit(0) && ok;
+		vTaskDelay(pdMS_TO_TICKS(STEADY_PERIOD_MS));
+	}
+	return ok;
+}
+
+static void test_body(void)
+{
+	//The old flight fills the area the new one is going to use.
+	memset(&sim_flash_memory()[FLASH_START_ADDRESS], 0x3C, OLD_DATA_END - FLASH_START_ADDRESS);
+
+	s_params.flash = flash_initialize();
+	s_params.start_address = FLASH_START_ADDRESS;
+	TEST_CHECK(s_params.flash != NULL);
+
+	test_create_task(thread_flash_writer_start, &s_params, osPriorityAboveNormal);
+	test_create_task(thread_flash_eraser_start, &s_params, osPriorityLow);
+
+	test_case("nothing is erased before the eraser starts");
+	vTaskDelay(pdMS_TO_TICKS(100));
+	TEST_CHECK(statistics().erased_address == FLASH_START_ADDRESS);
+	TEST_CHECK(sim_flash_memory()[FLASH_START_ADDRESS] == 0x3C);
+
+	//Logging starts once the first sector is clear, and goes on while the eraser works through the old flight.
+	test_case("logging while the old flight is cleared");
+	flash_writer_start_eraser(OLD_DATA_END);
+	TEST_CHECK(wait_for_erased(FLASH_START_ADDRESS + FLASH_PARAM_SECTOR_SIZE));
+	TEST_CHECK(submit_steadily(OLD_DATA_PAGES));
+	TEST_CHECK(wait_for_written(s_submitted));
+	TEST_CHECK(statistics().erased_address < OLD_DATA_END);
+
+	test_case("old flight cleared");
+	TEST_CHECK(wait_for_erased(OLD_DATA_END));
+	TEST_CHECK(is_blank(statistics().next_address, OLD_DATA_END));
+	vTaskDelay(pdMS_TO_TICKS(2 * SECTOR_ERASE_MS));
+	TEST_CHECK(statistics().erased_address == OLD_DATA_END);
+
+	//Past the old flight the eraser only keeps its lead, a sector at a time.
+	test_case("steady logging never waits");
+	TEST_CHECK(submit_steadily(PAST_OLD_PAGES));
+	TEST_CHECK(wait_for_written(s_submitted));
+	flash_writer_statistics stats = statistics();
+	TEST_CHECK(stats.next_address > OLD_DATA_END + FLASH_WRITER_ERASE_AHEAD);
+	TEST_CHECK(stats.erase_stall_max == 0);
+	TEST_CHECK(s_blank_ahead);
+	printf("  eraser lead %u to %u bytes\n", s_lead_min, s_lead_max);
+	TEST_CHECK(s_lead_min > DATA_BUFFER_SIZE);
+	TEST_CHECK(s_lead_max <= FLASH_WRITER_ERASE_AHEAD + FLASH_SECTOR_SIZE);
+
+	test_case("eraser stops at its lead");
+	vTaskDelay(pdMS_TO_TICKS(2 * SECTOR_ERASE_MS));
+	stats = statistics();
+	TEST_CHECK(stats.erased_address >= stats.next_address + FLASH_WRITER_ERASE_AHEAD);
+	TEST_CHECK(stats.erased_address <= stats.next_address + FLASH_WRITER_ERASE_AHEAD + FLASH_SECTOR_SIZE);
+	TEST_CHECK(is_blank(stats.next_address, stats.erased_address));
+	TEST_CHECK(is_blank(stats.erased_address, stats.erased_address + 4 * FLASH_SECTOR_SIZE));
+
+	//Programming a sector takes far less than erasing one, so a burst of pages runs into the eraser. The writer
+	//waits for it, and loses nothing as long as the producer waits for the queue.
+	test_case("burst waits for the eraser");
+	uint32_t queued = 0;
+	for(uint32_t i = 0; i < BURST_PAGES; i++)
+	{
+		queued += submit(2 * SECTOR_ERASE_MS) ? 1 : 0;
+	}
+	TEST_CHECK(queued == BURST_PAGES);
+	TEST_CHECK(wait_for_written(s_submitted));
+	stats = statistics();
+	printf("  longest wait for the eraser %u ms\n", stats.erase_stall_max);
+	TEST_CHECK(stats.erase_stall_max > 0);
+	TEST_CHECK(stats.erase_stall_max <= SECTOR_ERASE_MS + 50);
+	TEST_CHECK(s_blank_ahead);
+
+	test_case("every page in place");
+	TEST_CHECK(stats.pages_written == s_submitted);
+	TEST_CHECK(stats.pages_dropped == 0);
+	TEST_CHECK(stats.pages_lost == 0);
+	TEST_CHECK(stats.erase_errors == 0);
+	TEST_CHECK(stats.next_address == FLASH_START_ADDRESS + s_submitted * DATA_BUFFER_SIZE);
+	uint32_t misplaced = 0;
+	for(uint32_t i = 0; i < s_submitted; i++)
+	{
+		uint8_t expected[DATA_BUFFER_SIZE];
+		make_page(i, expected);
+		misplaced += memcmp(&sim_flash_memory()[FLASH_START_ADDRESS + i * DATA_BUFFER_SIZE], expected, DATA_BUFFER_SIZE) != 0;
+	}
+	TEST_CHECK(misplaced == 0);
+	uint32_t end;
+	TEST_CHECK(flash_scan(s_params.flash, 0, &end) == FLASH_OK);
+	TEST_CHECK(end == stats.next_address);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_run_task(test_body, 120.0);
+	return test_summary("test_flash_eraser");
+}
@@ -0,0 +1,290 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of flash_scan on the flash model: exact, stale, too far and missing hints, an empty and a full device,
+//  and a new flight written over an old one, with the eraser's run of erased sectors between them, all in a
+//  logarithmic number of reads. Also a scan while an erase is still running, a sector with a written page after an
+//  empty one, and a chip that does not answer.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "flash.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define PAGES(n)			((uint32_t) (n) * FLASH_PAGE_SIZE)
+#define SECTORS(n)			((uint32_t) (n) * FLASH_SECTOR_SIZE)
+#define FIRST_SECTOR		(FLASH_PARAM_END_ADDRESS + 1)		//Where the full size sectors start.
+#define MAX_SCAN_READS		48		//Searching out from the hint, then bisecting the sectors and the pages of the last.
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static Flash s_flash;
+static uint32_t s_transactions_per_read;
+static volatile uint32_t s_background_runs;
+static uint32_t s_max_reads;
+
+
+static void erase(uint32_t from, uint32_t to)
+{
+	memset(&sim_flash_memory()[from], 0xFF, to - from);
+}
+
+/**
+ * @brief Writes pages in [from, to). Each has a single byte programmed, at a different place in each page, so a page
+ * only reads as empty if all of it is.
+ */
+static void write(uint32_t from, uint32_t to)
+{
+	erase(from, to);
+	for(uint32_t address = from; address < to; address += FLASH_PAGE_SIZE)
+	{
+		sim_flash_memory()[address + (address / FLASH_PAGE_SIZE) % FLASH_PAGE_SIZE] = 0x00;
+	}
+}
+
+/**
+ * @brief A chip that does not answer: its status register reads busy and every page reads erased.
+ */
+static uint8_t stuck_exchange(uint8_t mosi)
+{
+	(void) mosi;
+	return 0xFF;
+}
+
+/**
+ * @brief Stands in for the other tasks. It only gets to run while the scan sleeps.
+ */
+static void background_task(void const *params)
+{
+	(void) params;
+	while(1)
+	{
+		s_background_runs++;
+		vTaskDelay(1);
+	}
+}
+
+/**
+ * @brief Runs flash_scan, checks that it succeeded and counts the page reads it took.
+ */
+static uint32_t scan(uint32_t hint, uint32_t *reads)
+{
+	uint32_t before = sim_flash_device.transactions;
+	uint32_t end;
+	TEST_CHECK(flash_scan(s_flash, hint, &end) == FLASH_OK);
+	*reads = (sim_flash_device.transactions - before) / s_transactions_per_read;
+	s_max_reads = (*reads > s_max_reads) ? *reads : s_max_reads;
+	return end;
+}
+
+/**
+ * @brief Checks that every hint finds end, and within MAX_SCAN_READS reads.
+ */
+static void check_hints(uint32_t end, const uint32_t *hints, uint32_t count)
+{
+	for(uint32_t i = 0; i < count; i++)
+	{
+		uint32_t reads;
+		uint32_t found = scan(hints[i], &reads);
+		if(!TEST_CHECK(found == end))
+		{
+			fprintf(stderr, "  hint %u found %u, the end is %u\n", hints[i], found, end);
+		}
+		TEST_CHECK(reads <= MAX_SCAN_READS);
+	}
+}
+
+static void test_hints(void)
+{
+	const uint32_t end = FIRST_SECTOR + SECTORS(20) + PAGES(37);
+	write(FLASH_START_ADDRESS, end);
+
+	test_case("exact hint");
+	uint32_t reads;
+	TEST_CHECK(scan(end, &reads) == end);
+	TEST_CHECK(reads == 2);
+	TEST_CHECK(scan(end + 17, &reads) == end);
+	TEST_CHECK(reads == 2);
+
+	test_case("stale hint");
+	const uint32_t stale[] = {FLASH_START_ADDRESS, FLASH_START_ADDRESS + PAGES(3), FIRST_SECTOR, end - SECTORS(1),
+							  end - PAGES(1)};
+	check_hints(end, stale, sizeof(stale) / sizeof(stale[0]));
+
+	test_case("hint past the data");
+	const uint32_t too_far[] = {end + PAGES(1), end + SECTORS(1), end + SECTORS(75), FLASH_SIZE_BYTES - PAGES(1)};
+	check_hints(end, too_far, sizeof(too_far) / sizeof(too_far[0]));
+
+	test_case("no hint");
+	const uint32_t none[] = {0, FLASH_START_ADDRESS - PAGES(1), FLASH_SIZE_BYTES, UINT32_MAX};
+	check_hints(end, none, sizeof(none) / sizeof(none[0]));
+
+	//The end of the log at the first page of a sector, in the parameter sectors and at the end of them.
+	test_case("end on a sector boundary");
+	const uint32_t boundaries[] = {FLASH_START_ADDRESS + PAGES(1), FLASH_START_ADDRESS + FLASH_PARAM_SECTOR_SIZE,
+								   FIRST_SECTOR, FIRST_SECTOR + SECTORS(5)};
+	for(uint32_t i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); i++)
+	{
+		erase(FLASH_START_ADDRESS, end);
+		write(FLASH_START_ADDRESS, boundaries[i]);
+		const uint32_t hints[] = {0, FLASH_START_ADDRESS, boundaries[i], boundaries[i] - PAGES(1), end};
+		check_hints(boundaries[i], hints, sizeof(hints) / sizeof(hints[0]));
+	}
+	erase(FLASH_START_ADDRESS, end);
+}
+
+static void test_empty_and_full(void)
+{
+	test_case("empty device");
+	const uint32_t hints[] = {0, FLASH_START_ADDRESS, FIRST_SECTOR + SECTORS(10), FLASH_SIZE_BYTES - PAGES(1)};
+	check_hints(FLASH_START_ADDRESS, hints, sizeof(hints) / sizeof(hints[0]));
+
+	test_case("full device");
+	write(FLASH_START_ADDRESS, FLASH_SIZE_BYTES);
+	check_hints(FLASH_SIZE_BYTES, hints, sizeof(hints) / sizeof(hints[0]));
+
+	//One empty page left, in the last sector, which is shorter than the others.
+	test_case("one page left");
+	erase(FLASH_SIZE_BYTES - PAGES(1), FLASH_SIZE_BYTES);
+	check_hints(FLASH_SIZE_BYTES - PAGES(1), hints, sizeof(hints) / sizeof(hints[0]));
+	erase(FLASH_START_ADDRESS, FLASH_SIZE_BYTES);
+}
+
+/**
+ * @brief The layout flash_writer leaves when a new flight is cut off: new pages from FLASH_START_ADDRESS to end, the
+ * sectors the eraser cleared ahead of the writer up to frontier, then the old flight up to old_end.
+ * The hints are the ones the board can have saved. The controller saves the writer's address at launch, before the
+ * first page of the new flight is queued, so from then on the saved end is never inside the old flight.
+ */
+static void check_layout(uint32_t end, uint32_t frontier, uint32_t old_end)
+{
+	write(FLASH_START_ADDRESS, end);
+	erase(end, frontier);
+	write(frontier, old_end);
+
+	const uint32_t hints[] = {0, FLASH_START_ADDRESS, end, end - PAGES(1), (FLASH_START_ADDRESS + end) / 2,
+							  frontier - PAGES(1)};
+	check_hints(end, hints, sizeof(hints) / sizeof(hints[0]));
+	erase(FLASH_START_ADDRESS, old_end);
+}
+
+static void test_new_over_old(void)
+{
+	//While the old flight is there the eraser clears it at 128 kB/s, ten times what the log fills, so the erased run is
+	//many times the new data. A bisection of the whole device would land in the old flight and end up at old_end.
+	test_case("new flight over an old one");
+	check_layout(FIRST_SECTOR + SECTORS(5) + PAGES(9), FIRST_SECTOR + SECTORS(40), FIRST_SECTOR + SECTORS(100) + PAGES(3));
+
+	test_case("new flight ends on a sector boundary");
+	check_layout(FIRST_SECTOR + SECTORS(5), FIRST_SECTOR + SECTORS(45), FIRST_SECTOR + SECTORS(75));
+
+	test_case("new flight in the parameter sectors");
+	check_layout(FLASH_START_ADDRESS + PAGES(5), FIRST_SECTOR + SECTORS(1), FIRST_SECTOR + SECTORS(62));
+
+	test_case("old flight to the end of the device");
+	check_layout(FIRST_SECTOR + SECTORS(3) + PAGES(255), FIRST_SECTOR + SECTORS(40), FLASH_SIZE_BYTES);
+
+	//Once the old flight is gone the eraser only keeps its lead, which can be less than a sector after a burst.
+	test_case("old flight gone, erased run of one part sector");
+	check_layout(FIRST_SECTOR + SECTORS(5) + PAGES(9), FIRST_SECTOR + SECTORS(6), FIRST_SECTOR + SECTORS(6));
+
+	//Reset on the pad after the eraser started: there is no new flight yet.
+	test_case("old flight partly erased");
+	check_layout(FLASH_START_ADDRESS, FIRST_SECTOR + SECTORS(8), FIRST_SECTOR + SECTORS(25));
+}
+
+/**
+ * @brief A sector with written pages after an empty one is not something the writer and the eraser leave, and the
+ * scan says so rather than guess. A chip that does not answer makes it give up. Both leave the flash looking full.
+ */
+static void test_errors(void)
+{
+	uint32_t end;
+
+	//The hint is in a sector of the log whose first page was lost.
+	test_case("written page after an empty one");
+	const uint32_t log_end = FIRST_SECTOR + SECTORS(10) + PAGES(2);
+	write(FLASH_START_ADDRESS, log_end);
+	erase(FIRST_SECTOR + SECTORS(3), FIRST_SECTOR + SECTORS(3) + PAGES(1));
+	TEST_CHECK(flash_scan(s_flash, FIRST_SECTOR + SECTORS(3) + PAGES(7), &end) == FLASH_CORRUPT);
+	TEST_CHECK(end == FLASH_SIZE_BYTES);
+	erase(FLASH_START_ADDRESS, log_end);
+
+	test_case("chip does not answer");
+	uint8_t (*exchange)(uint8_t mosi) = sim_flash_device.exchange;
+	sim_flash_device.exchange = stuck_exchange;
+	TickType_t start = xTaskGetTickCount();
+	TEST_CHECK(flash_scan(s_flash, FLASH_START_ADDRESS, &end) == FLASH_BUSY);
+	TEST_CHECK(xTaskGetTickCount() - start <= pdMS_TO_TICKS(3100));
+	TEST_CHECK(end == FLASH_SIZE_BYTES);
+	sim_flash_device.exchange = exchange;
+}
+
+/**
+ * @brief A reset in the middle of an erase leaves the flash erasing the sector after the log. The pages in it can
+ * not be read until it is done, so the scan has to wait for them rather than take them as written or read garbage.
+ */
+static void test_erase_running(void)
+{
+	test_case("erase still running");
+	const uint32_t end = FIRST_SECTOR + SECTORS(3) + PAGES(17);
+	write(FLASH_START_ADDRESS, end);
+	write(FIRST_SECTOR + SECTORS(4), FIRST_SECTOR + SECTORS(5));
+	TEST_CHECK(flash_erase_sector(s_flash, FIRST_SECTOR + SECTORS(4)) == FLASH_OK);
+
+	uint32_t reads;
+	uint32_t runs = s_background_runs;
+	TickType_t start = xTaskGetTickCount();
+	TEST_CHECK(scan(FIRST_SECTOR + SECTORS(4) + PAGES(3), &reads) == end);
+	TEST_CHECK(xTaskGetTickCount() - start >= pdMS_TO_TICKS(400));
+	TEST_CHECK(s_background_runs - runs >= 400);
+	TEST_CHECK(!FLASH_IS_DEVICE_BUSY(flash_get_status_register(s_flash)));
+	erase(FLASH_START_ADDRESS, end);
+}
+
+static void test_body(void)
+{
+	s_flash = flash_initialize();
+	TEST_CHECK(s_flash != NULL);
+
+	uint8_t page[FLASH_PAGE_SIZE];
+	uint32_t before = sim_flash_device.transactions;
+	TEST_CHECK(flash_read(s_flash, FLASH_START_ADDRESS, page, sizeof(page)) == FLASH_OK);
+	s_transactions_per_read = sim_flash_device.transactions - before;
+
+	test_empty_and_full();
+	test_hints();
+	test_new_over_old();
+	printf("  at most %u page reads\n", s_max_reads);
+
+	test_create_task(background_task, NULL, osPriorityLow);
+	test_erase_running();
+	test_errors();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_run_task(test_body, 60.0);
+	return test_summary("test_flash_scan");
+}
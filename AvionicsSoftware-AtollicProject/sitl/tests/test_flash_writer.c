@@ -0,0 +1,137 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the flash writer's page queue: what happens when the controller queues pages faster than the writer
+//  programs them, with and without a timeout, and that only the pages that were accepted end up in the flash, in
+//  order.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+
+#include "tasks/flash_writer.h"
+#include "tasks/flight_state_controller.h"
+#include "utilities/common.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define DRAIN_TIMEOUT_MS	10000
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static flash_writer_thread_parameters s_params;
+
+
+static void make_page(uint32_t number, uint8_t *page)
+{
+	memset(page, (uint8_t) number, DATA_BUFFER_SIZE);
+	write_32(number, page);
+}
+
+static flash_writer_statistics statistics(void)
+{
+	flash_writer_statistics result;
+	flash_writer_get_statistics(&result);
+	return result;
+}
+
+/**
+ * @brief Lets the writer run until it has programmed pages in total.
+ */
+static bool wait_for_written(uint32_t pages)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(statistics().pages_written < pages)
+	{
+		if(xTaskGetTickCount() - start > pdMS_TO_TICKS(DRAIN_TIMEOUT_MS))
+		{
+			return false;
+		}
+		vTaskDelay(1);
+	}
+	return true;
+}
+
+static bool page_in_flash(uint32_t slot, uint32_t number)
+{
+	uint8_t expected[DATA_BUFFER_SIZE];
+	make_page(number, expected);
+	return memcmp(&sim_flash_memory()[FLASH_START_ADDRESS + slot * DATA_BUFFER_SIZE], expected, DATA_BUFFER_SIZE) == 0;
+}
+
+static void test_body(void)
+{
+	uint8_t page[DATA_BUFFER_SIZE];
+
+	s_params.flash = flash_initialize();
+	s_params.start_address = FLASH_START_ADDRESS;
+	TEST_CHECK(s_params.flash != NULL);
+
+	test_create_task(thread_flash_writer_start, &s_params, osPriorityAboveNormal);
+	test_create_task(thread_flash_eraser_start, &s_params, osPriorityLow);
+
+	//The eraser is not running yet, so the writer holds on to the first page and every slot fills up.
+	test_case("full queue drops without a timeout");
+	uint32_t queued = 0;
+	for(uint32_t i = 0; i < FLASH_WRITER_QUEUE_PAGES + 4; i++)
+	{
+		make_page(i, page);
+		queued += flash_writer_submit_page(page, 0) ? 1 : 0;
+	}
+	TEST_CHECK(queued == FLASH_WRITER_QUEUE_PAGES);
+	TEST_CHECK(statistics().pages_dropped == 4);
+	TEST_CHECK(statistics().queue_high_water == FLASH_WRITER_QUEUE_PAGES);
+	TEST_CHECK(statistics().pages_written == 0);
+
+	test_case("full queue drops when the timeout runs out");
+	TickType_t start = xTaskGetTickCount();
+	make_page(50, page);
+	TEST_CHECK(!flash_writer_submit_page(page, 5));
+	TEST_CHECK(xTaskGetTickCount() - start >= pdMS_TO_TICKS(5));
+	TEST_CHECK(statistics().pages_dropped == 5);
+
+	//This page is queued while the writer is programming the others, so it also checks that the writer's wake-up
+	//does not cut the page program's SPI transfer short.
+	test_case("full queue waits for a slot");
+	flash_writer_start_eraser(FLASH_START_ADDRESS);
+	make_page(100, page);
+	TEST_CHECK(flash_writer_submit_page(page, 1000));
+	TEST_CHECK(statistics().pages_dropped == 5);
+
+	test_case("accepted pages are programmed in order");
+	TEST_CHECK(wait_for_written(FLASH_WRITER_QUEUE_PAGES + 1));
+	flash_writer_statistics stats = statistics();
+	TEST_CHECK(stats.pages_lost == 0);
+	TEST_CHECK(stats.next_address == FLASH_START_ADDRESS + (FLASH_WRITER_QUEUE_PAGES + 1) * DATA_BUFFER_SIZE);
+	for(uint32_t i = 0; i < FLASH_WRITER_QUEUE_PAGES; i++)
+	{
+		TEST_CHECK(page_in_flash(i, i));
+	}
+	TEST_CHECK(page_in_flash(FLASH_WRITER_QUEUE_PAGES, 100));
+	uint8_t blank[DATA_BUFFER_SIZE];
+	memset(blank, 0xFF, sizeof(blank));
+	TEST_CHECK(memcmp(&sim_flash_memory()[stats.next_address], blank, DATA_BUFFER_SIZE) == 0);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_run_task(test_body, 60.0);
+	return test_summary("test_flash_writer");
+}
@@ -0,0 +1,238 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the IMU task's sample read without the FIFOs: imu_sample_read has to be one SPI transaction on each
+//  half of the BMI088 and give exactly what bmi08a_get_data and bmi08g_get_data read from the same registers. The two
+//  halves are register files behind a counting spi_receive.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "tasks/sensors/imu_sample.h"
+#include "bmi08x.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define ACCEL_ID	0x00	//What the driver passes as dev_addr before the halves are configured.
+#define GYRO_ID		0x01
+
+//One half of the BMI088 on its own chip select.
+typedef struct
+{
+	uint8_t regs[128];
+	bool dummy_byte;			//The accelerometer sends a dummy byte before the data of every read.
+	uint32_t transactions;
+	uint8_t last_command;
+	uint32_t last_length;		//Bytes clocked in after the command, dummy byte included.
+	HAL_StatusTypeDef result;
+} chip;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static chip s_accel;
+static chip s_gyro;
+static struct bmi08x_dev s_dev;
+
+//Raw readings to put in the data registers: the ends of the range, zero, -1 and some in between.
+static const int16_t s_raw[][6] =
+{
+	{0, 0, 0, 0, 0, 0},
+	{-1, 1, -1, 1, -1, 1},
+	{INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX},
+	{INT16_MAX, INT16_MIN, 0x00FF, 0x0100, -256, 255},
+	{1365, -2730, 10923, -4096, 123, -32000},
+	{0x1234, -0x1234, 0x7F80, -0x0080, 0x5A5A, -0x5A5B},
+};
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Each chip select is one transaction: the command byte out, then len bytes in.
+HAL_StatusTypeDef spi_receive(SPI hspi, uint8_t *addr_buffer, uint8_t addr_buffer_size, uint8_t *rx_buffer,
+							  uint32_t rx_buffer_size, uint32_t timeout)
+{
+	chip *device = (chip *) hspi;
+	(void) timeout;
+
+	device->transactions++;
+	device->last_command = addr_buffer[0];
+	device->last_length = rx_buffer_size;
+	TEST_CHECK(addr_buffer_size == 1);
+	if(device->result != HAL_OK)
+	{
+		return device->result;
+	}
+
+	uint8_t address = addr_buffer[0] & 0x7F;
+	uint32_t i = 0;
+	if(device->dummy_byte && rx_buffer_size > 0)
+	{
+		rx_buffer[i++] = 0xA5;
+	}
+	for(uint32_t offset = 0; i < rx_buffer_size; i++, offset++)
+	{
+		rx_buffer[i] = device->regs[(address + offset) & 0x7F];
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef spi_send(SPI hspi, uint8_t *reg_addr, uint8_t reg_addr_size, uint8_t *tx_buffer,
+						   uint32_t tx_buffer_size, uint32_t timeout)
+{
+	(void) hspi;
+	(void) reg_addr;
+	(void) reg_addr_size;
+	(void) tx_buffer;
+	(void) tx_buffer_size;
+	(void) timeout;
+	return HAL_OK;
+}
+
+//The driver's read, as user_spi_read in imu_sensor.c.
+static int8_t driver_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+	SPI device = (dev_addr == ACCEL_ID) ? (SPI) &s_accel : (SPI) &s_gyro;
+	if(spi_receive(device, &reg_addr, 1, data, len, 10) != HAL_OK)
+	{
+		return BMI08X_E_COM_FAIL;
+	}
+	return BMI08X_OK;
+}
+
+static int8_t driver_write(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+	(void) dev_addr;
+	(void) reg_addr;
+	(void) data;
+	(void) len;
+	return BMI08X_OK;
+}
+
+static void delay_ms(uint32_t period)
+{
+	(void) period;
+}
+
+static void load_registers(const int16_t *raw)
+{
+	for(int axis = 0; axis < 3; axis++)
+	{
+		s_accel.regs[BMI08X_ACCEL_X_LSB_REG + 2 * axis] = (uint8_t) raw[axis];
+		s_accel.regs[BMI08X_ACCEL_X_LSB_REG + 2 * axis + 1] = (uint8_t) ((uint16_t) raw[axis] >> 8);
+		s_gyro.regs[BMI08X_GYRO_X_LSB_REG + 2 * axis] = (uint8_t) raw[3 + axis];
+		s_gyro.regs[BMI08X_GYRO_X_LSB_REG + 2 * axis + 1] = (uint8_t) ((uint16_t) raw[3 + axis] >> 8);
+	}
+}
+
+static void reset_counts(void)
+{
+	s_accel.transactions = 0;
+	s_gyro.transactions = 0;
+}
+
+static void test_transactions(void)
+{
+	imu_sensor_data sample;
+
+	test_case("one transaction on each chip select");
+	load_registers(s_raw[4]);
+	reset_counts();
+	TEST_CHECK(imu_sample_read(&s_accel, &s_gyro, &sample));
+	TEST_CHECK(s_accel.transactions == 1);
+	TEST_CHECK(s_accel.last_command == (BMI08X_ACCEL_X_LSB_REG | BMI08X_SPI_RD_MASK));
+	TEST_CHECK(s_accel.last_length == 1 + 6);
+	TEST_CHECK(s_gyro.transactions == 1);
+	TEST_CHECK(s_gyro.last_command == (BMI08X_GYRO_X_LSB_REG | BMI08X_SPI_RD_MASK));
+	TEST_CHECK(s_gyro.last_length == 6);
+
+	//The driver calls it replaces take the same two, so nothing else was left to fold in.
+	struct bmi08x_sensor_data accel, gyro;
+	reset_counts();
+	TEST_CHECK(bmi08a_get_data(&accel, &s_dev) == BMI08X_OK);
+	TEST_CHECK(bmi08g_get_data(&gyro, &s_dev) == BMI08X_OK);
+	TEST_CHECK(s_accel.transactions == 1);
+	TEST_CHECK(s_gyro.transactions == 1);
+	printf("  imu_sample_read: %u + %u transactions, %u + %u bytes\n", s_accel.transactions, s_gyro.transactions,
+		   1 + s_accel.last_length, 1 + s_gyro.last_length);
+}
+
+static void test_same_as_driver(void)
+{
+	test_case("the same readings as bmi08a_get_data and bmi08g_get_data");
+	bool same = true;
+	for(uint32_t i = 0; i < sizeof(s_raw) / sizeof(s_raw[0]); i++)
+	{
+		imu_sensor_data sample;
+		struct bmi08x_sensor_data accel, gyro;
+
+		load_registers(s_raw[i]);
+		TEST_CHECK(imu_sample_read(&s_accel, &s_gyro, &sample));
+		TEST_CHECK(bmi08a_get_data(&accel, &s_dev) == BMI08X_OK);
+		TEST_CHECK(bmi08g_get_data(&gyro, &s_dev) == BMI08X_OK);
+
+		same = same && sample.acc_x == accel.x && sample.acc_y == accel.y && sample.acc_z == accel.z;
+		same = same && sample.gyro_x == gyro.x && sample.gyro_y == gyro.y && sample.gyro_z == gyro.z;
+		same = same && sample.acc_x == s_raw[i][0] && sample.acc_z == s_raw[i][2] && sample.gyro_y == s_raw[i][4];
+	}
+	TEST_CHECK(same);
+}
+
+static void test_failed_read(void)
+{
+	imu_sensor_data sample;
+	imu_sensor_data before;
+
+	load_registers(s_raw[5]);
+	TEST_CHECK(imu_sample_read(&s_accel, &s_gyro, &sample));
+	before = sample;
+	load_registers(s_raw[4]);
+
+	test_case("a failed accelerometer read");
+	s_accel.result = HAL_TIMEOUT;
+	reset_counts();
+	TEST_CHECK(!imu_sample_read(&s_accel, &s_gyro, &sample));
+	TEST_CHECK(memcmp(&sample, &before, sizeof(sample)) == 0);
+	TEST_CHECK(s_gyro.transactions == 0);
+	s_accel.result = HAL_OK;
+
+	test_case("a failed gyroscope read");
+	s_gyro.result = HAL_ERROR;
+	TEST_CHECK(!imu_sample_read(&s_accel, &s_gyro, &sample));
+	TEST_CHECK(memcmp(&sample, &before, sizeof(sample)) == 0);
+	s_gyro.result = HAL_OK;
+}
+
+int main(void)
+{
+	s_accel.dummy_byte = true;
+
+	//Set up as imu_sensor.c and bmi08a_init do for SPI.
+	s_dev.accel_id = ACCEL_ID;
+	s_dev.gyro_id = GYRO_ID;
+	s_dev.intf = BMI08X_SPI_INTF;
+	s_dev.dummy_byte = 1;
+	s_dev.read = driver_read;
+	s_dev.write = driver_write;
+	s_dev.delay_ms = delay_ms;
+
+	test_transactions();
+	test_same_as_driver();
+	test_failed_read();
+
+	return test_summary("test_imu_sample");
+}
@@ -0,0 +1,524 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the log encoder: logs are built with log_encoder_append and log_encoder_set_policy the way the
+//  controller builds them, decoded with the ground station parser, and every row is compared with what was logged.
+//  Covers full and reduced precision, channels left out, policy changes in the middle of a page, and records that
+//  do not fit the page they were started on. Also that a damaged page fails log_encoder_verify and is skipped by the
+//  parser, and that a sequence number out of order is counted as a gap.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utilities/log_encoder.h"
+#include "utilities/log_rate.h"
+#include "log_decode.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define MAX_RECORDS			8000
+#define MAX_PAGES			2000
+#define PARSER_THREADS		4			//More than one, so the parser also has to join its chunks up.
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+static log_encoder s_encoder;
+static log_policy s_policy;
+static uint8_t s_log[(MAX_PAGES + 1) * LOG_PAGE_SIZE];
+static uint32_t s_pages;
+static uint32_t s_phase_pages[CONFIG_LOG_PHASES];
+
+//The data records logged and the policy each was logged under. Profile records are not kept, they have no row.
+static log_record s_records[MAX_RECORDS];
+static log_policy s_policies[MAX_RECORDS];
+static uint32_t s_count;
+static uint32_t s_profiles;
+
+static log_decode_row s_rows[MAX_RECORDS];
+static uint64_t s_random = 0x2545F4914F6CDD1DULL;
+
+
+static uint32_t random_next(void)
+{
+	s_random ^= s_random >> 12;
+	s_random ^= s_random << 25;
+	s_random ^= s_random >> 27;
+	return (uint32_t) ((s_random * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/**
+ * @brief A random value in [-range, range].
+ */
+static int32_t random_step(int32_t range)
+{
+	return (int32_t) (random_next() % (uint32_t) (2 * range + 1)) - range;
+}
+
+/**
+ * @brief Seals a page the encoder finished and puts it after the others, the way the controller numbers its pages.
+ */
+static void store_page(const uint8_t *page)
+{
+	if(!TEST_CHECK(s_pages < MAX_PAGES))
+	{
+		return;
+	}
+	s_pages++;
+	uint8_t *stored = &s_log[s_pages * LOG_PAGE_SIZE];
+	memcpy(stored, page, LOG_PAGE_SIZE);
+	log_encoder_seal(stored, s_pages);
+	TEST_CHECK(stored[LOG_PAGE_COUNT] > 0);
+	if(stored[LOG_PAGE_PHASE] < CONFIG_LOG_PHASES)
+	{
+		s_phase_pages[stored[LOG_PAGE_PHASE]]++;
+	}
+}
+
+static void start_log(uint8_t phase, uint8_t channels, uint8_t precision)
+{
+	configuration_data_t configuration;
+	memset(&configuration, 0, sizeof(configuration));
+	log_encoder_superblock(&configuration, s_log);
+	memset(&s_log[LOG_PAGE_SIZE], 0xFF, sizeof(s_log) - LOG_PAGE_SIZE);
+	s_pages = 0;
+	s_count = 0;
+	s_profiles = 0;
+	memset(s_phase_pages, 0, sizeof(s_phase_pages));
+
+	s_policy = (log_policy) {phase, channels, precision};
+	log_encoder_init(&s_encoder, &s_policy);
+}
+
+static void set_policy(uint8_t phase, uint8_t channels, uint8_t precision)
+{
+	uint8_t page[LOG_PAGE_SIZE];
+	s_policy = (log_policy) {phase, channels, precision};
+	if(log_encoder_set_policy(&s_encoder, &s_policy, page))
+	{
+		store_page(page);
+	}
+}
+
+static void append(const log_record *record)
+{
+	uint8_t page[LOG_PAGE_SIZE];
+	if(log_encoder_append(&s_encoder, record, page))
+	{
+		store_page(page);
+	}
+
+	if(record->types & LOG_RECORD_PROFILE)
+	{
+		s_profiles++;
+	}else if(TEST_CHECK(s_count < MAX_RECORDS))
+	{
+		s_records[s_count] = *record;
+		s_policies[s_count] = s_policy;
+		s_count++;
+	}
+}
+
+static void finish_log(void)
+{
+	uint8_t page[LOG_PAGE_SIZE];
+	if(log_encoder_flush(&s_encoder, page))
+	{
+		store_page(page);
+	}
+}
+
+/**
+ * @brief What the parser gives back for a value logged with bits low bits dropped: the nearest multiple of 1 << bits,
+ * halves rounded up.
+ */
+static int64_t rounded(int64_t value, uint8_t bits)
+{
+	return (int64_t) floor((double) value / (1 << bits) + 0.5) * (1 << bits);
+}
+
+static int16_t rounded16(int16_t value, uint8_t bits)
+{
+	int64_t result = rounded(value, bits);
+	return (int16_t) ((result > INT16_MAX) ? INT16_MAX : result);
+}
+
+/**
+ * @brief Decodes the log and checks every row against the records logged.
+ * @return The number of rows that differ.
+ */
+static uint32_t check_log(log_decode_stats *stats)
+{
+	int rows = log_decode(s_log, (s_pages + 1) * LOG_PAGE_SIZE, PARSER_THREADS, s_rows, MAX_RECORDS, stats);
+	TEST_CHECK(rows == (int) s_count);
+	TEST_CHECK(stats->pages == (int) s_pages);
+	TEST_CHECK(stats->records == (int) s_count);
+	TEST_CHECK(stats->profiles == (int) s_profiles);
+	for(int phase = 0; phase < CONFIG_LOG_PHASES; phase++)
+	{
+		TEST_CHECK(stats->phase_pages[phase] == (int) s_phase_pages[phase]);
+	}
+	if(rows != (int) s_count)
+	{
+		return s_count;
+	}
+
+	//Like the parser, a row repeats the last value of every channel it does not hold.
+	log_decode_row expected;
+	memset(&expected, 0, sizeof(expected));
+	uint32_t wrong = 0;
+	for(uint32_t i = 0; i < s_count; i++)
+	{
+		const log_record *record = &s_records[i];
+		uint8_t channels = s_policies[i].channels;
+		uint8_t imu_bits = LOG_PRECISION_IMU(s_policies[i].precision);
+		uint8_t baro_bits = LOG_PRECISION_BARO(s_policies[i].precision);
+
+		//The microsecond clock wraps, and the parser carries on counting past it.
+		if(i > 0)
+		{
+			expected.time_us += (int32_t) (record->time_us - s_records[i - 1].time_us);
+		}
+		expected.events |= record->events;
+		for(int j = 0; j < 3; j++)
+		{
+			if((record->types & LOG_RECORD_IMU) && (channels & LOG_CHANNEL_ACC))
+			{
+				expected.acc[j] = rounded16(record->acc[j], imu_bits);
+			}
+			if((record->types & LOG_RECORD_IMU) && (channels & LOG_CHANNEL_GYRO))
+			{
+				expected.gyro[j] = rounded16(record->gyro[j], imu_bits);
+			}
+		}
+		if((record->types & LOG_RECORD_BARO) && (channels & LOG_CHANNEL_PRESSURE))
+		{
+			expected.pressure = (uint32_t) rounded(record->pressure, baro_bits);
+		}
+		if((record->types & LOG_RECORD_BARO) && (channels & LOG_CHANNEL_TEMPERATURE))
+		{
+			expected.temperature = (int32_t) rounded(record->temperature, baro_bits);
+		}
+		if((record->types & LOG_RECORD_BARO) && (channels & LOG_CHANNEL_ALTITUDE))
+		{
+			expected.altitude_cm = (int32_t) rounded(record->altitude_cm, baro_bits);
+		}
+
+		const log_decode_row *row = &s_rows[i];
+		bool same = row->time_us == expected.time_us && row->pressure == expected.pressure
+				&& row->temperature == expected.temperature && row->altitude_cm == expected.altitude_cm
+				&& row->events == expected.events && memcmp(row->acc, expected.acc, sizeof(row->acc)) == 0
+				&& memcmp(row->gyro, expected.gyro, sizeof(row->gyro)) == 0;
+		if(!same && wrong++ == 0)
+		{
+			fprintf(stderr, "  first wrong row %u: time %llu acc %d %d %d pressure %u altitude %d, expected time %llu acc %d %d %d pressure %u altitude %d\n",
+					i, (unsigned long long) row->time_us, row->acc[0], row->acc[1], row->acc[2], row->pressure,
+					row->altitude_cm, (unsigned long long) expected.time_us, expected.acc[0], expected.acc[1],
+					expected.acc[2], expected.pressure, expected.altitude_cm);
+		}
+	}
+	return wrong;
+}
+
+/**
+ * @brief Logs count records of a flight: the IMU in every record, the barometer in every fourth, at about 100 Hz.
+ * Each value moves by up to step from the record before, and the altitude climbs.
+ */
+static void log_flight(uint32_t count, int32_t step)
+{
+	static log_record record = {
+		.time_us = 4000000000UL, .acc = {2730, -12, 40}, .gyro = {3, -7, 1}, .pressure = 10132500, .temperature = 2150
+	};
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		record.time_us += 10000 + random_step(40);
+		record.types = LOG_RECORD_IMU | ((i % 4 == 0) ? LOG_RECORD_BARO : 0);
+		record.events = (random_next() % 500 == 0) ? (uint8_t) (1 << (random_next() % 8)) : 0;
+		for(int j = 0; j < 3; j++)
+		{
+			record.acc[j] = (int16_t) (record.acc[j] + random_step(step));
+			record.gyro[j] = (int16_t) (record.gyro[j] + random_step(step));
+		}
+		record.pressure -= 30 + random_step(step);
+		record.temperature += random_step(step / 4 + 1);
+		record.altitude_cm += 250 + random_step(step);
+		append(&record);
+	}
+}
+
+static void test_full_precision(void)
+{
+	test_case("full precision round trip");
+	log_decode_stats stats;
+	start_log(LOG_PHASE_ASCENT, LOG_CHANNELS_ALL, LOG_PRECISION(0, 0));
+	log_flight(2000, 60);
+
+	//Timings go in between, and must not upset the time or the values of the records after them.
+	log_record profile = {.time_us = s_encoder.previous.time_us + 5000, .types = LOG_RECORD_PROFILE,
+						  .profile_id = LOG_PROFILE_SPAN + 3, .profile = {10, 200, 300, 400, 5000}};
+	append(&profile);
+	profile.profile_id = LOG_PROFILE_GAUGE + 1;
+	append(&profile);
+	log_flight(2000, 60);
+	finish_log();
+
+	TEST_CHECK(check_log(&stats) == 0);
+	TEST_CHECK(stats.bad_pages == 0);
+	TEST_CHECK(stats.gaps == 0);
+	printf("  %u records in %u pages, %.1f bytes a record\n", s_count, s_pages,
+		   (double) s_pages * LOG_PAGE_SIZE / s_count);
+}
+
+static void test_precision(void)
+{
+	test_case("reduced precision");
+	log_decode_stats stats;
+	start_log(LOG_PHASE_MAIN, LOG_CHANNELS_ALL, LOG_PRECISION(3, 4));
+	log_flight(1500, 200);
+
+	//Halves round up, and the largest values stay in range.
+	const int16_t edges[] = {4, -4, 12, -12, 3, -5, 20, -20, INT16_MAX, INT16_MIN, INT16_MAX - 3, INT16_MIN + 4};
+	for(uint32_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+	{
+		log_record record = {.time_us = s_records[s_count - 1].time_us + 10000, .types = LOG_RECORD_IMU | LOG_RECORD_BARO,
+							 .acc = {edges[i], edges[i], edges[i]}, .gyro = {edges[i], 0, 0},
+							 .pressure = 10132500 + edges[i], .temperature = edges[i], .altitude_cm = edges[i]};
+		append(&record);
+	}
+	finish_log();
+	TEST_CHECK(check_log(&stats) == 0);
+
+	const log_decode_row *edge = &s_rows[s_count - sizeof(edges) / sizeof(edges[0])];
+	TEST_CHECK(edge[0].acc[0] == 8 && edge[1].acc[0] == 0 && edge[2].acc[0] == 16 && edge[3].acc[0] == -8);
+	TEST_CHECK(edge[4].acc[0] == 0 && edge[5].acc[0] == -8);
+	TEST_CHECK(edge[2].temperature == 16 && edge[3].temperature == -16);
+	TEST_CHECK(edge[6].temperature == 16 && edge[7].temperature == -16);
+	TEST_CHECK(edge[8].acc[0] == INT16_MAX && edge[9].acc[0] == INT16_MIN);
+	TEST_CHECK(edge[10].acc[0] == INT16_MAX && edge[11].acc[0] == INT16_MIN + 8);
+
+	//Every value is within half a step of what was logged.
+	int32_t worst_imu = 0;
+	int32_t worst_baro = 0;
+	for(uint32_t i = 0; i < s_count - sizeof(edges) / sizeof(edges[0]); i++)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			int32_t error = abs(s_rows[i].acc[j] - s_records[i].acc[j]);
+			worst_imu = (error > worst_imu) ? error : worst_imu;
+		}
+		if(s_records[i].types & LOG_RECORD_BARO)
+		{
+			int32_t error = abs(s_rows[i].altitude_cm - s_records[i].altitude_cm);
+			worst_baro = (error > worst_baro) ? error : worst_baro;
+		}
+	}
+	TEST_CHECK(worst_imu <= 4);
+	TEST_CHECK(worst_baro <= 8);
+}
+
+static void test_policy_changes(void)
+{
+	//The phases of a flight, each with the channels and precision of the default configuration, changing in the
+	//middle of a page.
+	test_case("policy changes");
+	const uint8_t channels[CONFIG_LOG_PHASES] = LOG_CHANNELS;
+	const uint8_t precision[CONFIG_LOG_PHASES] = LOG_PRECISIONS;
+	log_decode_stats stats;
+
+	start_log(LOG_PHASE_PAD, channels[LOG_PHASE_PAD], precision[LOG_PHASE_PAD]);
+	for(uint8_t phase = LOG_PHASE_PAD; phase < CONFIG_LOG_PHASES; phase++)
+	{
+		set_policy(phase, channels[phase], precision[phase]);
+		log_flight(333, 60);
+	}
+
+	//Setting a policy with nothing logged since the last one gives no empty page.
+	uint32_t pages = s_pages;
+	set_policy(LOG_PHASE_LANDED, LOG_CHANNELS_BARO, LOG_PRECISION(0, 4));
+	uint32_t after_first = s_pages;
+	set_policy(LOG_PHASE_LANDED, LOG_CHANNELS_ALL, LOG_PRECISION(0, 0));
+	TEST_CHECK(after_first == pages + 1);
+	TEST_CHECK(s_pages == after_first);
+	log_flight(10, 60);
+	finish_log();
+
+	TEST_CHECK(check_log(&stats) == 0);
+	TEST_CHECK(stats.bad_pages == 0);
+	for(uint8_t phase = LOG_PHASE_PAD; phase < CONFIG_LOG_PHASES; phase++)
+	{
+		TEST_CHECK(stats.phase_pages[phase] > 0);
+	}
+}
+
+static void test_page_full(void)
+{
+	//Values that jump around take most of LOG_RECORD_MAX_SIZE, so pages fill up after a few records and most records
+	//have to be encoded again as the keyframe of a new page.
+	test_case("records that do not fit");
+	log_decode_stats stats;
+	start_log(LOG_PHASE_ASCENT, LOG_CHANNELS_ALL, LOG_PRECISION(0, 0));
+	log_record record = {.time_us = 1000};
+	for(uint32_t i = 0; i < 600; i++)
+	{
+		bool high = (i % 2) == 0;
+		record.time_us += (i % 7 == 0) ? 0x7FFFFFFF : 10000;	//Wraps the clock many times over.
+		record.types = LOG_RECORD_IMU | LOG_RECORD_BARO;
+		record.events = (i % 3 == 0) ? 0x80 : 0;
+		for(int j = 0; j < 3; j++)
+		{
+			record.acc[j] = high ? INT16_MAX : INT16_MIN;
+			record.gyro[j] = (int16_t) random_next();
+		}
+		record.pressure = high ? 0x7FFFFFFF : 0;
+		record.temperature = high ? INT32_MAX : INT32_MIN;
+		record.altitude_cm = random_step(1000000);	//The parser writes the altitude as a float, good to the cm up to here.
+		append(&record);
+	}
+	finish_log();
+
+	printf("  600 records in %u pages\n", s_pages);
+	TEST_CHECK(s_pages >= 600 / 8);
+	TEST_CHECK(check_log(&stats) == 0);
+	TEST_CHECK(stats.bad_pages == 0);
+}
+
+static void test_record_count(void)
+{
+	//A record is at least two bytes, so a page holds at most 121 of them and the count byte can not overflow through
+	//appending. Set the count to its limit to see that the next record still starts a new page rather than wrap it.
+	test_case("record count limit");
+	uint8_t page[LOG_PAGE_SIZE];
+	log_policy policy = {LOG_PHASE_ASCENT, LOG_CHANNELS_ALL, LOG_PRECISION(0, 0)};
+	log_record record = {.time_us = 1000, .types = LOG_RECORD_IMU};
+
+	log_encoder_init(&s_encoder, &policy);
+	TEST_CHECK(!log_encoder_append(&s_encoder, &record, page));
+	s_encoder.page[LOG_PAGE_COUNT] = UINT8_MAX;
+	record.time_us += 10000;
+	TEST_CHECK(log_encoder_append(&s_encoder, &record, page));
+	TEST_CHECK(page[LOG_PAGE_COUNT] == UINT8_MAX);
+	TEST_CHECK(s_encoder.page[LOG_PAGE_COUNT] == 1);
+	TEST_CHECK(s_encoder.length > LOG_PAGE_HEADER_SIZE);
+}
+
+/**
+ * @brief Logs a short flight at full precision for the tests that damage it.
+ */
+static void log_short_flight(void)
+{
+	start_log(LOG_PHASE_ASCENT, LOG_CHANNELS_ALL, LOG_PRECISION(0, 0));
+	log_flight(1000, 60);
+	finish_log();
+}
+
+static void test_verify(void)
+{
+	test_case("sealed pages verify");
+	log_decode_stats stats;
+	log_short_flight();
+	TEST_CHECK(log_encoder_verify(s_log));
+	uint32_t failed = 0;
+	for(uint32_t page = 1; page <= s_pages; page++)
+	{
+		failed += log_encoder_verify(&s_log[page * LOG_PAGE_SIZE]) ? 0 : 1;
+	}
+	TEST_CHECK(failed == 0);
+
+	//Any one bit flipped, in the records, the header or the CRC itself, fails the page.
+	test_case("a flipped bit fails the page");
+	uint8_t *page = &s_log[3 * LOG_PAGE_SIZE];
+	uint32_t passed = 0;
+	for(uint32_t byte = 0; byte < LOG_PAGE_SIZE; byte++)
+	{
+		for(uint8_t bit = 0; bit < 8; bit++)
+		{
+			page[byte] ^= (uint8_t) (1 << bit);
+			passed += log_encoder_verify(page) ? 1 : 0;
+			page[byte] ^= (uint8_t) (1 << bit);
+		}
+	}
+	TEST_CHECK(passed == 0);
+	TEST_CHECK(log_encoder_verify(page));
+
+	test_case("a flipped bit fails the superblock");
+	s_log[5] ^= 0x01;
+	TEST_CHECK(!log_encoder_verify(s_log));
+	s_log[5] ^= 0x01;
+
+	//The parser skips the page and carries on with the next, which then does not follow the last good one.
+	test_case("the parser skips a corrupted page");
+	uint8_t lost = page[LOG_PAGE_COUNT];
+	page[LOG_PAGE_FIRST_RECORD + 4] ^= 0x10;
+	TEST_CHECK(log_decode(s_log, (s_pages + 1) * LOG_PAGE_SIZE, PARSER_THREADS, s_rows, MAX_RECORDS, &stats) == (int) (s_count - lost));
+	TEST_CHECK(stats.pages == (int) s_pages);
+	TEST_CHECK(stats.bad_pages == 1);
+	TEST_CHECK(stats.gaps == 1);
+	TEST_CHECK(stats.records == (int) (s_count - lost));
+}
+
+/**
+ * @brief Seals the pages from first on again, with their sequence numbers moved by offset.
+ */
+static void renumber(uint32_t first, int32_t offset)
+{
+	for(uint32_t page = first; page <= s_pages; page++)
+	{
+		log_encoder_seal(&s_log[page * LOG_PAGE_SIZE], page + offset);
+	}
+}
+
+static void test_sequence(void)
+{
+	//A page missing from the log: every record that was written is still there.
+	test_case("a skipped sequence number is a gap");
+	log_decode_stats stats;
+	log_short_flight();
+	renumber(10, 1);
+	TEST_CHECK(log_decode(s_log, (s_pages + 1) * LOG_PAGE_SIZE, PARSER_THREADS, s_rows, MAX_RECORDS, &stats) == (int) s_count);
+	TEST_CHECK(stats.bad_pages == 0);
+	TEST_CHECK(stats.gaps == 1);
+
+	test_case("a repeated sequence number is a gap");
+	renumber(10, -1);
+	TEST_CHECK(log_decode(s_log, (s_pages + 1) * LOG_PAGE_SIZE, PARSER_THREADS, s_rows, MAX_RECORDS, &stats) == (int) s_count);
+	TEST_CHECK(stats.bad_pages == 0);
+	TEST_CHECK(stats.gaps == 1);
+
+	//Pages in the order they were written have no gaps, whichever parser thread decodes them.
+	test_case("no gaps in order");
+	renumber(1, 0);
+	TEST_CHECK(check_log(&stats) == 0);
+	TEST_CHECK(stats.gaps == 0);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_full_precision();
+	test_precision();
+	test_policy_changes();
+	test_page_full();
+	test_record_count();
+	test_verify();
+	test_sequence();
+	return test_summary("test_log_encoder");
+}
@@ -0,0 +1,127 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the table-driven altitude kernel in utilities/math.c against the barometric formula worked out in
+//  double precision: the table itself, the interpolation between its nodes, the powf fallback outside it, and the
+//  altitude over the whole flight envelope.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+
+#include "utilities/math.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define EXPONENT				(1 / 5.257)
+#define TABLE_MIN_PA			20000.0
+#define TABLE_MAX_PA			120000.0
+#define TABLE_STEP_PA			1000.0
+
+#define MAX_RELATIVE_ERROR		3e-7	//As promised in math.h.
+#define MAX_ALTITUDE_ERROR_M	0.02
+#define SWEEP_STEP_PA			0.5		//Hits every part of every interval, including the nodes.
+
+
+static double reference_power(double pressure)
+{
+	return pow(pressure, -EXPONENT);
+}
+
+static double reference_altitude(double pressure, double temperature, double ref_pres, double ref_alt)
+{
+	return (pow(ref_pres / pressure, EXPONENT) - 1) * (temperature + 273.15) / 0.0065 + ref_alt;
+}
+
+static void test_nodes(void)
+{
+	test_case("table nodes");
+	for(double pressure = TABLE_MIN_PA; pressure <= TABLE_MAX_PA; pressure += TABLE_STEP_PA)
+	{
+		double error = fabs(math_pressure_power((float) pressure) / reference_power(pressure) - 1);
+		TEST_CHECK(error < MAX_RELATIVE_ERROR);
+	}
+}
+
+static void test_interpolation(void)
+{
+	test_case("between the nodes");
+	double worst = 0;
+	for(double pressure = TABLE_MIN_PA; pressure < TABLE_MAX_PA; pressure += SWEEP_STEP_PA)
+	{
+		//The kernel only sees the pressure as a float, so that is what it is held to.
+		float input = (float) pressure;
+		double error = fabs(math_pressure_power(input) / reference_power(input) - 1);
+		worst = (error > worst) ? error : worst;
+	}
+	printf("  worst relative error of math_pressure_power: %.2e\n", worst);
+	TEST_CHECK(worst < MAX_RELATIVE_ERROR);
+}
+
+static void test_fallback(void)
+{
+	//Outside the table the kernel is powf itself.
+	test_case("outside the table");
+	const float outside[] = {1000.0F, 19999.0F, 120000.0F, 120500.0F, 200000.0F};
+	for(unsigned i = 0; i < sizeof(outside) / sizeof(outside[0]); i++)
+	{
+		TEST_CHECK(math_pressure_power(outside[i]) == powf(outside[i], -(1 / 5.257F)));
+	}
+	TEST_CHECK(isnan(math_pressure_power(NAN)));
+}
+
+static void test_altitude(void)
+{
+	test_case("altitude");
+	const float temperatures[] = {-20.0F, 15.0F, 40.0F};
+	const float ref_pressures[] = {98000.0F, 101325.0F, 104000.0F};
+	const float ref_altitudes[] = {0.0F, 230.0F};
+	double worst = 0;
+
+	for(unsigned t = 0; t < sizeof(temperatures) / sizeof(temperatures[0]); t++)
+	{
+		for(unsigned r = 0; r < sizeof(ref_pressures) / sizeof(ref_pressures[0]); r++)
+		{
+			for(unsigned a = 0; a < sizeof(ref_altitudes) / sizeof(ref_altitudes[0]); a++)
+			{
+				for(double pressure = TABLE_MIN_PA; pressure < TABLE_MAX_PA; pressure += 7.25)
+				{
+					float input = (float) pressure;
+					double error = fabs(math_fast_altitude(input, temperatures[t], ref_pressures[r], ref_altitudes[a]) -
+										reference_altitude(input, temperatures[t], ref_pressures[r], ref_altitudes[a]));
+					worst = (error > worst) ? error : worst;
+				}
+			}
+		}
+	}
+	printf("  worst altitude error of math_fast_altitude: %.4f m\n", worst);
+	TEST_CHECK(worst < MAX_ALTITUDE_ERROR_M);
+
+	//At the reference pressure the altitude is the reference altitude.
+	TEST_CHECK(fabsf(math_fast_altitude(101325.0F, 15.0F, 101325.0F, 230.0F) - 230.0F) < 1e-3F);
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	test_nodes();
+	test_interpolation();
+	test_fallback();
+	test_altitude();
+	return test_summary("test_math");
+}
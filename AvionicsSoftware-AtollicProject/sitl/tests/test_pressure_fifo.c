@@ -0,0 +1,297 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the pressure task's FIFO parsing: BMP388 FIFO bursts, read with bmp3_get_fifo_data from a register
+//  file and parsed with pressure_fifo_parse, have to give exactly the samples single-shot reads of the same raw bytes
+//  give. The bursts are ones the pressure task read from the BMP388 model in a SITL flight, on the pad and near
+//  apogee, and the same with a frame that arrived while the burst was read, a config change frame and a frame limit.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "tasks/sensors/pressure_fifo.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define FRAME_BYTES				7			//Header, temperature and pressure.
+#define TIME_FRAME_BYTES		4
+#define MAX_FRAMES				32			//PRESSURE_FIFO_MAX_FRAMES.
+#define MAX_STREAM				128
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//The calibration of the BMP388 model, as its NVM registers from 0x31 hold it.
+static const uint8_t s_calibration[BMP3_CALIB_DATA_LEN] =
+{
+	0x35, 0x6C, 0x18, 0x4B, 0xF9, 0xF4, 0xFB, 0xBD, 0xF3, 0x23, 0x00, 0x41, 0x62, 0x9B, 0x78, 0x03, 0xF8, 0x22, 0x3F,
+	0x09, 0xC4,
+};
+
+//On the pad: eight frames, the watermark, and the sensor time frame the chip sends once the FIFO is empty.
+static const uint8_t s_pad_burst[] =
+{
+	0x94, 0xC5, 0x64, 0x75, 0x5A, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x5D, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x63, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x68, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x6A, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x62, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x5C, 0x57, 0x61,
+	0x94, 0xC5, 0x64, 0x75, 0x57, 0x57, 0x61,
+	0xA0, 0x00, 0xA2, 0x04,
+};
+
+//Near 12 km, after a wakeup that came late: fourteen frames.
+static const uint8_t s_apogee_burst[] =
+{
+	0x94, 0xEA, 0x5E, 0x73, 0xC1, 0xBC, 0xA4,
+	0x94, 0xEA, 0x5E, 0x73, 0x9F, 0xBC, 0xA4,
+	0x94, 0xEA, 0x5E, 0x73, 0x6D, 0xBC, 0xA4,
+	0x94, 0xBB, 0x5C, 0x73, 0x06, 0xBC, 0xA4,
+	0x94, 0xBB, 0x5C, 0x73, 0xDB, 0xBB, 0xA4,
+	0x94, 0xBB, 0x5C, 0x73, 0xA5, 0xBB, 0xA4,
+	0x94, 0xBB, 0x5C, 0x73, 0x6E, 0xBB, 0xA4,
+	0x94, 0x8B, 0x5A, 0x73, 0x02, 0xBB, 0xA4,
+	0x94, 0x8B, 0x5A, 0x73, 0xD9, 0xBA, 0xA4,
+	0x94, 0x8B, 0x5A, 0x73, 0xAE, 0xBA, 0xA4,
+	0x94, 0x8B, 0x5A, 0x73, 0x7D, 0xBA, 0xA4,
+	0x94, 0x8B, 0x5A, 0x73, 0x55, 0xBA, 0xA4,
+	0x94, 0x8B, 0x5A, 0x73, 0x24, 0xBA, 0xA4,
+	0x94, 0x5C, 0x58, 0x73, 0xBA, 0xB9, 0xA4,
+	0xA0, 0x00, 0x98, 0x1C,
+};
+
+//The register file of the chip, and what the FIFO data register gives.
+static uint8_t s_regs[128];
+static uint8_t s_stream[MAX_STREAM];
+static struct bmp3_dev s_dev;
+static struct bmp3_fifo s_fifo;
+
+
+static int8_t chip_read(uint8_t dev_id, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+	(void) dev_id;
+	uint8_t address = reg_addr & 0x7F;
+
+	//The first byte of an SPI read is the dummy one.
+	data[0] = 0xFF;
+	for(uint16_t i = 1; i < len; i++)
+	{
+		if(address == BMP3_FIFO_DATA_ADDR)
+		{
+			data[i] = (i - 1 < MAX_STREAM) ? s_stream[i - 1] : 0x80;
+		}else
+		{
+			data[i] = s_regs[(address + i - 1) & 0x7F];
+		}
+	}
+	return BMP3_OK;
+}
+
+static int8_t chip_write(uint8_t dev_id, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+	(void) dev_id;
+	(void) reg_addr;
+	(void) data;
+	(void) len;
+	return BMP3_OK;
+}
+
+static void delay_ms(uint32_t period)
+{
+	(void) period;
+}
+
+/**
+ * @brief Loads the FIFO: fifo_length is what the length register says, stream what a burst read of the data
+ * register clocks out.
+ */
+static void load_fifo(uint16_t fifo_length, const uint8_t *stream, uint32_t stream_length)
+{
+	memset(s_stream, 0x80, sizeof(s_stream));
+	memcpy(s_stream, stream, stream_length);
+	s_regs[BMP3_FIFO_LENGTH_ADDR] = (uint8_t) fifo_length;
+	s_regs[BMP3_FIFO_LENGTH_ADDR + 1] = (uint8_t) (fifo_length >> 8);
+}
+
+/**
+ * @brief Reads and parses the FIFO as the pressure task does.
+ */
+static uint8_t read_burst(struct bmp3_data *frames, uint8_t max_frames, uint32_t *sensor_time)
+{
+	uint8_t count = 0;
+	TEST_CHECK(bmp3_get_fifo_data(&s_dev) == BMP3_OK);
+	TEST_CHECK(pressure_fifo_parse(&s_dev, frames, max_frames, &count, sensor_time) == BMP3_OK);
+	return count;
+}
+
+/**
+ * @brief The single-shot path: the frame's raw bytes in the data registers, pressure first, read back with
+ * bmp3_get_sensor_data.
+ */
+static struct bmp3_data single_shot(const uint8_t *frame)
+{
+	struct bmp3_data data = {0};
+	memcpy(&s_regs[BMP3_DATA_ADDR], &frame[4], 3);
+	memcpy(&s_regs[BMP3_DATA_ADDR + 3], &frame[1], 3);
+	TEST_CHECK(bmp3_get_sensor_data(BMP3_PRESS | BMP3_TEMP, &data, &s_dev) == BMP3_OK);
+	return data;
+}
+
+/**
+ * @brief Checks count frames against single-shot reads of the raw frames that start at raw, one every FRAME_BYTES.
+ */
+static bool same_as_single_shot(const struct bmp3_data *frames, uint8_t count, const uint8_t *raw)
+{
+	bool same = true;
+	for(uint8_t i = 0; i < count; i++)
+	{
+		struct bmp3_data expected = single_shot(&raw[i * FRAME_BYTES]);
+		same = same && frames[i].pressure == expected.pressure && frames[i].temperature == expected.temperature;
+	}
+	return same;
+}
+
+static uint32_t sensor_time_of(const uint8_t *burst, uint32_t length)
+{
+	const uint8_t *frame = &burst[length - TIME_FRAME_BYTES];
+	return frame[1] | (frame[2] << 8) | ((uint32_t) frame[3] << 16);
+}
+
+static void test_recorded(const char *name, const uint8_t *burst, uint32_t length)
+{
+	struct bmp3_data frames[MAX_FRAMES];
+	uint32_t sensor_time;
+	uint8_t expected_count = (length - TIME_FRAME_BYTES) / FRAME_BYTES;
+
+	test_case(name);
+	load_fifo(length - TIME_FRAME_BYTES, burst, length);
+	uint8_t count = read_burst(frames, MAX_FRAMES, &sensor_time);
+	TEST_CHECK(count == expected_count);
+	TEST_CHECK(sensor_time == sensor_time_of(burst, length));
+	TEST_CHECK(same_as_single_shot(frames, count, burst));
+	printf("  %s: %u frames, %.2f to %.2f Pa, sensor time %u\n", name, count, frames[0].pressure / 100.0,
+		   frames[count - 1].pressure / 100.0, sensor_time);
+
+	//In 1/100 Pa and 1/100 C, and inside what the compensation can give.
+	bool plausible = true;
+	for(uint8_t i = 0; i < count; i++)
+	{
+		plausible = plausible && frames[i].pressure > 0 && frames[i].pressure < 12500000;
+		plausible = plausible && frames[i].temperature > -4000 && frames[i].temperature < 8500;
+	}
+	TEST_CHECK(plausible);
+}
+
+static void test_partial_frame(void)
+{
+	uint8_t stream[sizeof(s_pad_burst) + FRAME_BYTES];
+	struct bmp3_data frames[MAX_FRAMES];
+	struct bmp3_data expected[MAX_FRAMES];
+	uint32_t sensor_time;
+	uint32_t data_length = sizeof(s_pad_burst) - TIME_FRAME_BYTES;
+
+	//A ninth frame lands between the length read and the burst, so the four bytes read for the sensor time frame are
+	//the start of it instead.
+	test_case("a frame cut off at the end of the burst");
+	memcpy(stream, s_pad_burst, data_length);
+	memcpy(&stream[data_length], s_pad_burst, FRAME_BYTES);
+	memcpy(&stream[data_length + FRAME_BYTES], &s_pad_burst[data_length], TIME_FRAME_BYTES);
+	load_fifo(data_length, s_pad_burst, sizeof(s_pad_burst));
+	read_burst(expected, MAX_FRAMES, &sensor_time);
+
+	load_fifo(data_length, stream, sizeof(stream));
+	uint8_t count = read_burst(frames, MAX_FRAMES, &sensor_time);
+	TEST_CHECK(count == data_length / FRAME_BYTES);
+	TEST_CHECK(sensor_time == PRESSURE_FIFO_NO_SENSOR_TIME);
+	TEST_CHECK(same_as_single_shot(frames, count, stream));
+	TEST_CHECK(memcmp(frames, expected, count * sizeof(frames[0])) == 0);
+
+	//The chip kept the frame it did not finish sending, and the next burst starts with it.
+	test_case("the cut off frame in the next burst");
+	load_fifo(FRAME_BYTES, &stream[data_length], FRAME_BYTES + TIME_FRAME_BYTES);
+	count = read_burst(frames, MAX_FRAMES, &sensor_time);
+	TEST_CHECK(count == 1);
+	TEST_CHECK(sensor_time == sensor_time_of(s_pad_burst, sizeof(s_pad_burst)));
+	TEST_CHECK(same_as_single_shot(frames, count, &stream[data_length]));
+}
+
+static void test_other_frames(void)
+{
+	uint8_t stream[sizeof(s_pad_burst) + 2];
+	struct bmp3_data frames[MAX_FRAMES];
+	uint32_t sensor_time;
+
+	//A config change frame between two frames is stepped over.
+	test_case("a config change frame");
+	memcpy(stream, s_pad_burst, 3 * FRAME_BYTES);
+	stream[3 * FRAME_BYTES] = 0x48;
+	stream[3 * FRAME_BYTES + 1] = 0x00;
+	memcpy(&stream[3 * FRAME_BYTES + 2], &s_pad_burst[3 * FRAME_BYTES], sizeof(s_pad_burst) - 3 * FRAME_BYTES);
+	load_fifo(sizeof(stream) - TIME_FRAME_BYTES, stream, sizeof(stream));
+	uint8_t count = read_burst(frames, MAX_FRAMES, &sensor_time);
+	TEST_CHECK(count == 8);
+	TEST_CHECK(sensor_time == sensor_time_of(s_pad_burst, sizeof(s_pad_burst)));
+	TEST_CHECK(same_as_single_shot(frames, 3, s_pad_burst));
+	TEST_CHECK(same_as_single_shot(&frames[3], count - 3, &s_pad_burst[3 * FRAME_BYTES]));
+
+	//Stopping at the frame limit leaves the sensor time frame unread.
+	test_case("the frame limit");
+	load_fifo(sizeof(s_apogee_burst) - TIME_FRAME_BYTES, s_apogee_burst, sizeof(s_apogee_burst));
+	count = read_burst(frames, 4, &sensor_time);
+	TEST_CHECK(count == 4);
+	TEST_CHECK(sensor_time == PRESSURE_FIFO_NO_SENSOR_TIME);
+	TEST_CHECK(same_as_single_shot(frames, count, s_apogee_burst));
+
+	test_case("an empty FIFO");
+	load_fifo(0, &s_pad_burst[sizeof(s_pad_burst) - TIME_FRAME_BYTES], TIME_FRAME_BYTES);
+	count = read_burst(frames, MAX_FRAMES, &sensor_time);
+	TEST_CHECK(count == 0);
+	TEST_CHECK(sensor_time == sensor_time_of(s_pad_burst, sizeof(s_pad_burst)));
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	s_regs[BMP3_CHIP_ID_ADDR] = BMP3_CHIP_ID;
+	s_regs[BMP3_SENS_STATUS_REG_ADDR] = BMP3_CMD_RDY;
+	memcpy(&s_regs[BMP3_CALIB_DATA_ADDR], s_calibration, sizeof(s_calibration));
+
+	//Set up as pressure_sensor.c does.
+	s_dev.dev_id = 0;
+	s_dev.intf = BMP3_SPI_INTF;
+	s_dev.read = chip_read;
+	s_dev.write = chip_write;
+	s_dev.delay_ms = delay_ms;
+	test_case("init");
+	TEST_CHECK(bmp3_init(&s_dev) == BMP3_OK);
+	s_dev.fifo = &s_fifo;
+	s_fifo.settings.mode = BMP3_ENABLE;
+	s_fifo.settings.time_en = BMP3_ENABLE;
+	s_fifo.settings.press_en = BMP3_ENABLE;
+	s_fifo.settings.temp_en = BMP3_ENABLE;
+
+	test_recorded("recorded on the pad", s_pad_burst, sizeof(s_pad_burst));
+	test_recorded("recorded high in the flight", s_apogee_burst, sizeof(s_apogee_burst));
+	test_partial_frame();
+	test_other_frames();
+
+	return test_summary("test_pressure_fifo");
+}
@@ -0,0 +1,98 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Runs the body of a host test as a task on the simulated board. Stands in for sitl_main.c and the parts of main.c
+//  the scheduler needs, so a test links against the firmware and the models without the flight.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define TEST_MAX_TASKS		4		//Besides the body.
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int sim_verbose;
+
+static void (*s_body)(void);
+static uint32_t s_task_count;
+
+//The port runs every task on a host stack of its own, so these only have to exist.
+static StaticTask_t s_controls[TEST_MAX_TASKS + 1];
+static StackType_t s_stacks[TEST_MAX_TASKS + 1][configMINIMAL_STACK_SIZE];
+static StaticTask_t s_idle_control;
+static StackType_t s_idle_stack[configMINIMAL_STACK_SIZE];
+
+
+static void body_task(void const *params)
+{
+	(void) params;
+	s_body();
+	vTaskEndScheduler();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void test_run_task(void (*body)(void), double max_time_s)
+{
+	sim_options options = {0};
+	options.max_time_s = max_time_s;
+
+	if(!sim_flash_init(NULL))
+	{
+		exit(EXIT_FAILURE);
+	}
+	sim_board_init(&options);
+
+	s_body = body;
+	test_create_task(body_task, NULL, osPriorityNormal);
+	vTaskStartScheduler();
+}
+
+osThreadId test_create_task(os_pthread function, void *parameters, osPriority priority)
+{
+	configASSERT(s_task_count < TEST_MAX_TASKS + 1);
+
+	uint32_t index = s_task_count++;
+	osThreadStaticDef(test, function, priority, 1, configMINIMAL_STACK_SIZE, s_stacks[index], &s_controls[index]);
+	osThreadId handle = osThreadCreate(osThread(test), parameters);
+	configASSERT(handle != NULL);
+	return handle;
+}
+
+void sim_finish(const char *reason)
+{
+	//Only the board's time limit ends a test early.
+	fprintf(stderr, "test: the simulated clock reached the %s after %.3f s, something never finished\n", reason,
+			ulPortSimTime() / 1e6);
+	exit(EXIT_FAILURE);
+}
+
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer,
+								   uint32_t *pulIdleTaskStackSize)
+{
+	*ppxIdleTaskTCBBuffer = &s_idle_control;
+	*ppxIdleTaskStackBuffer = s_idle_stack;
+	*pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
@@ -0,0 +1,47 @@
+#ifndef SITL_TEST_RTOS_H
+#define SITL_TEST_RTOS_H
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  For the host tests of firmware tasks: runs a test body as a task on the simulated board, with the SITL port and
+//  the flash and SPI models, and nothing else running unless the test starts it.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "cmsis_os.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Starts the scheduler with body as the only task, on a board with an erased flash, and returns when body does.
+//	Only once per program, since FreeRTOS can not be started again. The test fails if the simulated clock reaches
+//	max_time_s first, e.g. because a task it waits for never gets there.
+//
+// Returns:
+//  VOID
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+void test_run_task(void (*body)(void), double max_time_s);
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Description:
+//  Creates a task for one of the firmware's task functions, the way main.c does. There is room for TEST_MAX_TASKS.
+//
+// Returns:
+//  The task handle.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+osThreadId test_create_task(os_pthread function, void *parameters, osPriority priority);
+
+#endif // SITL_TEST_RTOS_H
@@ -0,0 +1,388 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Test of the sample ring with readers and the writer in the middle of each other's copies. Each sample can tell when
+//  it was torn. Every reader has to see its samples whole and in order, and account for each one it missed as an
+//  overrun.
+//
+//  The stress part runs one writer and several readers on host threads, on however many cores the host has. With
+//  one core the threads only meet where the scheduler happens to switch, so the preempted part makes sure they do:
+//  memcpy is wrapped at link time, and a copy into or out of the ring stops halfway to run the other side, as a
+//  higher priority task or interrupt would on the flight computer.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "utilities/sample_ring.h"
+#include "test.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define RING_CAPACITY		8			//Small, so the writer laps the readers.
+#define SAMPLE_WORDS		255			//Large, so a copy takes long enough to be overwritten halfway.
+#define STRESS_TIME_MS		1000		//Many time slices, for when the threads have to share cores.
+#define READERS				4
+#define SLOW_EVERY			64			//The slow readers yield this often.
+#define PREEMPTED_ROUNDS	(4 * RING_CAPACITY)	//Copies stopped halfway, of each kind.
+
+typedef struct
+{
+	uint32_t number;
+	uint32_t words[SAMPLE_WORDS];		//All follow from number.
+} stress_sample;
+
+typedef struct
+{
+	uint32_t yield_every;				//0 reads flat out.
+	uint32_t start;						//The reader's first sample number, and where it ended.
+	uint32_t end;
+	uint32_t read;
+	uint32_t overruns;
+	uint32_t skipped;					//Sample numbers that went by without being read.
+	uint32_t torn;
+	uint32_t backwards;
+} stress_reader;
+
+typedef struct
+{
+	uint32_t reads;
+	uint32_t torn;
+	uint32_t wrong_number;				//The number read_latest gave is not the sample's.
+	uint32_t backwards;
+} stress_latest;
+
+//Which of the ring's copies the memcpy wrapper stops halfway next. Only the first one after it is set.
+typedef enum
+{
+	PREEMPT_NONE = 0,
+	PREEMPT_WRITE,						//Into the ring: reads run in the middle of it.
+	PREEMPT_READ,						//Out of the ring: the writer laps the ring in the middle of it.
+} preempt_mode;
+
+typedef struct
+{
+	uint32_t overlapping_reads;			//sample_ring_read and read_latest calls made in the middle of a write.
+	uint32_t overwritten_copies;		//Reads that had their slot written over in the middle of the copy.
+	uint32_t wrong;						//Reads that did not give what the ring held at the time.
+} preempt_result;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+SAMPLE_RING_DEFINE(s_ring, stress_sample, RING_CAPACITY);
+static pthread_barrier_t s_start;
+static uint32_t s_done;
+static stress_reader s_readers[READERS];
+static stress_latest s_latest;
+
+static preempt_mode s_preempt;
+static preempt_result s_preempted;
+static uint32_t s_preempt_number;		//Number of the sample whose copy was stopped.
+
+void *__real_memcpy(void *destination, const void *source, size_t length);
+
+
+static uint32_t word(uint32_t number, uint32_t i)
+{
+	return number * 2654435761U + i;
+}
+
+static void make_sample(uint32_t number, stress_sample *sample)
+{
+	sample->number = number;
+	for(uint32_t i = 0; i < SAMPLE_WORDS; i++)
+	{
+		sample->words[i] = word(number, i);
+	}
+}
+
+static bool whole(const stress_sample *sample)
+{
+	for(uint32_t i = 0; i < SAMPLE_WORDS; i++)
+	{
+		if(sample->words[i] != word(sample->number, i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool in_ring(const void *pointer)
+{
+	const uint8_t *byte = (const uint8_t *) pointer;
+	return byte >= (const uint8_t *) s_ring_samples && byte < (const uint8_t *) &s_ring_samples[RING_CAPACITY];
+}
+
+/**
+ * @brief Reads in the middle of writing sample s_preempt_number, whose slot holds only half of it. A reader a ring
+ * behind wants the sample that was in the slot, and has to lose it; one that is up to date has nothing to read yet.
+ */
+static void read_during_write(void)
+{
+	uint32_t number = s_preempt_number;
+	sample_ring_reader reader;
+	stress_sample sample;
+	uint32_t latest;
+
+	reader.next = number - RING_CAPACITY;
+	reader.overruns = 0;
+	bool ok = sample_ring_read(&s_ring, &reader, &sample);
+	s_preempted.wrong += (ok && sample.number == number - RING_CAPACITY + 1 && whole(&sample) &&
+						  reader.overruns == 1) ? 0 : 1;
+
+	reader.next = number;
+	reader.overruns = 0;
+	s_preempted.wrong += sample_ring_read(&s_ring, &reader, &sample) ? 1 : 0;
+
+	ok = sample_ring_read_latest(&s_ring, &sample, &latest);
+	s_preempted.wrong += (ok && latest == number - 1 && sample.number == latest && whole(&sample)) ? 0 : 1;
+
+	s_preempted.overlapping_reads += 3;
+}
+
+/**
+ * @brief Laps the ring in the middle of a read of sample s_preempt_number, so its slot is written over while the first
+ * half has been copied out and the second half has not.
+ */
+static void write_during_read(void)
+{
+	stress_sample sample;
+	uint32_t written = s_ring.written;
+
+	for(uint32_t i = 0; i < RING_CAPACITY; i++)
+	{
+		make_sample(written + i, &sample);
+		sample_ring_write(&s_ring, &sample);
+	}
+	s_preempted.overwritten_copies += (((written + RING_CAPACITY - 1) & (RING_CAPACITY - 1)) ==
+									   (s_preempt_number & (RING_CAPACITY - 1))) ? 1 : 0;
+}
+
+/**
+ * @brief Linked in place of memcpy with -Wl,--wrap=memcpy. Passes every copy through, except that the one s_preempt
+ * asks for is stopped halfway while the other side of the ring runs.
+ */
+void *__wrap_memcpy(void *destination, const void *source, size_t length)
+{
+	preempt_mode mode = s_preempt;
+	if(!((mode == PREEMPT_WRITE && in_ring(destination)) || (mode == PREEMPT_READ && in_ring(source))))
+	{
+		return __real_memcpy(destination, source, length);
+	}
+
+	//The number is the first word of the sample, and is copied first.
+	size_t half = length / 2;
+	s_preempt = PREEMPT_NONE;
+	__real_memcpy(destination, source, half);
+	s_preempt_number = ((const stress_sample *) source)->number;
+	if(mode == PREEMPT_WRITE)
+	{
+		read_during_write();
+	}else
+	{
+		write_during_read();
+	}
+	__real_memcpy((uint8_t *) destination + half, (const uint8_t *) source + half, length - half);
+	return destination;
+}
+
+static uint64_t now_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static void *reader_thread(void *argument)
+{
+	stress_reader *stats = (stress_reader *) argument;
+	sample_ring_reader reader;
+	stress_sample sample;
+
+	sample_ring_reader_init(&s_ring, &reader);
+	stats->start = reader.next;
+	uint32_t expected = reader.next;
+	pthread_barrier_wait(&s_start);
+
+	//Once the writer is done, one more pass takes what is left.
+	bool done = false;
+	while(!done)
+	{
+		done = __atomic_load_n(&s_done, __ATOMIC_ACQUIRE);
+		while(sample_ring_read(&s_ring, &reader, &sample))
+		{
+			stats->torn += whole(&sample) ? 0 : 1;
+			if(sample.number < expected)
+			{
+				stats->backwards++;
+			}else
+			{
+				stats->skipped += sample.number - expected;
+			}
+			expected = sample.number + 1;
+			stats->read++;
+			if(stats->yield_every != 0 && stats->read % stats->yield_every == 0)
+			{
+				sched_yield();
+			}
+		}
+	}
+
+	stats->end = reader.next;
+	stats->overruns = reader.overruns;
+	return NULL;
+}
+
+static void *latest_thread(void *argument)
+{
+	stress_latest *stats = (stress_latest *) argument;
+	stress_sample sample;
+	uint32_t number;
+	uint32_t last = 0;
+
+	pthread_barrier_wait(&s_start);
+	while(!__atomic_load_n(&s_done, __ATOMIC_ACQUIRE))
+	{
+		//Copies the newest sample over and over, so this thread is nearly always in the middle of a copy.
+		if(!sample_ring_read_latest(&s_ring, &sample, &number))
+		{
+			continue;
+		}
+		stats->reads++;
+		stats->torn += whole(&sample) ? 0 : 1;
+		stats->wrong_number += (sample.number != number) ? 1 : 0;
+		stats->backwards += (number < last) ? 1 : 0;
+		last = number;
+	}
+	return NULL;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	pthread_t readers[READERS];
+	pthread_t latest;
+	stress_sample sample;
+
+	test_case("one writer, many readers");
+	pthread_barrier_init(&s_start, NULL, READERS + 2);
+	for(uint32_t i = 0; i < READERS; i++)
+	{
+		s_readers[i].yield_every = (i % 2 == 0) ? 0 : SLOW_EVERY;
+		pthread_create(&readers[i], NULL, reader_thread, &s_readers[i]);
+	}
+	pthread_create(&latest, NULL, latest_thread, &s_latest);
+
+	pthread_barrier_wait(&s_start);
+	uint64_t start = now_ms();
+	uint32_t samples = 0;
+	//Looks at the clock every 1024 samples.
+	while(samples % 1024 != 0 || now_ms() - start < STRESS_TIME_MS)
+	{
+		make_sample(samples, &sample);
+		sample_ring_write(&s_ring, &sample);
+		samples++;
+	}
+	__atomic_store_n(&s_done, 1, __ATOMIC_RELEASE);
+
+	for(uint32_t i = 0; i < READERS; i++)
+	{
+		pthread_join(readers[i], NULL);
+	}
+	pthread_join(latest, NULL);
+
+	//Every sample from a reader's start to the end was either read or counted as lost, and nothing else was.
+	printf("  %u samples written\n", samples);
+	uint32_t overruns = 0;
+	for(uint32_t i = 0; i < READERS; i++)
+	{
+		const stress_reader *reader = &s_readers[i];
+		printf("  reader %u: %u read, %u overruns\n", i, reader->read, reader->overruns);
+		TEST_CHECK(reader->torn == 0);
+		TEST_CHECK(reader->backwards == 0);
+		TEST_CHECK(reader->end == samples);
+		TEST_CHECK(reader->read + reader->overruns == reader->end - reader->start);
+		TEST_CHECK(reader->skipped == reader->overruns);
+		TEST_CHECK(reader->read > 0);
+		overruns += reader->overruns;
+	}
+	TEST_CHECK(overruns > 0);
+
+	printf("  read_latest: %u reads\n", s_latest.reads);
+	TEST_CHECK(s_latest.torn == 0);
+	TEST_CHECK(s_latest.wrong_number == 0);
+	TEST_CHECK(s_latest.backwards == 0);
+
+	test_case("after the writer stops");
+	sample_ring_reader reader;
+	sample_ring_reader_init(&s_ring, &reader);
+	TEST_CHECK(!sample_ring_read(&s_ring, &reader, &sample));
+	reader.next -= 3 * RING_CAPACITY;
+	TEST_CHECK(sample_ring_available(&s_ring, &reader) == RING_CAPACITY);
+	TEST_CHECK(sample_ring_read(&s_ring, &reader, &sample));
+	TEST_CHECK(sample.number == samples - RING_CAPACITY && whole(&sample));
+	TEST_CHECK(reader.overruns == 2 * RING_CAPACITY);
+	uint32_t number;
+	TEST_CHECK(sample_ring_read_latest(&s_ring, &sample, &number));
+	TEST_CHECK(number == samples - 1 && sample.number == number && whole(&sample));
+
+	//Every write is stopped halfway for reads. Only a reader that wants the sample being written over loses it.
+	test_case("reads in the middle of a write");
+	for(uint32_t i = 0; i < PREEMPTED_ROUNDS; i++)
+	{
+		make_sample(s_ring.written, &sample);
+		s_preempt = PREEMPT_WRITE;
+		sample_ring_write(&s_ring, &sample);
+		TEST_CHECK(s_preempt == PREEMPT_NONE);
+	}
+	printf("  %u reads in the middle of a write\n", s_preempted.overlapping_reads);
+	TEST_CHECK(s_preempted.overlapping_reads >= 3 * PREEMPTED_ROUNDS);
+	TEST_CHECK(s_preempted.wrong == 0);
+	TEST_CHECK(sample_ring_read_latest(&s_ring, &sample, &number));
+	TEST_CHECK(number == s_ring.written - 1 && sample.number == number && whole(&sample));
+
+	//Every read is stopped halfway while the writer goes round the ring and over the slot being copied. The half
+	//copied sample is thrown away and counted as lost, and the read gives the next one whole.
+	test_case("a write over the slot in the middle of a read");
+	s_preempted.wrong = 0;
+	for(uint32_t i = 0; i < PREEMPTED_ROUNDS; i++)
+	{
+		sample_ring_reader_init(&s_ring, &reader);
+		reader.next--;
+		uint32_t wanted = reader.next;
+		s_preempt = PREEMPT_READ;
+		bool ok = sample_ring_read(&s_ring, &reader, &sample);
+		s_preempted.wrong += (ok && sample.number == wanted + 1 && whole(&sample) && reader.overruns == 1) ? 0 : 1;
+	}
+	for(uint32_t i = 0; i < PREEMPTED_ROUNDS; i++)
+	{
+		uint32_t newest = s_ring.written - 1;
+		s_preempt = PREEMPT_READ;
+		bool ok = sample_ring_read_latest(&s_ring, &sample, &number);
+		s_preempted.wrong += (ok && number == newest + RING_CAPACITY && sample.number == number && whole(&sample)) ? 0 : 1;
+	}
+	printf("  %u reads with their slot written over in the middle\n", s_preempted.overwritten_copies);
+	TEST_CHECK(s_preempted.overwritten_copies >= 2 * PREEMPTED_ROUNDS);
+	TEST_CHECK(s_preempted.wrong == 0);
+
+	return test_summary("test_sample_ring");
+}
@@ -0,0 +1,423 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// UMSATS 2018-2020
+//
+// Repository:
+//  UMSATS/Avionics-2019
+//
+// File Description:
+//  Host test of the SPI driver itself, SPI.c rather than the sim_spi.c stand in, on a simulated SPI peripheral and
+//  DMA. Transfers shorter than 16 bytes, and all transfers before the scheduler starts, have to be polled; longer ones
+//  have to go by DMA, with the calling task asleep on its notification until the completion interrupt, while other
+//  tasks run. A DMA that never completes or fails has to end the transaction with an error, and one past 64 kB has to
+//  be split under a single chip select.
+//
+// History
+// 2026-10-18
+// - Created.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// INCLUDES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+#include "SPI.h"
+#include "hardware_definitions.h"
+#include "task.h"
+#include "sim.h"
+#include "test_rtos.h"
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DEFINITIONS AND MACROS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define DMA_MIN_TRANSFER_SIZE	16				//SPI_DMA_MIN_TRANSFER_SIZE in SPI.c.
+#define HAL_MAX_TRANSFER_SIZE	0xFFFF
+#define APB2_CLOCK_HZ			84000000
+#define APB1_CLOCK_HZ			42000000
+#define DEVICE_CLOCK_HZ			10000000		//Rounds down to 42 MHz / 8.
+#define TIMEOUT_MS				20
+#define MAX_CALLS				8
+#define WAIT_BYTES				4000			//About 6 ms on the wire.
+#define LONG_BYTES				70000
+#define LONG_TIMEOUT_MS			200				//For 64 kB, which take 100 ms.
+
+//One call into the HAL, with the device's chip select as it was during the call.
+typedef struct
+{
+	bool dma;
+	bool receive;
+	uint16_t size;
+	bool selected;
+} hal_call;
+
+typedef enum
+{
+	DMA_COMPLETES = 0,
+	DMA_FAILS,					//Ends with the error callback.
+	DMA_HANGS					//Never ends.
+} dma_behaviour;
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// VARIABLES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+SPI_TypeDef sim_spi1;
+SPI_TypeDef sim_spi2;
+SPI_TypeDef sim_spi3;
+DMA_Stream_TypeDef sim_dma1_streams[8];
+DMA_Stream_TypeDef sim_dma2_streams[8];
+
+static SPI s_device;
+
+//The peripheral: what the driver asked of it, the bytes it clocked out, and the next byte the chip sends back.
+static hal_call s_calls[MAX_CALLS];
+static uint32_t s_call_count;
+static uint8_t s_sent[256];
+static uint32_t s_sent_count;
+static uint8_t s_next_miso;
+static uint32_t s_aborts;
+
+//The DMA transfer in flight.
+static dma_behaviour s_dma_behaviour;
+static bool s_dma_active;
+static SPI_HandleTypeDef *s_dma_spi;
+static uint8_t *s_dma_data;
+static uint16_t s_dma_size;
+static bool s_dma_receive;
+static uint64_t s_dma_done_us;
+static uint64_t s_completed_us;				//When the last completion interrupt fired.
+
+static uint8_t s_buffer[LONG_BYTES];
+static volatile uint32_t s_background_runs;
+
+
+static bool is_selected(void)
+{
+	return (PRES_SPI_CS_PORT->outputs & PRES_SPI_CS_PIN) == 0;
+}
+
+static void record(bool dma, bool receive, uint16_t size)
+{
+	if(s_call_count < MAX_CALLS)
+	{
+		s_calls[s_call_count] = (hal_call) {dma, receive, size, is_selected()};
+	}
+	s_call_count++;
+}
+
+static void start_recording(void)
+{
+	s_call_count = 0;
+	s_sent_count = 0;
+	s_next_miso = 0;
+}
+
+static bool called(uint32_t index, bool dma, bool receive, uint16_t size)
+{
+	const hal_call *call = &s_calls[index];
+	return index < s_call_count && call->dma == dma && call->receive == receive && call->size == size && call->selected;
+}
+
+/**
+ * @brief Moves the bytes of a transfer: the chip sends back a count that runs on from transfer to transfer.
+ */
+static void exchange(uint8_t *data, uint16_t size, bool receive)
+{
+	for(uint16_t i = 0; i < size; i++)
+	{
+		if(receive)
+		{
+			data[i] = s_next_miso++;
+		}else if(s_sent_count < sizeof(s_sent))
+		{
+			s_sent[s_sent_count++] = data[i];
+		}
+	}
+}
+
+/**
+ * @brief Microseconds size bytes take at the prescaler in CR1, which SPI.c sets for each device.
+ */
+static uint64_t wire_time_us(SPI_HandleTypeDef *hspi, uint16_t size)
+{
+	uint32_t pclk = (hspi->Instance == SPI1) ? APB2_CLOCK_HZ : APB1_CLOCK_HZ;
+	uint32_t clock = pclk >> (((hspi->Instance->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos) + 1);
+	return ((uint64_t) size * 8 * SIM_US_PER_S + clock - 1) / clock;
+}
+
+static bool pattern_from(const uint8_t *data, uint32_t size, uint8_t first)
+{
+	for(uint32_t i = 0; i < size; i++)
+	{
+		if(data[i] != (uint8_t) (first + i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static HAL_StatusTypeDef polled(SPI_HandleTypeDef *hspi, uint8_t *data, uint16_t size, bool receive)
+{
+	record(false, receive, size);
+	exchange(data, size, receive);
+	vPortSimConsume(wire_time_us(hspi, size));
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef start_dma(SPI_HandleTypeDef *hspi, uint8_t *data, uint16_t size, bool receive)
+{
+	record(true, receive, size);
+	if(s_dma_active || hspi->hdmarx == NULL || hspi->hdmatx == NULL)
+	{
+		return HAL_BUSY;
+	}
+
+	s_dma_active = true;
+	s_dma_spi = hspi;
+	s_dma_data = data;
+	s_dma_size = size;
+	s_dma_receive = receive;
+	s_dma_done_us = ulPortSimTime() + wire_time_us(hspi, size);
+	if(s_dma_behaviour != DMA_HANGS)
+	{
+		vPortSimInterruptAt(s_dma_done_us);
+	}
+	return HAL_OK;
+}
+
+static void background_task(void const *params)
+{
+	(void) params;
+	while(1)
+	{
+		s_background_runs++;
+		vTaskDelay(1);
+	}
+}
+
+/**
+ * @brief Runs a receive with a one byte command and checks the HAL calls it took and the data it got.
+ */
+static void check_receive(uint32_t size, bool dma)
+{
+	uint8_t command = 0x0B;
+	start_recording();
+	TEST_CHECK(spi_receive(s_device, &command, 1, s_buffer, size, TIMEOUT_MS) == HAL_OK);
+	TEST_CHECK(s_call_count == 2);
+	TEST_CHECK(called(0, false, false, 1));
+	TEST_CHECK(called(1, dma, true, (uint16_t) size));
+	TEST_CHECK(pattern_from(s_buffer, size, 0));
+	TEST_CHECK(!is_selected());
+}
+
+static void test_threshold(void)
+{
+	test_case("below 16 bytes is polled");
+	check_receive(DMA_MIN_TRANSFER_SIZE - 1, false);
+
+	test_case("from 16 bytes is by DMA");
+	check_receive(DMA_MIN_TRANSFER_SIZE, true);
+	check_receive(200, true);
+
+	test_case("sending");
+	uint8_t command[2] = {0x02, 0x00};
+	uint8_t data[100];
+	for(uint32_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t) (0x80 + i);
+	}
+	start_recording();
+	TEST_CHECK(spi_send(s_device, command, sizeof(command), data, DMA_MIN_TRANSFER_SIZE - 1, TIMEOUT_MS) == HAL_OK);
+	TEST_CHECK(spi_send(s_device, command, sizeof(command), data, sizeof(data), TIMEOUT_MS) == HAL_OK);
+	TEST_CHECK(s_call_count == 4);
+	TEST_CHECK(called(0, false, false, 2));
+	TEST_CHECK(called(1, false, false, DMA_MIN_TRANSFER_SIZE - 1));
+	TEST_CHECK(called(2, false, false, 2));
+	TEST_CHECK(called(3, true, false, sizeof(data)));
+	TEST_CHECK(s_sent_count == 2 * sizeof(command) + DMA_MIN_TRANSFER_SIZE - 1 + sizeof(data));
+	TEST_CHECK(memcmp(&s_sent[2 * sizeof(command) + DMA_MIN_TRANSFER_SIZE - 1], data, sizeof(data)) == 0);
+}
+
+static void test_wait(void)
+{
+	uint8_t command = 0x0B;
+
+	//The caller sleeps until the completion interrupt, and the background task gets the time.
+	test_case("waits on the notification");
+	start_recording();
+	uint32_t runs = s_background_runs;
+	uint64_t start = ulPortSimTime();
+	TEST_CHECK(spi_receive(s_device, &command, 1, s_buffer, WAIT_BYTES, TIMEOUT_MS) == HAL_OK);
+	uint64_t wire_us = s_dma_done_us - start;
+	printf("  %u bytes by DMA: %.3f ms, background task ran %u times\n", WAIT_BYTES, wire_us / 1e3,
+		   s_background_runs - runs);
+	TEST_CHECK(called(1, true, true, WAIT_BYTES));
+	TEST_CHECK(s_completed_us == s_dma_done_us);
+	TEST_CHECK(ulPortSimTime() >= s_completed_us);
+	TEST_CHECK(wire_us >= (uint64_t) WAIT_BYTES * 8 * SIM_US_PER_S / (APB1_CLOCK_HZ / 8));
+	TEST_CHECK(s_background_runs - runs >= wire_us / 1000 - 1);
+	TEST_CHECK(pattern_from(s_buffer, WAIT_BYTES, 0));
+
+	//A notification left over from before is dropped, rather than ending the wait while the bytes are on the wire.
+	test_case("a stale notification is dropped");
+	xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+	memset(s_buffer, 0, WAIT_BYTES);
+	start_recording();
+	TEST_CHECK(spi_receive(s_device, &command, 1, s_buffer, WAIT_BYTES, TIMEOUT_MS) == HAL_OK);
+	TEST_CHECK(s_completed_us == s_dma_done_us);
+	TEST_CHECK(ulPortSimTime() >= s_completed_us);
+	TEST_CHECK(pattern_from(s_buffer, WAIT_BYTES, 0));
+}
+
+static void test_failures(void)
+{
+	uint8_t command = 0x0B;
+
+	test_case("a DMA that never completes");
+	s_dma_behaviour = DMA_HANGS;
+	uint64_t start = ulPortSimTime();
+	TEST_CHECK(spi_receive(s_device, &command, 1, s_buffer, 100, TIMEOUT_MS) == HAL_TIMEOUT);
+	uint64_t waited_us = ulPortSimTime() - start;
+	printf("  gave up after %.3f ms\n", waited_us / 1e3);
+	//The wait is counted in ticks, and the first one is partly gone when it starts.
+	TEST_CHECK(waited_us >= (TIMEOUT_MS - 1) * 1000 && waited_us <= (TIMEOUT_MS + 1) * 1000);
+	TEST_CHECK(s_aborts == 1 && !s_dma_active);
+	TEST_CHECK(!is_selected());
+
+	test_case("a DMA error");
+	s_dma_behaviour = DMA_FAILS;
+	TEST_CHECK(spi_receive(s_device, &command, 1, s_buffer, 100, TIMEOUT_MS) == HAL_ERROR);
+	TEST_CHECK(!is_selected());
+
+	//The bus was let go after each.
+	s_dma_behaviour = DMA_COMPLETES;
+	check_receive(100, true);
+}
+
+static void test_long(void)
+{
+	//The HAL takes at most 65535 bytes in a call, so the rest follows under the same chip select.
+	test_case("past 64 kB");
+	uint8_t command = 0x0B;
+	start_recording();
+	TEST_CHECK(spi_receive(s_device, &command, 1, s_buffer, LONG_BYTES, LONG_TIMEOUT_MS) == HAL_OK);
+	TEST_CHECK(s_call_count == 3);
+	TEST_CHECK(called(1, true, true, HAL_MAX_TRANSFER_SIZE));
+	TEST_CHECK(called(2, true, true, LONG_BYTES - HAL_MAX_TRANSFER_SIZE));
+	TEST_CHECK(pattern_from(s_buffer, LONG_BYTES, 0));
+}
+
+static void test_body(void)
+{
+	test_create_task(background_task, NULL, osPriorityLow);
+
+	test_threshold();
+	test_wait();
+	test_failures();
+	test_long();
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+// FUNCTIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	spi_device_config config = {SPI_BUS_2, PRES_SPI_CS_PORT, PRES_SPI_CS_PIN, DEVICE_CLOCK_HZ, 0};
+	s_device = spi_register_device(&config);
+
+	test_case("set up");
+	TEST_CHECK(s_device != NULL);
+	TEST_CHECK(spi_get_clock_hz(s_device) == APB1_CLOCK_HZ / 8);
+	TEST_CHECK(!is_selected());
+
+	//With no other task to give the time to, SPI.c polls.
+	test_case("polled before the scheduler");
+	check_receive(200, false);
+
+	test_run_task(test_body, 30.0);
+	return test_summary("test_spi");
+}
+
+//The peripheral and DMA behind SPI.c.
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return APB1_CLOCK_HZ;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+	return APB2_CLOCK_HZ;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+	(void) hdma;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi)
+{
+	hspi->Instance->CR1 = hspi->Init.BaudRatePrescaler | hspi->Init.CLKPolarity | hspi->Init.CLKPhase;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void) Timeout;
+	return polled(hspi, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void) Timeout;
+	return polled(hspi, pData, Size, true);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	return start_dma(hspi, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	return start_dma(hspi, pData, Size, true);
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi)
+{
+	(void) hspi;
+	s_dma_active = false;
+	s_aborts++;
+	return HAL_OK;
+}
+
+//The DMA completion interrupt, in place of the one sim_spi.c has for its own transfers.
+uint64_t sim_spi_interrupts(uint64_t now_us)
+{
+	if(!s_dma_active || s_dma_behaviour == DMA_HANGS)
+	{
+		return UINT64_MAX;
+	}else if(now_us < s_dma_done_us)
+	{
+		return s_dma_done_us;
+	}
+
+	s_dma_active = false;
+	s_completed_us = now_us;
+	if(s_dma_behaviour == DMA_FAILS)
+	{
+		HAL_SPI_ErrorCallback(s_dma_spi);
+	}else
+	{
+		exchange(s_dma_data, s_dma_size, s_dma_receive);
+		if(s_dma_receive)
+		{
+			HAL_SPI_RxCpltCallback(s_dma_spi);
+		}else
+		{
+			HAL_SPI_TxCpltCallback(s_dma_spi);
+		}
+	}
+	return UINT64_MAX;
+}
@@ -0,0 +1,65 @@
+#
+#   File Description:
+#       Compares getting a flight into numpy from the csv and from the columnar output.
+#       Builds parser_benchmark first ('make parser_benchmark'), then run:
+#           python3 columns_benchmark.py [megabytes]
+#       Each side is timed end to end: decoding the synthetic log to its file, then loading that file.
+#       The csv is loaded with numpy.loadtxt, the columns the way generate_plotly does.
+#
+#   History
+#   2019-06-20 by Joseph Howarth.
+#       -   Created.
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'PC_Software'))
+import flight_columns
+
+LABELS = {'time': 0, 'acceleration_x': 1, 'acceleration_y': 2, 'acceleration_z': 3, 'rotation_x': 4,
+          'rotation_y': 5, 'rotation_z': 6, 'pressure': 7, 'temperature': 8, 'altitude': 9, 'events': 10}
+
+
+def main():
+    megabytes = sys.argv[1] if len(sys.argv) > 1 else '8'
+    benchmark = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'parser_benchmark')
+
+    with tempfile.TemporaryDirectory() as directory:
+        name = os.path.join(directory, 'flight')
+        output = subprocess.run([benchmark, megabytes, name], check=True, stdout=subprocess.PIPE,
+                                universal_newlines=True).stdout
+        results = dict(line.split() for line in output.splitlines())
+
+        start = time.perf_counter()
+        csv_data = np.loadtxt(name + '.csv', delimiter=',', ndmin=2).T
+        csv_load = time.perf_counter() - start
+
+        start = time.perf_counter()
+        columns_data = flight_columns.flight_as_rows(flight_columns.load_flight(name + '.json'), LABELS)
+        columns_load = time.perf_counter() - start
+
+        if not np.allclose(csv_data, columns_data, rtol=0, atol=1e-3):
+            print('The csv and the columns hold different data.')
+            return 1
+
+        csv_parse = float(results['csv_parse_seconds'])
+        columns_parse = float(results['columns_parse_seconds'])
+        csv_size = os.path.getsize(name + '.csv')
+        columns_size = os.path.getsize(name + '.columns') + os.path.getsize(name + '.json')
+
+    print('{} MB log, {} records'.format(megabytes, results['records']))
+    print('{:8} {:>10} {:>10} {:>10} {:>10}'.format('', 'size MB', 'parse s', 'load s', 'total s'))
+    print('{:8} {:10.1f} {:10.3f} {:10.3f} {:10.3f}'.format('csv', csv_size / 1e6, csv_parse, csv_load,
+                                                           csv_parse + csv_load))
+    print('{:8} {:10.1f} {:10.3f} {:10.3f} {:10.3f}'.format('columns', columns_size / 1e6, columns_parse,
+                                                           columns_load, columns_parse + columns_load))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
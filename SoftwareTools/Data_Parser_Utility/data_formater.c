@@ -2,10 +2,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "log_parser.h"
 
 
 #define LOG_NAME  "UMSATS_ROCKET.log"
 #define OUTPUT_NAME "flightComputer.csv"
+#define COLUMNS_NAME "flightComputer"   //Base name of the columnar output, version 2 logs only.
 
 #define ACC_TYPE 			0x800000
 #define GYRO_TYPE			0x400000
@@ -136,6 +138,31 @@ int main(){
     }
     printf("Skiped %d null chars.\n",count);
     fseek(fp,-1,SEEK_CUR);
+
+    //Only version 2 logs get columns, so don't leave ones from an older log next to this csv.
+    remove(COLUMNS_NAME ".json");
+    remove(COLUMNS_NAME ".columns");
+
+    char magic[4];
+    if(fread(magic,1,4,fp) == 4 && memcmp(magic,LOG_SUPERBLOCK_MAGIC,4) == 0){
+        //Version 2 pages can be decoded independently, so hand the whole file to the parallel parser.
+        long offset = ftell(fp) - 4;
+        fclose(fp);
+
+        size_t size;
+        const uint8_t *log = log_parser_map(LOG_NAME,&size);
+        if(log == NULL){
+            printf("Could not map log file.:%s\n",LOG_NAME);
+            fclose(fp_out);
+            return -1;
+        }
+        log_parser_stats stats;
+        int result = log_parser_decode_v2(log + offset,size - offset,fp_out,COLUMNS_NAME,0,0,&stats);
+        log_parser_unmap(log,size);
+        fclose(fp_out);
+        return result;
+    }
+    fseek(fp,-4,SEEK_CUR);
    
     uint32_t prevTime =0;
     int done = 0;
@@ -0,0 +1,734 @@
+#include "log_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ROW_MAX_LENGTH  160     //Longest CSV row, with room to spare.
+
+#define COLUMN_ALIGN    8       //Every column starts on a multiple of this in the columns file.
+
+#define PAGE_OK         0
+#define PAGE_BAD        1       //Wrong marker or CRC, none of its records are used.
+#define PAGE_TRUNCATED  2       //A record ran off the end, the ones before it are used.
+
+typedef struct{
+
+    uint8_t status;
+    uint8_t bad_record;
+    uint8_t phase;              //0xFF on pages from before the log policy.
+    uint32_t sequence;
+
+} page_info;
+
+typedef struct{
+
+    uint64_t time_abs;          //Microseconds since the first record, filled in by the merge.
+    uint32_t time_us;
+    int16_t acc[3];
+    int16_t gyro[3];
+    uint32_t pres;
+    int32_t temp;
+    int32_t alt_cm;
+    uint8_t types;
+    uint8_t events;
+    uint8_t channels;           //The channels this record holds, the others are filled in by the merge.
+
+} decoded_record;
+
+typedef struct{
+
+    const uint8_t *log;         //The superblock, data page n is at log + n * LOG_PAGE_SIZE.
+    page_info *info;            //Indexed by data page number.
+    int first_page;
+    int end_page;               //One past the last page of this chunk.
+
+    decoded_record *records;
+    size_t count;
+    size_t capacity;
+
+    char *text;
+    size_t text_length;
+
+    int profiles;
+    int have_profile[LOG_PROFILE_IDS];
+    uint32_t profile[LOG_PROFILE_IDS][LOG_PROFILE_VALUES];
+
+    int failed;
+
+} chunk;
+
+
+uint32_t log_parser_crc32(const uint8_t *data, size_t size){
+
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    size_t i;
+    for(i=0;i<size;i++){
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+const uint8_t *log_parser_map(const char *path, size_t *size){
+
+    int fd = open(path,O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd,&st) != 0 || st.st_size == 0){
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(data == MAP_FAILED){
+        return NULL;
+    }
+
+    *size = st.st_size;
+    return data;
+}
+
+void log_parser_unmap(const uint8_t *data, size_t size){
+    munmap((void *)data,size);
+}
+
+static uint32_t get_be32(const uint8_t *bytes){
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static int page_crc_ok(const uint8_t *page){
+    return get_be32(&page[LOG_PAGE_CRC]) == log_parser_crc32(page,LOG_PAGE_CRC);
+}
+
+//Reads one varint. Sets *pos past the end of the page if it runs off it.
+static uint32_t get_varint(const uint8_t *page, int *pos){
+
+    uint32_t value = 0;
+    int shift = 0;
+    while(*pos < LOG_PAGE_SIZE && shift < 35){
+
+        uint8_t b = page[(*pos)++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if(!(b & 0x80)){
+            return value;
+        }
+        shift += 7;
+    }
+    *pos = LOG_PAGE_SIZE + 1;
+    return 0;
+}
+
+static int32_t get_delta(const uint8_t *page, int *pos){
+
+    uint32_t v = get_varint(page, pos);
+    return (int32_t)((v >> 1) ^ (0U - (v & 1)));
+}
+
+//Undoes the dropped low bits of a logged value.
+static int32_t restore(int32_t value, int bits){
+    return (int32_t)((uint32_t)value << bits);
+}
+
+static int16_t restore16(int32_t value, int bits){
+
+    int32_t v = restore(value,bits);
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+}
+
+static void decode_page(chunk *c, const uint8_t *page, page_info *info){
+
+    info->status = PAGE_OK;
+    info->phase = 0xFF;
+    if(page[0] != LOG_PAGE_MARKER || !page_crc_ok(page)){
+        info->status = PAGE_BAD;
+        return;
+    }
+    info->sequence = get_be32(&page[LOG_PAGE_SEQUENCE]);
+
+    //The log policy of the page. Pages without one hold every channel in full.
+    uint8_t channels = LOG_CHANNELS_ALL;
+    int imu_bits = 0;
+    int baro_bits = 0;
+    if(page[LOG_PAGE_FIRST_RECORD] >= LOG_PAGE_POLICY_END){
+        info->phase = page[LOG_PAGE_PHASE];
+        channels = page[LOG_PAGE_CHANNELS];
+        imu_bits = page[LOG_PAGE_PRECISION] & 0x0F;
+        baro_bits = page[LOG_PAGE_PRECISION] >> 4;
+    }
+
+    int count = page[1];
+    if(c->count + count > c->capacity){
+        size_t capacity = c->capacity * 2 + count;
+        decoded_record *records = realloc(c->records,capacity * sizeof(decoded_record));
+        if(records == NULL){
+            c->failed = 1;
+            return;
+        }
+        c->records = records;
+        c->capacity = capacity;
+    }
+
+    //Each page starts over from zero, so the first record is a keyframe. The deltas are of the values with the low
+    //bits dropped, so those are kept apart from the restored ones.
+    decoded_record r;
+    memset(&r,0,sizeof(r));
+    int32_t acc[3] = {0, 0, 0};
+    int32_t gyro[3] = {0, 0, 0};
+    uint32_t pres = 0;
+    int32_t temp = 0;
+    int32_t alt_cm = 0;
+    int pos = page[LOG_PAGE_FIRST_RECORD];
+    int i;
+    for(i=0;i<count && pos < LOG_PAGE_CRC;i++){
+
+        r.types = page[pos++];
+        r.events = 0;
+        if(r.types & LOG_RECORD_EVENTS){
+            r.events = page[pos++];
+        }
+        r.time_us += get_varint(page,&pos);
+
+        int j;
+        if(r.types & LOG_RECORD_PROFILE){
+            uint8_t id = page[pos++];
+            uint32_t values[LOG_PROFILE_VALUES];
+            int n = (id < LOG_PROFILE_GAUGE) ? LOG_PROFILE_VALUES : 1;
+            for(j=0;j<n;j++) values[j] = get_varint(page,&pos);
+            if(pos > LOG_PAGE_CRC){
+                info->status = PAGE_TRUNCATED;
+                info->bad_record = i;
+                break;
+            }
+            //Keeps the running time, so the next measurement is still right.
+            c->profiles++;
+            if(id < LOG_PROFILE_IDS){
+                c->have_profile[id] = 1;
+                memcpy(c->profile[id],values,n * sizeof(uint32_t));
+            }
+            continue;
+        }
+        r.channels = 0;
+        if(r.types & LOG_RECORD_IMU){
+            r.channels |= channels & (LOG_CHANNEL_ACC | LOG_CHANNEL_GYRO);
+        }
+        if(r.types & LOG_RECORD_BARO){
+            r.channels |= channels & (LOG_CHANNEL_PRESSURE | LOG_CHANNEL_TEMPERATURE | LOG_CHANNEL_ALTITUDE);
+        }
+        if(r.channels & LOG_CHANNEL_ACC){
+            for(j=0;j<3;j++){
+                acc[j] += get_delta(page,&pos);
+                r.acc[j] = restore16(acc[j],imu_bits);
+            }
+        }
+        if(r.channels & LOG_CHANNEL_GYRO){
+            for(j=0;j<3;j++){
+                gyro[j] += get_delta(page,&pos);
+                r.gyro[j] = restore16(gyro[j],imu_bits);
+            }
+        }
+        if(r.channels & LOG_CHANNEL_PRESSURE){
+            pres += get_delta(page,&pos);
+            r.pres = restore(pres,baro_bits);
+        }
+        if(r.channels & LOG_CHANNEL_TEMPERATURE){
+            temp += get_delta(page,&pos);
+            r.temp = restore(temp,baro_bits);
+        }
+        if(r.channels & LOG_CHANNEL_ALTITUDE){
+            alt_cm += get_delta(page,&pos);
+            r.alt_cm = restore(alt_cm,baro_bits);
+        }
+        if(pos > LOG_PAGE_CRC){
+            info->status = PAGE_TRUNCATED;
+            info->bad_record = i;
+            break;
+        }
+
+        c->records[c->count++] = r;
+    }
+}
+
+static void *decode_chunk(void *arg){
+
+    chunk *c = arg;
+    int n;
+    for(n=c->first_page;n<c->end_page && !c->failed;n++){
+        decode_page(c,c->log + (size_t)n * LOG_PAGE_SIZE,&c->info[n]);
+    }
+    return NULL;
+}
+
+//Writes value in decimal followed by a comma. Much faster than sprintf, which is most of the parse time.
+static char *put_int(char *out, int64_t value){
+
+    char digits[20];
+    int n = 0;
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    do{
+        digits[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    }while(magnitude != 0);
+
+    if(value < 0){
+        *out++ = '-';
+    }
+    while(n > 0){
+        *out++ = digits[--n];
+    }
+    *out++ = ',';
+    return out;
+}
+
+static void *format_chunk(void *arg){
+
+    chunk *c = arg;
+    c->text = malloc(c->count * ROW_MAX_LENGTH + 1);
+    if(c->text == NULL){
+        c->failed = 1;
+        return NULL;
+    }
+
+    char *out = c->text;
+    size_t i;
+    for(i=0;i<c->count;i++){
+        const decoded_record *r = &c->records[i];
+        float alt = r->alt_cm / 100.0;
+
+        //Same text as "%.3f,%d,%d,%d,%d,%d,%d,%d,%d,%f,%d\n" with the time in milliseconds.
+        out = put_int(out,r->time_abs / 1000);
+        out[-1] = '.';
+        *out++ = '0' + r->time_abs / 100 % 10;
+        *out++ = '0' + r->time_abs / 10 % 10;
+        *out++ = '0' + r->time_abs % 10;
+        *out++ = ',';
+        int j;
+        for(j=0;j<3;j++) out = put_int(out,r->acc[j]);
+        for(j=0;j<3;j++) out = put_int(out,r->gyro[j]);
+        out = put_int(out,(int32_t)r->pres);
+        out = put_int(out,r->temp);
+        out += sprintf(out,"%f,%d\n",alt,r->events);
+    }
+    c->text_length = out - c->text;
+    return NULL;
+}
+
+//Runs work on every chunk, one thread each. The first chunk runs on the calling thread.
+static void run_chunks(chunk *chunks, int n, void *(*work)(void *)){
+
+    pthread_t *threads = malloc(n * sizeof(pthread_t));
+    int *started = calloc(n,sizeof(int));
+    int i;
+    for(i=1;i<n && threads != NULL && started != NULL;i++){
+        started[i] = pthread_create(&threads[i],NULL,work,&chunks[i]) == 0;
+    }
+    work(&chunks[0]);
+    for(i=1;i<n;i++){
+        if(started != NULL && started[i]){
+            pthread_join(threads[i],NULL);
+        }else{
+            work(&chunks[i]);
+        }
+    }
+    free(started);
+    free(threads);
+}
+
+//Fills in what depends on earlier pages, walking the chunks in log order.
+static void merge_chunks(chunk *chunks, int n){
+
+    uint64_t time_abs = 0;
+    uint32_t last_time = 0;
+    int first = 1;
+    uint8_t event_occur = 0;
+    uint32_t pres = 0;
+    int32_t temp = 0;
+    int32_t alt_cm = 0;
+    int16_t acc[3] = {0, 0, 0};
+    int16_t gyro[3] = {0, 0, 0};
+
+    int i;
+    size_t j;
+    for(i=0;i<n;i++){
+        for(j=0;j<chunks[i].count;j++){
+
+            decoded_record *r = &chunks[i].records[j];
+
+            //The microsecond clock wraps every 71 minutes. A record can also be a little older than the one before it,
+            //e.g. when the IMU time base locks on, so the difference is signed.
+            if(first){
+                first = 0;
+            }else{
+                time_abs += (int32_t)(r->time_us - last_time);
+            }
+            last_time = r->time_us;
+            r->time_abs = time_abs;
+
+            //Rows repeat the last reading of every channel they do not hold: the sensors are logged at their own rates,
+            //and the log policy of a phase can leave channels out.
+            if(r->channels & LOG_CHANNEL_PRESSURE) pres = r->pres; else r->pres = pres;
+            if(r->channels & LOG_CHANNEL_TEMPERATURE) temp = r->temp; else r->temp = temp;
+            if(r->channels & LOG_CHANNEL_ALTITUDE) alt_cm = r->alt_cm; else r->alt_cm = alt_cm;
+            if(r->channels & LOG_CHANNEL_ACC) memcpy(acc,r->acc,sizeof(acc)); else memcpy(r->acc,acc,sizeof(acc));
+            if(r->channels & LOG_CHANNEL_GYRO) memcpy(gyro,r->gyro,sizeof(gyro)); else memcpy(r->gyro,gyro,sizeof(gyro));
+
+            event_occur |= r->events;
+            r->events = event_occur;
+        }
+    }
+}
+
+typedef enum{
+
+    COLUMN_TIME,
+    COLUMN_ACC_X, COLUMN_ACC_Y, COLUMN_ACC_Z,
+    COLUMN_GYRO_X, COLUMN_GYRO_Y, COLUMN_GYRO_Z,
+    COLUMN_PRESSURE,
+    COLUMN_TEMPERATURE,
+    COLUMN_ALTITUDE,
+    COLUMN_EVENTS,
+    COLUMN_COUNT
+
+} column_id;
+
+typedef struct{
+
+    const char *name;
+    const char *dtype;          //numpy dtype string.
+    int size;
+    const char *unit;
+
+} column_description;
+
+//Same channels and order as the CSV. The time is kept in whole microseconds so nothing is lost.
+static const column_description s_columns[COLUMN_COUNT] = {
+    {"time",        "<u8", 8, "us since the first record"},
+    {"acc_x",       "<i2", 2, "raw"},
+    {"acc_y",       "<i2", 2, "raw"},
+    {"acc_z",       "<i2", 2, "raw"},
+    {"gyro_x",      "<i2", 2, "raw"},
+    {"gyro_y",      "<i2", 2, "raw"},
+    {"gyro_z",      "<i2", 2, "raw"},
+    {"pressure",    "<u4", 4, "raw"},
+    {"temperature", "<i4", 4, "raw"},
+    {"altitude",    "<f4", 4, "m"},
+    {"events",      "<u1", 1, "event bits so far"},
+};
+
+static uint64_t column_value(const decoded_record *r, column_id column){
+
+    switch(column){
+        case COLUMN_TIME:           return r->time_abs;
+        case COLUMN_ACC_X:          return (uint16_t)r->acc[0];
+        case COLUMN_ACC_Y:          return (uint16_t)r->acc[1];
+        case COLUMN_ACC_Z:          return (uint16_t)r->acc[2];
+        case COLUMN_GYRO_X:         return (uint16_t)r->gyro[0];
+        case COLUMN_GYRO_Y:         return (uint16_t)r->gyro[1];
+        case COLUMN_GYRO_Z:         return (uint16_t)r->gyro[2];
+        case COLUMN_PRESSURE:       return r->pres;
+        case COLUMN_TEMPERATURE:    return (uint32_t)r->temp;
+        case COLUMN_ALTITUDE:{
+            float alt = r->alt_cm / 100.0;
+            uint32_t bits;
+            memcpy(&bits,&alt,4);
+            return bits;
+        }
+        case COLUMN_EVENTS:         return r->events;
+        default:                    return 0;
+    }
+}
+
+//JSON has no NaN or infinity, which is what an unset (0xFF) reference reads as.
+static void write_json_float(FILE *meta, const char *name, float value){
+
+    if(value == value && value - value == 0){
+        fprintf(meta,"    \"%s\": %f,\n",name,value);
+    }else{
+        fprintf(meta,"    \"%s\": null,\n",name);
+    }
+}
+
+//Writes <name>.columns, one little endian array per channel, and <name>.json that says where each one starts.
+static int write_columns(const chunk *chunks, int n, const uint8_t *superblock, const char *name){
+
+    size_t records = 0;
+    int i;
+    for(i=0;i<n;i++){
+        records += chunks[i].count;
+    }
+
+    char path[1024];
+    snprintf(path,sizeof(path),"%s.columns",name);
+    FILE *data = fopen(path,"wb");
+    snprintf(path,sizeof(path),"%s.json",name);
+    FILE *meta = fopen(path,"w");
+    uint8_t *buffer = malloc(records * 8 + COLUMN_ALIGN);
+    if(data == NULL || meta == NULL || buffer == NULL){
+        printf("Could not write the columns to %s.\n",name);
+        if(data != NULL) fclose(data);
+        if(meta != NULL) fclose(meta);
+        free(buffer);
+        return -1;
+    }
+
+    float ref_alt;
+    float ref_pres;
+    memcpy(&ref_alt,&superblock[16],4);
+    memcpy(&ref_pres,&superblock[20],4);
+    const char *base = strrchr(name,'/') != NULL ? strrchr(name,'/') + 1 : name;
+
+    fprintf(meta,"{\n");
+    fprintf(meta,"    \"format\": \"umsats-columns\",\n");
+    fprintf(meta,"    \"version\": 1,\n");
+    fprintf(meta,"    \"data\": \"%s.columns\",\n",base);
+    fprintf(meta,"    \"records\": %zu,\n",records);
+    fprintf(meta,"    \"data_rate\": %d,\n",superblock[5]);
+    write_json_float(meta,"ref_alt",ref_alt);
+    write_json_float(meta,"ref_pres",ref_pres);
+    fprintf(meta,"    \"columns\": [\n");
+
+    size_t offset = 0;
+    int c;
+    for(c=0;c<COLUMN_COUNT;c++){
+
+        const column_description *column = &s_columns[c];
+        uint8_t *out = buffer;
+        size_t j;
+        int b;
+        for(i=0;i<n;i++){
+            for(j=0;j<chunks[i].count;j++){
+                uint64_t value = column_value(&chunks[i].records[j],c);
+                for(b=0;b<column->size;b++){
+                    *out++ = (uint8_t)(value >> (8 * b));
+                }
+            }
+        }
+
+        //Pad so the next array is aligned.
+        size_t length = out - buffer;
+        while(length % COLUMN_ALIGN != 0){
+            buffer[length++] = 0;
+        }
+        fwrite(buffer,1,length,data);
+
+        fprintf(meta,"        {\"name\": \"%s\", \"dtype\": \"%s\", \"offset\": %zu, \"unit\": \"%s\"}%s\n",
+                column->name,column->dtype,offset,column->unit,c + 1 < COLUMN_COUNT ? "," : "");
+        offset += length;
+    }
+
+    fprintf(meta,"    ]\n}\n");
+
+    int result = ferror(data) || ferror(meta) ? -1 : 0;
+    fclose(data);
+    fclose(meta);
+    free(buffer);
+    if(result != 0){
+        printf("Could not write the columns to %s.\n",name);
+    }
+    return result;
+}
+
+static const char *const log_phase_names[LOG_PHASES] = {"pad", "ascent", "drogue", "main", "landed"};
+
+static void print_superblock(const uint8_t *page){
+
+    float ref_alt;
+    float ref_pres;
+
+    if(!page_crc_ok(page)){
+        printf("Superblock CRC does not match, the settings below may be wrong.\n");
+    }
+    memcpy(&ref_alt,&page[16],4);
+    memcpy(&ref_pres,&page[20],4);
+    printf("Format version %d, data rate %d\n",page[4],page[5]);
+    printf("Accel range %d odr %d bw %d, gyro range %d odr %d bw %d\n",page[6],page[7],page[8],page[9],page[10],page[11]);
+    printf("BMP odr %d pres os %d temp os %d iir %d, ref alt %f ref pres %f\n",page[12],page[13],page[14],page[15],ref_alt,ref_pres);
+
+    //Logs from before the log rates were set apart from the sensor rates leave these bytes erased.
+    if(page[LOG_SUPERBLOCK_AVERAGING] != 0xFF){
+        int phase;
+        printf("Log rates (Hz, 255 every sample), %s:",page[LOG_SUPERBLOCK_AVERAGING] ? "averaged" : "newest sample");
+        for(phase=0;phase<LOG_PHASES;phase++){
+            printf(" %s IMU %d pressure %d%s",log_phase_names[phase],page[LOG_SUPERBLOCK_IMU_RATES + phase],
+                   page[LOG_SUPERBLOCK_BARO_RATES + phase],phase + 1 < LOG_PHASES ? "," : "\n");
+        }
+    }
+
+    //As do logs from before the log policy these.
+    if(page[LOG_SUPERBLOCK_CHANNELS] != 0xFF){
+        int phase;
+        printf("Log policy (channels, bits dropped IMU/pressure sensor):");
+        for(phase=0;phase<LOG_PHASES;phase++){
+            uint8_t precision = page[LOG_SUPERBLOCK_PRECISION + phase];
+            printf(" %s 0x%02X %d/%d%s",log_phase_names[phase],page[LOG_SUPERBLOCK_CHANNELS + phase],
+                   precision & 0x0F,precision >> 4,phase + 1 < LOG_PHASES ? "," : "\n");
+        }
+    }
+}
+
+//Prints the last timings in the log. The span and gauge numbers are those of utilities/profiler.h in the firmware.
+static void print_profile(const log_parser_stats *stats){
+
+    int id;
+    for(id=0;id<LOG_PROFILE_GAUGE;id++){
+        if(stats->have_profile[id]){
+            const uint32_t *v = stats->profile[id];
+            printf("Span %d: count %u min %u mean %u p99 %u max %u cycles\n",id,v[0],v[1],v[2],v[3],v[4]);
+        }
+    }
+    for(id=LOG_PROFILE_GAUGE;id<LOG_PROFILE_IDS;id++){
+        if(stats->have_profile[id]){
+            printf("Gauge %d: %u\n",id - LOG_PROFILE_GAUGE,stats->profile[id][0]);
+        }
+    }
+}
+
+//Goes through the pages in order to count them and report problems, like a sequential reader would.
+static void check_pages(const page_info *info, int end_page, int quiet, log_parser_stats *stats){
+
+    uint32_t expected = 1;
+    int n;
+    for(n=1;n<end_page;n++){
+
+        if(info[n].status == PAGE_BAD){
+            if(!quiet) printf("Skipping bad page %d.\n",n);
+            stats->bad_pages++;
+            continue;
+        }
+
+        if(info[n].sequence != expected){
+            if(!quiet) printf("Page %d has sequence %u, expected %u.\n",n,info[n].sequence,expected);
+            stats->gaps++;
+        }
+        expected = info[n].sequence + 1;
+
+        if(info[n].status == PAGE_TRUNCATED){
+            if(!quiet) printf("Record %d runs off page %d.\n",info[n].bad_record,n);
+            stats->bad_pages++;
+        }
+        if(info[n].phase < LOG_PHASES){
+            stats->phase_pages[info[n].phase]++;
+        }
+    }
+    stats->pages = end_page - 1;
+}
+
+int log_parser_decode_v2(const uint8_t *log, size_t size, FILE *csv, const char *columns, int threads, int quiet, log_parser_stats *stats){
+
+    memset(stats,0,sizeof(log_parser_stats));
+
+    if(size < LOG_PAGE_SIZE){
+        printf("Log too short for a superblock.\n");
+        return -1;
+    }
+    if(!quiet){
+        print_superblock(log);
+    }
+
+    //Pages sit at fixed offsets, so finding where to split only needs the first byte of each.
+    //A page of erased flash is the end of the log.
+    int end_page = 1;
+    while((size_t)(end_page + 1) * LOG_PAGE_SIZE <= size && log[(size_t)end_page * LOG_PAGE_SIZE] != 0xFF){
+        end_page++;
+    }
+    int pages = end_page - 1;
+
+    if(threads <= 0){
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(threads > pages){
+        threads = pages;
+    }
+    if(threads < 1){
+        threads = 1;
+    }
+
+    page_info *info = calloc(end_page,sizeof(page_info));
+    chunk *chunks = calloc(threads,sizeof(chunk));
+    if(info == NULL || chunks == NULL){
+        printf("Out of memory.\n");
+        free(info);
+        free(chunks);
+        return -1;
+    }
+
+    int i;
+    for(i=0;i<threads;i++){
+        chunks[i].log = log;
+        chunks[i].info = info;
+        chunks[i].first_page = 1 + (int)((int64_t)pages * i / threads);
+        chunks[i].end_page = 1 + (int)((int64_t)pages * (i + 1) / threads);
+    }
+
+    int result = 0;
+    run_chunks(chunks,threads,decode_chunk);
+    for(i=0;i<threads;i++){
+        result |= chunks[i].failed;
+    }
+
+    if(result == 0){
+        merge_chunks(chunks,threads);
+        if(csv != NULL){
+            run_chunks(chunks,threads,format_chunk);
+            for(i=0;i<threads;i++){
+                result |= chunks[i].failed;
+            }
+        }
+    }
+
+    if(result != 0){
+        printf("Out of memory.\n");
+        result = -1;
+    }else if(columns != NULL){
+        result = write_columns(chunks,threads,log,columns);
+    }
+
+    if(result == 0){
+        check_pages(info,end_page,quiet,stats);
+        for(i=0;i<threads;i++){
+            if(csv != NULL){
+                fwrite(chunks[i].text,1,chunks[i].text_length,csv);
+            }
+            stats->records += chunks[i].count;
+            stats->profiles += chunks[i].profiles;
+            int id;
+            for(id=0;id<LOG_PROFILE_IDS;id++){
+                if(chunks[i].have_profile[id]){
+                    stats->have_profile[id] = 1;
+                    memcpy(stats->profile[id],chunks[i].profile[id],sizeof(stats->profile[id]));
+                }
+            }
+        }
+        if(!quiet){
+            printf("Pages: %d bad pages: %d sequence gaps: %d records: %d profile records: %d\n",stats->pages,stats->bad_pages,stats->gaps,stats->records,stats->profiles);
+            if(log[LOG_SUPERBLOCK_CHANNELS] != 0xFF){
+                int phase;
+                printf("Pages per phase:");
+                for(phase=0;phase<LOG_PHASES;phase++){
+                    printf(" %s %d%s",log_phase_names[phase],stats->phase_pages[phase],phase + 1 < LOG_PHASES ? "," : "\n");
+                }
+            }
+            print_profile(stats);
+        }
+    }
+
+    for(i=0;i<threads;i++){
+        free(chunks[i].records);
+        free(chunks[i].text);
+    }
+    free(chunks);
+    free(info);
+    return result;
+}
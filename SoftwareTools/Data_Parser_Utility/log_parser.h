@@ -0,0 +1,74 @@
+#ifndef LOG_PARSER_H
+#define LOG_PARSER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//Parallel decoder for version 2 logs, see Documentation/DataFormatDescription.md.
+//
+//Every data page is self contained, so page boundaries are the resynchronisation points: the pages are split into one
+//chunk per thread and decoded at the same time. The little state that does run across pages (the running time, the
+//last pressure reading and the events so far) is filled in by one quick pass over the decoded records, then the CSV
+//text is formatted in parallel again and the chunks are written out in log order, which is timestamp order.
+
+#define LOG_PAGE_SIZE			256
+#define LOG_SUPERBLOCK_MAGIC	"UMSL"
+#define LOG_PAGE_MARKER			0xA5
+#define LOG_PAGE_HEADER_SIZE	7
+#define LOG_PAGE_SEQUENCE		2
+#define LOG_PAGE_FIRST_RECORD	6
+#define LOG_PAGE_PHASE			7       //Pages with their first record from LOG_PAGE_POLICY_END on have the phase...
+#define LOG_PAGE_CHANNELS		8       //...the channels their records hold...
+#define LOG_PAGE_PRECISION		9       //...and the low bits dropped from them. Older pages hold every channel in full.
+#define LOG_PAGE_POLICY_END		10
+#define LOG_PAGE_CRC			(LOG_PAGE_SIZE - 4)
+#define LOG_RECORD_IMU			0x80
+#define LOG_RECORD_BARO			0x40
+#define LOG_RECORD_EVENTS		0x20
+#define LOG_RECORD_PROFILE		0x10    //Timings, not written to the CSV. Only the last of each is kept.
+#define LOG_PROFILE_GAUGE		0x40    //Ids below this are spans with 5 values, the ones from here gauges with 1.
+#define LOG_PROFILE_IDS			0x80
+#define LOG_PROFILE_VALUES		5
+#define LOG_PHASES				5       //Pad, ascent, drogue, main and landed, as log_phase in the firmware.
+#define LOG_SUPERBLOCK_IMU_RATES	24      //IMU log rate of each phase.
+#define LOG_SUPERBLOCK_BARO_RATES	29      //Pressure log rate of each phase.
+#define LOG_SUPERBLOCK_AVERAGING	34      //1 if the logged values are averages, 0 if they are the newest sample.
+#define LOG_SUPERBLOCK_CHANNELS	35      //Channels of each phase.
+#define LOG_SUPERBLOCK_PRECISION	40      //Low bits dropped in each phase, IMU in the low nibble, pressure sensor in the high.
+#define LOG_CHANNEL_ACC			0x01
+#define LOG_CHANNEL_GYRO		0x02
+#define LOG_CHANNEL_PRESSURE	0x04
+#define LOG_CHANNEL_TEMPERATURE	0x08
+#define LOG_CHANNEL_ALTITUDE	0x10
+#define LOG_CHANNELS_ALL		0x1F
+
+typedef struct{
+
+    int pages;
+    int bad_pages;
+    int gaps;
+    int records;
+    int profiles;
+    int phase_pages[LOG_PHASES];    //Pages written in each phase, for logs that record it.
+    int have_profile[LOG_PROFILE_IDS];
+    uint32_t profile[LOG_PROFILE_IDS][LOG_PROFILE_VALUES];  //Last profile record of each id, in log order.
+
+} log_parser_stats;
+
+//Same CRC-32 as the flight computer (and zlib).
+uint32_t log_parser_crc32(const uint8_t *data, size_t size);
+
+//Maps a whole file read only. Returns NULL if it can not be opened or is empty.
+const uint8_t *log_parser_map(const char *path, size_t *size);
+void log_parser_unmap(const uint8_t *data, size_t size);
+
+//Decodes the log that starts with the superblock at log and writes the CSV rows to csv.
+//If columns is not NULL, also writes <columns>.columns, one contiguous little endian array per channel, and
+//<columns>.json, which lists the arrays with their numpy dtype and offset so they can be loaded with numpy.memmap.
+//Either output can be NULL.
+//threads is the number of threads to use, 0 for one per core. Prints what it finds about the log unless quiet is set.
+//Returns 0 on success.
+int log_parser_decode_v2(const uint8_t *log, size_t size, FILE *csv, const char *columns, int threads, int quiet, log_parser_stats *stats);
+
+#endif // LOG_PARSER_H
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "log_parser.h"
+
+//Times the version 2 parser on a synthetic log that looks like a flight: IMU at the data rate, pressure every second
+//record and a few events. Usage: ./parser_benchmark [megabytes] [name]
+//
+//With a name, it instead times writing <name>.csv and the columnar <name>.columns/<name>.json separately, for
+//columns_benchmark.py to compare loading them.
+
+#define RECORD_MAX_SIZE     (1 + 1 + 5 + 6 * 3 + 3 * 5)
+
+static uint8_t *put_varint(uint8_t *out, uint32_t value){
+
+    while(value >= 0x80){
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static uint8_t *put_delta(uint8_t *out, int32_t delta){
+    return put_varint(out,((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+static void put_be32(uint32_t value, uint8_t *out){
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static void seal_page(uint8_t *page, uint32_t sequence){
+    put_be32(sequence,&page[LOG_PAGE_SEQUENCE]);
+    put_be32(log_parser_crc32(page,LOG_PAGE_CRC),&page[LOG_PAGE_CRC]);
+}
+
+static void start_page(uint8_t *page){
+    memset(page,0xFF,LOG_PAGE_SIZE);
+    page[0] = LOG_PAGE_MARKER;
+    page[1] = 0;
+    page[LOG_PAGE_FIRST_RECORD] = LOG_PAGE_HEADER_SIZE;
+}
+
+//Fills log with a superblock and data pages, like the flight computer's encoder would.
+static void generate_log(uint8_t *log, size_t size){
+
+    size_t pages = size / LOG_PAGE_SIZE;
+    memset(log,0xFF,size);
+    memcpy(log,LOG_SUPERBLOCK_MAGIC,4);
+    log[4] = 2;
+    log[5] = 100;
+    memset(&log[6],0,18);
+    put_be32(log_parser_crc32(log,LOG_PAGE_CRC),&log[LOG_PAGE_CRC]);
+
+    srand(1);
+    uint32_t time_us = 0;
+    uint32_t i = 0;
+    size_t n;
+    for(n=1;n<pages;n++){
+
+        uint8_t *page = log + n * LOG_PAGE_SIZE;
+        start_page(page);
+        int length = LOG_PAGE_HEADER_SIZE;
+        uint32_t last_time = 0;
+        int16_t last_acc[3] = {0,0,0};
+        int16_t last_gyro[3] = {0,0,0};
+        int32_t last_baro[3] = {0,0,0};
+
+        while(length + RECORD_MAX_SIZE <= LOG_PAGE_CRC && page[1] < 255){
+
+            uint8_t record[RECORD_MAX_SIZE];
+            uint8_t *out = record;
+            int baro = (i % 2) == 0;
+            uint8_t events = (i % 50000) == 0 ? 1 << (i / 50000 % 8) : 0;
+
+            time_us += 10000 + rand() % 50;
+            *out++ = LOG_RECORD_IMU | (baro ? LOG_RECORD_BARO : 0) | (events ? LOG_RECORD_EVENTS : 0);
+            if(events){
+                *out++ = events;
+            }
+            out = put_varint(out,time_us - last_time);
+            last_time = time_us;
+
+            int k;
+            for(k=0;k<3;k++){
+                int16_t acc = (int16_t)(2000 * sin(i * 0.01 + k) + rand() % 60 - 30);
+                out = put_delta(out,acc - last_acc[k]);
+                last_acc[k] = acc;
+            }
+            for(k=0;k<3;k++){
+                int16_t gyro = (int16_t)(rand() % 40 - 20);
+                out = put_delta(out,gyro - last_gyro[k]);
+                last_gyro[k] = gyro;
+            }
+            if(baro){
+                int32_t baro_values[3] = {10132500 - (int32_t)i * 3 + rand() % 20, 2500 + rand() % 3, (int32_t)i / 4};
+                for(k=0;k<3;k++){
+                    out = put_delta(out,baro_values[k] - last_baro[k]);
+                    last_baro[k] = baro_values[k];
+                }
+            }
+
+            memcpy(&page[length],record,out - record);
+            length += out - record;
+            page[1]++;
+            i++;
+        }
+
+        seal_page(page,n);
+    }
+}
+
+static double now(){
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run(const uint8_t *log, size_t size, int threads, FILE *out){
+
+    log_parser_stats stats;
+    double start = now();
+    if(log_parser_decode_v2(log,size,out,NULL,threads,1,&stats) != 0){
+        return -1;
+    }
+    double seconds = now() - start;
+
+    printf("%2d thread(s): %8.1f MB/s  (%d pages, %d records, %.3f s)\n",threads,size / seconds / 1e6,stats.pages,stats.records,seconds);
+    return stats.bad_pages == 0 ? stats.records : -1;
+}
+
+static int export_outputs(const uint8_t *log, size_t size, const char *name){
+
+    char path[1024];
+    log_parser_stats stats;
+
+    snprintf(path,sizeof(path),"%s.csv",name);
+    FILE *csv = fopen(path,"w");
+    if(csv == NULL){
+        printf("Could not open %s.\n",path);
+        return -1;
+    }
+    double start = now();
+    int result = log_parser_decode_v2(log,size,csv,NULL,0,1,&stats);
+    fclose(csv);
+    double csv_seconds = now() - start;
+
+    start = now();
+    result |= log_parser_decode_v2(log,size,NULL,name,0,1,&stats);
+    double columns_seconds = now() - start;
+
+    if(result != 0){
+        printf("Decoding failed.\n");
+        return -1;
+    }
+    printf("records %d\n",stats.records);
+    printf("csv_parse_seconds %.3f\n",csv_seconds);
+    printf("columns_parse_seconds %.3f\n",columns_seconds);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 8;
+    size_t size = megabytes * 1000000 / LOG_PAGE_SIZE * LOG_PAGE_SIZE;
+    uint8_t *log = malloc(size);
+    FILE *out = fopen("/dev/null","w");
+    if(log == NULL || out == NULL || size < 2 * LOG_PAGE_SIZE){
+        printf("Could not set up a %zu MB log.\n",megabytes);
+        return -1;
+    }
+
+    generate_log(log,size);
+    if(argc > 2){
+        return export_outputs(log,size,argv[2]);
+    }
+    printf("Synthetic log: %zu bytes\n",size);
+
+    int cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int records = run(log,size,1,out);
+    if(records < 0){
+        printf("Decoding failed.\n");
+        return -1;
+    }
+    if(cores > 1 && run(log,size,cores,out) != records){
+        printf("The parallel run decoded a different log.\n");
+        return -1;
+    }
+
+    fclose(out);
+    free(log);
+    return 0;
+}
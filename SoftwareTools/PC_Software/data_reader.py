@@ -5,10 +5,86 @@
 #   History
 #   2018-05 by Joseph Howarth.
 #       -   Created.
+#   2019-06-22 by Joseph Howarth.
+#       -   Added the framed download (see Documentation/DownloadProtocol.md).
 
+import datetime
+import os
 import serial
 import serial.tools.list_ports as list_ports
+import struct
 import time
+import zlib
+
+# Framed download, these match Inc/tasks/download.h.
+FRAME_SYNC = b'\x55\xaa'
+FRAME_HEADER = struct.Struct('>2sBBHII')    # sync, type, flags, payload length, sequence, offset
+FRAME_CRC_SIZE = 4
+FRAME_PAYLOAD_MAX = 1024
+FRAME_START, FRAME_INFO, FRAME_DATA, FRAME_ACK, FRAME_NAK, FRAME_END, FRAME_ABORT = range(1, 8)
+
+# The formater skips the first two lines of a log.
+DOWNLOAD_HEADER_LINES = 2
+
+
+def build_frame(frame_type, offset, payload=b'', sequence=0):
+    header = FRAME_HEADER.pack(FRAME_SYNC, frame_type, 0, len(payload), sequence, offset)
+    return header + payload + struct.pack('>I', zlib.crc32(header + payload))
+
+
+class FrameReader:
+    """
+    Collects bytes from the serial port and hands out the frames with a good CRC.
+    Anything else, like CLI text, is skipped.
+    """
+
+    def __init__(self, port):
+        self.port = port
+        self.buffer = bytearray()
+
+    def reset(self):
+        self.buffer = bytearray()
+
+    def read(self, timeout):
+        """
+        Returns (type, sequence, offset, payload), or None if no frame arrived within timeout seconds.
+        """
+
+        deadline = time.time() + timeout
+        while True:
+            frame = self._parse()
+            if frame is not None:
+                return frame
+            if time.time() > deadline:
+                return None
+            self.buffer += self.port.read(max(1, self.port.in_waiting))
+
+    def _parse(self):
+        while True:
+            start = self.buffer.find(FRAME_SYNC)
+            if start < 0:
+                del self.buffer[:-1]
+                return None
+            del self.buffer[:start]
+            if len(self.buffer) < FRAME_HEADER.size:
+                return None
+
+            _, frame_type, _, length, sequence, offset = FRAME_HEADER.unpack_from(self.buffer)
+            if length > FRAME_PAYLOAD_MAX:
+                del self.buffer[0]
+                continue
+
+            size = FRAME_HEADER.size + length + FRAME_CRC_SIZE
+            if len(self.buffer) < size:
+                return None
+            crc, = struct.unpack_from('>I', self.buffer, FRAME_HEADER.size + length)
+            if crc != zlib.crc32(bytes(self.buffer[:FRAME_HEADER.size + length])):
+                del self.buffer[0]
+                continue
+
+            payload = bytes(self.buffer[FRAME_HEADER.size:FRAME_HEADER.size + length])
+            del self.buffer[:size]
+            return frame_type, sequence, offset, payload
 
 
 class SerialFunctions:
@@ -57,6 +133,112 @@ class SerialFunctions:
 
         self.s.flush()
 
+    def download(self, filename, baudrate=921600, window=8, chunk=1024, resume=True):
+        """
+        Downloads the log with the flight computer's 'download' command into filename.
+        The file starts with two header lines, like a 'read' log, so the formater takes either.
+        If resume is set and filename already holds part of the log, only the rest is downloaded.
+        Returns True once the whole log is in the file.
+        """
+
+        self.close_log()
+        offset = 0
+        if resume and os.path.exists(filename):
+            with open(filename, 'rb') as f:
+                header = b''.join(f.readline() for _ in range(DOWNLOAD_HEADER_LINES))
+                if header.endswith(b'\n') and header.count(b'\n') == DOWNLOAD_HEADER_LINES:
+                    offset = os.path.getsize(filename) - len(header)
+
+        log = open(filename, 'r+b' if offset > 0 else 'wb')
+        if offset > 0:
+            log.seek(0, os.SEEK_END)
+        else:
+            log.write(datetime.date.today().strftime("%I:%M%p on %B %d, %Y").encode('ascii') + b'\n')
+            log.write(b'UMSATS framed download\n')
+
+        default_baudrate = self.s.baudrate
+        frames = FrameReader(self.s)
+        start = struct.pack('>IHH', baudrate, window, chunk)
+        done = False
+
+        try:
+            self.s.reset_input_buffer()
+            self.write('download\r')
+
+            info = None
+            for _ in range(30):
+                self.s.write(build_frame(FRAME_START, offset, start))
+                info = frames.read(1.0)
+                while info is not None and info[0] != FRAME_INFO:
+                    info = frames.read(1.0)
+                if info is not None:
+                    break
+            if info is None:
+                print('The flight computer did not answer.')
+                return False
+
+            total, new_baudrate, window, chunk = struct.unpack('>IIHH', info[3])
+            offset = info[2]
+            print('Log is {} bytes, downloading from {} at {} baud.'.format(total, offset, new_baudrate))
+
+            # The flight computer switches a few ms after INFO, keep acknowledging until data arrives.
+            time.sleep(0.005)
+            self.s.baudrate = new_baudrate
+            frames.reset()
+
+            started = time.time()
+            nak_sent = None
+            last_report = started
+            frame = None
+            for _ in range(20):
+                self.s.write(build_frame(FRAME_ACK, offset))
+                frame = frames.read(0.1)
+                if frame is not None:
+                    break
+
+            while frame is not None:
+                frame_type, _, frame_offset, payload = frame
+                if frame_type == FRAME_DATA:
+                    if frame_offset == offset:
+                        log.write(payload)
+                        offset += len(payload)
+                        nak_sent = None
+                        self.s.write(build_frame(FRAME_ACK, offset))
+                    elif frame_offset > offset:
+                        # Something in between got lost, ask once per gap.
+                        if nak_sent != offset:
+                            self.s.write(build_frame(FRAME_NAK, offset))
+                            nak_sent = offset
+                    else:
+                        self.s.write(build_frame(FRAME_ACK, offset))
+                elif frame_type == FRAME_END:
+                    self.s.write(build_frame(FRAME_ACK, offset))
+                    done = offset == total
+                    # Answer END again in case that ACK gets lost.
+                    while frames.read(0.6) is not None:
+                        self.s.write(build_frame(FRAME_ACK, offset))
+                    break
+                elif frame_type == FRAME_ABORT:
+                    break
+
+                if time.time() - last_report > 1.0:
+                    last_report = time.time()
+                    print('{:.0f}%  {:.1f} kB/s'.format(100.0 * offset / max(total, 1),
+                                                        (offset - info[2]) / (last_report - started) / 1000))
+                frame = frames.read(2.0)
+
+            seconds = time.time() - started
+            print('Downloaded {} bytes in {:.1f} s.'.format(offset - info[2], seconds))
+            if not done:
+                print('Download stopped at {} of {} bytes, run it again to resume.'.format(offset, total))
+            return done
+
+        finally:
+            log.close()
+            self.s.flush()
+            time.sleep(0.02)
+            self.s.baudrate = default_baudrate
+
 def list_COM_ports():
     """
     This function lists all available com ports and returns a list of the names.
@@ -0,0 +1,60 @@
+#
+#   File Description:
+#       This file loads the columnar output of the Data Parser Utility (flightComputer.json and
+#       flightComputer.columns). Every channel is a numpy.memmap straight onto the file, so loading
+#       takes no time and only the parts that are used get read from disk.
+#
+#   History
+#   2019-06-20 by Joseph Howarth.
+#       -   Created.
+
+import json
+import os
+
+import numpy as np
+
+
+def load_flight(json_path='flightComputer.json'):
+    """
+    Returns a dict of channel name -> numpy array, plus the metadata under 'meta'.
+    The channels are: time (us), acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z,
+    pressure, temperature, altitude (m) and events.
+    """
+
+    with open(json_path) as f:
+        meta = json.load(f)
+
+    if meta.get('format') != 'umsats-columns' or meta.get('version') != 1:
+        raise ValueError('{} is not a version 1 columns file.'.format(json_path))
+
+    data_path = os.path.join(os.path.dirname(json_path), meta['data'])
+    records = meta['records']
+
+    flight = {'meta': meta}
+    for column in meta['columns']:
+        if records == 0:
+            flight[column['name']] = np.zeros(0, dtype=column['dtype'])
+        else:
+            flight[column['name']] = np.memmap(data_path, dtype=column['dtype'], mode='r',
+                                               offset=column['offset'], shape=(records,))
+
+    return flight
+
+
+def flight_as_rows(flight, labels):
+    """
+    Returns the flight as one float64 row per channel, in the order of labels (name -> row index),
+    the same layout generate_plotly builds from the csv. The time is in milliseconds, like the csv.
+    """
+
+    names = {'time': 'time', 'acceleration_x': 'acc_x', 'acceleration_y': 'acc_y',
+             'acceleration_z': 'acc_z', 'rotation_x': 'gyro_x', 'rotation_y': 'gyro_y',
+             'rotation_z': 'gyro_z', 'pressure': 'pressure', 'temperature': 'temperature',
+             'altitude': 'altitude', 'events': 'events'}
+
+    data = np.empty((len(labels), flight['meta']['records']), dtype='float64')
+    for label, row in labels.items():
+        data[row] = flight[names[label]]
+    data[labels['time']] /= 1000.0
+
+    return data
@@ -15,12 +15,15 @@ import plotly.offline as ply
 # sheet = book.sheet_by_index(0) #data is on sheet 1
 
 import csv
+import os
 import numpy as np
+import flight_columns
 from urllib3.packages.rfc3986.parseresult import authority_from
 
 
 def plot_data():
     DATA_FILE_PATH = 'flightComputer.csv'
+    COLUMNS_FILE_PATH = 'flightComputer.json'
 
     DATA_LABELS = {'time':0,'acceleration_x':1,'acceleration_y':2,'acceleration_z':3,'rotation_x':4,'rotation_y':5,'rotation_z':6,'pressure':7,'temperature':8,'altitude':9,'events':10}
 
@@ -46,26 +49,30 @@ def plot_data():
 
     data = []
     stop_time = 0;
-    with open(DATA_FILE_PATH, newline='') as csvfile:
-        data_reader = csv.reader(csvfile, delimiter=',', quotechar='|')
+    if os.path.exists(COLUMNS_FILE_PATH):
+        #The parser also writes the flight as binary columns, which load without parsing any text.
+        data = flight_columns.flight_as_rows(flight_columns.load_flight(COLUMNS_FILE_PATH), DATA_LABELS)
+    else:
+        with open(DATA_FILE_PATH, newline='') as csvfile:
+            data_reader = csv.reader(csvfile, delimiter=',', quotechar='|')
 
 
-        for n,row in enumerate(data_reader):
+            for n,row in enumerate(data_reader):
 
-            if n == 0:
-                print(len(row))
-                for i in range(len(row)):
-                    data.append([])
+                if n == 0:
+                    print(len(row))
+                    for i in range(len(row)):
+                        data.append([])
 
-            for i in range(len(row)):
+                for i in range(len(row)):
 
-                try:
-                    data[i].append(int(row[i]))
+                    try:
+                        data[i].append(int(row[i]))
 
 
-                except:
-                    data[i].append(float(row[i]))
-    data = np.array(data)
+                    except:
+                        data[i].append(float(row[i]))
+        data = np.array(data)
     data = data.astype('float64')
     print(data[DATA_LABELS['pressure']])
 
@@ -1,4 +1,5 @@
 import datetime
+import os
 from data_reader import SerialFunctions
 import threading
 import sys
@@ -75,6 +76,8 @@ def run(num_args,com,baudRate,outName):
         baud_rate   Integer specifying the baud rate for serial communication. 
         log_file    String containing the name of the log file. Should be of the format: "logFileName.log"
 
+    To download faster, with CRC checks and resume:  python serialReader.py download com_port log_file [baud_rate]
+
             ''')
         sys.exit()
 
@@ -121,7 +124,24 @@ def run(serialObj):
     return serialThread, mutex
 
 
+def download(com, outName, baudRate=921600):
+    '''
+    Downloads the log with the flight computer's framed 'download' command. The CLI runs at 115200 baud,
+    baudRate is the rate asked for during the download. Running it again on the same file resumes it.
+    '''
+
+    S = SerialFunctions(115200, com, os.devnull)
+    try:
+        return S.download(outName, baudrate=baudRate)
+    finally:
+        S.close()
+
+
 if __name__ == "__main__":
 
+    if len(sys.argv) >= 4 and sys.argv[1] == "download":
+        # python serialReader.py download COM3 flight.log [baud_rate]
+        ok = download(sys.argv[2], sys.argv[3], int(sys.argv[4]) if len(sys.argv) > 4 else 921600)
+        sys.exit(0 if ok else 1)
 
     run(len(sys.argv),sys.argv[1],sys.argv[2],sys.argv[3])
\ No newline at end of file